@@ -1,8 +1,6 @@
 #ifndef __AB_API_H__
 #define __AB_API_H__
 
-/** Maximum channels on the boards */
-#define CHANS_MAX 32
 /*{{{ typedefs */
 typedef enum ab_dev_type_e ab_dev_type_t;
 typedef enum cod_type_e cod_type_t;
@@ -16,6 +14,9 @@ typedef struct ab_dev_s ab_dev_t;
 typedef struct ab_s ab_t;
 typedef struct ab_fw_s ab_fw_t;
 typedef struct ab_dev_event_s ab_dev_event_t;
+typedef struct ab_backend_s ab_backend_t;
+typedef struct ab_tone_s ab_tone_t;
+typedef struct ab_tone_zone_s ab_tone_zone_t;
 /*}}}*/
 
 enum jb_type_e {/*{{{*/
@@ -127,7 +128,8 @@ enum ab_chan_tone_e {/*{{{*/
 	ab_chan_tone_MUTE, /**< Mute any tone */
 	ab_chan_tone_DIAL,   /**< Play dial tone */
 	ab_chan_tone_BUSY,   /**< Play busy tone */
-	ab_chan_tone_RINGBACK   /**< Play ringback tone */
+	ab_chan_tone_RINGBACK,   /**< Play ringback tone */
+	ab_chan_tone_COUNT   /**< Tones count */
 };/*}}}*/
 enum ab_chan_ring_e {/*{{{*/
 	ab_chan_ring_MUTE, /**< Mute the ring */
@@ -153,6 +155,7 @@ enum ab_dev_event_e {/*{{{*/
 	ab_dev_event_FM_CED, /**< CED and CEDEND FAX events */
 	ab_dev_event_COD, /**< Coder event */
 	ab_dev_event_TONE, /**< Tone generator event */
+	ab_dev_event_COUNT /**< Number of event types (not an event) */
 };/*}}}*/
 enum vf_type_e {/*{{{*/
 	vf_type_DEFAULT = 0,
@@ -220,6 +223,22 @@ struct ab_chan_stat_s {/*{{{*/
 	struct ab_chan_jb_stat_s jb_stat; /**< Jitter Buffer statistics */
 	struct ab_chan_rtcp_stat_s rtcp_stat; /**< RTCP statistics */
 };/*}}}*/
+/** Channel configurations guarded by the last applied state */
+enum ab_chan_cfg_e {/*{{{*/
+	ab_chan_cfg_RING, /**< Ring start / stop */
+	ab_chan_cfg_TONE, /**< Local tone play / stop */
+	ab_chan_cfg_LINEFEED, /**< Linefeed mode */
+	ab_chan_cfg_HOOK, /**< FXO hook state */
+	ab_chan_cfg_CODER, /**< Payload table, rtp, enc/dec, vad, gains, hpf */
+	ab_chan_cfg_JB, /**< Jitter buffer configuration */
+	ab_chan_cfg_WLEC, /**< Echo canceller configuration */
+	ab_chan_cfg_COUNT, /**< Configurations count */
+};/*}}}*/
+struct ab_chan_cfg_stat_s {/*{{{*/
+	unsigned long applied [ab_chan_cfg_COUNT]; /**< ioctls made */
+	unsigned long suppressed [ab_chan_cfg_COUNT]; /**< ioctls skipped as
+			the parameters are already set */
+};/*}}}*/
 struct ab_chan_s {/*{{{*/
 	unsigned int idx;   /**< Channel index on device (from 1) */
 	unsigned char abs_idx; /**< Channel index on boards (from 0) */
@@ -227,8 +246,10 @@ struct ab_chan_s {/*{{{*/
 	enum vf_type_e type_if_vf; /**< VF type if it is VF channel (see parent type)*/
 	enum cid_std_e cid_std; /**<Caller id standard */
 	int rtp_fd;         /**< Channel file descriptor */
+	int be_fd; /**< Backend side of the channel to pass with rtp_fd (-1 if none) */
 	struct ab_chan_status_s status;  /**< Channel status info */
 	struct ab_chan_stat_s statistics; /**< Jitter Buffer and RTCP statistics */
+	struct ab_chan_cfg_stat_s cfg_stat; /**< Applied / suppressed ioctls */
 	void * ctx; /**< Channel context pointer (for user app) */
 };/*}}}*/
 struct ab_dev_s {/*{{{*/
@@ -237,14 +258,49 @@ struct ab_dev_s {/*{{{*/
 	ab_t * parent;		/**< Parent board pointer */
 	int cfg_fd;         /**< Device config file descriptor */
 	void * ctx; /**< Device context (for user app) */
+	unsigned long evt_gets; /**< Backend calls to get the events */
+};/*}}}*/
+enum ab_start_phase_e {/*{{{*/
+	ab_start_phase_OPEN, /**< Device nodes open and channels init */
+	ab_start_phase_FW, /**< Firmware fingerprint and download */
+	ab_start_phase_DEV_START, /**< DSP start */
+	ab_start_phase_BBD, /**< Coefficients download */
+	ab_start_phase_CHANS, /**< Channels setup */
+	ab_start_phase_COUNT, /**< Phases count */
+};/*}}}*/
+struct ab_start_stat_s {/*{{{*/
+	unsigned char warm; /**< DSP was running the same images, they are reused */
+	unsigned long phase_us [ab_start_phase_COUNT]; /**< Time of the phases */
+	unsigned long total_us; /**< Time of the whole ab_create (open and start) */
 };/*}}}*/
 struct ab_s {/*{{{*/
 	unsigned int devs_num;	/**< Devices number on the boards */
 	ab_dev_t * devs;	/**< Devices of the boards */
 	unsigned int chans_num;	/**< Channels number on the boards */
 	ab_chan_t * chans;	/**< Channels of the boards according to idx */
-	ab_chan_t * pchans[CHANS_MAX]; /**< Pointers to channels according to abs_idx*/
+	ab_chan_t ** pchans; /**< Pointers to channels according to abs_idx (chans_num items)*/
 	unsigned int chans_per_dev;/**< Channels number per device */
+	ab_backend_t const * be; /**< Backend operations */
+	void * be_ctx; /**< Backend context */
+	struct ab_start_stat_s start; /**< Startup phases timings */
+	unsigned char keep_dsp; /**< Destroy leaves the DSP running (restart) */
+};/*}}}*/
+/** Maximum steps (cadence parts) of the tone */
+#define AB_TONE_STEPS_MAX 6
+struct ab_tone_step_s {/*{{{*/
+	unsigned int freq1; /**< First frequency (Hz), 0 - none */
+	unsigned int freq2; /**< Second frequency (Hz), 0 - none */
+	unsigned int time; /**< Step duration (ms) */
+	unsigned char modulate; /**< freq1 is modulated by freq2 */
+};/*}}}*/
+struct ab_tone_s {/*{{{*/
+	unsigned char steps_num; /**< Steps count */
+	struct ab_tone_step_s steps [AB_TONE_STEPS_MAX]; /**< Steps */
+};/*}}}*/
+struct ab_tone_zone_s {/*{{{*/
+	char const * name; /**< Zone name (country code, "it", "us", ...) */
+	char const * country; /**< Country name (for logs) */
+	ab_tone_t tones [ab_chan_tone_COUNT]; /**< Tones, MUTE is empty */
 };/*}}}*/
 
 /* ERROR HANDLING *//*{{{*/
@@ -261,15 +317,34 @@ struct ab_s {/*{{{*/
 /** Hardware problem */
 #define AB_ERR_NO_HARDWARE  5
 
-/** global error characteristic string length */
+/** error characteristic string length */
 #define ERR_STR_LENGTH		256
 
+/** Update ab_g_err_* globals on errors (compatibility, not thread safe).
+ * Off by default: the globals cost a string format on every error.
+ * Legacy applications that read ab_g_err_* build libab and themselves
+ * with -DAB_ERR_GLOBALS=1. */
+#ifndef AB_ERR_GLOBALS
+#define AB_ERR_GLOBALS 0
+#endif
+
+#if AB_ERR_GLOBALS
 /** global error index */
 extern int ab_g_err_idx;
 /** global error characteristic string */
 extern char ab_g_err_str[ERR_STR_LENGTH];
 /** global error extra value (using in some cases) */
 extern int ab_g_err_extra_value;
+#endif
+
+/** Error index of the last failed call in this thread */
+int ab_err_idx (void);
+/** Error message of the last failed call in this thread */
+char const * ab_err_str (void);
+/** Error extra value of the last failed call in this thread */
+int ab_err_extra (void);
+/** Reset the error of this thread */
+void ab_err_clear (void);
 /*}}}*/
 
 /** @defgroup AB_BASIC ACTIONS Basic libab interface
@@ -300,12 +375,47 @@ extern int ab_g_err_extra_value;
 /** Firmware CRAM for VF transit 4-wired channel */
 #define AB_FW_CRAM_VFT4_NAME "/lib/firmware/cramfw_vft4.bin"
 
+/** Backends of the ab_t object */
+enum ab_backend_e {/*{{{*/
+	ab_backend_TAPI, /**< vmmc devices (Danube boards) */
+	ab_backend_SIM,  /**< Simulated channels (build host tests) */
+};/*}}}*/
+
+/** TAPI backend: download firmware even if the DSP runs it (environment) */
+#define AB_COLD_START_ENV "AB_COLD_START"
+/** TAPI backend: fingerprint of the images the DSP runs */
+#define AB_DSP_FP_PATH "/var/run/ab_dsp.fp"
+/** Startup phases names (see \ref ab_start_phase_e) */
+extern char const * const ab_start_phase_name [ab_start_phase_COUNT];
+
+/** Tone zone of the board after ab_create (the libab tones of the past) */
+#define AB_TONE_ZONE_DF "it"
+
+/** Simulated backend: channels count (environment, default 2) */
+#define AB_SIM_CHANS_ENV "AB_SIM_CHANS"
+/** Simulated backend: control socket path (environment) */
+#define AB_SIM_CTL_ENV "AB_SIM_CTL"
+/** Simulated backend: default control socket path */
+#define AB_SIM_CTL_DF "/tmp/ab_sim.ctl"
+
 /** Basic drivers loading and hardware initialization */
 // int ab_hardware_init (enum vf_type_e * const types, int const flags);
 /** Create the ab_t object */
 ab_t* ab_create (void);
+/** Create the ab_t object on the given backend */
+ab_t* ab_create_backend (enum ab_backend_e const backend);
+/** Create the ab_t object on the given backend without starting the board */
+ab_t* ab_create_open (enum ab_backend_e const backend);
+/** Start the board created with ab_create_open */
+int ab_start (ab_t * const ab);
+/** Create the ab_t object on the descriptors of the running board */
+ab_t* ab_create_adopt (enum ab_backend_e const backend,
+		int const * const fds, int const fds_num, int const * const be_fds,
+		unsigned char const * const media_up);
 /** Destroy the ab_t object */
 void ab_destroy (ab_t ** ab);
+/** Destroy the ab_t object, the DSP keeps running for the next start */
+void ab_destroy_keep (ab_t ** ab);
 /** Init channel with given CRAM file */
 //int ab_chan_cram_init (ab_chan_t const * const chan, char const * const path);
 /** Init device gpio with given channel types */
@@ -320,6 +430,15 @@ void ab_destroy (ab_t ** ab);
 int ab_FXS_line_ring( ab_chan_t * const chan, enum ab_chan_ring_e ring, char * number, char * name );
 /** Setup tone from asterisk playlist string */
 int ab_FXS_set_tone( ab_chan_t * const chan, enum ab_chan_tone_e tone, const char * playlst);
+/** Compile asterisk playlist string to the tone */
+int ab_tone_parse( char const * const playlst, ab_tone_t * const tone );
+/** Find the tone zone by name */
+ab_tone_zone_t const * ab_tone_zone_find( char const * const name );
+/** Get the tone zone by index (NULL after the last one) */
+ab_tone_zone_t const * ab_tone_zone_get( int const idx );
+/** Program the tone to the device tone table */
+int ab_dev_set_tone( ab_dev_t * const dev, enum ab_chan_tone_e tone,
+		ab_tone_t const * const t );
 /** Play tone or mute it */
 int ab_FXS_line_tone( ab_chan_t * const chan, enum ab_chan_tone_e tone );
 /** Change linefeed mode */
@@ -345,6 +464,12 @@ int ab_dev_event_get(
 		ab_dev_t * const dev, 
 		ab_dev_event_t * const evt, 
 		unsigned char * const chan_available );
+/** Get all pending events on given device in one pass */
+int ab_dev_event_get_batch( 
+		ab_dev_t * const dev, 
+		ab_dev_event_t * const evts, 
+		unsigned char * const chans_available,
+		int const max );
 /** @} */
 /*}}}*/
 
@@ -372,6 +497,8 @@ int ab_chan_media_jb_refresh( ab_chan_t * const chan );
 int ab_chan_media_rtcp_refresh( ab_chan_t * const chan );
 /** Set Caller id standard of the channel */
 int ab_chan_cid_standard( ab_chan_t * const chan, const cid_std_t std);
+/** Forget the last applied configuration of the channel */
+void ab_chan_cfg_invalidate( ab_chan_t * const chan );
 /** @} */
 /*}}}*/
 
@@ -0,0 +1,482 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ab_api.h"
+#include "ab_err.h"
+#include "ab_backend.h"
+
+/** Backend of ab_create() */
+#ifdef AB_NO_TAPI
+#define AB_BACKEND_DF ab_backend_SIM
+#else
+#define AB_BACKEND_DF ab_backend_TAPI
+#endif
+
+/** Startup phases names */
+char const * const ab_start_phase_name [ab_start_phase_COUNT] = {
+	"open", "firmware", "dev_start", "bbd", "chans",
+};
+
+/** Backend of the channel */
+#define CHAN_BE(chan) ((chan)->parent->parent->be)
+
+/**
+	Create the ab_t object on the default backend. 
+\return
+	Pointer to created object or NULL if something nasty happens.
+\remark
+	Default backend is TAPI, or the simulated one if libab is built
+	with AB_NO_TAPI.
+*/
+ab_t* 
+ab_create( void )
+{/*{{{*/
+	return ab_create_backend (AB_BACKEND_DF);
+}/*}}}*/
+
+/**
+	Get the operations of the backend.
+\param [in] backend - backend to use
+\return
+	Operations or NULL if the backend is not built in.
+*/
+static struct ab_backend_s const *
+ab_backend_get( enum ab_backend_e const backend )
+{/*{{{*/
+	if       (backend == ab_backend_SIM){
+		return &ab_backend_sim;
+#ifndef AB_NO_TAPI
+	} else if(backend == ab_backend_TAPI){
+		return &ab_backend_tapi;
+#endif
+	}
+	ab_err_set(AB_ERR_BAD_PARAM, "backend is not built in");
+	return NULL;
+}/*}}}*/
+
+/** Microseconds between two monotonic times */
+static unsigned long
+ab_elapsed_us( struct timespec const * const t0, struct timespec const * const t1 )
+{/*{{{*/
+	return (t1->tv_sec - t0->tv_sec) * 1000000L +
+			(t1->tv_nsec - t0->tv_nsec) / 1000;
+}/*}}}*/
+
+/**
+	Create the ab_t object on the given backend. 
+\param [in] backend - backend to use
+\return
+	Pointer to created object or NULL if something nasty happens.
+\remark
+	All ab_* functions on the object and its channels and devices
+	are passed to this backend.
+	It is \ref ab_create_open and \ref ab_start in one call.
+*/
+ab_t* 
+ab_create_backend( enum ab_backend_e const backend )
+{/*{{{*/
+	ab_t * ab;
+
+	ab = ab_create_open (backend);
+	if( !ab){
+		goto __exit_fail;
+	}
+	if(ab_start (ab)){
+		ab_destroy (&ab);
+		goto __exit_fail;
+	}
+	return ab;
+__exit_fail:
+	return NULL;
+}/*}}}*/
+
+/**
+	Create the ab_t object on the given backend without starting the board. 
+\param [in] backend - backend to use
+\return
+	Pointer to created object or NULL if something nasty happens.
+\remark
+	The device nodes are opened and the channels structures are ready,
+	but nothing but \ref ab_start and \ref ab_destroy should be called
+	on the board until \ref ab_start succeed.
+*/
+ab_t* 
+ab_create_open( enum ab_backend_e const backend )
+{/*{{{*/
+	struct ab_backend_s const * be;
+	struct timespec t0;
+	struct timespec t1;
+	ab_t * ab;
+
+	be = ab_backend_get (backend);
+	if( !be){
+		goto __exit_fail;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	ab = be->create();
+	if( !ab){
+		goto __exit_fail;
+	}
+	ab->be = be;
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	ab->start.total_us = ab_elapsed_us (&t0, &t1);
+	return ab;
+__exit_fail:
+	return NULL;
+}/*}}}*/
+
+/**
+	Start the board created with \ref ab_create_open.
+\param [in] ab - board to start
+\return
+	AB_ERR_NO_ERR or error code (the calling thread error is set).
+\remark
+	It is the firmware download and the DSP setup on the TAPI backend,
+	so it is slow. It can run in other thread while the caller does
+	not use the board and does not call other ab_* functions.
+*/
+int 
+ab_start( ab_t * const ab )
+{/*{{{*/
+	struct timespec t0;
+	struct timespec t1;
+	int err;
+
+	if( !ab->be->start){
+		return AB_ERR_NO_ERR;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	err = ab->be->start(ab);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	ab->start.total_us += ab_elapsed_us (&t0, &t1);
+	return err;
+}/*}}}*/
+
+/**
+	Create the ab_t object on the descriptors of the running board.
+\param [in] backend - backend to use
+\param [in] fds - devices cfg_fd in devices order, then channels rtp_fd
+	in channels order (taken by the object, closed on errors too)
+\param [in] fds_num - descriptors count
+\param [in] be_fds - backend side of every fds item (ab_chan_t be_fd of the
+	channels), -1 if there is no one, NULL if there are no ones at all
+	(taken and closed the same way as fds)
+\param [in] media_up - media is switched on, per channel
+\return
+	Pointer to created object or NULL if something nasty happens.
+\remark
+	The board is not started again, channels keep their state (it is
+	how the new process takes the board from the one it replaces).
+	The phones of the simulated board are the be_fds ends of the
+	channels socketpairs, so the simulated backend needs them.
+*/
+ab_t* 
+ab_create_adopt( enum ab_backend_e const backend,
+		int const * const fds, int const fds_num, int const * const be_fds,
+		unsigned char const * const media_up )
+{/*{{{*/
+	struct ab_backend_s const * be;
+	struct timespec t0;
+	struct timespec t1;
+	ab_t * ab;
+	int taken = 0;
+	int i;
+
+	be = ab_backend_get (backend);
+	if( !be){
+		goto __exit_fail;
+	}
+	if( !be->adopt){
+		ab_err_set(AB_ERR_BAD_PARAM, "backend can not adopt the board");
+		goto __exit_fail;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	taken = 1;
+	ab = be->adopt(fds, fds_num, be_fds, media_up);
+	if( !ab){
+		goto __exit_fail;
+	}
+	ab->be = be;
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	ab->start.total_us = ab_elapsed_us (&t0, &t1);
+	return ab;
+__exit_fail:
+	for (i=0; !taken && i<fds_num; i++){
+		close(fds[i]);
+		if(be_fds && be_fds[i] != -1){
+			close(be_fds[i]);
+		}
+	}
+	return NULL;
+}/*}}}*/
+
+/**
+	Destroy the ab_t object. 
+\param [in]
+	ab - pointer to pointer to destroying object.
+		pointer to object will set to NULL
+		after destroying
+\remark
+	After all ab = NULL.
+*/
+void 
+ab_destroy( ab_t ** ab )
+{/*{{{*/
+	if(*ab) {
+		(*ab)->be->destroy(*ab);
+		*ab = NULL;
+	}
+}/*}}}*/
+
+/**
+	Destroy the ab_t object, the DSP keeps running for the next start.
+\param [in]
+	ab - pointer to pointer to destroying object.
+\remark
+	It is the restart path: the next \ref ab_start can reuse the running
+	DSP (warm start). \ref ab_destroy stops it.
+*/
+void 
+ab_destroy_keep( ab_t ** ab )
+{/*{{{*/
+	if(*ab) {
+		(*ab)->keep_dsp = 1;
+		ab_destroy (ab);
+	}
+}/*}}}*/
+
+/**
+ * \param[in] ab - ata board 
+ * \param[in] abs_idx - absolute channel index
+ *
+ * \retval -1 if something nasty happens
+ * \retval 0 and greater - the channel number
+ */ 
+int 
+ab_get_chan_idx_by_abs(ab_t const * const ab, int const abs_idx)
+{/*{{{*/
+	int ret_idx;
+	int chans_num; 
+	int i;
+
+	ret_idx = -1;
+	chans_num = ab->chans_num;
+	for(i=0; i<chans_num; i++){
+		if (abs_idx == ab->chans[ i ].abs_idx){
+			ret_idx = i;
+			break;
+		}
+	}
+	return ret_idx;
+}/*}}}*/
+
+/*
+ * Dispatchers of the public interface to the backend operations.
+ * Description of every function is in the backend implementation
+ * (ab_line.c, ab_events.c and ab_media.c for TAPI).
+ */
+
+int 
+ab_FXS_line_ring( ab_chan_t * const chan, enum ab_chan_ring_e ring,
+		char * number, char * name )
+{/*{{{*/
+	return CHAN_BE(chan)->FXS_line_ring(chan, ring, number, name);
+}/*}}}*/
+
+/**
+	Setup the given tone using an asterisk playlist.
+\param [in] chan - channel to setup tone
+\param [in] tone - tone to setup
+\param [in] playlst - asterisk playlist defining the tone
+\return
+	AB_ERR_NO_ERR or error code.
+\remark
+	The tone table is per device, it is the tone of all the channels
+	of the device. Parse the playlist once with \ref ab_tone_parse
+	and use \ref ab_dev_set_tone to set many devices.
+*/
+int
+ab_FXS_set_tone( ab_chan_t * const chan, enum ab_chan_tone_e tone,
+		const char * playlst )
+{/*{{{*/
+	ab_tone_t t;
+	int err;
+
+	err = ab_tone_parse (playlst, &t);
+	if(err){
+		return err;
+	}
+	return ab_dev_set_tone (chan->parent, tone, &t);
+}/*}}}*/
+
+int
+ab_dev_set_tone( ab_dev_t * const dev, enum ab_chan_tone_e tone,
+		ab_tone_t const * const t )
+{/*{{{*/
+	if(tone == ab_chan_tone_MUTE || tone >= ab_chan_tone_COUNT){
+		return AB_ERR_NO_ERR;
+	}
+	return dev->parent->be->dev_set_tone(dev, tone, t);
+}/*}}}*/
+
+int 
+ab_FXS_line_tone( ab_chan_t * const chan, enum ab_chan_tone_e tone )
+{/*{{{*/
+	return CHAN_BE(chan)->FXS_line_tone(chan, tone);
+}/*}}}*/
+
+int 
+ab_FXS_line_feed( ab_chan_t * const chan, enum ab_chan_linefeed_e feed )
+{/*{{{*/
+	return CHAN_BE(chan)->FXS_line_feed(chan, feed);
+}/*}}}*/
+
+int 
+ab_FXO_line_hook( ab_chan_t * const chan, enum ab_chan_hook_e hook )
+{/*{{{*/
+	return CHAN_BE(chan)->FXO_line_hook(chan, hook);
+}/*}}}*/
+
+int 
+ab_FXO_line_digit( ab_chan_t * const chan, char const data_length, 
+		char const * const data, char const nInterDigitTime,
+		char const nDigitPlayTime, char const pulseMode )
+{/*{{{*/
+	return CHAN_BE(chan)->FXO_line_digit(chan, data_length, data,
+			nInterDigitTime, nDigitPlayTime, pulseMode);
+}/*}}}*/
+
+int 
+ab_FXS_netlo_play( ab_chan_t * const chan, char tone, char local )
+{/*{{{*/
+	return CHAN_BE(chan)->FXS_netlo_play(chan, tone, local);
+}/*}}}*/
+
+int 
+ab_dev_event_get( ab_dev_t * const dev, ab_dev_event_t * const evt, 
+		unsigned char * const chan_available )
+{/*{{{*/
+	dev->evt_gets++;
+	return dev->parent->be->dev_event_get(dev, evt, chan_available);
+}/*}}}*/
+
+/**
+	Get all pending events on the device
+\param dev - device to operate on it
+\param evts - array for the occured events
+\param chans_available - array for the chan_available flags of the events
+\param max - size of evts and chans_available arrays
+\return 
+	number of got events (0 if there are no events) or -1 on error
+\remark
+	Events are got until the backend reports no more of them or the arrays
+	are full, in the last case the last event has more flag set.
+	Backend without its own batch routine gets them one by one and stops
+	on the first event without more flag, so the queue is not asked
+	again just to see it empty. TAPI is such a backend: IFX_TAPI_EVENT_GET
+	returns one event per call and the driver has no call for several
+	of them, so it takes one ioctl per event. dev->evt_gets counts the
+	backend calls to compare them with the got events.
+*/
+int 
+ab_dev_event_get_batch( ab_dev_t * const dev, ab_dev_event_t * const evts, 
+		unsigned char * const chans_available, int const max )
+{/*{{{*/
+	struct ab_backend_s const * be = dev->parent->be;
+	int n = 0;
+
+	if(be->dev_event_get_batch){
+		dev->evt_gets++;
+		return be->dev_event_get_batch(dev, evts, chans_available, max);
+	}
+	while(n < max){
+		dev->evt_gets++;
+		if(be->dev_event_get(dev, &evts[n], &chans_available[n])){
+			return n ? n : -1;
+		}
+		if(evts[n].id == ab_dev_event_NONE){
+			break;
+		}
+		if( !evts[n++].more){
+			break;
+		}
+	}
+	return n;
+}/*}}}*/
+
+int 
+ab_chan_fax_pass_through_start( ab_chan_t * const chan )
+{/*{{{*/
+	return CHAN_BE(chan)->chan_fax_pass_through_start(chan);
+}/*}}}*/
+
+int 
+ab_chan_media_rtp_tune( ab_chan_t * const chan, codec_t const * const cod,
+		codec_t const * const fcod, rtp_session_prms_t const * const rtpp,
+		int te_payload )
+{/*{{{*/
+	return CHAN_BE(chan)->chan_media_rtp_tune(chan, cod, fcod, rtpp, te_payload);
+}/*}}}*/
+
+int 
+ab_chan_media_jb_tune( ab_chan_t * const chan, jb_prms_t const * const jbp )
+{/*{{{*/
+	return CHAN_BE(chan)->chan_media_jb_tune(chan, jbp);
+}/*}}}*/
+
+int 
+ab_chan_media_wlec_tune( ab_chan_t * const chan, wlec_t const * const wp )
+{/*{{{*/
+	return CHAN_BE(chan)->chan_media_wlec_tune(chan, wp);
+}/*}}}*/
+
+int 
+ab_chan_media_switch( ab_chan_t * const chan, unsigned char const switch_up )
+{/*{{{*/
+	return CHAN_BE(chan)->chan_media_switch(chan, switch_up);
+}/*}}}*/
+
+int 
+ab_chan_media_enc_hold( ab_chan_t * const chan, unsigned char const hold )
+{/*{{{*/
+	return CHAN_BE(chan)->chan_media_enc_hold(chan, hold);
+}/*}}}*/
+
+int 
+ab_chan_media_jb_refresh( ab_chan_t * const chan )
+{/*{{{*/
+	return CHAN_BE(chan)->chan_media_jb_refresh(chan);
+}/*}}}*/
+
+int 
+ab_chan_media_rtcp_refresh( ab_chan_t * const chan )
+{/*{{{*/
+	return CHAN_BE(chan)->chan_media_rtcp_refresh(chan);
+}/*}}}*/
+
+int 
+ab_chan_cid_standard( ab_chan_t * const chan, const cid_std_t std )
+{/*{{{*/
+	return CHAN_BE(chan)->chan_cid_standard(chan, std);
+}/*}}}*/
+
+/**
+	Forget the last applied media configuration of the channel
+\param chan - channel to operate on it
+\remark
+	Next rtp, jb and wlec tune calls make all their ioctls even if the
+	parameters are the same as before. Backend without the shadow state
+	ignores it.
+*/
+void 
+ab_chan_cfg_invalidate( ab_chan_t * const chan )
+{/*{{{*/
+	if(CHAN_BE(chan)->chan_cfg_invalidate){
+		CHAN_BE(chan)->chan_cfg_invalidate(chan);
+	}
+}/*}}}*/
@@ -0,0 +1,66 @@
+#ifndef __AB_BACKEND_H__
+#define __AB_BACKEND_H__
+
+#include "ab_api.h"
+
+/**
+	Backend operations.
+\remark
+	Public ab_* functions just take the backend from the channel (device)
+	parent board and call the operation with the same arguments.
+	Every operation sets the error of the calling thread (ab_err_set) on
+	errors like the public function.
+	create opens the board, start (if set) makes the slow hardware setup
+	and may run in other thread while the board is not used yet.
+*/
+struct ab_backend_s {/*{{{*/
+	char const * name; /**< Backend name (for logs) */
+	/* basic */
+	ab_t * (*create) (void);
+	int (*start) (ab_t * const ab); /**< optional, NULL if create starts all */
+	void (*destroy) (ab_t * const ab);
+	ab_t * (*adopt) (int const * const fds, int const fds_num,
+			int const * const be_fds, unsigned char const * const media_up);
+	/* rings and tones */
+	int (*FXS_line_ring) (ab_chan_t * const chan, enum ab_chan_ring_e ring,
+			char * number, char * name);
+	int (*dev_set_tone) (ab_dev_t * const dev, enum ab_chan_tone_e tone,
+			ab_tone_t const * const t);
+	int (*FXS_line_tone) (ab_chan_t * const chan, enum ab_chan_tone_e tone);
+	int (*FXS_line_feed) (ab_chan_t * const chan, enum ab_chan_linefeed_e feed);
+	int (*FXO_line_hook) (ab_chan_t * const chan, enum ab_chan_hook_e hook);
+	int (*FXO_line_digit) (ab_chan_t * const chan, char const data_length,
+			char const * const data, char const nInterDigitTime,
+			char const nDigitPlayTime, char const pulseMode);
+	int (*FXS_netlo_play) (ab_chan_t * const chan, char tone, char local);
+	/* events */
+	int (*dev_event_get) (ab_dev_t * const dev, ab_dev_event_t * const evt,
+			unsigned char * const chan_available);
+	/* media */
+	int (*chan_fax_pass_through_start) (ab_chan_t * const chan);
+	int (*chan_media_rtp_tune) (ab_chan_t * const chan,
+			codec_t const * const cod, codec_t const * const fcod,
+			rtp_session_prms_t const * const rtpp, int te_payload);
+	int (*chan_media_jb_tune) (ab_chan_t * const chan,
+			jb_prms_t const * const jbp);
+	int (*chan_media_wlec_tune) (ab_chan_t * const chan, wlec_t const * const wp);
+	int (*chan_media_switch) (ab_chan_t * const chan,
+			unsigned char const switch_up);
+	int (*chan_media_enc_hold) (ab_chan_t * const chan, unsigned char const hold);
+	int (*chan_media_jb_refresh) (ab_chan_t * const chan);
+	int (*chan_media_rtcp_refresh) (ab_chan_t * const chan);
+	int (*chan_cid_standard) (ab_chan_t * const chan, const cid_std_t std);
+	/* optional (can be NULL) */
+	void (*chan_cfg_invalidate) (ab_chan_t * const chan);
+	int (*dev_event_get_batch) (ab_dev_t * const dev, ab_dev_event_t * const evts,
+			unsigned char * const chans_available, int const max);
+};/*}}}*/
+
+#ifndef AB_NO_TAPI
+/** TAPI (vmmc ioctl) backend */
+extern struct ab_backend_s const ab_backend_tapi;
+#endif
+/** Simulated channels backend */
+extern struct ab_backend_s const ab_backend_sim;
+
+#endif /* __AB_BACKEND_H__ */
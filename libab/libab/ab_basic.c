@@ -3,7 +3,9 @@
 #include <string.h>
 #include <assert.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
+#include <time.h>
 
 #include "ab_internal_v22.h"
 
@@ -12,143 +14,254 @@
 #define TAPI_LL_DEV_FIRMWARE_NAME   "/lib/firmware/danube_firmware.bin" 
 #define TAPI_LL_BBD_NAME   "/lib/firmware/danube_bbd_fxs.bin" 
 
-int ab_g_err_idx;
-char ab_g_err_str[ERR_STR_LENGTH];
-int ab_g_err_extra_value;
-
+static ab_t * tapi_create (void);
+static int tapi_start (ab_t * const ab);
+static ab_t * tapi_adopt (int const * const fds, int const fds_num,
+		int const * const be_fds, unsigned char const * const media_up);
+static ab_t * tapi_board_create (int const * const fds, int const fds_num,
+		unsigned char const * const media_up);
+static void tapi_destroy (ab_t * const ab);
 static void ab_chan_status_init( ab_chan_t * const chan );
+static int tapi_dev_stop(ab_t *ab);
 #if 0
 static int get_devs_params (unsigned int * const devs_num, 
 		ab_dev_params_t ** const dprms);
 #endif		
 
-extern int ab_dev_event_clean(ab_dev_t * const dev);
+/** Firmware image mapped from the file */
+struct tapi_bin_s {
+   unsigned char *buf;
+   unsigned int size;
+   unsigned long long hash;
+};
+
+static unsigned long long tapi_now_us(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
 
-static int tapi_dev_binary_buffer_create(
+/* Map the binary file and take its fingerprint (FNV-1a) */
+static int tapi_dev_binary_map(
                      const char *pPath,
-                     unsigned char **ppBuf,
-                     unsigned int *pBufSz)
+                     struct tapi_bin_s *pBin)
 {
-   int status = AB_ERR_NO_ERR;
-   FILE *fd;
+   int fd;
    struct stat file_stat;
+   unsigned int i;
+
+   memset(pBin, 0, sizeof(*pBin));
 
    /* Open binary file for reading*/
-   fd = fopen(pPath, "rb");
-   if (fd == NULL) {
-      sprintf(ab_g_err_str, "ERROR -  binary file %s open failed!", pPath);
+   fd = open(pPath, O_RDONLY);
+   if (fd == -1) {
+      ab_err_setf(AB_ERR_NO_FILE, "ERROR -  binary file %s open failed!", pPath);
       return AB_ERR_NO_FILE;
    }
 
    /* Get file statistics*/
-   if (stat(pPath, &file_stat) != 0) {
-      sprintf(ab_g_err_str, "ERROR -  file %s statistics get failed!", pPath);
+   if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+      ab_err_setf(AB_ERR_NO_FILE, "ERROR -  file %s statistics get failed!", pPath);
+      close(fd);
       return AB_ERR_NO_FILE;
    }
 
-   *ppBuf = malloc(file_stat.st_size);
-   if (*ppBuf == NULL) {
-      sprintf(ab_g_err_str, "ERROR -  binary file %s memory allocation failed!", pPath);
-      status = AB_ERR_NO_FILE;
-
-      goto on_exit;
+   /* The driver copies it, no need to read it to the heap */
+   pBin->buf = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (pBin->buf == MAP_FAILED) {
+      pBin->buf = NULL;
+      ab_err_setf(AB_ERR_NO_MEM, "ERROR -  binary file %s mapping failed!", pPath);
+      return AB_ERR_NO_MEM;
    }
+   pBin->size = file_stat.st_size;
 
-   if (fread (*ppBuf, sizeof(unsigned char), file_stat.st_size, fd) <= 0) {
-      sprintf(ab_g_err_str, "ERROR - file %s read failed!", pPath);
-      status = AB_ERR_NO_FILE;
-
-      goto on_exit;
+   pBin->hash = 0xcbf29ce484222325ULL;
+   for (i = 0; i < pBin->size; i++) {
+      pBin->hash ^= pBin->buf[i];
+      pBin->hash *= 0x100000001b3ULL;
    }
 
-   *pBufSz = file_stat.st_size; 
-
-on_exit:
-   if (fd != NULL) {
-      fclose(fd);
-   }
-
-   if (*ppBuf != NULL && status != AB_ERR_NO_ERR) {
-      free(*ppBuf);
-   }
-
-   return status;
+   return AB_ERR_NO_ERR;
 }
 
-static void tapi_dev_binary_buffer_delete(unsigned char *pBuf)
+static void tapi_dev_binary_unmap(struct tapi_bin_s *pBin)
 {
-   if (pBuf != NULL)
-      free(pBuf);
+   if (pBin->buf != NULL)
+      munmap(pBin->buf, pBin->size);
+   pBin->buf = NULL;
 }
 
 static int tapi_dev_firmware_download(
                      int fd,
-                     const char *pPath)
+                     struct tapi_bin_s const *pBin)
 {
    int status = AB_ERR_NO_ERR;
-   unsigned char *pFirmware = NULL;
-   unsigned int binSz = 0;
    VMMC_IO_INIT vmmc_io_init;
 
-   /* Create binary buffer*/
-   status = tapi_dev_binary_buffer_create(pPath, &pFirmware, &binSz);
-   if (status != AB_ERR_NO_ERR) {
-      return status;
-   }
-
    /* Download Voice Firmware*/
    memset(&vmmc_io_init, 0, sizeof(VMMC_IO_INIT));
-   vmmc_io_init.pPRAMfw   = pFirmware;
-   vmmc_io_init.pram_size = binSz;
+   vmmc_io_init.pPRAMfw   = pBin->buf;
+   vmmc_io_init.pram_size = pBin->size;
 
    status = ioctl(fd, FIO_FW_DOWNLOAD, &vmmc_io_init);
    if (status != AB_ERR_NO_ERR) {
-      sprintf(ab_g_err_str, "ERROR -  FIO_FW_DOWNLOAD ioctl failed!");
+      ab_err_set(AB_ERR_UNKNOWN, "ERROR -  FIO_FW_DOWNLOAD ioctl failed!");
    }
 
-   /* Delete binary buffer*/
-   tapi_dev_binary_buffer_delete(pFirmware);
-
    return status;
 }
 
 static int tapi_dev_bbd_download(
                      int fd,
-                     const char *pPath)
+                     struct tapi_bin_s const *pBin)
 {
    int status = AB_ERR_NO_ERR;
-   unsigned char *pFirmware = NULL;
-   unsigned int binSz = 0;
    VMMC_DWLD_t bbd_data;
 
+   /* Download Voice Coefficients*/
+   memset(&bbd_data, 0, sizeof(VMMC_DWLD_t));
+   bbd_data.buf = pBin->buf;
+   bbd_data.size = pBin->size;
+
+   status = ioctl(fd, FIO_BBD_DOWNLOAD, &bbd_data);
+   if (status != AB_ERR_NO_ERR) {
+      ab_err_set(AB_ERR_UNKNOWN, "ERROR -  FIO_BBD_DOWNLOAD ioctl failed!");
+   }
+
+   return status;
+}
+
+/* Fingerprint of the images and of the firmware the driver reports */
+static int tapi_dev_fingerprint(
+                     int fd,
+                     struct tapi_bin_s const *pFw,
+                     struct tapi_bin_s const *pBbd,
+                     char *pFp,
+                     size_t fpSz)
+{
+#ifdef FIO_GET_VERS
+   VMMC_IO_VERSION vers;
+
+   /* the driver knows if the firmware is running */
+   memset(&vers, 0, sizeof(vers));
+   if (ioctl(fd, FIO_GET_VERS, &vers) != 0 ||
+         (vers.nEdspVers == 0 && vers.nEdspIntern == 0)) {
+      return AB_ERR_UNKNOWN;
+   }
+   snprintf(pFp, fpSz, "fw=%016llx:%u bbd=%016llx:%u edsp=%u.%u\n",
+         pFw->hash, pFw->size, pBbd->hash, pBbd->size,
+         vers.nEdspVers, vers.nEdspIntern);
+   return AB_ERR_NO_ERR;
+#else
+   /* without the driver check a stale file would pass as the warm start */
+   return AB_ERR_UNKNOWN;
+#endif
+}
+
+/* Check if the DSP runs the images (warm restart is possible) */
+static int tapi_dev_fingerprint_check(
+                     int fd,
+                     struct tapi_bin_s const *pFw,
+                     struct tapi_bin_s const *pBbd)
+{
+   char fp[128];
+   char saved[128];
+   FILE *f;
+   int same;
+
+   if (getenv(AB_COLD_START_ENV) != NULL) {
+      return 0;
+   }
+   if (tapi_dev_fingerprint(fd, pFw, pBbd, fp, sizeof(fp)) != AB_ERR_NO_ERR) {
+      /* the driver can not tell the firmware runs, the file is not trusted */
+      unlink(AB_DSP_FP_PATH);
+      return 0;
+   }
+   /* it is on tmpfs, so the board is not rebooted since it is saved */
+   f = fopen(AB_DSP_FP_PATH, "r");
+   if (f == NULL) {
+      return 0;
+   }
+   same = fgets(saved, sizeof(saved), f) != NULL && strcmp(saved, fp) == 0;
+   fclose(f);
+   return same;
+}
+
+static void tapi_dev_fingerprint_save(
+                     int fd,
+                     struct tapi_bin_s const *pFw,
+                     struct tapi_bin_s const *pBbd)
+{
+   char fp[128];
+   FILE *f;
+
+   if (tapi_dev_fingerprint(fd, pFw, pBbd, fp, sizeof(fp)) != AB_ERR_NO_ERR) {
+      return;
+   }
+   f = fopen(AB_DSP_FP_PATH, "w");
+   if (f == NULL) {
+      return;
+   }
+   fputs(fp, f);
+   fclose(f);
+}
+
+/* Stop the DSP, download the images and start it again */
+static int tapi_dev_cold_start(
+                     ab_t *ab,
+                     struct tapi_bin_s const *pFw,
+                     struct tapi_bin_s const *pBbd)
+{
+   int status = AB_ERR_NO_ERR;
+   IFX_TAPI_DEV_START_CFG_t tapistart;
+   unsigned long long t;
 
-   /* Create binary buffer*/
-   status = tapi_dev_binary_buffer_create(pPath, &pFirmware, &binSz);
+   /* the DSP state is unknown until it is started again */
+   unlink(AB_DSP_FP_PATH);
+
+   /* Stop TAPI*/
+   t = tapi_now_us();
+   status = tapi_dev_stop(ab);
    if (status != AB_ERR_NO_ERR) {
       return status;
    }
 
-   /* Download Voice Firmware*/
-   memset(&bbd_data, 0, sizeof(VMMC_DWLD_t));
-   bbd_data.buf = pFirmware;
-   bbd_data.size = binSz;
+   status = tapi_dev_firmware_download(ab->devs[0].cfg_fd, pFw);
+   if (status != AB_ERR_NO_ERR) {
+      return status;
+   }
+   ab->start.phase_us[ab_start_phase_FW] += tapi_now_us() - t;
 
-   status = ioctl(fd, FIO_BBD_DOWNLOAD, &bbd_data);
+   memset(&tapistart, 0x0, sizeof(IFX_TAPI_DEV_START_CFG_t));
+   tapistart.nMode = IFX_TAPI_INIT_MODE_VOICE_CODER;
+
+   /* Start TAPI*/
+   t = tapi_now_us();
+   status = ioctl(ab->devs[0].cfg_fd, IFX_TAPI_DEV_START, &tapistart);
    if (status != AB_ERR_NO_ERR) {
-      sprintf(ab_g_err_str, "ERROR -  FIO_BBD_DOWNLOAD ioctl failed!");
+      ab_err_set(AB_ERR_UNKNOWN, "ERROR - IFX_TAPI_DEV_START ioctl failed");
+      return status;
    }
+   ab->start.phase_us[ab_start_phase_DEV_START] = tapi_now_us() - t;
 
-   /* Delete binary buffer*/
-   tapi_dev_binary_buffer_delete(pFirmware);
+   /* Download coefficients */
+   t = tapi_now_us();
+   status = tapi_dev_bbd_download(ab->devs[0].cfg_fd, pBbd);
+   if (status != AB_ERR_NO_ERR) {
+      ab_err_set(AB_ERR_UNKNOWN, "ERROR - Voice Coefficients Download failed!");
+      return status;
+   }
+   ab->start.phase_us[ab_start_phase_BBD] = tapi_now_us() - t;
 
    return status;
 }
 
-static int tapi_dev_start(ab_t *ab)
+static int tapi_dev_chans_start(ab_t *ab, int warm)
 {
    int status = AB_ERR_NO_ERR;
    unsigned char c;
-   IFX_TAPI_DEV_START_CFG_t tapistart;
    IFX_TAPI_MAP_DATA_t datamap;
 #if 0   
    IFX_TAPI_ENC_CFG_t enc_cfg;
@@ -177,48 +290,22 @@ static int tapi_dev_start(ab_t *ab)
       f->dev_ctx.data2phone_map[c] = c & 0x1 ? 0 : 1;
    }
 #endif
-   /* Stop TAPI*/
-   status = ioctl(ab->devs[0].cfg_fd, IFX_TAPI_DEV_STOP, 0);
-   if (status != AB_ERR_NO_ERR) {
-      sprintf(ab_g_err_str, "ERROR - IFX_TAPI_DEV_STOP ioctl failed");
-      return status;
-   }
-
-   status = tapi_dev_firmware_download(ab->devs[0].cfg_fd, TAPI_LL_DEV_FIRMWARE_NAME);
-   if (status != AB_ERR_NO_ERR) {
-      return status;
-   }
-
-   memset(&tapistart, 0x0, sizeof(IFX_TAPI_DEV_START_CFG_t));
-   tapistart.nMode = IFX_TAPI_INIT_MODE_VOICE_CODER;
-
-   /* Start TAPI*/
-   status = ioctl(ab->devs[0].cfg_fd, IFX_TAPI_DEV_START, &tapistart);
-   if (status != AB_ERR_NO_ERR) {
-      sprintf(ab_g_err_str, "ERROR - IFX_TAPI_DEV_START ioctl failed");
-      return status;
-   }
-
-   /* Download coefficients */
-   status = tapi_dev_bbd_download(ab->devs[0].cfg_fd, TAPI_LL_BBD_NAME);
-   if (status != AB_ERR_NO_ERR) {
-      sprintf(ab_g_err_str, "ERROR - Voice Coefficients Download failed!");
-      return status;
-   }
-
    for (c = 0; c < TAPI_AUDIO_DEV_NUM; c++) {
       /* Perform mapping*/
       memset(&datamap, 0x0, sizeof(IFX_TAPI_MAP_DATA_t));
       datamap.nDstCh  = c ;
       datamap.nChType = IFX_TAPI_MAP_TYPE_PHONE;
 
+      /* the running DSP keeps the mapping of the previous start */
+      if (warm) {
+         ioctl(ab->chans[c].rtp_fd, IFX_TAPI_MAP_DATA_REMOVE, &datamap);
+      }
       status = ioctl(ab->chans[c].rtp_fd, IFX_TAPI_MAP_DATA_ADD, &datamap);
-
+      /* on the warm start any error makes the caller fall back to cold */
       if (status != AB_ERR_NO_ERR) {
-         sprintf(ab_g_err_str, "ERROR - IFX_TAPI_MAP_DATA_ADD ioctl failed");
+         ab_err_set(AB_ERR_UNKNOWN, "ERROR - IFX_TAPI_MAP_DATA_ADD ioctl failed");
          return status;
       }
-
       char data[10] = {0xFF,0xFF,0xF0,0,0,0,0,0,0,0};
       IFX_TAPI_RING_CADENCE_t ringCadence;
 
@@ -228,7 +315,7 @@ static int tapi_dev_start(ab_t *ab)
       dtmfDetection.sig = IFX_TAPI_SIG_DTMFTX;
       status = ioctl (ab->chans[c].rtp_fd,IFX_TAPI_SIG_DETECT_ENABLE,&dtmfDetection);
       if (status != AB_ERR_NO_ERR ){
-         sprintf(ab_g_err_str, "ERROR - IFX_TAPI_SIG_DTMFTX ioctl failed");
+         ab_err_set(AB_ERR_UNKNOWN, "ERROR - IFX_TAPI_SIG_DTMFTX ioctl failed");
          return status;
       }
       
@@ -238,12 +325,12 @@ static int tapi_dev_start(ab_t *ab)
       ringCadence.nr = sizeof(data) * 8;
       status = ioctl(ab->chans[c].rtp_fd, IFX_TAPI_RING_CADENCE_HR_SET, &ringCadence);
       if (status != AB_ERR_NO_ERR ){
-         sprintf(ab_g_err_str, "ERROR - IFX_TAPI_RING_CADENCE_HR_SET ioctl failed");
+         ab_err_set(AB_ERR_UNKNOWN, "ERROR - IFX_TAPI_RING_CADENCE_HR_SET ioctl failed");
          return status;
       }
       
       /* configure caller id */
-      ab_chan_cid_standard(&ab->chans[c], cid_ETSI_FSK);
+      tapi_chan_cid_standard(&ab->chans[c], cid_ETSI_FSK);
       
       /* ENABLE detection of FAX signals */
       memset (&faxSig, 0, sizeof(faxSig));
@@ -251,7 +338,7 @@ static int tapi_dev_start(ab_t *ab)
                    IFX_TAPI_SIG_CEDENDRX | IFX_TAPI_SIG_CEDENDTX;
       status = ioctl (ab->chans[c].rtp_fd,IFX_TAPI_SIG_DETECT_ENABLE,&faxSig);
       if (status != AB_ERR_NO_ERR ){
-         sprintf(ab_g_err_str, "ERROR - IFX_TAPI_SIG_DETECT_ENABLE ioctl failed");
+         ab_err_set(AB_ERR_UNKNOWN, "ERROR - IFX_TAPI_SIG_DETECT_ENABLE ioctl failed");
          return status;
       }
 
@@ -259,7 +346,7 @@ static int tapi_dev_start(ab_t *ab)
       status = ioctl(ab->chans[c].rtp_fd, IFX_TAPI_LINE_FEED_SET, IFX_TAPI_LINE_FEED_STANDBY);
 
       if (status != AB_ERR_NO_ERR) {
-         sprintf(ab_g_err_str, "ERROR - IFX_TAPI_LINE_FEED_SET ioctl failed");
+         ab_err_set(AB_ERR_UNKNOWN, "ERROR - IFX_TAPI_LINE_FEED_SET ioctl failed");
          return status;
       }
 #if 0
@@ -300,7 +387,7 @@ static int tapi_dev_stop(ab_t *ab)
    
    /* Stop TAPI device*/
    if (ioctl(ab->devs[0].cfg_fd, IFX_TAPI_DEV_STOP, 0) != AB_ERR_NO_ERR) {
-      sprintf(ab_g_err_str, "ERROR - IFX_TAPI_DEV_STOP ioctl failed");
+      ab_err_set(AB_ERR_UNKNOWN, "ERROR - IFX_TAPI_DEV_STOP ioctl failed");
       status = AB_ERR_UNKNOWN;
    }
 #if 0
@@ -316,29 +403,166 @@ static int tapi_dev_stop(ab_t *ab)
    return status;
 }
 
+static int tapi_dev_start(ab_t *ab)
+{
+   int status = AB_ERR_NO_ERR;
+   struct tapi_bin_s fw;
+   struct tapi_bin_s bbd;
+   unsigned long long t;
+   int fd = ab->devs[0].cfg_fd;
+
+   /* Fingerprint the images */
+   t = tapi_now_us();
+   status = tapi_dev_binary_map(TAPI_LL_DEV_FIRMWARE_NAME, &fw);
+   if (status != AB_ERR_NO_ERR) {
+      return status;
+   }
+   status = tapi_dev_binary_map(TAPI_LL_BBD_NAME, &bbd);
+   if (status != AB_ERR_NO_ERR) {
+      goto on_exit;
+   }
+   ab->start.warm = tapi_dev_fingerprint_check(fd, &fw, &bbd);
+   ab->start.phase_us[ab_start_phase_FW] = tapi_now_us() - t;
+
+   if (!ab->start.warm) {
+      status = tapi_dev_cold_start(ab, &fw, &bbd);
+      if (status != AB_ERR_NO_ERR) {
+         goto on_exit;
+      }
+   }
+
+   t = tapi_now_us();
+   status = tapi_dev_chans_start(ab, ab->start.warm);
+   if (status != AB_ERR_NO_ERR && ab->start.warm) {
+      /* the DSP state is not what it is expected to be */
+      ab->start.warm = 0;
+      status = tapi_dev_cold_start(ab, &fw, &bbd);
+      if (status != AB_ERR_NO_ERR) {
+         goto on_exit;
+      }
+      t = tapi_now_us();
+      status = tapi_dev_chans_start(ab, 0);
+   }
+   if (status != AB_ERR_NO_ERR) {
+      goto on_exit;
+   }
+   ab->start.phase_us[ab_start_phase_CHANS] = tapi_now_us() - t;
+
+   if (!ab->start.warm) {
+      tapi_dev_fingerprint_save(fd, &fw, &bbd);
+   }
+
+on_exit:
+   tapi_dev_binary_unmap(&bbd);
+   tapi_dev_binary_unmap(&fw);
+   return status;
+}
+
 static int
-ab_chan_default_tones( ab_chan_t * const chan )
+ab_dev_default_tones( ab_dev_t * const dev )
 {/*{{{*/
-	ab_FXS_set_tone(chan, ab_chan_tone_DIAL, "425/200,0/200,425/600,0/1000");
-	ab_FXS_set_tone(chan, ab_chan_tone_BUSY, "425/500,0/500");
-	ab_FXS_set_tone(chan, ab_chan_tone_RINGBACK, "425/1000,0/4000");
+	ab_tone_zone_t const * zone = ab_tone_zone_find(AB_TONE_ZONE_DF);
+	tapi_dev_set_tone(dev, ab_chan_tone_DIAL, &zone->tones[ab_chan_tone_DIAL]);
+	tapi_dev_set_tone(dev, ab_chan_tone_BUSY, &zone->tones[ab_chan_tone_BUSY]);
+	tapi_dev_set_tone(dev, ab_chan_tone_RINGBACK, &zone->tones[ab_chan_tone_RINGBACK]);
 	return AB_ERR_NO_ERR;
 }/*}}}*/
 
+/** TAPI backend operations */
+struct ab_backend_s const ab_backend_tapi = {/*{{{*/
+	.name = "tapi",
+	.create = tapi_create,
+	.start = tapi_start,
+	.destroy = tapi_destroy,
+	.adopt = tapi_adopt,
+	.FXS_line_ring = tapi_FXS_line_ring,
+	.dev_set_tone = tapi_dev_set_tone,
+	.FXS_line_tone = tapi_FXS_line_tone,
+	.FXS_line_feed = tapi_FXS_line_feed,
+	.FXO_line_hook = tapi_FXO_line_hook,
+	.FXO_line_digit = tapi_FXO_line_digit,
+	.FXS_netlo_play = tapi_FXS_netlo_play,
+	.dev_event_get = tapi_dev_event_get,
+	.chan_fax_pass_through_start = tapi_chan_fax_pass_through_start,
+	.chan_media_rtp_tune = tapi_chan_media_rtp_tune,
+	.chan_media_jb_tune = tapi_chan_media_jb_tune,
+	.chan_media_wlec_tune = tapi_chan_media_wlec_tune,
+	.chan_media_switch = tapi_chan_media_switch,
+	.chan_media_enc_hold = tapi_chan_media_enc_hold,
+	.chan_media_jb_refresh = tapi_chan_media_jb_refresh,
+	.chan_media_rtcp_refresh = tapi_chan_media_rtcp_refresh,
+	.chan_cid_standard = tapi_chan_cid_standard,
+	.chan_cfg_invalidate = tapi_chan_cfg_invalidate,
+};/*}}}*/
+
+/**
+	Create the ab_t object on vmmc devices (the DSP is not started yet). 
+\return
+	Pointer to created object or NULL if something nasty happens.
+*/
+static ab_t* 
+tapi_create( void )
+{/*{{{*/
+	return tapi_board_create (NULL, 0, NULL);
+}/*}}}*/
+
+/**
+	Start the DSP of the opened board.
+\param [in] ab - board created by \ref tapi_create
+\return
+	AB_ERR_NO_ERR or error code (the calling thread error is set).
+*/
+static int
+tapi_start( ab_t * const ab )
+{/*{{{*/
+	return tapi_dev_start (ab);
+}/*}}}*/
+
 /**
-	Create the ab_t object. 
+	Create the ab_t object on the vmmc descriptors of the running board.
+\param [in] fds - devices cfg_fd, then channels rtp_fd
+\param [in] fds_num - descriptors count
+\param [in] be_fds - backend side of the descriptors (TAPI has none, closed)
+\param [in] media_up - media is switched on, per channel
+\return
+	Pointer to created object or NULL if something nasty happens.
+\remark
+	The DSP is not touched, the firmware and the channels mapping stay.
+*/
+static ab_t* 
+tapi_adopt( int const * const fds, int const fds_num,
+		int const * const be_fds, unsigned char const * const media_up )
+{/*{{{*/
+	int i;
+
+	for (i=0; be_fds && i<fds_num; i++){
+		if(be_fds[i] != -1){
+			close(be_fds[i]);
+		}
+	}
+	return tapi_board_create (fds, fds_num, media_up);
+}/*}}}*/
+
+/**
+	Create the ab_t object on vmmc devices. 
+\param [in] fds - descriptors to take instead of opening the nodes (or NULL)
+\param [in] fds_num - descriptors count
+\param [in] media_up - media is switched on, per channel (with fds)
 \return
 	Pointer to created object or NULL if something nasty happens.
 \remark
 	This function:
 	- allocates memory
 	- make nessesary initializations
+	The DSP is started by \ref tapi_start.
 */
-ab_t* 
-ab_create( void )
+static ab_t* 
+tapi_board_create( int const * const fds, int const fds_num,
+		unsigned char const * const media_up )
 {/*{{{*/
 	ab_t *ab = NULL;
 	ab_dev_params_t * dprms = NULL;
+	unsigned long long t = tapi_now_us();
 	unsigned int devs_num;
 	unsigned int chans_num;
 	int i;
@@ -361,6 +585,15 @@ ab_create( void )
 	dprms->chans_idx[0] = 0;
 	dprms->chans_idx[1] = 1;
 #endif	
+	chans_num = devs_num * CHANS_PER_DEV;
+	if(fds && fds_num != devs_num + chans_num){
+		ab_err_set(AB_ERR_BAD_PARAM, "wrong descriptors count of the board");
+		for (i=0; i<fds_num; i++){
+			close(fds[i]);
+		}
+		goto __free_and_exit_fail;
+	}
+
 	ab = malloc(sizeof(*ab));
 	if( !ab){
 		ab_err_set(AB_ERR_NO_MEM, "Not enough memory for ab");
@@ -369,7 +602,6 @@ ab_create( void )
 	memset(ab, 0, sizeof(*ab));
 
 	ab->devs_num = devs_num;
-	chans_num = devs_num * CHANS_PER_DEV;
 	ab->chans_num = chans_num;
 	ab->chans_per_dev = CHANS_PER_DEV;
 	if((! ab->devs_num) || (! ab->chans_num)) {
@@ -386,6 +618,19 @@ ab_create( void )
 	memset(ab->chans, 0, sizeof(*(ab->chans)) * ab->chans_num);
 	memset(ab->devs, 0, sizeof(*(ab->devs)) * ab->devs_num);
 
+	ab->pchans = calloc(ab->chans_num, sizeof(*(ab->pchans)));
+	if( !ab->pchans){
+		ab_err_set(AB_ERR_NO_MEM, "no memory for channels index");
+		goto __free_and_exit_fail;
+	}
+
+	/* nothing is applied yet */
+	ab->be_ctx = calloc(ab->chans_num, sizeof(struct tapi_shadow_s));
+	if( !ab->be_ctx){
+		ab_err_set(AB_ERR_NO_MEM, "no memory for channels shadow");
+		goto __free_and_exit_fail;
+	}
+
 	/* Devices init */ 
 	for (i=0; i<devs_num; i++){
 		ab_dev_t * curr_dev = &ab->devs[ i ];
@@ -397,7 +642,7 @@ ab_create( void )
 
 		sprintf(dev_node,"/dev/vmmc%d0", curr_dev->idx );
 
-		fd_chip = open(dev_node, O_RDWR);
+		fd_chip = fds ? fds[i] : open(dev_node, O_RDWR);
 		if(fd_chip==-1){
 			ab_err_set(AB_ERR_NO_FILE, "opening vmmc device node");
 			goto __free_and_exit_fail;
@@ -427,15 +672,16 @@ ab_create( void )
 		sprintf(dev_node, "/dev/vmmc%d%d", 
 				curr_chan->parent->idx, curr_chan->idx);
 
-		fd_chan = open(dev_node, O_RDWR);
+		fd_chan = fds ? fds[devs_num + i] : open(dev_node, O_RDWR);
 		if (fd_chan==-1){
 			ab_err_set(AB_ERR_NO_FILE, "opening vmmc channel node");
 			goto __free_and_exit_fail;
 		}
 		curr_chan->rtp_fd = fd_chan;
+		curr_chan->be_fd = -1;
 		curr_chan->abs_idx = dprms[pdev_idx].chans_idx[chan_idx_in_dev];
 
-		if(curr_chan->abs_idx >= CHANS_MAX){
+		if(curr_chan->abs_idx >= ab->chans_num){
 			ab_err_set(AB_ERR_BAD_PARAM, "too many channels on boards");
 			goto __free_and_exit_fail;
 		}
@@ -443,17 +689,23 @@ ab_create( void )
 
 		/* set channel status to initial proper values */
 		ab_chan_status_init (curr_chan);
+		if(media_up){
+			curr_chan->statistics.is_up = media_up[i];
+		}
+	}
 
-		/* setup default tones */
-		if (ab_chan_default_tones(curr_chan) != AB_ERR_NO_ERR)
+	/* setup default tones, the table is per device */
+	for (i=0; i<devs_num; i++){
+		if (ab_dev_default_tones(&ab->devs[i]) != AB_ERR_NO_ERR)
 			goto __free_and_exit_fail;
 	}
 	
-	if (tapi_dev_start(ab) != AB_ERR_NO_ERR) {
-		/* tapi_dev_start sets the error message */
-		ab_g_err_idx = AB_ERR_UNKNOWN;
-		goto __free_and_exit_fail;
-	}  
+	ab->start.phase_us[ab_start_phase_OPEN] = tapi_now_us() - t;
+
+	if (fds) {
+		/* the running board is taken as is */
+		ab->start.warm = 1;
+	}
 
 	if(dprms){
 		free (dprms);
@@ -461,7 +713,7 @@ ab_create( void )
 	return ab;
 
 __free_and_exit_fail:
-	ab_destroy(&ab);
+	tapi_destroy(ab);
 	if(dprms){
 		free (dprms);
 	}
@@ -546,20 +798,20 @@ __exit_fail:
 #endif
 
 /**
-	Destroy the ab_t object. 
+	Destroy the ab_t object created by \ref tapi_create. 
 \param [in]
-	ab - pointer to pointer to destroying object.
-		pointer to object will set to NULL
-		after destroying
-\remark
-	After all ab = NULL.
+	ab - destroying object.
 */
-void 
-ab_destroy( ab_t ** ab )
+static void 
+tapi_destroy( ab_t * const ab )
 {/*{{{*/
-	ab_t * ab_tmp = *ab;
+	ab_t * ab_tmp = ab;
 	if(ab_tmp) {
-		tapi_dev_stop(ab_tmp);
+		/* DSP keeps running only for the restart (see AB_DSP_FP_PATH) */
+		if( !ab_tmp->keep_dsp && ab_tmp->devs && ab_tmp->devs_num) {
+			unlink(AB_DSP_FP_PATH);
+			tapi_dev_stop(ab_tmp);
+		}
 		if(ab_tmp->chans) {
 			int i;
 			int j;
@@ -584,8 +836,13 @@ ab_destroy( ab_t ** ab )
 			}
 			free (ab_tmp->devs);
 		}
+		if(ab_tmp->pchans) {
+			free (ab_tmp->pchans);
+		}
+		if(ab_tmp->be_ctx) {
+			free (ab_tmp->be_ctx);
+		}
 		free (ab_tmp);
-		ab_tmp = NULL;
 	}
 }/*}}}*/
 
@@ -657,31 +914,6 @@ __exit_fail:
 }/*}}}*/
 #endif
 
-/**
- * \param[in] ab - ata board 
- * \param[in] abs_idx - absolute channel index
- *
- * \retval -1 if something nasty happens
- * \retval 0 and greater - the channel number
- */ 
-int 
-ab_get_chan_idx_by_abs(ab_t const * const ab, int const abs_idx)
-{/*{{{*/
-	int ret_idx;
-	int chans_num; 
-	int i;
-
-	ret_idx = -1;
-	chans_num = ab->chans_num;
-	for(i=0; i<chans_num; i++){
-		if (abs_idx == ab->chans[ i ].abs_idx){
-			ret_idx = i;
-			break;
-		}
-	}
-	return ret_idx;
-}/*}}}*/
-
 /**
 	Sets the proper state and status of the channel structure 
 \param chan[in,out] - channel struture 
@@ -720,6 +952,6 @@ ab_chan_status_init( ab_chan_t * const chan )
 		chan->status.tone = ab_chan_tone_MUTE;
 	}
 	/* initial onhook detected (from channel) */
-	ab_dev_event_clean(chan->parent);
+	tapi_dev_event_clean(chan->parent);
 }/*}}}*/
 
@@ -0,0 +1,86 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ab_api.h"
+#include "ab_err.h"
+
+__thread struct ab_err_s ab_err_tls;
+
+#if AB_ERR_GLOBALS
+int ab_g_err_idx;
+char ab_g_err_str[ERR_STR_LENGTH];
+int ab_g_err_extra_value;
+
+/**
+	Copy the error to ab_g_err_* compatibility globals
+\param err_idx - error index
+\param err_fmt - message or format with one %s
+\param err_arg - argument of the format or NULL
+*/
+void 
+ab_err_global_set( int const err_idx, char const * const err_fmt,
+		char const * const err_arg )
+{/*{{{*/
+	ab_g_err_idx = err_idx;
+	if(err_arg){
+		snprintf(ab_g_err_str, sizeof(ab_g_err_str), err_fmt, err_arg);
+	} else {
+		snprintf(ab_g_err_str, sizeof(ab_g_err_str), "%s", err_fmt);
+	}
+}/*}}}*/
+#endif
+
+/**
+	Error index of the last failed call in the calling thread
+\return
+	AB_ERR_* value, AB_ERR_NO_ERR if there was no errors
+*/
+int 
+ab_err_idx( void )
+{/*{{{*/
+	return ab_err_tls.idx;
+}/*}}}*/
+
+/**
+	Error message of the last failed call in the calling thread
+\return
+	Message string, valid until the next error in the thread
+\remark
+	Message is formatted on the first request after the error.
+*/
+char const * 
+ab_err_str( void )
+{/*{{{*/
+	if( !ab_err_tls.fmt){
+		return "";
+	} else if( !ab_err_tls.arg){
+		return ab_err_tls.fmt;
+	}
+	if( !ab_err_tls.formatted){
+		snprintf(ab_err_tls.str, sizeof(ab_err_tls.str),
+				ab_err_tls.fmt, ab_err_tls.arg);
+		ab_err_tls.formatted = 1;
+	}
+	return ab_err_tls.str;
+}/*}}}*/
+
+/**
+	Error extra value of the last failed call in the calling thread
+\return
+	Extra value (0 if it is not set)
+*/
+int 
+ab_err_extra( void )
+{/*{{{*/
+	return ab_err_tls.extra;
+}/*}}}*/
+
+/**
+	Reset the error of the calling thread
+*/
+void 
+ab_err_clear( void )
+{/*{{{*/
+	memset(&ab_err_tls, 0, sizeof(ab_err_tls) - sizeof(ab_err_tls.str));
+}/*}}}*/
@@ -1,12 +1,59 @@
 #ifndef __AB_ERR_H__
 #define __AB_ERR_H__
 
-/** Set the error index and string globally and to object if it exists */
-#define ab_err_set(err_idx, str)					\
-	do {											\
-		strncpy(ab_g_err_str,(str),ERR_STR_LENGTH);	\
-		ab_g_err_idx = (err_idx);					\
+#include <stdio.h>
+#include <string.h>
+
+/**
+	Error of the last failed call in the thread.
+\remark
+	Message is formatted only when \ref ab_err_str() asks for it,
+	so fmt and arg should be static strings. Use \ref ab_err_setf_copy
+	if the argument does not outlive the call.
+*/
+struct ab_err_s {/*{{{*/
+	int idx; /**< Error index (AB_ERR_*) */
+	char const * fmt; /**< Message or format with one %s */
+	char const * arg; /**< Argument of the format or NULL */
+	int extra; /**< Extra value (using in some cases) */
+	int formatted; /**< str contains the formatted message */
+	char str [ERR_STR_LENGTH]; /**< Formatted message */
+};/*}}}*/
+
+/** Error of the last failed call in the thread */
+extern __thread struct ab_err_s ab_err_tls;
+
+#if AB_ERR_GLOBALS
+/** Copy the error to ab_g_err_* compatibility globals */
+void ab_err_global_set (int const err_idx, char const * const err_fmt,
+		char const * const err_arg);
+#else
+#define ab_err_global_set(err_idx, err_fmt, err_arg) do {} while(0)
+#endif
+
+/** Set the error index and the message with one %s argument */
+#define ab_err_setf(err_idx, err_fmt, err_arg)				\
+	do {													\
+		ab_err_tls.idx = (err_idx);							\
+		ab_err_tls.fmt = (err_fmt);							\
+		ab_err_tls.arg = (err_arg);							\
+		ab_err_tls.formatted = 0;							\
+		ab_err_global_set((err_idx), (err_fmt), (err_arg));	\
 	} while(0)
 
-#endif /* __AB_ERR_H__ */
+/** Set the error with the message formatted now (err_arg is a temporary) */
+#define ab_err_setf_copy(err_idx, err_fmt, err_arg)			\
+	do {													\
+		snprintf(ab_err_tls.str, sizeof(ab_err_tls.str),	\
+				(err_fmt), (err_arg));						\
+		ab_err_tls.idx = (err_idx);							\
+		ab_err_tls.fmt = ab_err_tls.str;					\
+		ab_err_tls.arg = NULL;								\
+		ab_err_tls.formatted = 1;							\
+		ab_err_global_set((err_idx), (err_fmt), (err_arg));	\
+	} while(0)
 
+/** Set the error index and string for the thread (and globally) */
+#define ab_err_set(err_idx, str) ab_err_setf((err_idx), (str), NULL)
+
+#endif /* __AB_ERR_H__ */
@@ -14,10 +14,12 @@
 \return 
 	0 in success case and other value otherwise
 \remark
-	returns the ioctl error value and writes error message
+	returns the ioctl error value and writes error message.
+	It is one IFX_TAPI_EVENT_GET ioctl for one event, evt->more tells
+	if the driver has more of them.
 */
 int 
-ab_dev_event_get(ab_dev_t * const dev, ab_dev_event_t * const evt, 
+tapi_dev_event_get(ab_dev_t * const dev, ab_dev_event_t * const evt, 
 		unsigned char * const chan_available )
 {/*{{{*/
 	IFX_TAPI_EVENT_t ioctl_evt;
@@ -112,7 +114,7 @@ ab_dev_event_get_exit:
 \remark
 	returns the ioctl error value and writes error message
 */
-int ab_dev_event_clean(ab_dev_t * const dev)
+int tapi_dev_event_clean(ab_dev_t * const dev)
 {/*{{{*/
 	ab_dev_event_t evt;
 	int err = 0;
@@ -121,7 +123,7 @@ int ab_dev_event_clean(ab_dev_t * const dev)
 
 	do {
 		unsigned char ch_av;
-		err = ab_dev_event_get(dev, &evt, &ch_av);
+		err = tapi_dev_event_get(dev, &evt, &ch_av);
 		if(err){
 			goto __exit_fail;
 		}
@@ -3,6 +3,7 @@
 
 #include "ab_api.h"
 #include "ab_err.h"
+#include "ab_backend.h"
 
 #include "drv_tapi_io.h"	/* from TAPI_HL_driver */
 #include "vmmc_io.h" 		/* from Vinetic_LL_driver */
@@ -12,5 +13,70 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+/** Configurations in the TAPI channel shadow */
+enum tapi_shadow_e {/*{{{*/
+	tapi_shadow_PT, /**< IFX_TAPI_PKT_RTP_PT_CFG_SET */
+	tapi_shadow_RTP, /**< IFX_TAPI_PKT_RTP_CFG_SET */
+	tapi_shadow_ENC, /**< IFX_TAPI_ENC_CFG_SET */
+	tapi_shadow_DEC, /**< IFX_TAPI_DEC_CFG_SET */
+	tapi_shadow_VAD, /**< IFX_TAPI_ENC_VAD_CFG_SET */
+	tapi_shadow_VOL, /**< IFX_TAPI_COD_VOLUME_SET */
+	tapi_shadow_HPF, /**< IFX_TAPI_COD_DEC_HP_SET */
+	tapi_shadow_JB, /**< IFX_TAPI_JB_CFG_SET */
+	tapi_shadow_WLEC, /**< IFX_TAPI_WLEC_PHONE_CFG_SET */
+	tapi_shadow_COUNT,
+};/*}}}*/
+
+/**
+	Last successfully applied parameters of the channel configuration
+	ioctls (TAPI backend context is the array of it per channel).
+	Ring, tone, linefeed and hook are shadowed by chan->status.
+*/
+struct tapi_shadow_s {/*{{{*/
+	unsigned int valid; /**< Bit (1 << tapi_shadow_e) if it is applied */
+	IFX_TAPI_PKT_RTP_PT_CFG_t pt;
+	IFX_TAPI_PKT_RTP_CFG_t rtp;
+	IFX_TAPI_ENC_CFG_t enc;
+	IFX_TAPI_DEC_CFG_t dec;
+	int vad;
+	IFX_TAPI_PKT_VOLUME_t vol;
+	int hpf;
+	IFX_TAPI_JB_CFG_t jb;
+	IFX_TAPI_WLEC_CFG_t wlec;
+};/*}}}*/
+
+/** Shadow of the channel configuration */
+#define TAPI_SHADOW(chan) (&((struct tapi_shadow_s *) \
+		(chan)->parent->parent->be_ctx)[(chan) - (chan)->parent->parent->chans])
+
+/* TAPI backend operations (see \ref ab_backend_s) {{{*/
+int tapi_FXS_line_ring (ab_chan_t * const chan, enum ab_chan_ring_e ring,
+		char * number, char * name);
+int tapi_dev_set_tone (ab_dev_t * const dev, enum ab_chan_tone_e tone,
+		ab_tone_t const * const t);
+int tapi_FXS_line_tone (ab_chan_t * const chan, enum ab_chan_tone_e tone);
+int tapi_FXS_line_feed (ab_chan_t * const chan, enum ab_chan_linefeed_e feed);
+int tapi_FXO_line_hook (ab_chan_t * const chan, enum ab_chan_hook_e hook);
+int tapi_FXO_line_digit (ab_chan_t * const chan, char const data_length,
+		char const * const data, char const nInterDigitTime,
+		char const nDigitPlayTime, char const pulseMode);
+int tapi_FXS_netlo_play (ab_chan_t * const chan, char tone, char local);
+int tapi_dev_event_get (ab_dev_t * const dev, ab_dev_event_t * const evt,
+		unsigned char * const chan_available);
+int tapi_dev_event_clean (ab_dev_t * const dev);
+int tapi_chan_fax_pass_through_start (ab_chan_t * const chan);
+int tapi_chan_media_rtp_tune (ab_chan_t * const chan, codec_t const * const cod,
+		codec_t const * const fcod, rtp_session_prms_t const * const rtpp,
+		int te_payload);
+int tapi_chan_media_jb_tune (ab_chan_t * const chan, jb_prms_t const * const jbp);
+int tapi_chan_media_wlec_tune (ab_chan_t * const chan, wlec_t const * const wp);
+int tapi_chan_media_switch (ab_chan_t * const chan, unsigned char const switch_up);
+int tapi_chan_media_enc_hold (ab_chan_t * const chan, unsigned char const hold);
+int tapi_chan_media_jb_refresh (ab_chan_t * const chan);
+int tapi_chan_media_rtcp_refresh (ab_chan_t * const chan);
+int tapi_chan_cid_standard (ab_chan_t * const chan, const cid_std_t std);
+void tapi_chan_cfg_invalidate (ab_chan_t * const chan);
+/*}}}*/
+
 #endif /* __AB_INTERNAL_H__ */
 
@@ -77,6 +77,7 @@ ab_FXS_line_just_play_it (ab_chan_t * const chan, enum ab_chan_tone_e const tone
 			index = -1;
 	}
 	if (index>=0) {
+		chan->cfg_stat.applied[ab_chan_cfg_TONE]++;
 		err = err_set_ioctl(chan, IFX_TAPI_TONE_LOCAL_PLAY, index, err_msg);
 		if( !err){
 			chan->status.tone = tone;
@@ -107,7 +108,7 @@ static int cid_string(IFX_TAPI_CID_SERVICE_TYPE_t st, IFX_TAPI_CID_MSG_ELEMENT_t
 	If the given ring state is actual - there is nothing happens
 */
 int 
-ab_FXS_line_ring (ab_chan_t * const chan, enum ab_chan_ring_e ring, char * number, char * name)
+tapi_FXS_line_ring (ab_chan_t * const chan, enum ab_chan_ring_e ring, char * number, char * name)
 {/*{{{*/
 	int err = 0;
 	if (chan->status.ring != ring){
@@ -157,122 +158,13 @@ ab_FXS_line_ring (ab_chan_t * const chan, enum ab_chan_ring_e ring, char * numbe
 				chan->status.ring = ab_chan_ring_MUTE;
 			}
 		}
+		chan->cfg_stat.applied[ab_chan_cfg_RING]++;
+	} else {
+		chan->cfg_stat.suppressed[ab_chan_cfg_RING]++;
 	}
 	return err;
 }/*}}}*/
 
-/******************************************************************
- *   Asterisk routines
- */
-
-struct ast_tone_zone_part {
-	unsigned int freq1;
-	unsigned int freq2;
-	unsigned int time;
-	unsigned int modulate:1;
-	unsigned int midinote:1;
-};
-
-int ast_tone_zone_part_parse(const char *s, struct ast_tone_zone_part *tone_data)
-{
-	if (sscanf(s, "%30u+%30u/%30u", &tone_data->freq1, &tone_data->freq2,
-			&tone_data->time) == 3) {
-		/* f1+f2/time format */
-	} else if (sscanf(s, "%30u+%30u", &tone_data->freq1, &tone_data->freq2) == 2) {
-		/* f1+f2 format */
-		tone_data->time = 0;
-	} else if (sscanf(s, "%30u*%30u/%30u", &tone_data->freq1, &tone_data->freq2,
-			&tone_data->time) == 3) {
-		/* f1*f2/time format */
-		tone_data->modulate = 1;
-	} else if (sscanf(s, "%30u*%30u", &tone_data->freq1, &tone_data->freq2) == 2) {
-		/* f1*f2 format */
-		tone_data->time = 0;
-		tone_data->modulate = 1;
-	} else if (sscanf(s, "%30u/%30u", &tone_data->freq1, &tone_data->time) == 2) {
-		/* f1/time format */
-		tone_data->freq2 = 0;
-	} else if (sscanf(s, "%30u", &tone_data->freq1) == 1) {
-		/* f1 format */
-		tone_data->freq2 = 0;
-		tone_data->time = 0;
-	} else if (sscanf(s, "M%30u+M%30u/%30u", &tone_data->freq1, &tone_data->freq2,
-			&tone_data->time) == 3) {
-		/* Mf1+Mf2/time format */
-		tone_data->midinote = 1;
-	} else if (sscanf(s, "M%30u+M%30u", &tone_data->freq1, &tone_data->freq2) == 2) {
-		/* Mf1+Mf2 format */
-		tone_data->time = 0;
-		tone_data->midinote = 1;
-	} else if (sscanf(s, "M%30u*M%30u/%30u", &tone_data->freq1, &tone_data->freq2,
-			&tone_data->time) == 3) {
-		/* Mf1*Mf2/time format */
-		tone_data->modulate = 1;
-		tone_data->midinote = 1;
-	} else if (sscanf(s, "M%30u*M%30u", &tone_data->freq1, &tone_data->freq2) == 2) {
-		/* Mf1*Mf2 format */
-		tone_data->time = 0;
-		tone_data->modulate = 1;
-		tone_data->midinote = 1;
-	} else if (sscanf(s, "M%30u/%30u", &tone_data->freq1, &tone_data->time) == 2) {
-		/* Mf1/time format */
-		tone_data->freq2 = -1;
-		tone_data->midinote = 1;
-	} else if (sscanf(s, "M%30u", &tone_data->freq1) == 1) {
-		/* Mf1 format */
-		tone_data->freq2 = -1;
-		tone_data->time = 0;
-		tone_data->midinote = 1;
-	} else {
-		return -1;
-	}
-
-	return 0;
-}
-
-
-static int ast_strlen_zero(const char *s)
-{
-	return (!s || (*s == '\0'));
-}
-
-static char * ast_skip_blanks(const char *str)
-{
-	if (str) {
-		while (*str && ((unsigned char) *str) < 33) {
-			str++;
-		}
-	}
-
-	return (char *) str;
-}
-static char *ast_trim_blanks(char *str)
-{
-	char *work = str;
-
-	if (work) {
-		work += strlen(work) - 1;
-		/* It's tempting to only want to erase after we exit this loop,
-		   but since ast_trim_blanks *could* receive a constant string
-		   (which we presumably wouldn't have to touch), we shouldn't
-		   actually set anything unless we must, and it's easier just
-		   to set each position to \0 than to keep track of a variable
-		   for it */
-		while ((work >= str) && ((unsigned char) *work) < 33)
-			*(work--) = '\0';
-	}
-	return str;
-}
-
-static char *ast_strip(char *s)
-{
-	if ((s = ast_skip_blanks(s))) {
-		ast_trim_blanks(s);
-	}
-	return s;
-}
-
-
 /******************************************************************
  *   chan_lantiq  routines
  */
@@ -326,13 +218,9 @@ static int tapitone_add_freq (IFX_TAPI_TONE_t *tone, IFX_uint32_t freq) {
 	return ret; /* freq ID */
 }
 
-/* convert asterisk playlist string to tapi tone structure */
-/* based on ast_playtones_start() from indications.c of asterisk 13 */
-static void playlist_to_tapitone (const char *playlst, IFX_uint32_t index, IFX_TAPI_TONE_t *tone)
+/* convert the compiled tone to tapi tone structure */
+static void tone_to_tapitone (ab_tone_t const * const t, IFX_uint32_t index, IFX_TAPI_TONE_t *tone)
 {
-	char *s, *data = strdup(playlst);
-	char *stringp;
-	char *separator;
 	int i;
 
 	/* initialize tapi tone structure */
@@ -340,69 +228,45 @@ static void playlist_to_tapitone (const char *playlst, IFX_uint32_t index, IFX_T
 	tone->simple.format = IFX_TAPI_TONE_TYPE_SIMPLE;
 	tone->simple.index = index;
 
-	stringp = data;
-
-	/* check if the data is separated with '|' or with ',' by default */
-	if (strchr(stringp,'|')) {
-		separator = "|";
-	} else {
-		separator = ",";
-	}
+	for ( i = 0; i < t->steps_num && i < IFX_TAPI_TONE_STEPS_MAX; i++) {
+		struct ab_tone_step_s const * step = &t->steps[i];
 
-	for ( i = 0; (s = strsep(&stringp, separator)) && !ast_strlen_zero(s) && i < IFX_TAPI_TONE_STEPS_MAX; i++) {
-		struct ast_tone_zone_part tone_data = {
-			.time = 0,
-		};
-
-		s = ast_strip(s);
-		if (s[0]=='!') {
-			s++;
-		}
-
-		if (ast_tone_zone_part_parse(s, &tone_data)) {
-			//FIXME ast_log(LOG_ERROR, "Failed to parse tone part '%s'\n", s);
-			continue;
-		}
-
-		/* first tone must hava a cadence */
-		if (i==0 && !tone_data.time)
-			tone->simple.cadence[i] = 1000;
-		else
-			tone->simple.cadence[i] = tone_data.time;
+		tone->simple.cadence[i] = step->time;
 
 		/* check for modulation */
-		if (tone_data.modulate) {
+		if (step->modulate) {
 			tone->simple.modulation[i] = IFX_TAPI_TONE_MODULATION_ON;
 			tone->simple.modulation_factor = IFX_TAPI_TONE_MODULATION_FACTOR_90;
 		}
 
 		/* copy freq's to tapi tone structure */
 		/* a freq will implicitly skipped if it is zero  */
-		tone->simple.frequencies[i] |= tapitone_add_freq(tone, tone_data.freq1);
-		tone->simple.frequencies[i] |= tapitone_add_freq(tone, tone_data.freq2);
+		tone->simple.frequencies[i] |= tapitone_add_freq(tone, step->freq1);
+		tone->simple.frequencies[i] |= tapitone_add_freq(tone, step->freq2);
 	}
-	free(data);
 }
 /**
-	Setup the given tone using an asterisk playlist
-\param chan - channel to setup tone
+	Program the compiled tone to the device tone table
+\param dev - device to setup tone
 \param tone - tone to setup
-\param playlst - asterisk playlist defining the tone
+\param t - compiled tone (see \ref ab_tone_parse)
 \return
 	ioctl result
+\remark
+	The table is shared by the device channels, the ioctl goes to the
+	first channel of the device.
 */
 int
-ab_FXS_set_tone(ab_chan_t *const chan, enum ab_chan_tone_e tone, const char* playlst)
+tapi_dev_set_tone(ab_dev_t * const dev, enum ab_chan_tone_e tone, ab_tone_t const * const t)
 {
 	IFX_TAPI_TONE_t tapi_tone;
 	IFX_uint32_t index;
 	char const * err_msg;
+	ab_t * ab = dev->parent;
+	int fd = -1;
+	int i;
 
 	switch(tone){
-		case ab_chan_tone_MUTE: {
-			return AB_ERR_NO_ERR;
-			break;
-		}
 		case ab_chan_tone_DIAL: {
 			index = TAPI_TONE_LOCALE_DIAL_CODE;
 			err_msg = "dial";
@@ -422,11 +286,19 @@ ab_FXS_set_tone(ab_chan_t *const chan, enum ab_chan_tone_e tone, const char* pla
 			return AB_ERR_NO_ERR;
 		}
 	}
-	memset(&tapi_tone, 0, sizeof(IFX_TAPI_TONE_t));
-	tapi_tone.simple.format = IFX_TAPI_TONE_TYPE_SIMPLE;
-	playlist_to_tapitone(playlst, index, &tapi_tone);
-	if (ioctl(chan->rtp_fd, IFX_TAPI_TONE_TABLE_CFG_SET, &tapi_tone)) {
-		sprintf(ab_g_err_str, "IFX_TAPI_TONE_CFG_SET %s tone failed", err_msg);
+	for (i=0; i<ab->chans_num; i++){
+		if (ab->chans[i].parent == dev) {
+			fd = ab->chans[i].rtp_fd;
+			break;
+		}
+	}
+	if (fd == -1) {
+		ab_err_set(AB_ERR_BAD_PARAM, "device has no channels for the tone");
+		return AB_ERR_BAD_PARAM;
+	}
+	tone_to_tapitone(t, index, &tapi_tone);
+	if (ioctl(fd, IFX_TAPI_TONE_TABLE_CFG_SET, &tapi_tone)) {
+		ab_err_setf(AB_ERR_UNKNOWN, "IFX_TAPI_TONE_CFG_SET %s tone failed", err_msg);
 		return AB_ERR_UNKNOWN;
 	}
 	return AB_ERR_NO_ERR;
@@ -442,7 +314,7 @@ ab_FXS_set_tone(ab_chan_t *const chan, enum ab_chan_tone_e tone, const char* pla
 	it test the state and do not do the unnecessary actions
 */
 int 
-ab_FXS_line_tone (ab_chan_t * const chan, enum ab_chan_tone_e tone)
+tapi_FXS_line_tone (ab_chan_t * const chan, enum ab_chan_tone_e tone)
 {/*{{{*/
 	int err = 0;
 	if (chan->status.tone != tone){
@@ -466,6 +338,8 @@ ab_FXS_line_tone (ab_chan_t * const chan, enum ab_chan_tone_e tone)
 				} 
 			}
 		}
+	} else {
+		chan->cfg_stat.suppressed[ab_chan_cfg_TONE]++;
 	}
 __exit:
 	return err;
@@ -483,7 +357,7 @@ __exit:
 			it to standby first
 */
 int 
-ab_FXS_line_feed (ab_chan_t * const chan, enum ab_chan_linefeed_e feed) 
+tapi_FXS_line_feed (ab_chan_t * const chan, enum ab_chan_linefeed_e feed) 
 {/*{{{*/
 	int err = 0;
 
@@ -506,6 +380,7 @@ ab_FXS_line_feed (ab_chan_t * const chan, enum ab_chan_linefeed_e feed)
 			case ab_chan_linefeed_ACTIVE: {
 				/* linefeed_STANDBY should be set before ACTIVE */
 				if( chan->status.linefeed == ab_chan_linefeed_DISABLED){
+					chan->cfg_stat.applied[ab_chan_cfg_LINEFEED]++;
 					err = err_set_ioctl (chan, IFX_TAPI_LINE_FEED_SET, 
 						IFX_TAPI_LINE_FEED_STANDBY, 
 						"Setting linefeed to standby before set "
@@ -522,10 +397,13 @@ ab_FXS_line_feed (ab_chan_t * const chan, enum ab_chan_linefeed_e feed)
 			}
 			default: return -1; //it shouldn't happen
 		}
+		chan->cfg_stat.applied[ab_chan_cfg_LINEFEED]++;
 		err = err_set_ioctl (chan, IFX_TAPI_LINE_FEED_SET, lf_to_set, err_msg);
 		if ( !err){
 			chan->status.linefeed = feed;
 		} 
+	} else {
+		chan->cfg_stat.suppressed[ab_chan_cfg_LINEFEED]++;
 	}
 __exit:
 	return err;
@@ -543,7 +421,7 @@ __exit:
 	we can also test hook by ioctl there
 */
 int 
-ab_FXO_line_hook (ab_chan_t * const chan, enum ab_chan_hook_e hook)
+tapi_FXO_line_hook (ab_chan_t * const chan, enum ab_chan_hook_e hook)
 {/*{{{*/
 	int err = 0;
 
@@ -563,10 +441,13 @@ ab_FXO_line_hook (ab_chan_t * const chan, enum ab_chan_hook_e hook)
 			}
 			default: return -1; //it shouldn't happen
 		}
+		chan->cfg_stat.applied[ab_chan_cfg_HOOK]++;
 		err = err_set_ioctl (chan, IFX_TAPI_FXO_HOOK_SET, h_to_set, err_msg);
 		if( !err){
 			chan->status.hook = hook;
 		} 
+	} else {
+		chan->cfg_stat.suppressed[ab_chan_cfg_HOOK]++;
 	}
 	return err;
 }/*}}}*/
@@ -587,7 +468,7 @@ ab_FXO_line_hook (ab_chan_t * const chan, enum ab_chan_hook_e hook)
 			default value (100 ms). Maximum value is 127 ms.
 */
 int 
-ab_FXO_line_digit (ab_chan_t * const chan, char const data_length, 
+tapi_FXO_line_digit (ab_chan_t * const chan, char const data_length, 
 		char const * const data, char const nInterDigitTime,
 		char const nDigitPlayTime, char const pulseMode)
 {/*{{{*/
@@ -643,7 +524,7 @@ __exit:
  *	'm' for muting previously playing tone.
  */
 int 
-ab_FXS_netlo_play (ab_chan_t * const chan, char tone, char local)
+tapi_FXS_netlo_play (ab_chan_t * const chan, char tone, char local)
 {/*{{{*/
 	int err;
 	int idx;
@@ -701,7 +582,7 @@ __exit_fail:
 	0 in success case and other value otherwise
 */
 int 
-ab_chan_cid_standard( ab_chan_t * const chan, const cid_std_t std )
+tapi_chan_cid_standard( ab_chan_t * const chan, const cid_std_t std )
 {/*{{{*/
 	int err;
 	IFX_TAPI_CID_CFG_t cidConf;
@@ -6,6 +6,61 @@
 
 #include "ab_internal_v22.h"
 
+/**
+ *	Make the configuration ioctl if its parameters differ from the shadow.
+ *
+ * \param[in,out] chan channel to operate on.
+ * \param[in] cfg configuration to count in chan->cfg_stat.
+ * \param[in] sh shadow entry.
+ * \param[in] request ioctl request.
+ * \param[in] data ioctl data (pointer to the int for by value ioctls).
+ * \param[in,out] last shadow of the data.
+ * \param[in] size data size or 0 if data is the int passed by value.
+ * \retval	0 in success or if the ioctl is suppressed.
+ * \retval	other - ioctl result.
+ * \remark
+ *	Shadow entry becomes invalid if the ioctl fails, the next call
+ *	will try it again.
+ */ 
+static int
+tapi_shadow_ioctl( ab_chan_t * const chan, enum ab_chan_cfg_e const cfg,
+		enum tapi_shadow_e const sh, int const request,
+		void const * const data, void * const last, size_t const size)
+{/*{{{*/
+	struct tapi_shadow_s * shadow = TAPI_SHADOW(chan);
+	size_t const sz = size ? size : sizeof(int);
+	int err;
+
+	if((shadow->valid & (1 << sh)) && !memcmp(last, data, sz)){
+		chan->cfg_stat.suppressed[cfg]++;
+		return 0;
+	}
+	chan->cfg_stat.applied[cfg]++;
+	if(size){
+		err = ioctl(chan->rtp_fd, request, data);
+	} else {
+		err = ioctl(chan->rtp_fd, request, *(int const *)data);
+	}
+	if(err){
+		shadow->valid &= ~(1 << sh);
+	} else {
+		memcpy(last, data, sz);
+		shadow->valid |= (1 << sh);
+	}
+	return err;
+}/*}}}*/
+
+/**
+ *	Forget the last applied media configuration of the channel.
+ *
+ * \param[in,out] chan channel to operate on.
+ */ 
+void 
+tapi_chan_cfg_invalidate( ab_chan_t * const chan )
+{/*{{{*/
+	TAPI_SHADOW(chan)->valid = 0;
+}/*}}}*/
+
 /**
  * \param[in,out] chan channel to operate on.
  * \retval	0 in success.
@@ -16,7 +71,7 @@
  *	Set WLEC type NE with NLP off
  */ 
 int 
-ab_chan_fax_pass_through_start( ab_chan_t * const chan ) 
+tapi_chan_fax_pass_through_start( ab_chan_t * const chan ) 
 {/*{{{*/
 
 	return -1; //function not implemented
@@ -75,7 +130,7 @@ ab_chan_fax_pass_through_start( ab_chan_t * const chan )
  * 	from \c fcod using just \c type and \c sdp_selected_payload_type.
  */ 
 int 
-ab_chan_media_rtp_tune( ab_chan_t * const chan, codec_t const * const cod,
+tapi_chan_media_rtp_tune( ab_chan_t * const chan, codec_t const * const cod,
 		codec_t const * const fcod, rtp_session_prms_t const * const rtpp, int te_payload)
 {/*{{{*/
 	IFX_TAPI_PKT_RTP_PT_CFG_t rtpPTConf;
@@ -83,6 +138,7 @@ ab_chan_media_rtp_tune( ab_chan_t * const chan, codec_t const * const cod,
 	IFX_TAPI_PKT_VOLUME_t codVolume;
 	IFX_TAPI_ENC_CFG_t encCfg;
 	IFX_TAPI_DEC_CFG_t decCfg;
+	struct tapi_shadow_s * shadow;
 	int vad_param;
 	int hpf_param;
 	int fcodt;
@@ -282,57 +338,61 @@ fprintf(stderr," hpf off\n");
 	}
 #endif/*}}}*/
 	/*********** ioctl seq {{{*/
+	shadow = TAPI_SHADOW(chan);
 
 	/* Set the coder payload table */ 
-	err = 0;
-	err = ioctl(chan->rtp_fd, IFX_TAPI_PKT_RTP_PT_CFG_SET, &rtpPTConf);
+	err = tapi_shadow_ioctl(chan, ab_chan_cfg_CODER, tapi_shadow_PT,
+			IFX_TAPI_PKT_RTP_PT_CFG_SET, &rtpPTConf, &shadow->pt,
+			sizeof(rtpPTConf));
 	if(err){
 		err_summary++;
 		ab_err_set(AB_ERR_UNKNOWN, "media rtp PT tune ioctl error");
 	}
 
 	/* Set the rtp configuration (OOB, pkt params, etc.) */ 
-	err = 0;
-	err = ioctl(chan->rtp_fd, IFX_TAPI_PKT_RTP_CFG_SET, &rtpConf);
+	err = tapi_shadow_ioctl(chan, ab_chan_cfg_CODER, tapi_shadow_RTP,
+			IFX_TAPI_PKT_RTP_CFG_SET, &rtpConf, &shadow->rtp,
+			sizeof(rtpConf));
 	if(err){
 		err_summary++;
 		ab_err_set(AB_ERR_UNKNOWN, "media rtp tune ioctl error");
 	}
 
 	/* Set the encoder */ 
-	err = 0;
-	err = ioctl(chan->rtp_fd, IFX_TAPI_ENC_CFG_SET, &encCfg);
+	err = tapi_shadow_ioctl(chan, ab_chan_cfg_CODER, tapi_shadow_ENC,
+			IFX_TAPI_ENC_CFG_SET, &encCfg, &shadow->enc, sizeof(encCfg));
 	if(err){
 		ab_err_set(AB_ERR_UNKNOWN, "encoder set ioctl error");
 		err_summary++;
 	}
 	/* Set the decoder */ 
-	err = 0;
-	err = ioctl(chan->rtp_fd, IFX_TAPI_DEC_CFG_SET, &decCfg);
+	err = tapi_shadow_ioctl(chan, ab_chan_cfg_CODER, tapi_shadow_DEC,
+			IFX_TAPI_DEC_CFG_SET, &decCfg, &shadow->dec, sizeof(decCfg));
 	if(err){
 		ab_err_set(AB_ERR_UNKNOWN, "decoder set ioctl error");
 		err_summary++;
 	}
 	
 	/* Set the VAD configuration */
-	err = 0;
-	err = ioctl(chan->rtp_fd, IFX_TAPI_ENC_VAD_CFG_SET, vad_param);
+	err = tapi_shadow_ioctl(chan, ab_chan_cfg_CODER, tapi_shadow_VAD,
+			IFX_TAPI_ENC_VAD_CFG_SET, &vad_param, &shadow->vad, 0);
 	if(err){
 		ab_err_set(AB_ERR_UNKNOWN, "vad set ioctl error");
 		err_summary++;
 	}
 
 	/* Configure encoder and decoder gains */
-	err = 0;
-	err = ioctl(chan->rtp_fd, IFX_TAPI_COD_VOLUME_SET, &codVolume);
+	err = tapi_shadow_ioctl(chan, ab_chan_cfg_CODER, tapi_shadow_VOL,
+			IFX_TAPI_COD_VOLUME_SET, &codVolume, &shadow->vol,
+			sizeof(codVolume));
 	if(err){
 		ab_err_set(AB_ERR_UNKNOWN, "volume set ioctl error");
 		err_summary++;
 	}
 
 	/* Configure high-pass filter */
-	err = 0;
-	err = ioctl(chan->rtp_fd, IFX_TAPI_COD_DEC_HP_SET, hpf_param);
+	err = tapi_shadow_ioctl(chan, ab_chan_cfg_CODER, tapi_shadow_HPF,
+			IFX_TAPI_COD_DEC_HP_SET, &hpf_param, &shadow->hpf, 0);
 	if(err){
 		ab_err_set(AB_ERR_UNKNOWN, "high pass set ioctl error");
 		err_summary++;
@@ -354,7 +414,7 @@ __exit:
  * \retval	-1 if fail.
  */ 
 int 
-ab_chan_media_jb_tune( ab_chan_t * const chan, jb_prms_t const * const jbp)
+tapi_chan_media_jb_tune( ab_chan_t * const chan, jb_prms_t const * const jbp)
 {/*{{{*/
 	IFX_TAPI_JB_CFG_t jbCfg;
 	int err;
@@ -382,7 +442,8 @@ ab_chan_media_jb_tune( ab_chan_t * const chan, jb_prms_t const * const jbp)
 	jbCfg.nMaxSize = jbp->jb_max_sz;
 
 	/* Configure jitter buffer */
-	err = ioctl(chan->rtp_fd, IFX_TAPI_JB_CFG_SET, &jbCfg);
+	err = tapi_shadow_ioctl(chan, ab_chan_cfg_JB, tapi_shadow_JB,
+			IFX_TAPI_JB_CFG_SET, &jbCfg, &TAPI_SHADOW(chan)->jb, sizeof(jbCfg));
 	if(err){
 		ab_err_set(AB_ERR_UNKNOWN, "jb cfg set ioctl error");
 	}
@@ -399,7 +460,7 @@ ab_chan_media_jb_tune( ab_chan_t * const chan, jb_prms_t const * const jbp)
  * \retval	-1 if fail.
  */ 
 int 
-ab_chan_media_wlec_tune( ab_chan_t * const chan, wlec_t const * const wp )
+tapi_chan_media_wlec_tune( ab_chan_t * const chan, wlec_t const * const wp )
 {/*{{{*/
 	IFX_TAPI_WLEC_CFG_t lecConf;
 	int err;
@@ -455,7 +516,9 @@ ab_chan_media_wlec_tune( ab_chan_t * const chan, wlec_t const * const wp )
 	}
 
 	/* Set configuration */
-	err = ioctl(chan->rtp_fd, IFX_TAPI_WLEC_PHONE_CFG_SET, &lecConf);
+	err = tapi_shadow_ioctl(chan, ab_chan_cfg_WLEC, tapi_shadow_WLEC,
+			IFX_TAPI_WLEC_PHONE_CFG_SET, &lecConf, &TAPI_SHADOW(chan)->wlec,
+			sizeof(lecConf));
 
 	if (err){
 		ab_err_set(AB_ERR_UNKNOWN, "wlec_phone_cfg_set ioctl error");
@@ -553,7 +616,7 @@ jb_stat_write(ab_chan_t * const chan, IFX_TAPI_JB_STATISTICS_t * const jb_stat)
 	returns the ioctl error value and writes error message
 */
 int 
-ab_chan_media_switch( ab_chan_t * const chan, unsigned char const switch_up )
+tapi_chan_media_switch( ab_chan_t * const chan, unsigned char const switch_up )
 {/*{{{*/
 	int err1= 0;
 	int err2= 0;
@@ -583,7 +646,7 @@ ab_chan_media_switch( ab_chan_t * const chan, unsigned char const switch_up )
 			if( !err){
 				jb_stat_avg_count_and_wirte(chan, &jb_stat);
 				jb_stat_write(chan, &jb_stat);
-				ab_chan_media_rtcp_refresh (chan);
+				tapi_chan_media_rtcp_refresh (chan);
 			}
 			chan->statistics.is_up = 0;
 			chan->statistics.con_cnt++;
@@ -608,7 +671,7 @@ __exit_success:
 	returns the ioctl error value and writes error message
 */
 int 
-ab_chan_media_enc_hold( ab_chan_t * const chan, unsigned char const hold )
+tapi_chan_media_enc_hold( ab_chan_t * const chan, unsigned char const hold )
 {/*{{{*/
 	int err = 0;
 	IFX_operation_t op;
@@ -633,16 +696,19 @@ ab_chan_media_enc_hold( ab_chan_t * const chan, unsigned char const hold )
 	returns the ioctl error value and writes error message
 */
 int 
-ab_chan_media_volume( ab_chan_t * const chan, 
+tapi_chan_media_volume( ab_chan_t * const chan, 
 		int const enc_gain, int const dec_gain )
 {/*{{{*/
 	int err = 0;
 	IFX_TAPI_PKT_VOLUME_t codVolume;
 
+	memset(&codVolume, 0, sizeof(codVolume));
 	codVolume.nDec = dec_gain;
 	codVolume.nEnc = enc_gain;
 
-	err = ioctl(chan->rtp_fd, IFX_TAPI_COD_VOLUME_SET, &codVolume);
+	err = tapi_shadow_ioctl(chan, ab_chan_cfg_CODER, tapi_shadow_VOL,
+			IFX_TAPI_COD_VOLUME_SET, &codVolume, &TAPI_SHADOW(chan)->vol,
+			sizeof(codVolume));
 	if(err){
 		ab_err_set(AB_ERR_UNKNOWN, "encoder mute/unmute ioctl error");
 	}
@@ -656,7 +722,7 @@ ab_chan_media_volume( ab_chan_t * const chan,
 	0 in success case and other value otherwise
 */
 int 
-ab_chan_media_jb_refresh( ab_chan_t * const chan )
+tapi_chan_media_jb_refresh( ab_chan_t * const chan )
 {/*{{{*/
 	int err;
 	IFX_TAPI_JB_STATISTICS_t jb_stat;
@@ -686,7 +752,7 @@ __exit_fail:
 	0 in success case and other value otherwise
 */
 int 
-ab_chan_media_rtcp_refresh( ab_chan_t * const chan )
+tapi_chan_media_rtcp_refresh( ab_chan_t * const chan )
 {/*{{{*/
 	int err;
 	IFX_TAPI_PKT_RTCP_STATISTICS_t rtcp_stat;
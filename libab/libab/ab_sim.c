@@ -0,0 +1,1177 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+
+#include "ab_api.h"
+#include "ab_err.h"
+#include "ab_backend.h"
+
+/*
+ * Simulated backend.
+ *
+ * Every channel is FXS, its rtp_fd is one end of the datagram socketpair,
+ * the other end is the "phone": it sends voice frames while the media is
+ * up (if talking is on) and counts the frames the application writes.
+ * Device cfg_fd is the eventfd of the device events queue, it is readable
+ * while the queue is not empty.
+ *
+ * The phone is driven through the control datagram socket
+ * (AB_SIM_CTL_ENV or AB_SIM_CTL_DF), one text command per datagram,
+ * the reply goes back to the sender address:
+ *	offhook N | onhook N			hook events on channel N (from 0)
+ *	digit N DIGITS | pulse N DIGITS	tone or pulse digits
+ *	ced N 0|1						fax CED end / start
+ *	event N ID DATA					raw event (ab_dev_event_e value and data)
+ *	talk N 0|1						send voice frames while media is up
+ *	state N							channel state line
+ *	stats N [reset]					stamped frames transit line
+ *
+ * The phone ends of the socketpairs are the channels be_fd, so the new
+ * process of the handoff rebuilds the channels on the same socketpairs
+ * (sim_adopt) and the media path goes on, the queued events and the
+ * phones counters are not handed off.
+ *
+ * Voice frames of the phone carry AB_SIM_STAMP_MAGIC and the monotonic
+ * send time (us, big endian) at the start of the payload, the phone
+ * does the same accounting for the stamped frames it gets, so the
+ * relay delay of the application is measured in both directions.
+ */
+
+/** Channels count if AB_SIM_CHANS_ENV is not set */
+#define AB_SIM_CHANS_DF 2
+/** Channels limit (abs_idx is 8 bit, every channel takes a socketpair) */
+#define AB_SIM_CHANS_MAX 128
+/** Channels per simulated device */
+#define AB_SIM_CHANS_PER_DEV 2
+/** Events queue length per device (power of 2) */
+#define AB_SIM_EVENTS 64
+/** Voice frame period (ms) */
+#define AB_SIM_TICK_MS 20
+/** RTP timestamp units per frame (8 kHz clock) */
+#define AB_SIM_TS_PER_TICK (AB_SIM_TICK_MS * 8)
+/** RTP header length */
+#define AB_SIM_RTP_HDR 12
+/** Maximum frame on the socketpair */
+#define AB_SIM_RTP_MAX 512
+/** Maximum control command / reply length */
+#define AB_SIM_CMD_MAX 256
+/** Caller id / dialled digits string length */
+#define AB_SIM_STR_LEN 64
+/** Stamped frame payload starts with it */
+#define AB_SIM_STAMP_MAGIC "SVDT"
+/** Stamp length: magic and 64 bit time (us) */
+#define AB_SIM_STAMP_LEN 12
+/** Transit histogram bins count, the last one is for the rest */
+#define AB_SIM_HIST 10
+
+/** Transit histogram bins upper bounds (us) */
+static unsigned long const ab_sim_hist_us [AB_SIM_HIST-1] = {/*{{{*/
+	50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000
+};/*}}}*/
+
+/** Voice payload bytes per frame for every codec type */
+static int const ab_sim_frame_len [] = {/*{{{*/
+	[cod_type_NONE] = 160,
+	[cod_type_G722_64] = 160,
+	[cod_type_ALAW] = 160,
+	[cod_type_G729] = 20,
+	[cod_type_G729E] = 30,
+	[cod_type_ILBC_133] = 50,
+	[cod_type_G723] = 24,
+	[cod_type_G726_16] = 40,
+	[cod_type_G726_24] = 60,
+	[cod_type_G726_32] = 80,
+	[cod_type_G726_40] = 100,
+};/*}}}*/
+
+/** Phone side of the channel */
+struct ab_sim_chan_s {/*{{{*/
+	int phone_fd; /**< Phone end of the rtp_fd socketpair */
+	unsigned char offhook; /**< Phone hook state */
+	unsigned char up; /**< Media is switched on */
+	unsigned char hold; /**< Encoder is on hold */
+	unsigned char talk; /**< Send frames while media is up */
+	int pt; /**< Voice frames payload type */
+	int frame_len; /**< Voice payload bytes per frame */
+	unsigned short seq; /**< Next sent sequence number */
+	unsigned long ts; /**< Next sent timestamp */
+	unsigned long ssrc; /**< Sent frames SSRC */
+	unsigned long tx_pkts; /**< Frames sent by the phone (encoder) */
+	unsigned long tx_bytes; /**< Bytes sent by the phone */
+	unsigned long rx_pkts; /**< Frames got by the phone (decoder) */
+	unsigned long rx_bytes; /**< Bytes got by the phone */
+	unsigned long rx_ssrc; /**< SSRC of got frames */
+	unsigned long rx_seq_first; /**< First got sequence number */
+	unsigned long rx_seq_last; /**< Extended last got sequence number */
+	unsigned long rx_jitter; /**< Interarrival jitter (RFC 3550, ts units) */
+	long rx_transit; /**< Previous transit time (ts units) */
+	unsigned long st_pkts; /**< Stamped frames got */
+	unsigned long long st_sum_us; /**< Their transit time sum */
+	unsigned long st_max_us; /**< Their maximum transit time */
+	unsigned long st_jitter_us; /**< Their transit jitter (RFC 3550) */
+	long st_transit_us; /**< Previous stamped frame transit */
+	unsigned long long st_last_us; /**< Previous stamped frame arrival */
+	unsigned long st_gap_max_us; /**< Maximum stamped frames interarrival */
+	unsigned long st_hist [AB_SIM_HIST]; /**< Transit histogram */
+	unsigned long rings; /**< Ring starts count */
+	char cid [AB_SIM_STR_LEN]; /**< Last caller id "number name" */
+	char dialed [AB_SIM_STR_LEN]; /**< Last FXO dialled digits */
+};/*}}}*/
+
+/** Events queue of the device */
+struct ab_sim_dev_s {/*{{{*/
+	ab_dev_event_t q [AB_SIM_EVENTS]; /**< Queued events */
+	unsigned int head; /**< Next to put */
+	unsigned int tail; /**< Next to get */
+};/*}}}*/
+
+/** Backend context (ab->be_ctx) */
+struct ab_sim_s {/*{{{*/
+	pthread_mutex_t lock; /**< Guards queues and phone state */
+	pthread_t thread; /**< Phone thread */
+	int thread_up; /**< Phone thread is running */
+	int stop_fd; /**< Stop the phone thread (eventfd) */
+	int ctl_fd; /**< Control socket */
+	char ctl_path [sizeof(((struct sockaddr_un *)0)->sun_path)];
+	ab_t * ab; /**< Board */
+	struct ab_sim_dev_s * devs; /**< Per device */
+	struct ab_sim_chan_s * chans; /**< Per channel */
+};/*}}}*/
+
+static ab_t * sim_create (void);
+static ab_t * sim_adopt (int const * const fds, int const fds_num,
+		int const * const be_fds, unsigned char const * const media_up);
+static ab_t * sim_board_create (int const * const fds, int const fds_num,
+		int const * const be_fds, unsigned char const * const media_up);
+static void sim_destroy (ab_t * const ab);
+static void * sim_phone (void * arg);
+
+/** Phone side of the channel */
+static struct ab_sim_chan_s *
+sim_chan (ab_chan_t const * const chan)
+{/*{{{*/
+	ab_t * ab = chan->parent->parent;
+	struct ab_sim_s * s = ab->be_ctx;
+	return &s->chans[chan - ab->chans];
+}/*}}}*/
+
+/** Monotonic time (us) */
+static unsigned long long
+sim_now_us (void)
+{/*{{{*/
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}/*}}}*/
+
+/** Monotonic time (ms) */
+static unsigned long long
+sim_now_ms (void)
+{/*{{{*/
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}/*}}}*/
+
+/**
+	Put the event to the device queue of the channel
+\param s - backend context
+\param chan_idx - channel index (in ab->chans)
+\param id - event
+\param data - event data
+\return
+	0 in success case and -1 if the queue is full
+*/
+static int
+sim_event_put (struct ab_sim_s * const s, int const chan_idx,
+		enum ab_dev_event_e const id, long const data)
+{/*{{{*/
+	struct ab_sim_dev_s * d = &s->devs[chan_idx / AB_SIM_CHANS_PER_DEV];
+	ab_dev_event_t * evt;
+	unsigned long long one = 1;
+	int err = 0;
+
+	pthread_mutex_lock(&s->lock);
+	if(d->head - d->tail >= AB_SIM_EVENTS){
+		err = -1;
+	} else {
+		evt = &d->q[d->head++ & (AB_SIM_EVENTS-1)];
+		memset(evt, 0, sizeof(*evt));
+		evt->id = id;
+		evt->ch = chan_idx % AB_SIM_CHANS_PER_DEV;
+		evt->data = data;
+	}
+	pthread_mutex_unlock(&s->lock);
+
+	if( !err){
+		err = write(s->ab->devs[chan_idx / AB_SIM_CHANS_PER_DEV].cfg_fd,
+				&one, sizeof(one)) == sizeof(one) ? 0 : -1;
+	}
+	return err;
+}/*}}}*/
+
+/* Backend operations {{{*/
+static int
+sim_FXS_line_ring (ab_chan_t * const chan, enum ab_chan_ring_e ring,
+		char * number, char * name)
+{/*{{{*/
+	struct ab_sim_chan_s * c = sim_chan(chan);
+	struct ab_sim_s * s = chan->parent->parent->be_ctx;
+
+	if (chan->status.ring != ring){
+		pthread_mutex_lock(&s->lock);
+		if(ring == ab_chan_ring_RINGING){
+			c->rings++;
+			snprintf(c->cid, sizeof(c->cid), "%s %s",
+					number ? number : "", name ? name : "");
+		}
+		pthread_mutex_unlock(&s->lock);
+		chan->status.ring = ring;
+	}
+	return 0;
+}/*}}}*/
+
+static int
+sim_dev_set_tone (ab_dev_t * const dev, enum ab_chan_tone_e tone,
+		ab_tone_t const * const t)
+{/*{{{*/
+	return AB_ERR_NO_ERR;
+}/*}}}*/
+
+static int
+sim_FXS_line_tone (ab_chan_t * const chan, enum ab_chan_tone_e tone)
+{/*{{{*/
+	chan->status.tone = tone;
+	return 0;
+}/*}}}*/
+
+static int
+sim_FXS_line_feed (ab_chan_t * const chan, enum ab_chan_linefeed_e feed)
+{/*{{{*/
+	chan->status.linefeed = feed;
+	return 0;
+}/*}}}*/
+
+static int
+sim_FXO_line_hook (ab_chan_t * const chan, enum ab_chan_hook_e hook)
+{/*{{{*/
+	chan->status.hook = hook;
+	return 0;
+}/*}}}*/
+
+static int
+sim_FXO_line_digit (ab_chan_t * const chan, char const data_length,
+		char const * const data, char const nInterDigitTime,
+		char const nDigitPlayTime, char const pulseMode)
+{/*{{{*/
+	struct ab_sim_chan_s * c = sim_chan(chan);
+	struct ab_sim_s * s = chan->parent->parent->be_ctx;
+	int len = data_length;
+
+	if(len >= sizeof(c->dialed)){
+		len = sizeof(c->dialed) - 1;
+	}
+	pthread_mutex_lock(&s->lock);
+	memcpy(c->dialed, data, len);
+	c->dialed[len] = '\0';
+	pthread_mutex_unlock(&s->lock);
+	return 0;
+}/*}}}*/
+
+static int
+sim_FXS_netlo_play (ab_chan_t * const chan, char tone, char local)
+{/*{{{*/
+	return 0;
+}/*}}}*/
+
+/**
+	Get all queued events of the device
+\remark
+	The eventfd counter is reset by read and set again if some events are
+	left in the queue, so the device fd stays readable while the queue is
+	not empty. If it can`t be set the error is set, but the got events
+	are returned anyway (the last one has more flag, the caller asks
+	again).
+*/
+static int
+sim_dev_event_get_batch (ab_dev_t * const dev, ab_dev_event_t * const evts,
+		unsigned char * const chans_available, int const max)
+{/*{{{*/
+	struct ab_sim_s * s = dev->parent->be_ctx;
+	struct ab_sim_dev_s * d = &s->devs[dev->idx - 1];
+	unsigned long long cnt;
+	int left;
+	int n = 0;
+
+	if(read(dev->cfg_fd, &cnt, sizeof(cnt)) != sizeof(cnt)){
+		if(errno == EAGAIN){
+			/* no events */
+			return 0;
+		}
+		ab_err_set(AB_ERR_UNKNOWN, "Getting event (eventfd read)");
+		return -1;
+	}
+
+	pthread_mutex_lock(&s->lock);
+	while(n < max && d->head != d->tail){
+		evts[n] = d->q[d->tail++ & (AB_SIM_EVENTS-1)];
+		evts[n].more = (d->head != d->tail);
+		chans_available[n++] = 1;
+	}
+	left = (d->head != d->tail);
+	pthread_mutex_unlock(&s->lock);
+
+	if(left){
+		cnt = 1;
+		if(write(dev->cfg_fd, &cnt, sizeof(cnt)) != sizeof(cnt)){
+			/* popped events are not lost */
+			ab_err_set(AB_ERR_UNKNOWN, "Getting event (eventfd write)");
+		}
+	}
+	return n;
+}/*}}}*/
+
+/** Get one event from the device queue */
+static int
+sim_dev_event_get (ab_dev_t * const dev, ab_dev_event_t * const evt,
+		unsigned char * const chan_available)
+{/*{{{*/
+	memset(evt, 0, sizeof(*evt));
+	*chan_available = 0;
+	evt->id = ab_dev_event_NONE;
+
+	return sim_dev_event_get_batch(dev, evt, chan_available, 1) < 0 ? -1 : 0;
+}/*}}}*/
+
+static int
+sim_chan_fax_pass_through_start (ab_chan_t * const chan)
+{/*{{{*/
+	/* the same as on TAPI */
+	ab_err_set(AB_ERR_UNKNOWN, "fax pass through is not implemented");
+	return -1;
+}/*}}}*/
+
+static int
+sim_chan_media_rtp_tune (ab_chan_t * const chan, codec_t const * const cod,
+		codec_t const * const fcod, rtp_session_prms_t const * const rtpp,
+		int te_payload)
+{/*{{{*/
+	struct ab_sim_chan_s * c = sim_chan(chan);
+	struct ab_sim_s * s = chan->parent->parent->be_ctx;
+
+	if(cod->type == cod_type_NONE){
+		ab_err_set(AB_ERR_BAD_PARAM, "codec type not set");
+		return -1;
+	}
+	pthread_mutex_lock(&s->lock);
+	c->pt = cod->sdp_selected_payload;
+	c->frame_len = ab_sim_frame_len[cod->type];
+	pthread_mutex_unlock(&s->lock);
+	return 0;
+}/*}}}*/
+
+static int
+sim_chan_media_jb_tune (ab_chan_t * const chan, jb_prms_t const * const jbp)
+{/*{{{*/
+	chan->statistics.jb_stat.nType = jbp->jb_type;
+	return 0;
+}/*}}}*/
+
+static int
+sim_chan_media_wlec_tune (ab_chan_t * const chan, wlec_t const * const wp)
+{/*{{{*/
+	return 0;
+}/*}}}*/
+
+static int
+sim_chan_media_jb_refresh (ab_chan_t * const chan)
+{/*{{{*/
+	struct ab_chan_jb_stat_s * jb = &chan->statistics.jb_stat;
+	struct ab_sim_chan_s * c = sim_chan(chan);
+	struct ab_sim_s * s = chan->parent->parent->be_ctx;
+
+	if( !chan->statistics.is_up){
+		/* nothing to do */
+		return 0;
+	}
+	pthread_mutex_lock(&s->lock);
+	jb->nPackets = c->rx_pkts;
+	jb->nRecBytesH = 0;
+	jb->nRecBytesL = c->rx_bytes;
+	jb->nBufSize = jb->nPODelay = AB_SIM_TICK_MS * 3;
+	jb->nMinBufSize = jb->nMinPODelay = AB_SIM_TICK_MS * 2;
+	jb->nMaxBufSize = jb->nMaxPODelay = AB_SIM_TICK_MS * 4;
+	pthread_mutex_unlock(&s->lock);
+	return 0;
+}/*}}}*/
+
+static int
+sim_chan_media_rtcp_refresh (ab_chan_t * const chan)
+{/*{{{*/
+	struct ab_chan_rtcp_stat_s * r = &chan->statistics.rtcp_stat;
+	struct ab_sim_chan_s * c = sim_chan(chan);
+	struct ab_sim_s * s = chan->parent->parent->be_ctx;
+	unsigned long expected;
+
+	if( !chan->statistics.is_up){
+		/* nothing to do */
+		return 0;
+	}
+	pthread_mutex_lock(&s->lock);
+	r->ssrc = c->ssrc;
+	r->rtp_ts = c->ts;
+	r->psent = c->tx_pkts;
+	r->osent = c->tx_bytes;
+	r->rssrc = c->rx_ssrc;
+	r->last_seq = c->rx_seq_last;
+	r->jitter = c->rx_jitter;
+	expected = c->rx_pkts ? c->rx_seq_last - c->rx_seq_first + 1 : 0;
+	r->lost = expected > c->rx_pkts ? expected - c->rx_pkts : 0;
+	r->fraction = expected ? r->lost * 256 / expected : 0;
+	pthread_mutex_unlock(&s->lock);
+	return 0;
+}/*}}}*/
+
+/**
+	Switch media on / off on the given channel
+\remark
+	Phone counters are reset on switching on, statistics are refreshed
+	and the average packets count is updated on switching off.
+*/
+static int
+sim_chan_media_switch (ab_chan_t * const chan, unsigned char const switch_up)
+{/*{{{*/
+	struct ab_sim_chan_s * c = sim_chan(chan);
+	struct ab_sim_s * s = chan->parent->parent->be_ctx;
+	double n;
+
+	if( chan->statistics.is_up == switch_up ){
+		/* nothing to do */
+		return 0;
+	}
+	if(switch_up){
+		pthread_mutex_lock(&s->lock);
+		c->up = 1;
+		c->hold = 0;
+		c->seq = random();
+		c->ts = random();
+		c->ssrc = random();
+		c->tx_pkts = c->tx_bytes = 0;
+		c->rx_pkts = c->rx_bytes = 0;
+		c->rx_seq_first = c->rx_seq_last = 0;
+		c->rx_jitter = 0;
+		c->rx_transit = 0;
+		pthread_mutex_unlock(&s->lock);
+		chan->statistics.is_up = 1;
+	} else {
+		sim_chan_media_jb_refresh (chan);
+		sim_chan_media_rtcp_refresh (chan);
+		n = chan->statistics.con_cnt;
+		chan->statistics.pcks_avg = n/(n+1)*chan->statistics.pcks_avg +
+				(double)chan->statistics.jb_stat.nPackets/(n+1);
+		pthread_mutex_lock(&s->lock);
+		c->up = 0;
+		pthread_mutex_unlock(&s->lock);
+		chan->statistics.is_up = 0;
+		chan->statistics.con_cnt++;
+	}
+	return 0;
+}/*}}}*/
+
+static int
+sim_chan_media_enc_hold (ab_chan_t * const chan, unsigned char const hold)
+{/*{{{*/
+	struct ab_sim_chan_s * c = sim_chan(chan);
+	struct ab_sim_s * s = chan->parent->parent->be_ctx;
+
+	pthread_mutex_lock(&s->lock);
+	c->hold = hold;
+	pthread_mutex_unlock(&s->lock);
+	return 0;
+}/*}}}*/
+
+static int
+sim_chan_cid_standard (ab_chan_t * const chan, const cid_std_t std)
+{/*{{{*/
+	chan->cid_std = std;
+	return 0;
+}/*}}}*/
+/*}}}*/
+
+/** Simulated backend operations */
+struct ab_backend_s const ab_backend_sim = {/*{{{*/
+	.name = "sim",
+	.create = sim_create,
+	.destroy = sim_destroy,
+	.adopt = sim_adopt,
+	.FXS_line_ring = sim_FXS_line_ring,
+	.dev_set_tone = sim_dev_set_tone,
+	.FXS_line_tone = sim_FXS_line_tone,
+	.FXS_line_feed = sim_FXS_line_feed,
+	.FXO_line_hook = sim_FXO_line_hook,
+	.FXO_line_digit = sim_FXO_line_digit,
+	.FXS_netlo_play = sim_FXS_netlo_play,
+	.dev_event_get = sim_dev_event_get,
+	.chan_fax_pass_through_start = sim_chan_fax_pass_through_start,
+	.chan_media_rtp_tune = sim_chan_media_rtp_tune,
+	.chan_media_jb_tune = sim_chan_media_jb_tune,
+	.chan_media_wlec_tune = sim_chan_media_wlec_tune,
+	.chan_media_switch = sim_chan_media_switch,
+	.chan_media_enc_hold = sim_chan_media_enc_hold,
+	.chan_media_jb_refresh = sim_chan_media_jb_refresh,
+	.chan_media_rtcp_refresh = sim_chan_media_rtcp_refresh,
+	.chan_cid_standard = sim_chan_cid_standard,
+	.dev_event_get_batch = sim_dev_event_get_batch,
+};/*}}}*/
+
+/**
+	Create the ab_t object with simulated channels.
+\return
+	Pointer to created object or NULL if something nasty happens.
+\remark
+	Channels count is taken from AB_SIM_CHANS_ENV, it starts the phone
+	thread with the control socket.
+*/
+static ab_t *
+sim_create (void)
+{/*{{{*/
+	return sim_board_create (NULL, 0, NULL, NULL);
+}/*}}}*/
+
+/**
+	Create the ab_t object on the channels of the previous process.
+\param fds - devices cfg_fd (eventfd), then channels rtp_fd
+\param fds_num - descriptors count
+\param be_fds - phone ends of the channels socketpairs (-1 for devices)
+\param media_up - media is switched on, per channel
+\return
+	Pointer to created object or NULL if something nasty happens.
+\remark
+	Channels are rebuilt on the taken socketpairs, so the frames in
+	flight stay in them and the relay goes on. The phones of the channels
+	with the media up are off hook, talk is off until the control command
+	and the payload type of their frames is 0 until the next tuning.
+	The control socket is bound again with the same path.
+*/
+static ab_t *
+sim_adopt (int const * const fds, int const fds_num,
+		int const * const be_fds, unsigned char const * const media_up)
+{/*{{{*/
+	int i;
+
+	if( !be_fds){
+		ab_err_set(AB_ERR_BAD_PARAM, "no phone ends of the channels");
+		for (i=0; i<fds_num; i++){
+			close(fds[i]);
+		}
+		return NULL;
+	}
+	return sim_board_create (fds, fds_num, be_fds, media_up);
+}/*}}}*/
+
+/**
+	Create the ab_t object with new or taken simulated channels.
+\param fds - descriptors to take (see \ref sim_adopt) or NULL
+\param fds_num - descriptors count
+\param be_fds - phone ends of the channels (with fds)
+\param media_up - media is switched on, per channel (with fds)
+\return
+	Pointer to created object or NULL if something nasty happens.
+\remark
+	With fds the channels count is the one of the previous board:
+	fds_num is chans + devs and every device has AB_SIM_CHANS_PER_DEV
+	channels but the last one. Taken descriptors are closed on errors.
+*/
+static ab_t *
+sim_board_create (int const * const fds, int const fds_num,
+		int const * const be_fds, unsigned char const * const media_up)
+{/*{{{*/
+	struct ab_sim_s * s = NULL;
+	struct sockaddr_un addr;
+	char const * env;
+	ab_t * ab = NULL;
+	unsigned long long cnt;
+	int chans_num = AB_SIM_CHANS_DF;
+	int taken = 0;
+	int sv[2];
+	int i;
+
+	if(fds){
+		/* chans + ceil(chans / per_dev) == fds_num */
+		for (chans_num=1; chans_num<=AB_SIM_CHANS_MAX; chans_num++){
+			if(chans_num + (chans_num + AB_SIM_CHANS_PER_DEV - 1) /
+					AB_SIM_CHANS_PER_DEV == fds_num){
+				break;
+			}
+		}
+		if(chans_num > AB_SIM_CHANS_MAX){
+			ab_err_set(AB_ERR_BAD_PARAM, "wrong taken descriptors number");
+			goto __exit_fail;
+		}
+	} else {
+		env = getenv(AB_SIM_CHANS_ENV);
+		if(env){
+			chans_num = strtol(env, NULL, 10);
+		}
+		if(chans_num <= 0 || chans_num > AB_SIM_CHANS_MAX){
+			ab_err_set(AB_ERR_BAD_PARAM, "wrong simulated channels number");
+			goto __exit_fail;
+		}
+	}
+
+	ab = calloc(1, sizeof(*ab));
+	s = calloc(1, sizeof(*s));
+	if( !ab || !s){
+		ab_err_set(AB_ERR_NO_MEM, "Not enough memory for ab");
+		free (ab);
+		free (s);
+		goto __exit_fail;
+	}
+	ab->be_ctx = s;
+	s->ab = ab;
+	s->stop_fd = s->ctl_fd = -1;
+	pthread_mutex_init(&s->lock, NULL);
+
+	ab->chans_num = chans_num;
+	ab->chans_per_dev = AB_SIM_CHANS_PER_DEV;
+	ab->devs_num = (chans_num + AB_SIM_CHANS_PER_DEV - 1) / AB_SIM_CHANS_PER_DEV;
+
+	ab->chans = calloc(ab->chans_num, sizeof(*(ab->chans)));
+	ab->devs = calloc(ab->devs_num, sizeof(*(ab->devs)));
+	ab->pchans = calloc(ab->chans_num, sizeof(*(ab->pchans)));
+	s->chans = calloc(ab->chans_num, sizeof(*(s->chans)));
+	s->devs = calloc(ab->devs_num, sizeof(*(s->devs)));
+	if( !ab->chans || !ab->devs || !ab->pchans || !s->chans || !s->devs){
+		ab_err_set(AB_ERR_NO_MEM, "no memory for chans or devs structures");
+		goto __free_and_exit_fail;
+	}
+	for (i=0; i<ab->devs_num; i++){
+		ab->devs[i].cfg_fd = -1;
+	}
+	for (i=0; i<ab->chans_num; i++){
+		ab->chans[i].rtp_fd = ab->chans[i].be_fd = s->chans[i].phone_fd = -1;
+	}
+	if(fds){
+		/* the board owns them from here, sim_destroy closes them */
+		taken = 1;
+		for (i=0; i<ab->devs_num; i++){
+			ab->devs[i].cfg_fd = fds[i];
+		}
+		for (i=0; i<ab->chans_num; i++){
+			ab->chans[i].rtp_fd = fds[ab->devs_num + i];
+			s->chans[i].phone_fd = be_fds[ab->devs_num + i];
+		}
+		for (i=0; i<ab->devs_num; i++){
+			if(be_fds[i] != -1){
+				close(be_fds[i]);
+			}
+		}
+	}
+
+	/* Devices init */
+	for (i=0; i<ab->devs_num; i++){
+		ab_dev_t * curr_dev = &ab->devs[ i ];
+		curr_dev->idx = i + 1;
+		curr_dev->parent = ab;
+		curr_dev->type = ab_dev_type_FXS;
+		if(fds){
+			/* the events queue was in the previous process */
+			if(read(curr_dev->cfg_fd, &cnt, sizeof(cnt)) != sizeof(cnt) &&
+					errno != EAGAIN){
+				ab_err_set(AB_ERR_NO_FILE, "reading taken device eventfd");
+				goto __free_and_exit_fail;
+			}
+			continue;
+		}
+		curr_dev->cfg_fd = eventfd(0, EFD_NONBLOCK);
+		if(curr_dev->cfg_fd == -1){
+			ab_err_set(AB_ERR_NO_FILE, "creating device eventfd");
+			goto __free_and_exit_fail;
+		}
+	}
+
+	/* Channels init */
+	for (i=0; i<ab->chans_num; i++){
+		ab_chan_t * curr_chan = &ab->chans[ i ];
+		curr_chan->idx = i % AB_SIM_CHANS_PER_DEV + 1;
+		curr_chan->abs_idx = i;
+		curr_chan->parent = &ab->devs[i / AB_SIM_CHANS_PER_DEV];
+		ab->pchans[i] = curr_chan;
+
+		if( !fds){
+			if(socketpair(AF_UNIX, SOCK_DGRAM, 0, sv)){
+				ab_err_set(AB_ERR_NO_FILE, "creating channel socketpair");
+				goto __free_and_exit_fail;
+			}
+			fcntl(sv[0], F_SETFL, O_NONBLOCK);
+			fcntl(sv[1], F_SETFL, O_NONBLOCK);
+			curr_chan->rtp_fd = sv[0];
+			s->chans[i].phone_fd = sv[1];
+		} else if(curr_chan->rtp_fd == -1 || s->chans[i].phone_fd == -1){
+			ab_err_set(AB_ERR_BAD_PARAM, "no taken channel socketpair");
+			goto __free_and_exit_fail;
+		}
+		curr_chan->be_fd = s->chans[i].phone_fd;
+		s->chans[i].frame_len = ab_sim_frame_len[cod_type_ALAW];
+
+		curr_chan->status.linefeed = ab_chan_linefeed_STANDBY;
+		curr_chan->status.ring = ab_chan_ring_MUTE;
+		curr_chan->status.tone = ab_chan_tone_MUTE;
+		curr_chan->cid_std = cid_ETSI_FSK;
+		if(media_up && media_up[i]){
+			/* the call goes on, sim_chan_media_switch() is no-op */
+			curr_chan->status.linefeed = ab_chan_linefeed_ACTIVE;
+			curr_chan->statistics.is_up = 1;
+			s->chans[i].offhook = 1;
+			s->chans[i].up = 1;
+			s->chans[i].seq = random();
+			s->chans[i].ts = random();
+			s->chans[i].ssrc = random();
+		}
+	}
+
+	/* Control socket */
+	env = getenv(AB_SIM_CTL_ENV);
+	if(snprintf(s->ctl_path, sizeof(s->ctl_path), "%s",
+			env ? env : AB_SIM_CTL_DF) >= sizeof(s->ctl_path)){
+		ab_err_set(AB_ERR_BAD_PARAM, "control socket path is too long");
+		goto __free_and_exit_fail;
+	}
+	s->ctl_fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+	if(s->ctl_fd == -1){
+		ab_err_set(AB_ERR_NO_FILE, "creating control socket");
+		goto __free_and_exit_fail;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	memcpy(addr.sun_path, s->ctl_path, sizeof(addr.sun_path));
+	unlink(s->ctl_path);
+	if(bind(s->ctl_fd, (struct sockaddr *)&addr, sizeof(addr))){
+		ab_err_set(AB_ERR_NO_FILE, "binding control socket");
+		goto __free_and_exit_fail;
+	}
+
+	/* Phone thread */
+	s->stop_fd = eventfd(0, 0);
+	if(s->stop_fd == -1){
+		ab_err_set(AB_ERR_NO_FILE, "creating stop eventfd");
+		goto __free_and_exit_fail;
+	}
+	if(pthread_create(&s->thread, NULL, sim_phone, s)){
+		ab_err_set(AB_ERR_UNKNOWN, "starting phone thread");
+		goto __free_and_exit_fail;
+	}
+	s->thread_up = 1;
+
+	return ab;
+
+__free_and_exit_fail:
+	sim_destroy(ab);
+__exit_fail:
+	for (i=0; fds && !taken && i<fds_num; i++){
+		close(fds[i]);
+		if(be_fds && be_fds[i] != -1){
+			close(be_fds[i]);
+		}
+	}
+	return NULL;
+}/*}}}*/
+
+/**
+	Destroy the ab_t object created by \ref sim_create.
+\param [in]
+	ab - destroying object.
+*/
+static void
+sim_destroy (ab_t * const ab)
+{/*{{{*/
+	struct ab_sim_s * s;
+	unsigned long long one = 1;
+	int i;
+
+	if( !ab){
+		return;
+	}
+	s = ab->be_ctx;
+	if(s){
+		if(s->thread_up){
+			if(write(s->stop_fd, &one, sizeof(one)) == sizeof(one)){
+				pthread_join(s->thread, NULL);
+			}
+		}
+		if(s->stop_fd != -1){
+			close(s->stop_fd);
+		}
+		if(s->ctl_fd != -1){
+			close(s->ctl_fd);
+			unlink(s->ctl_path);
+		}
+		if(s->chans){
+			for (i=0; i<ab->chans_num; i++){
+				if(s->chans[i].phone_fd != -1){
+					close(s->chans[i].phone_fd);
+				}
+			}
+			free (s->chans);
+		}
+		if(s->devs){
+			free (s->devs);
+		}
+		pthread_mutex_destroy(&s->lock);
+		free (s);
+	}
+	if(ab->chans){
+		for (i=0; i<ab->chans_num; i++){
+			if(ab->chans[i].rtp_fd != -1){
+				close(ab->chans[i].rtp_fd);
+			}
+		}
+		free (ab->chans);
+	}
+	if(ab->devs){
+		for (i=0; i<ab->devs_num; i++){
+			if(ab->devs[i].cfg_fd != -1){
+				close(ab->devs[i].cfg_fd);
+			}
+		}
+		free (ab->devs);
+	}
+	if(ab->pchans){
+		free (ab->pchans);
+	}
+	free (ab);
+}/*}}}*/
+
+/**
+	Execute one control command
+\param s - backend context
+\param cmd - command line
+\param rpl - reply buffer (AB_SIM_CMD_MAX)
+*/
+static void
+sim_control (struct ab_sim_s * const s, char * const cmd, char * const rpl)
+{/*{{{*/
+	struct ab_sim_chan_s * c;
+	ab_chan_t * chan;
+	char op [16];
+	char arg [AB_SIM_STR_LEN];
+	long id;
+	long data;
+	int ch;
+	int n;
+	int i;
+	int err = 0;
+
+	arg[0] = '\0';
+	n = sscanf(cmd, "%15s %d %63s", op, &ch, arg);
+	if(n < 2 || ch < 0 || ch >= s->ab->chans_num){
+		snprintf(rpl, AB_SIM_CMD_MAX, "error: usage \"command channel [arg]\"");
+		return;
+	}
+	chan = &s->ab->chans[ch];
+	c = &s->chans[ch];
+
+	if       ( !strcmp(op, "offhook") || !strcmp(op, "onhook")){
+		pthread_mutex_lock(&s->lock);
+		c->offhook = (op[1] == 'f');
+		pthread_mutex_unlock(&s->lock);
+		err = sim_event_put (s, ch, c->offhook ?
+				ab_dev_event_FXS_OFFHOOK : ab_dev_event_FXS_ONHOOK, 0);
+	} else if( !strcmp(op, "digit")){
+		for (i=0; arg[i] && !err; i++){
+			/* ascii and "local" bit like the TAPI DTMF event */
+			err = sim_event_put (s, ch, ab_dev_event_FXS_DIGIT_TONE,
+					arg[i] | (1L << 9));
+		}
+	} else if( !strcmp(op, "pulse")){
+		for (i=0; arg[i] && !err; i++){
+			err = sim_event_put (s, ch, ab_dev_event_FXS_DIGIT_PULSE, arg[i]);
+		}
+	} else if( !strcmp(op, "ced")){
+		err = sim_event_put (s, ch, ab_dev_event_FM_CED, strtol(arg, NULL, 10));
+	} else if( !strcmp(op, "event")){
+		data = 0;
+		if(sscanf(cmd, "%*s %*d %ld %li", &id, &data) < 1 ||
+				id <= ab_dev_event_NONE || id >= ab_dev_event_COUNT){
+			snprintf(rpl, AB_SIM_CMD_MAX, "error: usage \"event channel id [data]\"");
+			return;
+		}
+		if(id == ab_dev_event_FXS_OFFHOOK || id == ab_dev_event_FXS_ONHOOK){
+			pthread_mutex_lock(&s->lock);
+			c->offhook = (id == ab_dev_event_FXS_OFFHOOK);
+			pthread_mutex_unlock(&s->lock);
+		}
+		err = sim_event_put (s, ch, id, data);
+	} else if( !strcmp(op, "talk")){
+		pthread_mutex_lock(&s->lock);
+		c->talk = strtol(arg, NULL, 10) ? 1 : 0;
+		pthread_mutex_unlock(&s->lock);
+	} else if( !strcmp(op, "stats")){
+		pthread_mutex_lock(&s->lock);
+		n = snprintf(rpl, AB_SIM_CMD_MAX, "ch=%d pkts=%lu avg_us=%llu "
+				"max_us=%lu jitter_us=%lu gap_max_us=%lu hist=",
+				ch, c->st_pkts, c->st_pkts ? c->st_sum_us / c->st_pkts : 0,
+				c->st_max_us, c->st_jitter_us, c->st_gap_max_us);
+		for (i=0; i<AB_SIM_HIST && n < AB_SIM_CMD_MAX; i++){
+			n += snprintf(rpl + n, AB_SIM_CMD_MAX - n, i ? ",%lu" : "%lu",
+					c->st_hist[i]);
+		}
+		if( !strcmp(arg, "reset")){
+			c->st_pkts = c->st_sum_us = c->st_max_us = c->st_jitter_us = 0;
+			c->st_transit_us = c->st_last_us = c->st_gap_max_us = 0;
+			memset(c->st_hist, 0, sizeof(c->st_hist));
+		}
+		pthread_mutex_unlock(&s->lock);
+		return;
+	} else if( !strcmp(op, "state")){
+		pthread_mutex_lock(&s->lock);
+		snprintf(rpl, AB_SIM_CMD_MAX, "ch=%d hook=%s ring=%d tone=%d "
+				"linefeed=%d media=%d talk=%d pt=%d tx=%lu rx=%lu "
+				"rings=%lu cid=\"%s\"",
+				ch, c->offhook ? "off" : "on", chan->status.ring,
+				chan->status.tone, chan->status.linefeed, c->up, c->talk,
+				c->pt, c->tx_pkts, c->rx_pkts, c->rings, c->cid);
+		pthread_mutex_unlock(&s->lock);
+		return;
+	} else {
+		snprintf(rpl, AB_SIM_CMD_MAX, "error: unknown command \"%s\"", op);
+		return;
+	}
+	snprintf(rpl, AB_SIM_CMD_MAX, err ? "error: events queue is full" : "ok");
+}/*}}}*/
+
+/**
+	Account the stamped frame got by the phone
+\param c - phone side of the channel
+\param stamp - send time of the frame (us, big endian)
+*/
+static void
+sim_phone_rx_stamp (struct ab_sim_chan_s * const c,
+		unsigned char const * const stamp)
+{/*{{{*/
+	unsigned long long const now = sim_now_us();
+	unsigned long long sent = 0;
+	unsigned long us;
+	long d;
+	int i;
+
+	for (i=0; i<8; i++){
+		sent = (sent << 8) | stamp[i];
+	}
+	us = now > sent ? now - sent : 0;
+	c->st_pkts++;
+	c->st_sum_us += us;
+	if(us > c->st_max_us){
+		c->st_max_us = us;
+	}
+	for (i=0; i<AB_SIM_HIST-1 && us >= ab_sim_hist_us[i]; i++);
+	c->st_hist[i]++;
+	if(c->st_pkts > 1){
+		d = (long)us - c->st_transit_us;
+		if(d < 0){
+			d = -d;
+		}
+		c->st_jitter_us += (d - (long)c->st_jitter_us) / 16;
+		if(now - c->st_last_us > c->st_gap_max_us){
+			c->st_gap_max_us = now - c->st_last_us;
+		}
+	}
+	c->st_transit_us = us;
+	c->st_last_us = now;
+}/*}}}*/
+
+/**
+	Account the frame got by the phone
+\param c - phone side of the channel
+\param buf - frame
+\param len - frame length
+\param now - arrival time (ms)
+*/
+static void
+sim_phone_rx (struct ab_sim_chan_s * const c, unsigned char const * const buf,
+		int const len, unsigned long long const now)
+{/*{{{*/
+	unsigned long seq;
+	unsigned long ts;
+	long transit;
+	long d;
+
+	c->rx_pkts++;
+	c->rx_bytes += len;
+	if(len < AB_SIM_RTP_HDR){
+		return;
+	}
+	seq = (buf[2] << 8) | buf[3];
+	ts = ((unsigned long)buf[4] << 24) | (buf[5] << 16) | (buf[6] << 8) | buf[7];
+	c->rx_ssrc = ((unsigned long)buf[8] << 24) | (buf[9] << 16) |
+			(buf[10] << 8) | buf[11];
+
+	if(c->rx_pkts == 1){
+		c->rx_seq_first = c->rx_seq_last = seq;
+	} else {
+		/* extend the sequence number with wraps */
+		seq |= c->rx_seq_last & ~0xFFFFUL;
+		if(seq + 0x8000 < c->rx_seq_last){
+			seq += 0x10000;
+		}
+		if(seq > c->rx_seq_last){
+			c->rx_seq_last = seq;
+		}
+	}
+
+	/* RFC 3550 interarrival jitter with 8 kHz arrival clock */
+	transit = (long)(now * 8) - (long)ts;
+	if(c->rx_pkts > 1){
+		d = transit - c->rx_transit;
+		if(d < 0){
+			d = -d;
+		}
+		c->rx_jitter += (d - (long)c->rx_jitter) / 16;
+	}
+	c->rx_transit = transit;
+
+	if(len >= AB_SIM_RTP_HDR + AB_SIM_STAMP_LEN &&
+			!memcmp(buf + AB_SIM_RTP_HDR, AB_SIM_STAMP_MAGIC, 4)){
+		sim_phone_rx_stamp (c, buf + AB_SIM_RTP_HDR + 4);
+	}
+}/*}}}*/
+
+/**
+	Send the voice frame from the phone
+\param c - phone side of the channel
+*/
+static void
+sim_phone_tx (struct ab_sim_chan_s * const c)
+{/*{{{*/
+	unsigned char buf [AB_SIM_RTP_MAX];
+	unsigned long long const now = sim_now_us();
+	int len = AB_SIM_RTP_HDR + c->frame_len;
+	int i;
+
+	buf[0] = 0x80;
+	buf[1] = c->pt & 0x7F;
+	buf[2] = c->seq >> 8;
+	buf[3] = c->seq;
+	buf[4] = c->ts >> 24;
+	buf[5] = c->ts >> 16;
+	buf[6] = c->ts >> 8;
+	buf[7] = c->ts;
+	buf[8] = c->ssrc >> 24;
+	buf[9] = c->ssrc >> 16;
+	buf[10] = c->ssrc >> 8;
+	buf[11] = c->ssrc;
+	/* A-law silence after the stamp */
+	memset(buf + AB_SIM_RTP_HDR, 0xD5, c->frame_len);
+	memcpy(buf + AB_SIM_RTP_HDR, AB_SIM_STAMP_MAGIC, 4);
+	for (i=0; i<8; i++){
+		buf[AB_SIM_RTP_HDR + 4 + i] = now >> (56 - 8*i);
+	}
+
+	if(send(c->phone_fd, buf, len, 0) == len){
+		c->tx_pkts++;
+		c->tx_bytes += len;
+	}
+	c->seq++;
+	c->ts += AB_SIM_TS_PER_TICK;
+}/*}}}*/
+
+/**
+	Phone thread
+\param arg - backend context
+\remark
+	It serves the control socket, reads the frames the application
+	writes to the channels and sends voice frames every AB_SIM_TICK_MS.
+*/
+static void *
+sim_phone (void * arg)
+{/*{{{*/
+	struct ab_sim_s * s = arg;
+	int const nfds = s->ab->chans_num + 2;
+	struct pollfd * fds;
+	unsigned char buf [AB_SIM_RTP_MAX];
+	char cmd [AB_SIM_CMD_MAX];
+	char rpl [AB_SIM_CMD_MAX];
+	struct sockaddr_un from;
+	socklen_t from_len;
+	unsigned long long now;
+	unsigned long long tick;
+	int timeout;
+	int len;
+	int i;
+
+	fds = calloc(nfds, sizeof(*fds));
+	if( !fds){
+		return NULL;
+	}
+	fds[0].fd = s->stop_fd;
+	fds[1].fd = s->ctl_fd;
+	for (i=0; i<s->ab->chans_num; i++){
+		fds[i+2].fd = s->chans[i].phone_fd;
+	}
+	for (i=0; i<nfds; i++){
+		fds[i].events = POLLIN;
+	}
+
+	tick = sim_now_ms() + AB_SIM_TICK_MS;
+	for(;;){
+		now = sim_now_ms();
+		timeout = tick > now ? tick - now : 0;
+		if(poll(fds, nfds, timeout) < 0 && errno != EINTR){
+			break;
+		}
+		if(fds[0].revents & POLLIN){
+			break;
+		}
+		if(fds[1].revents & POLLIN){
+			from_len = sizeof(from);
+			len = recvfrom(s->ctl_fd, cmd, sizeof(cmd)-1, 0,
+					(struct sockaddr *)&from, &from_len);
+			if(len > 0){
+				cmd[len] = '\0';
+				sim_control (s, cmd, rpl);
+				if(from_len > sizeof(sa_family_t)){
+					sendto(s->ctl_fd, rpl, strlen(rpl), 0,
+							(struct sockaddr *)&from, from_len);
+				}
+			}
+		}
+		now = sim_now_ms();
+		pthread_mutex_lock(&s->lock);
+		for (i=0; i<s->ab->chans_num; i++){
+			if( !(fds[i+2].revents & POLLIN)){
+				continue;
+			}
+			while((len = recv(s->chans[i].phone_fd, buf, sizeof(buf), 0)) > 0){
+				if(s->chans[i].up){
+					sim_phone_rx (&s->chans[i], buf, len, now);
+				}
+			}
+		}
+		if(now >= tick){
+			for (i=0; i<s->ab->chans_num; i++){
+				struct ab_sim_chan_s * c = &s->chans[i];
+				if(c->up && c->talk && !c->hold){
+					sim_phone_tx (c);
+				}
+			}
+			tick += AB_SIM_TICK_MS;
+			if(tick <= now){
+				/* we are late for more than a frame - resync */
+				tick = now + AB_SIM_TICK_MS;
+			}
+		}
+		pthread_mutex_unlock(&s->lock);
+	}
+	free (fds);
+	return NULL;
+}/*}}}*/
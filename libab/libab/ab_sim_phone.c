@@ -0,0 +1,128 @@
+/*
+ * ab_sim_phone - drive the simulated libab backend.
+ *
+ * Usage: ab_sim_phone [-c ctl_path] [command ...]
+ * Every argument (or every stdin line without arguments) is sent to the
+ * control socket as one command, "sleep MS" pauses the script.
+ * Replies are printed to stdout, exit status is 1 if some command fails.
+ *
+ * Example: ab_sim_phone "offhook 0" "sleep 500" "digit 0 101#" "talk 0 1"
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "ab_api.h"
+
+/** Reply waiting timeout (ms) */
+#define PHONE_TIMEOUT 1000
+/** Maximum command / reply length */
+#define PHONE_CMD_MAX 256
+
+static int phone_fd = -1;
+static struct sockaddr_un phone_addr;
+static struct sockaddr_un ctl_addr;
+
+/**
+	Send the command and print the reply
+\return
+	0 on "ok" or state reply and -1 on errors
+*/
+static int
+phone_cmd (char * cmd)
+{/*{{{*/
+	char rpl [PHONE_CMD_MAX];
+	struct pollfd pfd;
+	int len;
+
+	len = strlen(cmd);
+	while(len && (cmd[len-1] == '\n' || cmd[len-1] == '\r')){
+		cmd[--len] = '\0';
+	}
+	if( !len || cmd[0] == '#'){
+		return 0;
+	}
+	if( !strncmp(cmd, "sleep ", 6)){
+		usleep(strtol(cmd+6, NULL, 10) * 1000);
+		return 0;
+	}
+	if(sendto(phone_fd, cmd, len, 0, (struct sockaddr *)&ctl_addr,
+			sizeof(ctl_addr)) != len){
+		perror("sendto");
+		return -1;
+	}
+	pfd.fd = phone_fd;
+	pfd.events = POLLIN;
+	if(poll(&pfd, 1, PHONE_TIMEOUT) <= 0){
+		fprintf(stderr, "%s: no reply\n", cmd);
+		return -1;
+	}
+	len = recv(phone_fd, rpl, sizeof(rpl)-1, 0);
+	if(len < 0){
+		perror("recv");
+		return -1;
+	}
+	rpl[len] = '\0';
+	printf("%s: %s\n", cmd, rpl);
+	return strncmp(rpl, "error", 5) ? 0 : -1;
+}/*}}}*/
+
+int
+main (int argc, char ** argv)
+{/*{{{*/
+	char const * ctl = getenv(AB_SIM_CTL_ENV);
+	char line [PHONE_CMD_MAX];
+	int err = 0;
+	int opt;
+	int i;
+
+	while((opt = getopt(argc, argv, "c:h")) != -1){
+		if(opt == 'c'){
+			ctl = optarg;
+		} else {
+			fprintf(stderr, "Usage: %s [-c ctl_path] [command ...]\n",
+					argv[0]);
+			return 2;
+		}
+	}
+	if( !ctl){
+		ctl = AB_SIM_CTL_DF;
+	}
+
+	phone_fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+	if(phone_fd == -1){
+		perror("socket");
+		return 1;
+	}
+	/* bind to own path to get replies */
+	memset(&phone_addr, 0, sizeof(phone_addr));
+	phone_addr.sun_family = AF_UNIX;
+	snprintf(phone_addr.sun_path, sizeof(phone_addr.sun_path),
+			"%s.%d", ctl, getpid());
+	unlink(phone_addr.sun_path);
+	if(bind(phone_fd, (struct sockaddr *)&phone_addr, sizeof(phone_addr))){
+		perror("bind");
+		return 1;
+	}
+	memset(&ctl_addr, 0, sizeof(ctl_addr));
+	ctl_addr.sun_family = AF_UNIX;
+	strncpy(ctl_addr.sun_path, ctl, sizeof(ctl_addr.sun_path)-1);
+
+	if(optind < argc){
+		for (i=optind; i<argc; i++){
+			err |= phone_cmd (argv[i]);
+		}
+	} else {
+		while(fgets(line, sizeof(line), stdin)){
+			err |= phone_cmd (line);
+		}
+	}
+
+	close(phone_fd);
+	unlink(phone_addr.sun_path);
+	return err ? 1 : 0;
+}/*}}}*/
@@ -0,0 +1,358 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include "ab_api.h"
+#include "ab_err.h"
+
+/*
+ * Tones of the board.
+ *
+ * Asterisk playlists ("f1+f2/time,...") are compiled to ab_tone_t once,
+ * the backends program the compiled tone to the device tone table
+ * without parsing. The zones are compiled here as the static table,
+ * the playlists of every zone are in its comment.
+ */
+
+/** Step of the tone: frequencies and duration */
+#define STEP(f1,f2,t) {(f1), (f2), (t), 0}
+/** Tone of the steps */
+#define TONE(n, ...) {(n), {__VA_ARGS__}}
+/** Continuous tone (the first step must have a cadence) */
+#define CONT(f1,f2) TONE(1, STEP(f1,f2,1000))
+/** Tone on / off cadence */
+#define CAD(f1,f2,on,off) TONE(2, STEP(f1,f2,on), STEP(0,0,off))
+
+/** Tone zones (AB_TONE_ZONE_DF is the first) */
+static ab_tone_zone_t const ab_tone_zones [] = {/*{{{*/
+	/* 425/200,0/200,425/600,0/1000 425/500,0/500 425/1000,0/4000 */
+	{"it", "Italy", {
+		[ab_chan_tone_DIAL] = TONE(4, STEP(425,0,200), STEP(0,0,200),
+				STEP(425,0,600), STEP(0,0,1000)),
+		[ab_chan_tone_BUSY] = CAD(425,0,500,500),
+		[ab_chan_tone_RINGBACK] = CAD(425,0,1000,4000),
+	}},
+	/* 420 420/400,0/400 420/1000,0/5000 */
+	{"at", "Austria", {
+		[ab_chan_tone_DIAL] = CONT(420,0),
+		[ab_chan_tone_BUSY] = CAD(420,0,400,400),
+		[ab_chan_tone_RINGBACK] = CAD(420,0,1000,5000),
+	}},
+	/* 413+438 425/375,0/375 413+438/400,0/200,413+438/400,0/2000 */
+	{"au", "Australia", {
+		[ab_chan_tone_DIAL] = CONT(413,438),
+		[ab_chan_tone_BUSY] = CAD(425,0,375,375),
+		[ab_chan_tone_RINGBACK] = TONE(4, STEP(413,438,400), STEP(0,0,200),
+				STEP(413,438,400), STEP(0,0,2000)),
+	}},
+	/* 425 425/500,0/500 425/1000,0/3000 */
+	{"be", "Belgium", {
+		[ab_chan_tone_DIAL] = CONT(425,0),
+		[ab_chan_tone_BUSY] = CAD(425,0,500,500),
+		[ab_chan_tone_RINGBACK] = CAD(425,0,1000,3000),
+	}},
+	/* 425 425/250,0/250 425/1000,0/4000 */
+	{"br", "Brazil", {
+		[ab_chan_tone_DIAL] = CONT(425,0),
+		[ab_chan_tone_BUSY] = CAD(425,0,250,250),
+		[ab_chan_tone_RINGBACK] = CAD(425,0,1000,4000),
+	}},
+	/* 425 425/500,0/500 425/1000,0/4000 */
+	{"ch", "Switzerland", {
+		[ab_chan_tone_DIAL] = CONT(425,0),
+		[ab_chan_tone_BUSY] = CAD(425,0,500,500),
+		[ab_chan_tone_RINGBACK] = CAD(425,0,1000,4000),
+	}},
+	/* 425 425/480,0/480 425/1000,0/4000 */
+	{"de", "Germany", {
+		[ab_chan_tone_DIAL] = CONT(425,0),
+		[ab_chan_tone_BUSY] = CAD(425,0,480,480),
+		[ab_chan_tone_RINGBACK] = CAD(425,0,1000,4000),
+	}},
+	/* 425 425/200,0/200 425/1500,0/3000 */
+	{"es", "Spain", {
+		[ab_chan_tone_DIAL] = CONT(425,0),
+		[ab_chan_tone_BUSY] = CAD(425,0,200,200),
+		[ab_chan_tone_RINGBACK] = CAD(425,0,1500,3000),
+	}},
+	/* 440 440/500,0/500 440/1500,0/3500 */
+	{"fr", "France", {
+		[ab_chan_tone_DIAL] = CONT(440,0),
+		[ab_chan_tone_BUSY] = CAD(440,0,500,500),
+		[ab_chan_tone_RINGBACK] = CAD(440,0,1500,3500),
+	}},
+	/* 425 425/500,0/500 425/1000,0/4000 */
+	{"nl", "Netherlands", {
+		[ab_chan_tone_DIAL] = CONT(425,0),
+		[ab_chan_tone_BUSY] = CAD(425,0,500,500),
+		[ab_chan_tone_RINGBACK] = CAD(425,0,1000,4000),
+	}},
+	/* 425 425/500,0/500 425/1000,0/4000 */
+	{"pl", "Poland", {
+		[ab_chan_tone_DIAL] = CONT(425,0),
+		[ab_chan_tone_BUSY] = CAD(425,0,500,500),
+		[ab_chan_tone_RINGBACK] = CAD(425,0,1000,4000),
+	}},
+	/* 425 425/500,0/500 425/1000,0/5000 */
+	{"pt", "Portugal", {
+		[ab_chan_tone_DIAL] = CONT(425,0),
+		[ab_chan_tone_BUSY] = CAD(425,0,500,500),
+		[ab_chan_tone_RINGBACK] = CAD(425,0,1000,5000),
+	}},
+	/* 425 425/350,0/350 425/800,0/3200 */
+	{"ru", "Russia", {
+		[ab_chan_tone_DIAL] = CONT(425,0),
+		[ab_chan_tone_BUSY] = CAD(425,0,350,350),
+		[ab_chan_tone_RINGBACK] = CAD(425,0,800,3200),
+	}},
+	/* 425 425/250,0/250 425/1000,0/5000 */
+	{"se", "Sweden", {
+		[ab_chan_tone_DIAL] = CONT(425,0),
+		[ab_chan_tone_BUSY] = CAD(425,0,250,250),
+		[ab_chan_tone_RINGBACK] = CAD(425,0,1000,5000),
+	}},
+	/* 350+440 400/375,0/375 400+450/400,0/200,400+450/400,0/2000 */
+	{"uk", "United Kingdom", {
+		[ab_chan_tone_DIAL] = CONT(350,440),
+		[ab_chan_tone_BUSY] = CAD(400,0,375,375),
+		[ab_chan_tone_RINGBACK] = TONE(4, STEP(400,450,400), STEP(0,0,200),
+				STEP(400,450,400), STEP(0,0,2000)),
+	}},
+	/* 350+440 480+620/500,0/500 440+480/2000,0/4000 */
+	{"us", "United States", {
+		[ab_chan_tone_DIAL] = CONT(350,440),
+		[ab_chan_tone_BUSY] = CAD(480,620,500,500),
+		[ab_chan_tone_RINGBACK] = CAD(440,480,2000,4000),
+	}},
+};/*}}}*/
+
+/** Tone zones count */
+#define AB_TONE_ZONES_NUM (sizeof(ab_tone_zones)/sizeof(ab_tone_zones[0]))
+
+/******************************************************************
+ *   Asterisk routines
+ */
+
+struct ast_tone_zone_part {
+	unsigned int freq1;
+	unsigned int freq2;
+	unsigned int time;
+	unsigned int modulate:1;
+	unsigned int midinote:1;
+};
+
+static int ast_tone_zone_part_parse(const char *s, struct ast_tone_zone_part *tone_data)
+{
+	if (sscanf(s, "%30u+%30u/%30u", &tone_data->freq1, &tone_data->freq2,
+			&tone_data->time) == 3) {
+		/* f1+f2/time format */
+	} else if (sscanf(s, "%30u+%30u", &tone_data->freq1, &tone_data->freq2) == 2) {
+		/* f1+f2 format */
+		tone_data->time = 0;
+	} else if (sscanf(s, "%30u*%30u/%30u", &tone_data->freq1, &tone_data->freq2,
+			&tone_data->time) == 3) {
+		/* f1*f2/time format */
+		tone_data->modulate = 1;
+	} else if (sscanf(s, "%30u*%30u", &tone_data->freq1, &tone_data->freq2) == 2) {
+		/* f1*f2 format */
+		tone_data->time = 0;
+		tone_data->modulate = 1;
+	} else if (sscanf(s, "%30u/%30u", &tone_data->freq1, &tone_data->time) == 2) {
+		/* f1/time format */
+		tone_data->freq2 = 0;
+	} else if (sscanf(s, "%30u", &tone_data->freq1) == 1) {
+		/* f1 format */
+		tone_data->freq2 = 0;
+		tone_data->time = 0;
+	} else if (sscanf(s, "M%30u+M%30u/%30u", &tone_data->freq1, &tone_data->freq2,
+			&tone_data->time) == 3) {
+		/* Mf1+Mf2/time format */
+		tone_data->midinote = 1;
+	} else if (sscanf(s, "M%30u+M%30u", &tone_data->freq1, &tone_data->freq2) == 2) {
+		/* Mf1+Mf2 format */
+		tone_data->time = 0;
+		tone_data->midinote = 1;
+	} else if (sscanf(s, "M%30u*M%30u/%30u", &tone_data->freq1, &tone_data->freq2,
+			&tone_data->time) == 3) {
+		/* Mf1*Mf2/time format */
+		tone_data->modulate = 1;
+		tone_data->midinote = 1;
+	} else if (sscanf(s, "M%30u*M%30u", &tone_data->freq1, &tone_data->freq2) == 2) {
+		/* Mf1*Mf2 format */
+		tone_data->time = 0;
+		tone_data->modulate = 1;
+		tone_data->midinote = 1;
+	} else if (sscanf(s, "M%30u/%30u", &tone_data->freq1, &tone_data->time) == 2) {
+		/* Mf1/time format */
+		tone_data->freq2 = -1;
+		tone_data->midinote = 1;
+	} else if (sscanf(s, "M%30u", &tone_data->freq1) == 1) {
+		/* Mf1 format */
+		tone_data->freq2 = -1;
+		tone_data->time = 0;
+		tone_data->midinote = 1;
+	} else {
+		return -1;
+	}
+
+	return 0;
+}
+
+
+static int ast_strlen_zero(const char *s)
+{
+	return (!s || (*s == '\0'));
+}
+
+static char * ast_skip_blanks(const char *str)
+{
+	if (str) {
+		while (*str && ((unsigned char) *str) < 33) {
+			str++;
+		}
+	}
+
+	return (char *) str;
+}
+static char *ast_trim_blanks(char *str)
+{
+	char *work = str;
+
+	if (work) {
+		work += strlen(work) - 1;
+		/* It's tempting to only want to erase after we exit this loop,
+		   but since ast_trim_blanks *could* receive a constant string
+		   (which we presumably wouldn't have to touch), we shouldn't
+		   actually set anything unless we must, and it's easier just
+		   to set each position to \0 than to keep track of a variable
+		   for it */
+		while ((work >= str) && ((unsigned char) *work) < 33)
+			*(work--) = '\0';
+	}
+	return str;
+}
+
+static char *ast_strip(char *s)
+{
+	if ((s = ast_skip_blanks(s))) {
+		ast_trim_blanks(s);
+	}
+	return s;
+}
+
+
+
+/**
+	Compile the asterisk playlist to the tone.
+\param [in] playlst - playlist like "425/200,0/200" ('|' separators too)
+\param [out] tone - compiled tone
+\return
+	AB_ERR_NO_ERR or AB_ERR_BAD_PARAM if some part is not parsed or there
+	are more than AB_TONE_STEPS_MAX parts.
+\remark
+	Based on ast_playtones_start() from indications.c of asterisk 13.
+	The first step gets 1000 ms if it has no duration (the tone must have
+	a cadence), the midi notes are taken as frequencies.
+*/
+int
+ab_tone_parse( char const * const playlst, ab_tone_t * const tone )
+{/*{{{*/
+	char *s, *data;
+	char *stringp;
+	char *separator;
+	int err = AB_ERR_NO_ERR;
+	int i;
+
+	memset(tone, 0, sizeof(*tone));
+	if(ast_strlen_zero(playlst)){
+		ab_err_set(AB_ERR_BAD_PARAM, "empty tone playlist");
+		return AB_ERR_BAD_PARAM;
+	}
+	data = strdup(playlst);
+	if( !data){
+		ab_err_set(AB_ERR_NO_MEM, "no memory for tone playlist");
+		return AB_ERR_NO_MEM;
+	}
+
+	stringp = data;
+
+	/* check if the data is separated with '|' or with ',' by default */
+	if (strchr(stringp,'|')) {
+		separator = "|";
+	} else {
+		separator = ",";
+	}
+
+	for ( i = 0; (s = strsep(&stringp, separator)) && !ast_strlen_zero(s); i++) {
+		struct ast_tone_zone_part tone_data = {
+			.time = 0,
+		};
+		struct ab_tone_step_s * step;
+
+		if (i == AB_TONE_STEPS_MAX) {
+			ab_err_setf_copy(AB_ERR_BAD_PARAM,
+					"too many tone parts in '%s'", playlst);
+			err = AB_ERR_BAD_PARAM;
+			break;
+		}
+
+		s = ast_strip(s);
+		if (s[0]=='!') {
+			s++;
+		}
+
+		if (ast_tone_zone_part_parse(s, &tone_data)) {
+			/* s points to data, freed below */
+			ab_err_setf_copy(AB_ERR_BAD_PARAM, "bad tone part '%s'", s);
+			err = AB_ERR_BAD_PARAM;
+			break;
+		}
+
+		step = &tone->steps[i];
+		step->freq1 = tone_data.freq1;
+		step->freq2 = tone_data.freq2;
+		step->modulate = tone_data.modulate;
+		/* first tone must hava a cadence */
+		if (i==0 && !tone_data.time)
+			step->time = 1000;
+		else
+			step->time = tone_data.time;
+	}
+	tone->steps_num = i;
+	free(data);
+	return err;
+}/*}}}*/
+
+/**
+	Find the tone zone by name.
+\param [in] name - zone name (case insensitive)
+\return
+	Zone or NULL if there is no such zone.
+*/
+ab_tone_zone_t const *
+ab_tone_zone_find( char const * const name )
+{/*{{{*/
+	int i;
+	for (i=0; i<AB_TONE_ZONES_NUM; i++){
+		if( !strcasecmp(ab_tone_zones[i].name, name)){
+			return &ab_tone_zones[i];
+		}
+	}
+	return NULL;
+}/*}}}*/
+
+/**
+	Get the tone zone by index.
+\param [in] idx - zone index (from 0)
+\return
+	Zone or NULL after the last one.
+*/
+ab_tone_zone_t const *
+ab_tone_zone_get( int const idx )
+{/*{{{*/
+	if(idx < 0 || idx >= AB_TONE_ZONES_NUM){
+		return NULL;
+	}
+	return &ab_tone_zones[idx];
+}/*}}}*/
@@ -1,16 +1,33 @@
 #!/bin/sh
+# ./build.sh      - TAPI and simulated backends (needs TAPI headers)
+# ./build.sh sim  - simulated backend only and ab_sim_phone (host build)
 
 src_files="\
 	ab_basic.c \
 	ab_line.c \
 	ab_events.c \
 	ab_media.c \
+	ab_backend.c \
+	ab_err.c \
+	ab_sim.c \
+	ab_tone.c \
+	"
+sim_files="\
+	ab_backend.c \
+	ab_err.c \
+	ab_sim.c \
+	ab_tone.c \
 	"
 echo MAKING LIBAB ...
 	rm *.o
 	rm *.a
+if [ "$1" = "sim" ]; then
+	gcc -Wall -DAB_NO_TAPI -I.. -I../.. $sim_files -c
+	ar cr libab.a *.o
+	gcc -Wall -I. ab_sim_phone.c -o ab_sim_phone
+else
 	#mipsel-linux-gcc -Wall -I./vinetic/include/ -I./tapi/include/ -I./sgatab/ -I.. -I../.. $src_files -c
 	gcc -Wall -I./vmmc/include/ -I./tapi/include/ -I./ifxos/include/ -I./sgatab/ -I.. -I../.. $src_files -c
 	ar cr libab.a *.o
+fi
 echo OK
-
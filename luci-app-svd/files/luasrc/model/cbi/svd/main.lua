@@ -68,6 +68,26 @@ local_ip.optional=true
 local_ip.rmempty=true
 local_ip.datatype="ipaddr"
 
+tone_zone=s:option(ListValue,"tone_zone",translate("Tone zone"), translate("Country of the dial, busy and ring tones, the custom tones replace them"))
+tone_zone.optional=true
+tone_zone:value("it",translate("Italy"))
+tone_zone:value("at",translate("Austria"))
+tone_zone:value("au",translate("Australia"))
+tone_zone:value("be",translate("Belgium"))
+tone_zone:value("br",translate("Brazil"))
+tone_zone:value("ch",translate("Switzerland"))
+tone_zone:value("de",translate("Germany"))
+tone_zone:value("es",translate("Spain"))
+tone_zone:value("fr",translate("France"))
+tone_zone:value("nl",translate("Netherlands"))
+tone_zone:value("pl",translate("Poland"))
+tone_zone:value("pt",translate("Portugal"))
+tone_zone:value("ru",translate("Russia"))
+tone_zone:value("se",translate("Sweden"))
+tone_zone:value("uk",translate("United Kingdom"))
+tone_zone:value("us",translate("United States"))
+tone_zone:value("",translate("--remove--"))
+
 dial_tone=s:option(Value,"dial_tone",translate("Custom dial tone"), translate("Definition of a custom dial tone in asterisk format, ") .. asturl)
 dial_tone.optional=true
 dial_tone.rmempty=true
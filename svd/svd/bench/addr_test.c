@@ -0,0 +1,232 @@
+/**
+ * @file addr_test.c
+ * RTP addresses loopback test.
+ * It checks the remote address resolver, the local interface address
+ * 		and the relay of the dual-stack RTP socket between IPv4 and IPv6
+ * 		peers on the loopback (svd_addr.c, as svd uses it).
+ *
+ * Build it from this directory and run it:
+ * \code
+ * 	gcc -O2 -Wall -I../src -o addr_test addr_test.c ../src/svd_addr.c
+ * 	./addr_test
+ * \endcode
+ * Every check prints one line, the exit code is the failed checks count.
+ * The IPv6 checks are skipped if the loopback has no ::1.
+ */
+
+/* Includes {{{ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "svd_addr.h"
+/*}}}*/
+
+/** Wait for the datagram (ms).*/
+#define TEST_WAIT_MS 1000
+
+/** Failed checks.*/
+static int g_failed;
+
+/** Print the check result.*/
+static void
+test_check (int const ok, char const * const what)
+{/*{{{*/
+	printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+	if( !ok){
+		g_failed++;
+	}
+}/*}}}*/
+
+/** Check the resolver result.*/
+static void
+test_resolve (char const * const host, int const sock_af, int const ret,
+		int const family, int const host_af)
+{/*{{{*/
+	struct sockaddr_storage sa;
+	socklen_t len;
+	int af;
+	int err;
+	int ok;
+	char what [128];
+
+	err = svd_addr_resolve (host, 5004, sock_af, &sa, &len, &af);
+	ok = err == ret && af == host_af;
+	if(ok && !err){
+		ok = sa.ss_family == family;
+		if(family == AF_INET6){
+			struct sockaddr_in6 * a6 = (struct sockaddr_in6 *)&sa;
+			ok = ok && len == sizeof(*a6) && ntohs(a6->sin6_port) == 5004;
+			if(host_af == AF_INET){
+				ok = ok && IN6_IS_ADDR_V4MAPPED(&a6->sin6_addr);
+			}
+		} else {
+			struct sockaddr_in * a4 = (struct sockaddr_in *)&sa;
+			ok = ok && len == sizeof(*a4) && ntohs(a4->sin_port) == 5004;
+		}
+	} else if(ok){
+		ok = len == 0;
+	}
+	snprintf(what, sizeof(what), "resolve %s on %s socket -> %d",
+			host, sock_af == AF_INET6 ? "IPv6" : "IPv4", ret);
+	test_check (ok, what);
+}/*}}}*/
+
+/** Open the peer socket bound to the loopback.*/
+static int
+test_peer (int const af, int * const port)
+{/*{{{*/
+	struct sockaddr_storage sa;
+	socklen_t len;
+	int host_af;
+	int fd;
+
+	svd_addr_resolve (af == AF_INET6 ? "::1" : "127.0.0.1", 0, af,
+			&sa, &len, &host_af);
+	fd = socket(af, SOCK_DGRAM, 0);
+	if(fd == -1){
+		return -1;
+	}
+	if(bind(fd, (struct sockaddr *)&sa, len) ||
+			getsockname(fd, (struct sockaddr *)&sa, &len)){
+		close(fd);
+		return -1;
+	}
+	*port = ntohs(af == AF_INET6 ?
+			((struct sockaddr_in6 *)&sa)->sin6_port :
+			((struct sockaddr_in *)&sa)->sin_port);
+	return fd;
+}/*}}}*/
+
+/** Receive the datagram with the timeout.*/
+static int
+test_recv (int const fd, char * const buf, size_t const size)
+{/*{{{*/
+	struct pollfd p;
+	int rode;
+
+	p.fd = fd;
+	p.events = POLLIN;
+	if(poll(&p, 1, TEST_WAIT_MS) != 1){
+		return -1;
+	}
+	rode = recv(fd, buf, size - 1, 0);
+	if(rode >= 0){
+		buf[rode] = '\0';
+	}
+	return rode;
+}/*}}}*/
+
+/**
+ * Relay the datagram from one peer to the other through the RTP socket.
+ * The relay sends to the address the resolver gives for the numeric
+ * host, as the media handlers send to call->remote_addr.
+ */
+static void
+test_relay (int const rtp, int const rtp_af, int const rtp_port,
+		int const from, char const * const from_host,
+		int const to, char const * const to_host, int const to_port)
+{/*{{{*/
+	struct sockaddr_storage sa;
+	socklen_t len;
+	int host_af;
+	char buf [64];
+	char what [128];
+	int ok;
+
+	snprintf(what, sizeof(what), "relay %s -> %s", from_host, to_host);
+	ok = !svd_addr_resolve (from_host, rtp_port, from_host[0] == ':' ?
+			AF_INET6 : AF_INET, &sa, &len, &host_af);
+	ok = ok && sendto(from, what, strlen(what), 0,
+			(struct sockaddr *)&sa, len) > 0;
+	ok = ok && test_recv (rtp, buf, sizeof(buf)) > 0 && !strcmp(buf, what);
+	ok = ok && !svd_addr_resolve (to_host, to_port, rtp_af, &sa, &len,
+			&host_af);
+	ok = ok && sendto(rtp, buf, strlen(buf), 0,
+			(struct sockaddr *)&sa, len) > 0;
+	ok = ok && test_recv (to, buf, sizeof(buf)) > 0 && !strcmp(buf, what);
+	test_check (ok, what);
+}/*}}}*/
+
+int
+main (int argc, char ** argv)
+{/*{{{*/
+	struct sockaddr_storage sa;
+	socklen_t len;
+	char addr [INET6_ADDRSTRLEN];
+	int has_v6;
+	int rtp_af;
+	int rtp;
+	int rtp_port;
+	int p4;
+	int p4_port;
+	int p6 = -1;
+	int p6_port = 0;
+
+	/* resolver */
+	test_resolve ("127.0.0.1", AF_INET6, 0, AF_INET6, AF_INET);
+	test_resolve ("127.0.0.1", AF_INET, 0, AF_INET, AF_INET);
+	test_resolve ("::1", AF_INET6, 0, AF_INET6, AF_INET6);
+	test_resolve ("2001:db8::5", AF_INET6, 0, AF_INET6, AF_INET6);
+	test_resolve ("::1", AF_INET, -2, 0, AF_INET6);
+	test_resolve ("::ffff:10.0.0.1", AF_INET6, 0, AF_INET6, AF_INET6);
+	test_resolve ("pbx.example.com", AF_INET6, -1, 0, AF_UNSPEC);
+	test_resolve ("", AF_INET6, -1, 0, AF_UNSPEC);
+
+	/* local interface address */
+	test_check ( !svd_addr_local ("lo", AF_INET, addr, sizeof(addr)) &&
+			!strcmp(addr, "127.0.0.1"), "local IPv4 address of lo");
+	test_check (svd_addr_local ("lo", AF_INET6, NULL, 0) == -1,
+			"lo has no global IPv6 address (::1 is skipped)");
+	test_check (svd_addr_local ("no_such_if0", AF_INET, NULL, 0) == -1,
+			"unknown interface has no address");
+	test_check ( !svd_addr_local (NULL, AF_INET, NULL, 0),
+			"any interface has IPv4 address");
+
+	/* dual-stack relay */
+	rtp = svd_addr_socket (&rtp_af);
+	test_check (rtp != -1, "RTP socket");
+	if(rtp == -1){
+		goto __exit;
+	}
+	svd_addr_any (rtp_af, 0, &sa, &len);
+	if(bind(rtp, (struct sockaddr *)&sa, len) ||
+			getsockname(rtp, (struct sockaddr *)&sa, &len)){
+		test_check (0, "RTP socket bind");
+		goto __exit;
+	}
+	rtp_port = ntohs(rtp_af == AF_INET6 ?
+			((struct sockaddr_in6 *)&sa)->sin6_port :
+			((struct sockaddr_in *)&sa)->sin_port);
+
+	p4 = test_peer (AF_INET, &p4_port);
+	test_check (p4 != -1, "IPv4 peer");
+	has_v6 = rtp_af == AF_INET6;
+	if(has_v6){
+		p6 = test_peer (AF_INET6, &p6_port);
+		has_v6 = p6 != -1;
+	}
+	if(p4 == -1){
+		goto __exit;
+	}
+	test_relay (rtp, rtp_af, rtp_port, p4, "127.0.0.1", p4, "127.0.0.1",
+			p4_port);
+	if( !has_v6){
+		printf("skip IPv6 relay (no ::1)\n");
+		goto __exit;
+	}
+	test_relay (rtp, rtp_af, rtp_port, p6, "::1", p6, "::1", p6_port);
+	test_relay (rtp, rtp_af, rtp_port, p4, "127.0.0.1", p6, "::1", p6_port);
+	test_relay (rtp, rtp_af, rtp_port, p6, "::1", p4, "127.0.0.1", p4_port);
+
+__exit:
+	printf("%d failed\n", g_failed);
+	return g_failed;
+}/*}}}*/
@@ -0,0 +1,32 @@
+#!/bin/sh
+# Media engines side by side: the same relay load on poll and on uring.
+#
+# ./engine_bench.sh [SVD [CHANS [HOLD_MS]]]
+#   SVD      svd binary configured with --enable-uring (../src/svd)
+#   CHANS    simulated channels and calls (64)
+#   HOLD_MS  connected time of the call (30000)
+#
+# Every engine runs ROUNDS times (3, env), the JSON lines of load_bench
+# go to stdout in the run order, the progress to stderr. The log of svd
+# (-v) tells if uring fell back to poll on this kernel.
+
+svd=${1:-../src/svd}
+chans=${2:-64}
+hold=${3:-30000}
+rounds=${ROUNDS:-3}
+
+cd `dirname $0`
+if [ ! -x ./load_bench ] || [ load_bench.c -nt ./load_bench ]; then
+	gcc -O2 -Wall -o load_bench load_bench.c || exit 1
+fi
+
+i=0
+while [ $i -lt $rounds ]; do
+	# interleaved, so the box state drifts over both engines
+	for engine in poll uring; do
+		echo "round $i engine $engine ..." >&2
+		./load_bench -x $svd -m -n $chans -k $chans -t $hold -e $engine ||
+				exit 1
+	done
+	i=`expr $i + 1`
+done
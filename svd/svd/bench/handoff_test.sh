@@ -0,0 +1,33 @@
+#!/bin/sh
+# Handoff of svd with the calls up on the simulated board.
+#
+# ./handoff_test.sh [SVD [CHANS [HOLD_MS [AT_MS]]]]
+#   SVD      svd binary on libab "build.sh sim" (../src/svd), svd_if must
+#            be next to it, /var/svd must be writable (svd-socket)
+#   CHANS    simulated channels and calls (2)
+#   HOLD_MS  connected time of the call (8000)
+#   AT_MS    handoff time after the first call (2000)
+#
+# The JSON line of load_bench goes to stdout. The test passes if every call
+# is ended with BYE and the calls up at the handoff relay frames in both
+# directions after it and end with BYE of the new svd.
+
+svd=${1:-../src/svd}
+chans=${2:-2}
+hold=${3:-8000}
+at=${4:-2000}
+
+cd `dirname $0`
+if [ ! -x ./load_bench ] || [ load_bench.c -nt ./load_bench ]; then
+	gcc -O2 -Wall -o load_bench load_bench.c || exit 1
+fi
+
+./load_bench -x $svd -n $chans -k $chans -t $hold -H $at
+err=$?
+case $err in
+0) echo "handoff ok" >&2 ;;
+2) echo "handoff FAIL: calls failed" >&2 ;;
+3) echo "handoff FAIL: calls did not survive (see \"handoff\")" >&2 ;;
+*) echo "handoff FAIL: load_bench error $err" >&2 ;;
+esac
+exit $err
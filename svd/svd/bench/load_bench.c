@@ -0,0 +1,1318 @@
+/**
+ * @file load_bench.c
+ * End-to-end load benchmark.
+ * It starts svd on the simulated board with N channels, plays the
+ * 		registrar, the proxy and the called phones on the loopback and
+ * 		drives off-hook / dial / answer / hang-up cycles on all channels.
+ *
+ * Build it from this directory and run it against the host svd
+ * (libab built with "build.sh sim"):
+ * \code
+ * 	gcc -O2 -Wall -o load_bench load_bench.c
+ * 	./load_bench -x ../src/svd -n 16 -c 16 -k 500 -t 2000
+ * \endcode
+ * The result is one JSON line on stdout: calls per second, the setup
+ * latencies (dial to INVITE, answer to the first RTP packet, on-hook to
+ * BYE) percentiles, svd CPU over its idle rate per call and per call
+ * second of relayed media, RSS growth per call and open fds. Progress
+ * goes to stderr. Runs with the same options on the same box are
+ * comparable between commits: the call schedule is fixed, no randomness
+ * and no network is used (svd listens on 127.0.0.1:5060, the stand-in on
+ * 127.0.0.1:5070 by default).
+ *
+ * With "-m" it measures the RTP relay of svd instead of echoing: the
+ * stand-in sends paced 20 ms frames to every connected call and the
+ * simulated phone sends its own, both stamp the send time into the
+ * payload (see ab_sim.c), so the transit time histogram, added jitter
+ * (RFC 3550 style) and the maximum interarrival gap are reported for
+ * both directions. "-s RATE" adds SIP load (OPTIONS requests to svd):
+ * \code
+ * 	./load_bench -x ../src/svd -m -n 32 -k 32 -t 30000 -s 200
+ * \endcode
+ * "-e ENGINE" sets svd "option media_engine", the engines are compared
+ * side by side with the same relay load (svd configured with
+ * --enable-uring, the log shows if it fell back to poll):
+ * \code
+ * 	./load_bench -x ../src/svd -m -n 64 -k 64 -t 30000 -e poll
+ * 	./load_bench -x ../src/svd -m -n 64 -k 64 -t 30000 -e uring
+ * \endcode
+ * engine_bench.sh runs both of them interleaved a few times.
+ *
+ * "-H MS" hands svd off ("svd_if handoff[]", svd_if is taken from the
+ * directory of the svd binary) MS into the calls and checks that the
+ * calls up at that time go on: frames of both directions relayed by the
+ * new svd and the BYE from the saved dialog on hook (it sets "-m").
+ * handoff_test.sh runs it.
+ */
+
+/* Includes {{{ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+/*}}}*/
+
+/** Channels limit of the simulated board.*/
+#define LB_CHANS_MAX 128
+/** Called number of the channel is LB_NUM_BASE + channel.*/
+#define LB_NUM_BASE 7000
+/** Off-hook to dialing (dial tone) time.*/
+#define LB_DIALTONE_MS 100
+/** Pause between the calls on the channel.*/
+#define LB_REST_MS 100
+/** Call step timeout, the call fails after it.*/
+#define LB_TIMEOUT_MS 10000
+/** Registration wait time.*/
+#define LB_REG_TIMEOUT_MS 15000
+/** Idle svd CPU measurement time.*/
+#define LB_IDLE_MS 1000
+/** /proc sampling period.*/
+#define LB_SAMPLE_MS 100
+/** SIP message buffer size.*/
+#define LB_SIP_MAX 4096
+/** Small buffers size.*/
+#define LB_STR_MAX 256
+/** RTP frame period (ms).*/
+#define LB_FRAME_MS 20
+/** RTP frame size (G.711 20 ms).*/
+#define LB_FRAME_LEN 172
+/** Phone talk retry period after the handoff (ms).*/
+#define LB_HANDOFF_RETRY_MS 200
+/** Stamped frame payload starts with it (as ab_sim.c does).*/
+#define LB_STAMP_MAGIC "SVDT"
+/** Transit histogram bins count (as in ab_sim.c).*/
+#define LB_HIST 10
+
+/** Transit histogram bins upper bounds (us), the last bin is the rest.*/
+static unsigned long const lb_hist_us [LB_HIST-1] = {/*{{{*/
+	50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000
+};/*}}}*/
+
+/** lb_poll() modes.*/
+enum lb_mode_e {/*{{{*/
+	lb_mode_REG, /**< Wait for the registration */
+	lb_mode_IDLE, /**< Just answer */
+	lb_mode_CALLS, /**< Make the calls until all are done */
+};/*}}}*/
+
+/** Channel call states.*/
+enum lb_state_e {/*{{{*/
+	lb_state_IDLE, /**< On-hook, waiting for the next call */
+	lb_state_OFFHOOK, /**< Off-hook, waiting to dial */
+	lb_state_DIALED, /**< Number dialed, waiting for INVITE */
+	lb_state_RINGING, /**< INVITE got, 180 sent, waiting to answer */
+	lb_state_UP, /**< 200 sent, media should flow */
+	lb_state_HANGUP, /**< On-hook, waiting for BYE */
+};/*}}}*/
+
+/** Stamped frames transit of one direction.*/
+struct lb_relay_s {/*{{{*/
+	unsigned long pkts; /**< Frames got.*/
+	unsigned long sent; /**< Frames sent (known for calls to the board).*/
+	unsigned long long sum_us; /**< Transit time sum.*/
+	unsigned long max_us; /**< Maximum transit time.*/
+	unsigned long jitter_us; /**< Jitter of the stream (RFC 3550).*/
+	long transit_us; /**< Previous frame transit.*/
+	long long last_us; /**< Previous frame arrival.*/
+	unsigned long gap_max_us; /**< Maximum interarrival.*/
+	unsigned long hist [LB_HIST]; /**< Transit histogram.*/
+	unsigned long streams; /**< Folded streams (totals).*/
+	unsigned long long jitter_sum_us; /**< Jitter sum of streams (totals).*/
+	unsigned long jitter_max_us; /**< Maximum jitter of streams (totals).*/
+};/*}}}*/
+
+/** Channel context.*/
+struct lb_chan_s {/*{{{*/
+	enum lb_state_e state; /**< Call state.*/
+	long long t_state; /**< State entry time (us).*/
+	long long t_dial; /**< Dial end time (us).*/
+	long long t_answer; /**< 200 OK sent time (us).*/
+	long long t_onhook; /**< On-hook time (us).*/
+	int got_media; /**< First RTP packet of the call came.*/
+	int rtp_fd; /**< RTP echo socket.*/
+	int rtp_port; /**< RTP echo socket port.*/
+	char invite [LB_SIP_MAX]; /**< The call INVITE.*/
+	char call_id [LB_STR_MAX]; /**< The call Call-ID.*/
+	struct sockaddr_in src; /**< The INVITE source.*/
+	int pt; /**< Offered payload type.*/
+	unsigned long seq; /**< Calls on the channel (To tag).*/
+	struct sockaddr_in media; /**< svd RTP address of the call.*/
+	long long tx_next; /**< Next frame to svd time (us).*/
+	unsigned short tx_seq; /**< Next frame to svd sequence number.*/
+	unsigned long tx_sent; /**< Frames sent to svd in the call.*/
+	struct lb_relay_s to_net; /**< The call frames from the board.*/
+	int ho_call; /**< The call was up at the handoff.*/
+	int ho_talk; /**< The phone talk should be switched on again.*/
+	long long ho_retry; /**< Next talk try time (us).*/
+	unsigned long ho_net; /**< to_net frames at the handoff.*/
+};/*}}}*/
+
+/** Latency samples.*/
+struct lb_lat_s {/*{{{*/
+	long long * us; /**< Samples.*/
+	int n; /**< Samples count.*/
+};/*}}}*/
+
+/** svd process sample.*/
+struct lb_proc_s {/*{{{*/
+	long long cpu_ms; /**< User and system CPU time.*/
+	long rss_kb; /**< Resident set size.*/
+	int fds; /**< Open fds.*/
+};/*}}}*/
+
+/** Benchmark context.*/
+static struct {/*{{{*/
+	int chans; /**< Channels count.*/
+	int conc; /**< Concurrent calls limit.*/
+	int calls; /**< Calls to make.*/
+	int hold_ms; /**< Connected call time.*/
+	int answer_ms; /**< INVITE to answer time.*/
+	double rate; /**< Call starts per second limit (0 - no limit).*/
+	int port; /**< Stand-in SIP port.*/
+	int verbose; /**< Show svd output.*/
+	int relay; /**< Measure the relay (do not echo RTP).*/
+	double sip_rate; /**< OPTIONS per second to svd (0 - none).*/
+	char const * engine; /**< svd media engine.*/
+	char const * svd; /**< svd binary.*/
+	int handoff_ms; /**< Hand svd off so long into the calls (0 - no).*/
+
+	char dir [64]; /**< Temporary config directory.*/
+	char ctl_path [96]; /**< Board control socket.*/
+	char cli_path [96]; /**< Our control client socket.*/
+	pid_t pid; /**< svd process.*/
+	int registered; /**< svd registered the account.*/
+	struct sockaddr_in svd_sip; /**< svd SIP address.*/
+	int sip_fd; /**< Stand-in SIP socket.*/
+	int ctl_fd; /**< Board control client socket.*/
+	struct lb_chan_s chan [LB_CHANS_MAX]; /**< Channels.*/
+
+	int started; /**< Started calls.*/
+	int active; /**< Calls in progress.*/
+	int ok; /**< Completed calls.*/
+	int failed; /**< Failed calls.*/
+	long long call_us; /**< Connected time of completed calls.*/
+	unsigned long rtp_echoed; /**< Echoed RTP packets.*/
+	struct lb_lat_s lat_invite; /**< Dial to INVITE.*/
+	struct lb_lat_s lat_media; /**< Answer to the first RTP packet.*/
+	struct lb_lat_s lat_bye; /**< On-hook to BYE.*/
+	struct lb_proc_s p_start; /**< svd before the calls.*/
+	struct lb_proc_s p_peak; /**< svd peaks.*/
+	struct lb_proc_s p_end; /**< svd after the calls.*/
+	struct lb_relay_s to_net; /**< Board to network frames.*/
+	struct lb_relay_s to_board; /**< Network to board frames.*/
+	unsigned long opt_sent; /**< OPTIONS sent.*/
+	unsigned long opt_ok; /**< OPTIONS answered.*/
+	int ho_state; /**< Handoff: 0 - not yet, 1 - done, -1 - failed.*/
+	int ho_calls; /**< Calls up at the handoff.*/
+	int ho_net_ok; /**< Of them with frames to the net after it.*/
+	int ho_board_ok; /**< Of them with frames to the board after it.*/
+	int ho_ended; /**< Of them ended with BYE on hook.*/
+} lb;/*}}}*/
+
+/** Get monotonic time in us.*/
+static long long
+lb_us (void)
+{/*{{{*/
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}/*}}}*/
+
+/** Sample svd CPU, RSS and fds from /proc.*/
+static int
+lb_sample (struct lb_proc_s * const p)
+{/*{{{*/
+	char path [LB_STR_MAX];
+	char buf [1024];
+	unsigned long ut;
+	unsigned long st;
+	char * s;
+	FILE * f;
+	DIR * d;
+	struct dirent * de;
+	int n;
+
+	snprintf(path, sizeof(path), "/proc/%d/stat", lb.pid);
+	f = fopen(path, "r");
+	if( !f){
+		return -1;
+	}
+	n = fread(buf, 1, sizeof(buf)-1, f);
+	fclose(f);
+	buf[n > 0 ? n : 0] = '\0';
+	/* comm can have spaces, fields count from its closing paren */
+	s = strrchr(buf, ')');
+	if( !s || sscanf(s + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+			&ut, &st) != 2){
+		return -1;
+	}
+	p->cpu_ms = (ut + st) * 1000LL / sysconf(_SC_CLK_TCK);
+
+	snprintf(path, sizeof(path), "/proc/%d/status", lb.pid);
+	f = fopen(path, "r");
+	if( !f){
+		return -1;
+	}
+	p->rss_kb = 0;
+	while(fgets(buf, sizeof(buf), f)){
+		if( !strncmp(buf, "VmRSS:", 6)){
+			p->rss_kb = strtol(buf + 6, NULL, 10);
+			break;
+		}
+	}
+	fclose(f);
+
+	snprintf(path, sizeof(path), "/proc/%d/fd", lb.pid);
+	d = opendir(path);
+	if( !d){
+		return -1;
+	}
+	p->fds = 0;
+	while((de = readdir(d))){
+		if(de->d_name[0] != '.'){
+			p->fds++;
+		}
+	}
+	closedir(d);
+	return 0;
+}/*}}}*/
+
+/** Update the peaks with the new sample.*/
+static void
+lb_sample_peak (void)
+{/*{{{*/
+	struct lb_proc_s p;
+	if(lb_sample(&p)){
+		return;
+	}
+	if(p.rss_kb > lb.p_peak.rss_kb){
+		lb.p_peak.rss_kb = p.rss_kb;
+	}
+	if(p.fds > lb.p_peak.fds){
+		lb.p_peak.fds = p.fds;
+	}
+}/*}}}*/
+
+/** Add the latency sample.*/
+static void
+lb_lat_add (struct lb_lat_s * const l, long long const us)
+{/*{{{*/
+	l->us[l->n++] = us;
+}/*}}}*/
+
+/** qsort comparator.*/
+static int
+lb_lat_cmp (void const * a, void const * b)
+{/*{{{*/
+	long long const x = *(long long const *)a;
+	long long const y = *(long long const *)b;
+	return (x > y) - (x < y);
+}/*}}}*/
+
+/** Print the latency percentiles as JSON object.*/
+static void
+lb_lat_print (char const * const name, struct lb_lat_s * const l)
+{/*{{{*/
+	long long * u = l->us;
+	int n = l->n;
+	qsort(u, n, sizeof(*u), lb_lat_cmp);
+	printf("\"%s\":{\"n\":%d,\"p50\":%lld,\"p90\":%lld,\"p99\":%lld,\"max\":%lld}",
+			name, n, n ? u[n * 50 / 100] : 0, n ? u[n * 90 / 100] : 0,
+			n ? u[n * 99 / 100] : 0, n ? u[n - 1] : 0);
+}/*}}}*/
+
+/** Send the command to the board and get the reply (LB_STR_MAX).*/
+static int
+lb_ctl_rpl (char * const rpl, char const * const fmt, int const ch,
+		char const * const arg)
+{/*{{{*/
+	struct sockaddr_un addr;
+	struct pollfd pfd;
+	char cmd [LB_STR_MAX];
+	int len;
+
+	len = snprintf(cmd, sizeof(cmd), fmt, ch, arg);
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, lb.ctl_path, sizeof(addr.sun_path)-1);
+	if(sendto(lb.ctl_fd, cmd, len, 0, (struct sockaddr *)&addr,
+			sizeof(addr)) != len){
+		fprintf(stderr, "control \"%s\": %s\n", cmd, strerror(errno));
+		return -1;
+	}
+	pfd.fd = lb.ctl_fd;
+	pfd.events = POLLIN;
+	if(poll(&pfd, 1, 1000) != 1){
+		fprintf(stderr, "control \"%s\": no reply\n", cmd);
+		return -1;
+	}
+	len = recv(lb.ctl_fd, rpl, LB_STR_MAX-1, 0);
+	if(len <= 0){
+		return -1;
+	}
+	rpl[len] = '\0';
+	if( !strncmp(rpl, "error", 5)){
+		fprintf(stderr, "control \"%s\": %s\n", cmd, rpl);
+		return -1;
+	}
+	return 0;
+}/*}}}*/
+
+/** Send the command to the board and wait for "ok".*/
+static int
+lb_ctl (char const * const fmt, int const ch, char const * const arg)
+{/*{{{*/
+	char rpl [LB_STR_MAX];
+	return lb_ctl_rpl(rpl, fmt, ch, arg);
+}/*}}}*/
+
+/** Account the stamped frame.*/
+static void
+lb_relay_add (struct lb_relay_s * const r, unsigned char const * const stamp,
+		long long const now)
+{/*{{{*/
+	long long sent = 0;
+	unsigned long us;
+	long d;
+	int i;
+
+	for (i=0; i<8; i++){
+		sent = (sent << 8) | stamp[i];
+	}
+	us = now > sent ? now - sent : 0;
+	r->pkts++;
+	r->sum_us += us;
+	if(us > r->max_us){
+		r->max_us = us;
+	}
+	for (i=0; i<LB_HIST-1 && us >= lb_hist_us[i]; i++);
+	r->hist[i]++;
+	if(r->pkts > 1){
+		d = (long)us - r->transit_us;
+		if(d < 0){
+			d = -d;
+		}
+		r->jitter_us += (d - (long)r->jitter_us) / 16;
+		if((unsigned long)(now - r->last_us) > r->gap_max_us){
+			r->gap_max_us = now - r->last_us;
+		}
+	}
+	r->transit_us = us;
+	r->last_us = now;
+}/*}}}*/
+
+/** Add the stream to the totals and clear it.*/
+static void
+lb_relay_fold (struct lb_relay_s * const t, struct lb_relay_s * const r)
+{/*{{{*/
+	int i;
+	t->pkts += r->pkts;
+	t->sent += r->sent;
+	t->sum_us += r->sum_us;
+	if(r->max_us > t->max_us){
+		t->max_us = r->max_us;
+	}
+	if(r->gap_max_us > t->gap_max_us){
+		t->gap_max_us = r->gap_max_us;
+	}
+	for (i=0; i<LB_HIST; i++){
+		t->hist[i] += r->hist[i];
+	}
+	if(r->pkts > 1){
+		t->streams++;
+		t->jitter_sum_us += r->jitter_us;
+		if(r->jitter_us > t->jitter_max_us){
+			t->jitter_max_us = r->jitter_us;
+		}
+	}
+	memset(r, 0, sizeof(*r));
+}/*}}}*/
+
+/** Get the phone stamped frames stats of the call and fold them.*/
+static void
+lb_relay_board (int const ch)
+{/*{{{*/
+	struct lb_relay_s r;
+	char rpl [LB_STR_MAX];
+	char * h;
+	int i;
+
+	memset(&r, 0, sizeof(r));
+	if(lb_ctl_rpl(rpl, "stats %d %s", ch, "reset")){
+		return;
+	}
+	h = strstr(rpl, "hist=");
+	if(sscanf(rpl, "ch=%*d pkts=%lu avg_us=%*u max_us=%lu jitter_us=%lu "
+			"gap_max_us=%lu", &r.pkts, &r.max_us, &r.jitter_us,
+			&r.gap_max_us) != 4 || !h){
+		fprintf(stderr, "[%02d] bad stats \"%s\"\n", ch, rpl);
+		return;
+	}
+	h += 5;
+	for (i=0; i<LB_HIST && *h; i++){
+		r.hist[i] = strtoul(h, &h, 10);
+		h += *h == ',';
+	}
+	/* the sum is restored from the average */
+	sscanf(strstr(rpl, "avg_us="), "avg_us=%llu", &r.sum_us);
+	r.sum_us *= r.pkts;
+	r.sent = lb.chan[ch].tx_sent;
+	lb_relay_fold(&lb.to_board, &r);
+}/*}}}*/
+
+/** Print the direction totals as JSON object.*/
+static void
+lb_relay_print (char const * const name, struct lb_relay_s const * const t)
+{/*{{{*/
+	int i;
+	printf("\"%s\":{\"pkts\":%lu,\"sent\":%lu,\"avg_us\":%llu,\"max_us\":%lu,"
+			"\"jitter_avg_us\":%llu,\"jitter_max_us\":%lu,\"gap_max_us\":%lu,"
+			"\"hist\":[", name, t->pkts, t->sent,
+			t->pkts ? t->sum_us / t->pkts : 0, t->max_us,
+			t->streams ? t->jitter_sum_us / t->streams : 0,
+			t->jitter_max_us, t->gap_max_us);
+	for (i=0; i<LB_HIST; i++){
+		printf(i ? ",%lu" : "%lu", t->hist[i]);
+	}
+	printf("]}");
+}/*}}}*/
+
+/** Find the header value in the SIP message (full or compact name).*/
+static int
+lb_hdr (char const * const msg, char const * const name, char const cname,
+		char * const out, int const size)
+{/*{{{*/
+	char const * l = strstr(msg, "\r\n");
+	int nlen = strlen(name);
+
+	while(l && l[2] != '\r'){
+		char const * h = l + 2;
+		char const * v = NULL;
+		char const * e;
+		if( !strncasecmp(h, name, nlen) &&
+				(h[nlen] == ':' || h[nlen] == ' ')){
+			v = h + nlen;
+		} else if(tolower(h[0]) == cname && (h[1] == ':' || h[1] == ' ')){
+			v = h + 1;
+		}
+		l = strstr(h, "\r\n");
+		if(v && l){
+			while(*v == ' ' || *v == ':'){
+				v++;
+			}
+			e = l;
+			if(e - v >= size){
+				e = v + size - 1;
+			}
+			memcpy(out, v, e - v);
+			out[e - v] = '\0';
+			return 0;
+		}
+	}
+	return -1;
+}/*}}}*/
+
+/** Send the response to the request.*/
+static void
+lb_reply (char const * const req, struct sockaddr_in const * const to,
+		int const code, char const * const phrase, int const ch,
+		char const * const sdp)
+{/*{{{*/
+	char rsp [LB_SIP_MAX];
+	char v [LB_STR_MAX];
+	char const * l = strstr(req, "\r\n");
+	int len;
+
+	len = snprintf(rsp, sizeof(rsp), "SIP/2.0 %d %s\r\n", code, phrase);
+	/* all Via lines as they are */
+	while(l && l[2] != '\r'){
+		char const * h = l + 2;
+		l = strstr(h, "\r\n");
+		if(l && (!strncasecmp(h, "Via:", 4) || !strncasecmp(h, "v:", 2))){
+			len += snprintf(rsp + len, sizeof(rsp) - len, "%.*s\r\n",
+					(int)(l - h), h);
+		}
+	}
+	if( !lb_hdr(req, "From", 'f', v, sizeof(v))){
+		len += snprintf(rsp + len, sizeof(rsp) - len, "From: %s\r\n", v);
+	}
+	if( !lb_hdr(req, "To", 't', v, sizeof(v))){
+		len += snprintf(rsp + len, sizeof(rsp) - len, "To: %s", v);
+		if( !strstr(v, "tag=") && ch >= 0){
+			len += snprintf(rsp + len, sizeof(rsp) - len, ";tag=lb%dx%lu",
+					ch, lb.chan[ch].seq);
+		}
+		len += snprintf(rsp + len, sizeof(rsp) - len, "\r\n");
+	}
+	if( !lb_hdr(req, "Call-ID", 'i', v, sizeof(v))){
+		len += snprintf(rsp + len, sizeof(rsp) - len, "Call-ID: %s\r\n", v);
+	}
+	if( !lb_hdr(req, "CSeq", '\0', v, sizeof(v))){
+		len += snprintf(rsp + len, sizeof(rsp) - len, "CSeq: %s\r\n", v);
+	}
+	if( !strncmp(req, "REGISTER", 8) &&
+			!lb_hdr(req, "Contact", 'm', v, sizeof(v))){
+		len += snprintf(rsp + len, sizeof(rsp) - len,
+				"Contact: %s;expires=3600\r\n", v);
+	} else if(code / 100 == 2 && ch >= 0){
+		len += snprintf(rsp + len, sizeof(rsp) - len,
+				"Contact: <sip:%d@127.0.0.1:%d>\r\n", LB_NUM_BASE + ch, lb.port);
+	}
+	if(sdp){
+		len += snprintf(rsp + len, sizeof(rsp) - len,
+				"Content-Type: application/sdp\r\n"
+				"Content-Length: %d\r\n\r\n%s", (int)strlen(sdp), sdp);
+	} else {
+		len += snprintf(rsp + len, sizeof(rsp) - len,
+				"Content-Length: 0\r\n\r\n");
+	}
+	if(len >= (int)sizeof(rsp)){
+		len = sizeof(rsp) - 1;
+	}
+	sendto(lb.sip_fd, rsp, len, 0, (struct sockaddr const *)to, sizeof(*to));
+}/*}}}*/
+
+/** Find the channel of the call by Call-ID.*/
+static int
+lb_chan_by_call (char const * const msg)
+{/*{{{*/
+	char id [LB_STR_MAX];
+	int i;
+	if(lb_hdr(msg, "Call-ID", 'i', id, sizeof(id))){
+		return -1;
+	}
+	for (i=0; i<lb.chans; i++){
+		if(lb.chan[i].state != lb_state_IDLE && !strcmp(lb.chan[i].call_id, id)){
+			return i;
+		}
+	}
+	return -1;
+}/*}}}*/
+
+/** Put the channel to the state.*/
+static void
+lb_state (int const ch, enum lb_state_e const st, long long const now)
+{/*{{{*/
+	lb.chan[ch].state = st;
+	lb.chan[ch].t_state = now;
+}/*}}}*/
+
+/** Finish the call on the channel.*/
+static void
+lb_call_end (int const ch, int const ok, long long const now)
+{/*{{{*/
+	struct lb_chan_s * c = &lb.chan[ch];
+	if(ok){
+		lb.ok++;
+		lb.call_us += c->t_onhook - c->t_answer;
+	} else {
+		lb.failed++;
+		fprintf(stderr, "[%02d] call failed in state %d\n", ch, c->state);
+		if(c->state == lb_state_UP){
+			lb_ctl("talk %d 0", ch, "");
+		}
+		if(c->state != lb_state_HANGUP){
+			lb_ctl("onhook %d", ch, "");
+		}
+	}
+	lb.active--;
+	c->call_id[0] = '\0';
+	c->ho_call = c->ho_talk = 0;
+	lb_state(ch, lb_state_IDLE, now);
+}/*}}}*/
+
+/** Handle the INVITE of svd.*/
+static void
+lb_sip_invite (char const * const msg, struct sockaddr_in const * const from,
+		long long const now)
+{/*{{{*/
+	struct lb_chan_s * c;
+	char const * s;
+	int ch;
+
+	/* retransmission */
+	ch = lb_chan_by_call(msg);
+	if(ch >= 0){
+		lb_reply(msg, from, 180, "Ringing", ch, NULL);
+		return;
+	}
+	s = strstr(msg, "sip:");
+	ch = s ? strtol(s + 4, NULL, 10) - LB_NUM_BASE : -1;
+	if(ch < 0 || ch >= lb.chans || lb.chan[ch].state != lb_state_DIALED){
+		lb_reply(msg, from, 404, "Not Found", -1, NULL);
+		return;
+	}
+	c = &lb.chan[ch];
+	lb_lat_add(&lb.lat_invite, now - c->t_dial);
+	snprintf(c->invite, sizeof(c->invite), "%s", msg);
+	lb_hdr(msg, "Call-ID", 'i', c->call_id, sizeof(c->call_id));
+	c->src = *from;
+	c->pt = 8;
+	c->media = *from;
+	s = strstr(msg, "m=audio ");
+	if(s){
+		int port = 0;
+		sscanf(s, "m=audio %d %*s %d", &port, &c->pt);
+		c->media.sin_port = htons(port);
+	}
+	s = strstr(msg, "c=IN IP4 ");
+	if(s){
+		char ip [32];
+		if(sscanf(s, "c=IN IP4 %31s", ip) == 1){
+			inet_aton(ip, &c->media.sin_addr);
+		}
+	}
+	c->seq++;
+	lb_reply(msg, from, 100, "Trying", -1, NULL);
+	lb_reply(msg, from, 180, "Ringing", ch, NULL);
+	lb_state(ch, lb_state_RINGING, now);
+}/*}}}*/
+
+/** Handle one SIP message from svd.*/
+static void
+lb_sip_msg (char * const msg, struct sockaddr_in const * const from,
+		long long const now)
+{/*{{{*/
+	int ch;
+
+	if( !strncmp(msg, "SIP/2.0", 7)){
+		/* we send OPTIONS only */
+		if( !strncmp(msg, "SIP/2.0 200", 11)){
+			lb.opt_ok++;
+		}
+		return;
+	} else if( !strncmp(msg, "ACK ", 4)){
+		/* the answer is acked by svd */
+		return;
+	} else if( !strncmp(msg, "REGISTER ", 9)){
+		lb_reply(msg, from, 200, "OK", -1, NULL);
+		lb.svd_sip = *from;
+		if( !lb.registered){
+			fprintf(stderr, "registered\n");
+			lb.registered = 1;
+		}
+	} else if( !strncmp(msg, "INVITE ", 7)){
+		lb_sip_invite(msg, from, now);
+	} else if( !strncmp(msg, "BYE ", 4)){
+		ch = lb_chan_by_call(msg);
+		lb_reply(msg, from, ch >= 0 ? 200 : 481,
+				ch >= 0 ? "OK" : "Call Does Not Exist", -1, NULL);
+		if(ch >= 0 && lb.chan[ch].state == lb_state_HANGUP){
+			lb_lat_add(&lb.lat_bye, now - lb.chan[ch].t_onhook);
+			lb.ho_ended += lb.chan[ch].ho_call;
+			lb_call_end(ch, 1, now);
+		} else if(ch >= 0){
+			lb_call_end(ch, 0, now);
+		}
+	} else if( !strncmp(msg, "CANCEL ", 7)){
+		ch = lb_chan_by_call(msg);
+		lb_reply(msg, from, 200, "OK", -1, NULL);
+		if(ch >= 0){
+			lb_reply(lb.chan[ch].invite, &lb.chan[ch].src, 487,
+					"Request Terminated", ch, NULL);
+			lb_call_end(ch, 0, now);
+		}
+	} else {
+		lb_reply(msg, from, 200, "OK", -1, NULL);
+	}
+}/*}}}*/
+
+/** Read SIP messages.*/
+static void
+lb_sip_read (long long const now)
+{/*{{{*/
+	char msg [LB_SIP_MAX];
+	struct sockaddr_in from;
+	socklen_t flen = sizeof(from);
+	int len;
+
+	while((len = recvfrom(lb.sip_fd, msg, sizeof(msg)-1, MSG_DONTWAIT,
+			(struct sockaddr *)&from, &flen)) > 0){
+		msg[len] = '\0';
+		lb_sip_msg(msg, &from, now);
+		flen = sizeof(from);
+	}
+}/*}}}*/
+
+/** Echo RTP packets of the channel.*/
+static void
+lb_rtp_read (int const ch, long long const now)
+{/*{{{*/
+	struct lb_chan_s * c = &lb.chan[ch];
+	unsigned char pkt [1500];
+	struct sockaddr_in from;
+	socklen_t flen = sizeof(from);
+	int len;
+
+	while((len = recvfrom(c->rtp_fd, pkt, sizeof(pkt), MSG_DONTWAIT,
+			(struct sockaddr *)&from, &flen)) > 0){
+		if(c->state == lb_state_UP && !c->got_media){
+			c->got_media = 1;
+			lb_lat_add(&lb.lat_media, now - c->t_answer);
+		}
+		if(lb.relay){
+			if(c->state == lb_state_UP && len >= 12 + 12 &&
+					!memcmp(pkt + 12, LB_STAMP_MAGIC, 4)){
+				lb_relay_add(&c->to_net, pkt + 16, now);
+			}
+		} else if(sendto(c->rtp_fd, pkt, len, 0, (struct sockaddr *)&from, flen) == len){
+			lb.rtp_echoed++;
+		}
+		flen = sizeof(from);
+	}
+}/*}}}*/
+
+/** Send the stamped frame to svd.*/
+static void
+lb_relay_send (int const ch, long long const now)
+{/*{{{*/
+	struct lb_chan_s * c = &lb.chan[ch];
+	unsigned char pkt [LB_FRAME_LEN];
+	unsigned long ts = c->tx_seq * LB_FRAME_MS * 8;
+	long long const t = lb_us();
+	int i;
+
+	memset(pkt, 0xD5, sizeof(pkt));
+	pkt[0] = 0x80;
+	pkt[1] = c->pt & 0x7F;
+	pkt[2] = c->tx_seq >> 8;
+	pkt[3] = c->tx_seq;
+	pkt[4] = ts >> 24;
+	pkt[5] = ts >> 16;
+	pkt[6] = ts >> 8;
+	pkt[7] = ts;
+	pkt[8] = pkt[9] = pkt[10] = 0;
+	pkt[11] = ch;
+	memcpy(pkt + 12, LB_STAMP_MAGIC, 4);
+	for (i=0; i<8; i++){
+		pkt[16 + i] = t >> (56 - 8*i);
+	}
+	if(sendto(c->rtp_fd, pkt, sizeof(pkt), 0, (struct sockaddr *)&c->media,
+			sizeof(c->media)) == sizeof(pkt)){
+		c->tx_sent++;
+	}
+	c->tx_seq++;
+	c->tx_next += LB_FRAME_MS * 1000LL;
+	if(c->tx_next <= now){
+		/* late for more than a frame - resync */
+		c->tx_next = now + LB_FRAME_MS * 1000LL;
+	}
+}/*}}}*/
+
+/** Send OPTIONS request to svd.*/
+static void
+lb_options_send (void)
+{/*{{{*/
+	char req [LB_SIP_MAX];
+	int len;
+
+	len = snprintf(req, sizeof(req),
+			"OPTIONS sip:bench@%s:%d SIP/2.0\r\n"
+			"Via: SIP/2.0/UDP 127.0.0.1:%d;branch=z9hG4bK-lbo%lu;rport\r\n"
+			"Max-Forwards: 70\r\n"
+			"From: <sip:load@127.0.0.1:%d>;tag=lbo\r\n"
+			"To: <sip:bench@%s>\r\n"
+			"Call-ID: lbo-%lu@127.0.0.1\r\n"
+			"CSeq: 1 OPTIONS\r\n"
+			"Content-Length: 0\r\n\r\n",
+			inet_ntoa(lb.svd_sip.sin_addr), ntohs(lb.svd_sip.sin_port),
+			lb.port, lb.opt_sent, lb.port, inet_ntoa(lb.svd_sip.sin_addr),
+			lb.opt_sent);
+	if(sendto(lb.sip_fd, req, len, 0, (struct sockaddr *)&lb.svd_sip,
+			sizeof(lb.svd_sip)) == len){
+		lb.opt_sent++;
+	}
+}/*}}}*/
+
+/** Move the channel call on by timers.*/
+static void
+lb_chan_step (int const ch, long long const now, long long const t_first)
+{/*{{{*/
+	struct lb_chan_s * c = &lb.chan[ch];
+	long long const in_state = now - c->t_state;
+	char sdp [LB_STR_MAX];
+	char num [16];
+
+	if(c->state != lb_state_IDLE && in_state > LB_TIMEOUT_MS * 1000LL){
+		lb_call_end(ch, 0, now);
+		return;
+	}
+	switch(c->state){
+	case lb_state_IDLE:
+		if(lb.started >= lb.calls || lb.active >= lb.conc ||
+				in_state < LB_REST_MS * 1000LL ||
+				(lb.rate > 0 && now < t_first + lb.started * 1e6 / lb.rate)){
+			break;
+		}
+		lb.started++;
+		lb.active++;
+		c->got_media = 0;
+		c->tx_sent = 0;
+		memset(&c->to_net, 0, sizeof(c->to_net));
+		lb_state(ch, lb_state_OFFHOOK, now);
+		if(lb_ctl("offhook %d", ch, "")){
+			lb_call_end(ch, 0, now);
+		}
+		break;
+	case lb_state_OFFHOOK:
+		if(in_state < LB_DIALTONE_MS * 1000LL){
+			break;
+		}
+		snprintf(num, sizeof(num), "%d#", LB_NUM_BASE + ch);
+		c->t_dial = lb_us();
+		lb_state(ch, lb_state_DIALED, c->t_dial);
+		if(lb_ctl("digit %d %s", ch, num)){
+			lb_call_end(ch, 0, now);
+		}
+		break;
+	case lb_state_RINGING:
+		if(in_state < lb.answer_ms * 1000LL){
+			break;
+		}
+		snprintf(sdp, sizeof(sdp),
+				"v=0\r\no=- %lu 1 IN IP4 127.0.0.1\r\ns=-\r\n"
+				"c=IN IP4 127.0.0.1\r\nt=0 0\r\n"
+				"m=audio %d RTP/AVP %d\r\na=sendrecv\r\n",
+				c->seq, c->rtp_port, c->pt);
+		c->t_answer = lb_us();
+		c->tx_next = c->t_answer;
+		lb_reply(c->invite, &c->src, 200, "OK", ch, sdp);
+		lb_state(ch, lb_state_UP, c->t_answer);
+		lb_ctl("talk %d 1", ch, "");
+		break;
+	case lb_state_UP:
+		if(lb.relay && now >= c->tx_next){
+			lb_relay_send(ch, now);
+		}
+		if(c->ho_talk && now >= c->ho_retry){
+			/* the phone of the new svd does not talk until asked */
+			c->ho_retry = now + LB_HANDOFF_RETRY_MS * 1000LL;
+			c->ho_talk = lb_ctl("talk %d 1", ch, "") ? 1 : 0;
+		}
+		if(in_state < lb.hold_ms * 1000LL){
+			break;
+		}
+		lb_ctl("talk %d 0", ch, "");
+		if(lb.relay){
+			unsigned long const board = lb.to_board.pkts;
+			if(c->ho_call && c->to_net.pkts > c->ho_net){
+				lb.ho_net_ok++;
+			}
+			lb_relay_fold(&lb.to_net, &c->to_net);
+			lb_relay_board(ch);
+			/* the phone of the new svd counts from the handoff */
+			if(c->ho_call && lb.to_board.pkts > board){
+				lb.ho_board_ok++;
+			}
+		}
+		c->t_onhook = lb_us();
+		lb_state(ch, lb_state_HANGUP, c->t_onhook);
+		if(lb_ctl("onhook %d", ch, "")){
+			lb_call_end(ch, 0, now);
+		}
+		break;
+	case lb_state_DIALED:
+	case lb_state_HANGUP:
+		break;
+	}
+}/*}}}*/
+
+/** Hand svd off to the same binary and mark the calls that are up.*/
+static void
+lb_handoff (long long const now)
+{/*{{{*/
+	char cmd [LB_STR_MAX];
+	char const * slash = strrchr(lb.svd, '/');
+	int i;
+
+	for (i=0; i<lb.chans; i++){
+		struct lb_chan_s * c = &lb.chan[i];
+		if(c->state != lb_state_UP){
+			continue;
+		}
+		c->ho_call = 1;
+		c->ho_talk = 1;
+		c->ho_retry = now + LB_HANDOFF_RETRY_MS * 1000LL;
+		c->ho_net = c->to_net.pkts;
+		lb.ho_calls++;
+	}
+	snprintf(cmd, sizeof(cmd), "echo 'handoff[]' | %.*ssvd_if >&2",
+			slash ? (int)(slash - lb.svd + 1) : 0, lb.svd);
+	fprintf(stderr, "handoff with %d calls up\n", lb.ho_calls);
+	lb.ho_state = system(cmd) ? -1 : 1;
+	if(lb.ho_state < 0){
+		fprintf(stderr, "\"%s\" failed\n", cmd);
+	}
+}/*}}}*/
+
+/** Write svd config to the temporary directory.*/
+static int
+lb_config (void)
+{/*{{{*/
+	char path [LB_STR_MAX];
+	FILE * f;
+
+	snprintf(path, sizeof(path), "%s/svd", lb.dir);
+	f = fopen(path, "w");
+	if( !f){
+		perror(path);
+		return -1;
+	}
+	fprintf(f,
+			"config main\n"
+			"\toption log_level 0\n"
+			"\toption local_ip 127.0.0.1\n"
+			"\toption rtp_port_first 16000\n"
+			"\toption rtp_port_last %d\n"
+			"\toption sip_tos 0x10\n"
+			"\toption rtp_tos 0x10\n"
+			"\toption media_engine %s\n"
+			"\n"
+			"config account bench\n"
+			"\toption user \"bench\"\n"
+			"\toption domain \"127.0.0.1:%d\"\n"
+			"\toption registrar \"127.0.0.1:%d\"\n"
+			"\toption outbound_proxy \"127.0.0.1:%d\"\n"
+			"\toption password \"bench\"\n",
+			16000 + lb.chans * 4, lb.engine, lb.port, lb.port, lb.port);
+	fclose(f);
+	return 0;
+}/*}}}*/
+
+/** Open the stand-in sockets.*/
+static int
+lb_sockets (void)
+{/*{{{*/
+	struct sockaddr_in a;
+	struct sockaddr_un u;
+	socklen_t alen;
+	int i;
+
+	memset(&a, 0, sizeof(a));
+	a.sin_family = AF_INET;
+	a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	a.sin_port = htons(lb.port);
+	lb.sip_fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if(lb.sip_fd == -1 || bind(lb.sip_fd, (struct sockaddr *)&a, sizeof(a))){
+		fprintf(stderr, "SIP socket on port %d: %s\n", lb.port, strerror(errno));
+		return -1;
+	}
+	for (i=0; i<lb.chans; i++){
+		a.sin_port = 0;
+		lb.chan[i].rtp_fd = socket(AF_INET, SOCK_DGRAM, 0);
+		alen = sizeof(a);
+		if(lb.chan[i].rtp_fd == -1 ||
+				bind(lb.chan[i].rtp_fd, (struct sockaddr *)&a, sizeof(a)) ||
+				getsockname(lb.chan[i].rtp_fd, (struct sockaddr *)&a, &alen)){
+			perror("RTP socket");
+			return -1;
+		}
+		lb.chan[i].rtp_port = ntohs(a.sin_port);
+	}
+
+	memset(&u, 0, sizeof(u));
+	u.sun_family = AF_UNIX;
+	strncpy(u.sun_path, lb.cli_path, sizeof(u.sun_path)-1);
+	lb.ctl_fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+	if(lb.ctl_fd == -1 || bind(lb.ctl_fd, (struct sockaddr *)&u, sizeof(u))){
+		perror("control socket");
+		return -1;
+	}
+	return 0;
+}/*}}}*/
+
+/** Start svd on the simulated board.*/
+static int
+lb_svd_start (void)
+{/*{{{*/
+	char chans [16];
+	int null;
+
+	snprintf(chans, sizeof(chans), "%d", lb.chans);
+	lb.pid = fork();
+	if(lb.pid == -1){
+		perror("fork");
+		return -1;
+	} else if(lb.pid == 0){
+		setenv("AB_SIM_CHANS", chans, 1);
+		setenv("AB_SIM_CTL", lb.ctl_path, 1);
+		if( !lb.verbose){
+			null = open("/dev/null", O_WRONLY);
+			dup2(null, 1);
+			dup2(null, 2);
+		}
+		execlp(lb.svd, lb.svd, "-s", "-f", "-C", lb.dir, (char *)NULL);
+		fprintf(stderr, "exec %s: %s\n", lb.svd, strerror(errno));
+		_exit(127);
+	}
+	return 0;
+}/*}}}*/
+
+/** Stop svd and remove the temporary files.*/
+static void
+lb_cleanup (void)
+{/*{{{*/
+	char path [LB_STR_MAX];
+	if(lb.pid > 0){
+		kill(lb.pid, SIGTERM);
+		waitpid(lb.pid, NULL, 0);
+		lb.pid = 0;
+	}
+	snprintf(path, sizeof(path), "%s/svd", lb.dir);
+	unlink(path);
+	unlink(lb.cli_path);
+	unlink(lb.ctl_path);
+	rmdir(lb.dir);
+}/*}}}*/
+
+/** Wait for SIP and RTP until the time and step the calls.*/
+static void
+lb_poll (long long const until, long long const t_first,
+		enum lb_mode_e const mode)
+{/*{{{*/
+	struct pollfd pfd [LB_CHANS_MAX + 1];
+	long long now = lb_us();
+	long long sampled = now;
+	long long opt_next = now;
+	int const wait_ms = lb.relay || lb.sip_rate > 0 ? 1 : 5;
+	int i;
+
+	for (i=0; i<lb.chans; i++){
+		pfd[i].fd = lb.chan[i].rtp_fd;
+		pfd[i].events = POLLIN;
+	}
+	pfd[lb.chans].fd = lb.sip_fd;
+	pfd[lb.chans].events = POLLIN;
+
+	while(now < until){
+		if(mode == lb_mode_CALLS && lb.started >= lb.calls && lb.active == 0){
+			break;
+		} else if(mode == lb_mode_REG && lb.registered){
+			break;
+		}
+		if(poll(pfd, lb.chans + 1, wait_ms) > 0){
+			now = lb_us();
+			for (i=0; i<lb.chans; i++){
+				if(pfd[i].revents & POLLIN){
+					lb_rtp_read(i, now);
+				}
+			}
+			if(pfd[lb.chans].revents & POLLIN){
+				lb_sip_read(now);
+			}
+		}
+		now = lb_us();
+		if(mode == lb_mode_CALLS && lb.handoff_ms && !lb.ho_state &&
+				now >= t_first + lb.handoff_ms * 1000LL){
+			lb_handoff(now);
+		}
+		if(mode == lb_mode_CALLS){
+			for (i=0; i<lb.chans; i++){
+				lb_chan_step(i, now, t_first);
+			}
+			while(lb.sip_rate > 0 && now >= opt_next){
+				lb_options_send();
+				opt_next += 1e6 / lb.sip_rate;
+			}
+		}
+		if(now - sampled >= LB_SAMPLE_MS * 1000LL){
+			sampled = now;
+			lb_sample_peak();
+		}
+		if(waitpid(lb.pid, NULL, WNOHANG) == lb.pid){
+			fprintf(stderr, "svd exited\n");
+			lb.pid = 0;
+			break;
+		}
+	}
+}/*}}}*/
+
+/** Print usage.*/
+static void
+lb_usage (char const * const me)
+{/*{{{*/
+	fprintf(stderr,
+"Usage: %s [OPTION]\n"
+"  -x PATH  svd binary (svd)\n"
+"  -n N     simulated channels (16, up to %d)\n"
+"  -c N     concurrent calls (all channels)\n"
+"  -k N     calls to make (200)\n"
+"  -t MS    connected time of the call (1000)\n"
+"  -a MS    INVITE to answer time (0)\n"
+"  -r CPS   call starts per second limit (no limit)\n"
+"  -p PORT  stand-in SIP port (5070)\n"
+"  -m       measure the RTP relay (stamped frames) instead of echoing\n"
+"  -s RATE  SIP load: OPTIONS requests per second to svd while calling\n"
+"  -e NAME  svd media engine: poll or uring (poll)\n"
+"  -H MS    hand svd off MS into the calls and check the calls go on\n"
+"  -v       show svd output\n", me, LB_CHANS_MAX);
+}/*}}}*/
+
+int
+main (int argc, char ** argv)
+{/*{{{*/
+	struct lb_proc_s idle0;
+	struct lb_proc_s idle1;
+	long long t_first;
+	long long t_end;
+	double dur;
+	double idle_rate;
+	double busy_ms;
+	int opt;
+	int i;
+
+	lb.svd = "svd";
+	lb.chans = 16;
+	lb.conc = 0;
+	lb.calls = 200;
+	lb.hold_ms = 1000;
+	lb.answer_ms = 0;
+	lb.rate = 0;
+	lb.port = 5070;
+	lb.engine = "poll";
+	while((opt = getopt(argc, argv, "x:n:c:k:t:a:r:p:ms:e:H:vh")) != -1){
+		switch(opt){
+		case 'x': lb.svd = optarg; break;
+		case 'n': lb.chans = strtol(optarg, NULL, 10); break;
+		case 'c': lb.conc = strtol(optarg, NULL, 10); break;
+		case 'k': lb.calls = strtol(optarg, NULL, 10); break;
+		case 't': lb.hold_ms = strtol(optarg, NULL, 10); break;
+		case 'a': lb.answer_ms = strtol(optarg, NULL, 10); break;
+		case 'r': lb.rate = strtod(optarg, NULL); break;
+		case 'p': lb.port = strtol(optarg, NULL, 10); break;
+		case 'm': lb.relay = 1; break;
+		case 's': lb.sip_rate = strtod(optarg, NULL); break;
+		case 'e': lb.engine = optarg; break;
+		case 'H': lb.handoff_ms = strtol(optarg, NULL, 10); lb.relay = 1; break;
+		case 'v': lb.verbose = 1; break;
+		default: lb_usage(argv[0]); return 1;
+		}
+	}
+	if(lb.chans < 1 || lb.chans > LB_CHANS_MAX || lb.calls < 1){
+		lb_usage(argv[0]);
+		return 1;
+	}
+	if(lb.conc < 1 || lb.conc > lb.chans){
+		lb.conc = lb.chans;
+	}
+	lb.lat_invite.us = calloc(lb.calls, sizeof(long long));
+	lb.lat_media.us = calloc(lb.calls, sizeof(long long));
+	lb.lat_bye.us = calloc(lb.calls, sizeof(long long));
+	if( !lb.lat_invite.us || !lb.lat_media.us || !lb.lat_bye.us){
+		perror("calloc");
+		return 1;
+	}
+	signal(SIGPIPE, SIG_IGN);
+
+	snprintf(lb.dir, sizeof(lb.dir), "/tmp/svd_bench.XXXXXX");
+	if( !mkdtemp(lb.dir)){
+		perror("mkdtemp");
+		return 1;
+	}
+	snprintf(lb.ctl_path, sizeof(lb.ctl_path), "%s/ctl", lb.dir);
+	snprintf(lb.cli_path, sizeof(lb.cli_path), "%s/cli", lb.dir);
+	if(lb_config() || lb_sockets() || lb_svd_start()){
+		goto __exit_fail;
+	}
+
+	/* registration, then idle svd CPU rate */
+	lb_poll(lb_us() + LB_REG_TIMEOUT_MS * 1000LL, 0, lb_mode_REG);
+	if( !lb.registered){
+		fprintf(stderr, "svd did not register\n");
+		goto __exit_fail;
+	}
+	if(lb_sample(&idle0)){
+		goto __exit_fail;
+	}
+	lb_poll(lb_us() + LB_IDLE_MS * 1000LL, 0, lb_mode_IDLE);
+	if(lb_sample(&idle1)){
+		goto __exit_fail;
+	}
+	idle_rate = (double)(idle1.cpu_ms - idle0.cpu_ms) / LB_IDLE_MS;
+	lb.p_start = idle1;
+	lb.p_peak = idle1;
+
+	/* calls */
+	fprintf(stderr, "%d calls on %d channels, %d at once\n",
+			lb.calls, lb.chans, lb.conc);
+	t_first = lb_us();
+	lb_poll(t_first + (long long)lb.calls * (lb.hold_ms + lb.answer_ms +
+			LB_TIMEOUT_MS) * 1000LL, t_first, lb_mode_CALLS);
+	t_end = lb_us();
+	if( !lb.pid || lb_sample(&lb.p_end)){
+		goto __exit_fail;
+	}
+	lb_sample_peak();
+
+	dur = (t_end - t_first) / 1e6;
+	busy_ms = lb.p_end.cpu_ms - lb.p_start.cpu_ms - idle_rate * dur * 1000;
+	printf("{\"bench\":\"load\",\"chans\":%d,\"concurrent\":%d,\"calls\":%d,"
+			"\"hold_ms\":%d,\"answer_ms\":%d,\"rate\":%.1f,\"engine\":\"%s\","
+			"\"ok\":%d,\"failed\":%d,\"duration_s\":%.3f,\"cps\":%.2f,",
+			lb.chans, lb.conc, lb.calls, lb.hold_ms, lb.answer_ms, lb.rate,
+			lb.engine,
+			lb.ok, lb.failed, dur, lb.ok / dur);
+	lb_lat_print("invite_us", &lb.lat_invite);
+	printf(",");
+	lb_lat_print("media_us", &lb.lat_media);
+	printf(",");
+	lb_lat_print("bye_us", &lb.lat_bye);
+	printf(",\"rtp_echoed\":%lu,\"cpu_idle_ms_per_s\":%.3f,\"cpu_ms\":%lld,"
+			"\"cpu_ms_per_call\":%.3f,\"cpu_ms_per_call_s\":%.3f,"
+			"\"rss_kb\":{\"start\":%ld,\"peak\":%ld,\"end\":%ld},"
+			"\"rss_b_per_call\":%.1f,"
+			"\"fds\":{\"start\":%d,\"peak\":%d,\"end\":%d}",
+			lb.rtp_echoed, idle_rate * 1000,
+			lb.p_end.cpu_ms - lb.p_start.cpu_ms,
+			lb.ok ? busy_ms / lb.ok : 0,
+			lb.call_us ? busy_ms / (lb.call_us / 1e6) : 0,
+			lb.p_start.rss_kb, lb.p_peak.rss_kb, lb.p_end.rss_kb,
+			lb.ok ? (lb.p_end.rss_kb - lb.p_start.rss_kb) * 1024.0 / lb.ok : 0,
+			lb.p_start.fds, lb.p_peak.fds, lb.p_end.fds);
+	if(lb.sip_rate > 0){
+		printf(",\"sip_load\":{\"rate\":%.1f,\"sent\":%lu,\"ok\":%lu}",
+				lb.sip_rate, lb.opt_sent, lb.opt_ok);
+	}
+	if(lb.relay){
+		printf(",\"relay\":{\"hist_us\":[");
+		for (i=0; i<LB_HIST-1; i++){
+			printf(i ? ",%lu" : "%lu", lb_hist_us[i]);
+		}
+		printf("],");
+		lb_relay_print("to_net", &lb.to_net);
+		printf(",");
+		lb_relay_print("to_board", &lb.to_board);
+		printf("}");
+	}
+	if(lb.handoff_ms){
+		printf(",\"handoff\":{\"at_ms\":%d,\"done\":%s,\"calls\":%d,"
+				"\"net_ok\":%d,\"board_ok\":%d,\"ended\":%d}",
+				lb.handoff_ms, lb.ho_state > 0 ? "true" : "false",
+				lb.ho_calls, lb.ho_net_ok, lb.ho_board_ok, lb.ho_ended);
+	}
+	printf("}\n");
+	lb_cleanup();
+	if(lb.handoff_ms && (lb.ho_state <= 0 || !lb.ho_calls ||
+			lb.ho_net_ok != lb.ho_calls || lb.ho_board_ok != lb.ho_calls ||
+			lb.ho_ended != lb.ho_calls)){
+		return 3;
+	}
+	return lb.failed ? 2 : 0;
+__exit_fail:
+	lb_cleanup();
+	return 1;
+}/*}}}*/
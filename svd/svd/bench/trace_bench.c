@@ -0,0 +1,139 @@
+/**
+ * @file trace_bench.c
+ * Relay path function tracing benchmark.
+ * It measures the per-packet cost of the RTP relay steps of svd
+ * 		(svd_relay.c, as the poll media engine calls them) built with
+ * 		and without the DFS/DFE markers.
+ *
+ * Build it twice from this directory and compare the results:
+ * \code
+ * 	gcc -O2 -Wall -I../src -o trace_off trace_bench.c ../src/svd_relay.c
+ * 	gcc -O2 -Wall -I../src -DSVD_TRACE -o trace_on trace_bench.c \
+ * 			../src/svd_relay.c
+ * 	./trace_off 1000000; ./trace_on 1000000
+ * \endcode
+ * TAPI stream is emulated by the datagram socketpair, the network peer is
+ * the UDP socket on the loopback. The sofia-sip logging macro is emulated
+ * with the same level check it does at runtime (log level is 3, so lines
+ * are not printed, just checked).
+ */
+
+/* Includes {{{ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "svd_relay.h"
+/*}}}*/
+
+/** svd log level (svd_relay.c checks it as SU_DEBUG_9 does).*/
+unsigned int volatile svd_relay_log_level = 3;
+/** Function start/end offset (svd_log.h).*/
+unsigned int g_f_offset = 0;
+
+/** RTP packet size for 20 ms G.711.*/
+#define PKT_SIZE 172
+/** Relay buffer size (as BUFF_PER_RTP_PACK_SIZE).*/
+#define BUF_SIZE 512
+
+/** Get monotonic time in ns.*/
+static long long
+bench_ns (void)
+{/*{{{*/
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}/*}}}*/
+
+/** Open the UDP socket bound to the loopback.*/
+static int
+bench_udp (struct sockaddr_in * const sa)
+{/*{{{*/
+	socklen_t len = sizeof(*sa);
+	int fd;
+
+	memset(sa, 0, sizeof(*sa));
+	sa->sin_family = AF_INET;
+	sa->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if(fd == -1 || bind(fd, (struct sockaddr *)sa, len) ||
+			getsockname(fd, (struct sockaddr *)sa, &len)){
+		perror("udp");
+		exit(1);
+	}
+	return fd;
+}/*}}}*/
+
+int
+main (int argc, char ** argv)
+{/*{{{*/
+	struct sockaddr_in rtp_sa;
+	struct sockaddr_in peer_sa;
+	int tapi[2];
+	int rtp;
+	int peer;
+	unsigned char pkt[PKT_SIZE];
+	unsigned char buf[BUF_SIZE];
+	unsigned char sink[BUF_SIZE];
+	long n = argc > 1 ? strtol(argv[1], NULL, 10) : 1000000;
+	long i;
+	long long t0;
+	long long t_net = 0;
+	long long t_board = 0;
+	int done;
+
+	if(socketpair(AF_UNIX, SOCK_DGRAM, 0, tapi)){
+		perror("socketpair");
+		return 1;
+	}
+	rtp = bench_udp (&rtp_sa);
+	peer = bench_udp (&peer_sa);
+	memset(pkt, 0, sizeof(pkt));
+	pkt[0] = 0x80;
+
+	for (i=0; i<n; i++){
+		/* board -> net */
+		if(write(tapi[1], pkt, sizeof(pkt)) != sizeof(pkt)){
+			perror("write");
+			return 1;
+		}
+		t0 = bench_ns();
+		svd_relay_to_net (tapi[0], rtp, (struct sockaddr *)&peer_sa,
+				sizeof(peer_sa), buf, sizeof(buf), &done);
+		t_net += bench_ns() - t0;
+		if(done != sizeof(pkt) ||
+				recv(peer, sink, sizeof(sink), 0) != sizeof(pkt)){
+			perror("to net");
+			return 1;
+		}
+
+		/* net -> board */
+		if(sendto(peer, pkt, sizeof(pkt), 0, (struct sockaddr *)&rtp_sa,
+				sizeof(rtp_sa)) != sizeof(pkt)){
+			perror("sendto");
+			return 1;
+		}
+		t0 = bench_ns();
+		svd_relay_to_board (rtp, tapi[0], buf, sizeof(buf), &done);
+		t_board += bench_ns() - t0;
+		if(done != sizeof(pkt) ||
+				read(tapi[1], sink, sizeof(sink)) != sizeof(pkt)){
+			perror("to board");
+			return 1;
+		}
+	}
+
+#ifdef SVD_TRACE
+	printf("trace=on ");
+#else
+	printf("trace=off ");
+#endif
+	printf("packets=%ld to_net_ns_per_pkt=%.1f to_board_ns_per_pkt=%.1f\n",
+			n, (double)t_net / n, (double)t_board / n);
+	return 0;
+}/*}}}*/
@@ -6,6 +6,14 @@
 #ifndef __SOFIA_H__
 #define __SOFIA_H__
 
+#include "config.h"
+
+/* SU_DEBUG_9 is the function tracing level, compile it out if tracing
+ * is off (see svd_log.h) */
+#if !defined(SVD_TRACE) && !defined(SU_DEBUG_MAX)
+#define SU_DEBUG_MAX 8
+#endif
+
 #include <sofia-sip/nua.h>
 #include <sofia-sip/nua_tag.h>
 #include <sofia-sip/nta.h>
@@ -17,6 +25,7 @@
 #include <sofia-sip/su_tag.h>
 #include <sofia-sip/su_debug.h>
 #include <sofia-sip/su_alloc.h>
+#include <sofia-sip/su_alloc_stat.h>
 #include <sofia-sip/su_vector.h>
 #include <sofia-sip/nua_tag.h>
 #include <sofia-sip/sdp.h>
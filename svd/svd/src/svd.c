@@ -11,6 +11,14 @@
 #include "svd_atab.h"
 #include "svd_server_if.h"
 #include "svd_if.h"
+#include "svd_logring.h"
+#include "svd_flight.h"
+#include "svd_loop.h"
+#include "svd_rec.h"
+#include "svd_handoff.h"
+#include "svd_boot.h"
+#include "svd_led.h"
+#include "svd_cdr.h"
 
 #include <stddef.h>
 #include <stdlib.h>
@@ -23,13 +31,20 @@
 #include <netinet/ip.h>
 #include <errno.h>
 #include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
 /*}}}*/
 
 /** Name of the daemon (using in logs).*/
 #define DAEMON_NAME "svd"
 
 //globals
+#ifdef SVD_TRACE_TLS
+__thread unsigned int g_f_offset = 0;
+#else
 unsigned int g_f_offset = 0;
+#endif
 _startup_options g_so;
 svd_conf_s g_conf;
 
@@ -44,16 +59,113 @@ static void svd_destroy( svd_t ** svd );
 static void svd_logger(void *logarg, char const *format, va_list ap);
 /** Set logging function.*/
 static void svd_log_set( int const level, int const debug);
+/** Set log file and per-subsystem levels from \ref g_conf.*/
+static void svd_log_conf( int const debug);
+/** Log the board startup phases timings.*/
+static void svd_log_start( ab_t const * const ab );
+
+/** Sofia-sip log objects of the subsystems.*/
+extern su_log_t nua_log[];
+extern su_log_t nta_log[];
+extern su_log_t tport_log[];
+extern su_log_t soa_log[];
+
+/** Subsystems names for "log_subsys" config option.*/
+static struct {
+	char const * name;
+	su_log_t * log;
+} const svd_log_subsys[] = {
+	{"svd",   su_log_default},
+	{"nua",   nua_log},
+	{"nta",   nta_log},
+	{"tport", tport_log},
+	{"soa",   soa_log},
+};
 
 /* svd pointer for termination handler */
 static svd_t * main_svd;
+/* exit leaves the DSP running for the next start (SIGUSR1) */
+static volatile sig_atomic_t keep_dsp;
 /* termination handler */
 static void term_handler(int signum)
 {
   printf("term_handler\n");
+  if(signum == SIGUSR1){
+    keep_dsp = 1;
+  }
   svd_shutdown(main_svd);
 }
 
+/* SIGHUP wakes the main loop through this pipe */
+static int hup_pipe [2] = {-1, -1};
+/* reload handler, the reload itself goes in the main loop */
+static void hup_handler(int signum)
+{
+	int e = errno;
+	char c = 0;
+	if(write(hup_pipe[1], &c, 1) < 0){
+		/* pipe is full, the reload is on the way already */
+	}
+	errno = e;
+}
+
+/**
+ * Reload the configuration on SIGHUP.
+ *
+ * \param[in] root 		root magic (not used).
+ * \param[in] w 			wait object (not used).
+ * \param[in] user_data 	svd context.
+ * \retval 0 	always.
+ */
+static int
+hup_reload (su_root_magic_t * root, su_wait_t * w, su_wakeup_arg_t * user_data)
+{/*{{{*/
+	svd_t * svd = (svd_t *) user_data;
+	char buf [16];
+
+	/* several signals make one reload */
+	while(read(hup_pipe[0], buf, sizeof(buf)) > 0);
+
+	SU_DEBUG_3(("SIGHUP: reloading the configuration\n" VA_NONE));
+	svd_conf_reload (svd, NULL);
+	return 0;
+}/*}}}*/
+
+/**
+ * Install SIGHUP handler to reload the configuration.
+ *
+ * \param[in] svd 	svd context.
+ * \retval 0 	if etherything ok.
+ * \retval -1 	if somthing nasty happens.
+ */
+static int
+hup_init (svd_t * const svd)
+{/*{{{*/
+	su_wait_t wait[1];
+	int i;
+
+	if(pipe(hup_pipe)){
+		SU_DEBUG_0 ((LOG_FNC_A (strerror(errno))));
+		goto __exit_fail;
+	}
+	for(i=0; i<2; i++){
+		fcntl(hup_pipe[i], F_SETFL, fcntl(hup_pipe[i], F_GETFL) | O_NONBLOCK);
+		fcntl(hup_pipe[i], F_SETFD, FD_CLOEXEC);
+	}
+	if(su_wait_create (wait, hup_pipe[0], POLLIN)){
+		SU_DEBUG_0 ((LOG_FNC_A ("su_wait_create() fails" ) ));
+		goto __exit_fail;
+	}
+	if(su_root_register (svd->root, wait, hup_reload, svd, 0) == -1){
+		SU_DEBUG_0 ((LOG_FNC_A ("su_root_register() fails" ) ));
+		goto __exit_fail;
+	}
+	signal(SIGHUP, hup_handler);
+	return 0;
+__exit_fail:
+	return -1;
+}/*}}}*/
+
 /**
  * Main.
  *
@@ -77,13 +189,18 @@ main (int argc, char ** argv)
 	if( nothing_to_do ){
 		goto __startup;
 	}
+	svd_handoff_argv (argc, argv);
+	svd_boot_init ();
+	svd_led_backend (g_so.sim ? led_backend_NONE : led_backend_SYSFS);
 
 	if (g_so.foreground == 0) {
 		/* daemonization */
+		svd_boot_begin (boot_phase_DAEMON);
 		err = svd_daemonize ();
 		if(err){
 			goto __startup;
 		}
+		svd_boot_end (boot_phase_DAEMON);
 		/* the daemon from now */
 	}
 
@@ -100,12 +217,29 @@ main (int argc, char ** argv)
 		svd_log_set (g_so.debug_level, 1);
 	}
 
-	/* init hardware structures */
-	ab = ab_create();
+	/* always-on events recorder */
+	svd_flight_init ();
+
+	/* state of the previous svd (handoff) */
+	if(g_so.handoff_fd != -1 && svd_handoff_recv (g_so.handoff_fd)){
+		SU_DEBUG_0 (("Handoff failed, starting from scratch\n" VA_NONE));
+	}
+
+	/* init hardware structures, the board starts in the board thread */
+	svd_boot_begin (boot_phase_BOARD_OPEN);
+	if(svd_handoff_on()){
+		ab = svd_handoff_board (g_so.sim ? ab_backend_SIM : ab_backend_TAPI);
+	} else {
+		ab = ab_create_open (g_so.sim ? ab_backend_SIM : ab_backend_TAPI);
+	}
 	if( !ab){
-		SU_DEBUG_0 ((LOG_FNC_A(ab_g_err_str)));
+		SU_DEBUG_0 ((LOG_FNC_A(ab_err_str())));
 		goto __su;
 	}
+	svd_boot_end (boot_phase_BOARD_OPEN);
+	if( !svd_handoff_on()){
+		svd_boot_board_start (ab);
+	}
 
 	/* create svd structure */
 	/* uses !!g_conf */
@@ -120,22 +254,63 @@ main (int argc, char ** argv)
 		goto __if;
 	}
 
+	/* traffic recording */
+	if(g_so.rec_path){
+		err = svd_rec_open (g_so.rec_path, ab->chans_num);
+		if(err){
+			goto __if;
+		}
+	}
+
+	/* call detail records, calls go on without them */
+	if(g_conf.cdr_file && svd_cdr_open (g_conf.cdr_file, g_conf.cdr_size,
+			g_conf.cdr_files, g_conf.cdr_sync)){
+		SU_DEBUG_1 (("Call detail records are off\n" VA_NONE));
+	}
+
 	/* set termination handler to shutdown svd */
 	main_svd = svd;
 	signal(SIGTERM, term_handler);
 	signal(SIGINT, term_handler);
+	/* restart: the next svd reuses the running DSP (warm start) */
+	signal(SIGUSR1, term_handler);
+
+	/* reload the configuration on SIGHUP */
+	err = hup_init (svd);
+	if(err){
+		goto __if;
+	}
+
+	/* calls of the previous svd */
+	if(svd_handoff_on()){
+		svd_handoff_apply (svd);
+	}
+	svd_boot_ready ();
 	
 	/* run main cycle */
 	su_root_run (svd->root);
+	while(svd_handoff_pending()){
+		/* it returns on error only, svd goes on then */
+		svd_handoff_exec (svd);
+		su_root_run (svd->root);
+	}
 
 __if:
+	svd_rec_close ();
 	svd_destroy_interface(svd);
 	svd_destroy (&svd);
+	svd_cdr_close ();
 __conf:
 	svd_conf_destroy ();
-	ab_destroy (&ab);
+	svd_boot_board_wait ();
+	if(keep_dsp){
+		ab_destroy_keep (&ab);
+	} else {
+		ab_destroy (&ab);
+	}
 __su:
 	su_deinit ();
+	svd_logring_destroy ();
 	syslog( LOG_NOTICE, "terminated" );
 	closelog();
 __startup:
@@ -245,15 +420,21 @@ DFS
 	}
 	
 	/* read svd *.conf files */
+	svd_boot_begin (boot_phase_CONF);
 	err = svd_conf_init (ab, svd->home);
 	if (err){
 		goto __exit_fail;
 	}
+	svd_boot_end (boot_phase_CONF);
+
+	/* resolve the registrars while the SIP stack is created */
+	svd_boot_dns_start ();
 
 	/* change log level, if it is not debug mode, from config sets */
 	if (g_so.debug_level == -1){
 		svd_log_set (g_conf.log_level, 0);
 	}
+	svd_log_conf (g_so.debug_level != -1);
 
 	/* extended SIP parser */
 	if(sip_update_default_mclass(sip_extend_mclass(NULL)) < 0) {
@@ -262,22 +443,28 @@ DFS
 	}
 	
 	/* svd root creation */
+	svd_boot_begin (boot_phase_SIP);
 	svd->root = su_root_create (svd);
 	if (svd->root == NULL) {
     		SU_DEBUG_0 (("svd_create() su_root_create() failed\n" VA_NONE));
 		goto __exit_fail;
 	}
 
-	/* init svd->ab with existing structure */
-	svd->ab = ab;
+	/* main loop handlers statistics */
+	err = svd_loop_init (svd, g_conf.slow_handler_ms);
+	if( err ) {
+		goto __exit_fail;
+	}
 
-	/* create ab structure of svd and handle callbacks */
-	/* uses !!g_cnof */
-	err = svd_atab_create (svd);
+	/* coalesced leds updates */
+	err = svd_led_init (svd);
 	if( err ) {
 		goto __exit_fail;
 	}
 
+	/* init svd->ab with existing structure */
+	svd->ab = ab;
+
 	/* launch the SIP stack */
 	/* *
 	 * NUTAG_AUTOANSWER (1)
@@ -317,9 +504,36 @@ DFS
 		      NUTAG_OUTBOUND ("gruuize no-outbound validate "
 				      "natify use-rport options-keepalive"),
 		      TAG_NULL () );
-
-	svd_refresh_registration (svd);
+	svd_boot_end (boot_phase_SIP);
+
+	/* registrations go out on the first main loop round,
+	 * before the channels tones */
+	svd_boot_dns_wait ();
+	svd_boot_begin (boot_phase_REGISTER);
+	if(svd_handoff_on()){
+		svd_handoff_register (svd);
+	} else {
+		svd_refresh_registration (svd);
+	}
 	nua_get_params(svd->nua, TAG_ANY(), TAG_NULL());
+	svd_boot_end (boot_phase_REGISTER);
+
+	/* the board is needed from now */
+	err = svd_boot_board_wait ();
+	if(err){
+		SU_DEBUG_0 ((LOG_FNC_A(svd_boot_board_err())));
+		goto __exit_fail;
+	}
+	svd_log_start (ab);
+
+	/* create ab structure of svd and handle callbacks */
+	/* uses !!g_cnof */
+	svd_boot_begin (boot_phase_ATAB);
+	err = svd_atab_create (svd);
+	if( err ) {
+		goto __exit_fail;
+	}
+	svd_boot_end (boot_phase_ATAB);
 DFE
 	return svd;
 __exit_fail:
@@ -351,6 +565,8 @@ DFS
 			svd_shutdown (*svd);
 		}
 		if((*svd)->root){
+			svd_led_destroy ();
+			svd_loop_destroy ();
 			su_root_destroy ((*svd)->root);
 		}
 		if((*svd)->home){
@@ -363,6 +579,27 @@ DFS
 DFE
 }/*}}}*/
 
+/**
+ * Log the board startup phases timings.
+ *
+ * \param[in] ab 	created board.
+ */
+static void
+svd_log_start( ab_t const * const ab )
+{/*{{{*/
+	char buf [256];
+	int len;
+	int i;
+
+	len = snprintf(buf, sizeof(buf), "Board %s start %lu us:",
+			ab->start.warm ? "warm" : "cold", ab->start.total_us);
+	for (i=0; i<ab_start_phase_COUNT && len<sizeof(buf); i++){
+		len += snprintf(buf+len, sizeof(buf)-len, " %s %lu",
+				ab_start_phase_name[i], ab->start.phase_us[i]);
+	}
+	SU_DEBUG_3(("%s\n", buf));
+}/*}}}*/
+
 /**
  * Logging callback function
  *
@@ -371,25 +608,40 @@ DFE
  * \param[in] ap 		message arguments (internal sofia log value)
  * \remark
  *		It calls for every log action and make a decision what to do.
+ *		It formats the whole line with indentation and puts it to the
+ *		log ring, the ring flusher writes it to the target later.
  */
 static void
 svd_logger(void *logarg, char const *format, va_list ap)
 {/*{{{*/
-  int i;
+	char line[LOGRING_LINE_LEN];
+	int ind;
+	int len;
+	int truncated = 0;
+
 	if( (int)logarg == -1){
 		/* do not log anything */
 		return;
-	} else if ( (int)logarg ) {
-		/* debug is on - log to stderr */
-		for (i=0; i<g_f_offset; i++)
-		  fprintf(stderr,"  ");
-		vfprintf(stderr, format, ap);
-	} else {
-		/* debug is off - standart log */
-		for (i=0; i<g_f_offset; i++)
-		  syslog(LOG_INFO, "  ");
-		vsyslog (LOG_INFO, format, ap);
 	}
+
+	ind = g_f_offset * 2;
+	if(ind > LOGRING_LINE_LEN/2){
+		ind = LOGRING_LINE_LEN/2;
+	}
+	memset(line, ' ', ind);
+
+	len = vsnprintf(line+ind, sizeof(line)-ind, format, ap);
+	if(len < 0){
+		return;
+	}
+	len += ind;
+	if(len >= sizeof(line)){
+		len = sizeof(line)-1;
+		line[len-1] = '\n';
+		truncated = 1;
+	}
+
+	svd_logring_put (line, len, truncated);
 }/*}}}*/
 
 /**
@@ -404,10 +656,21 @@ svd_logger(void *logarg, char const *format, va_list ap)
  * \remark
  *		It attaches the callback logger function with proper params and uses
  *		sofia sip logging system
+ *		It starts the log ring flusher on the first call
  */
 static void
 svd_log_set( int const level, int const debug)
 {/*{{{*/
+	if(svd_logring_create()){
+		fprintf(stderr, "log ring flusher is not started, "
+				"logging synchronously\n");
+	}
+	if(debug){
+		svd_logring_target (logring_target_FD, NULL);
+	} else {
+		svd_logring_target (logring_target_SYSLOG, NULL);
+	}
+
 	if (level == -1){
  		/* do not log anything */
 		su_log_set_level (NULL, 0);
@@ -418,3 +681,57 @@ svd_log_set( int const level, int const debug)
 	}
 }/*}}}*/
 
+/**
+ * Sets log file and per-subsystem log levels from \ref g_conf.
+ *
+ * \param[in] debug 	debug mode (stderr) is on
+ * \remark
+ *		"log_subsys" option is the list of "name:level" pairs,
+ *		separated with spaces or commas, names are in \ref svd_log_subsys.
+ *		Log file is not used in debug mode.
+ */
+static void
+svd_log_conf( int const debug)
+{/*{{{*/
+	char * str;
+	char * tok;
+	char * save = NULL;
+	char * lvl;
+	int i;
+
+	if( !debug && g_conf.log_file){
+		if(svd_logring_target (logring_target_FD, g_conf.log_file)){
+			SU_DEBUG_1(("can`t open log file \"%s\": %s\n",
+					g_conf.log_file, strerror(errno)));
+		}
+	}
+
+	if( !g_conf.log_subsys){
+		return;
+	}
+	str = strdup(g_conf.log_subsys);
+	if( !str){
+		SU_DEBUG_0((LOG_FNC_A(LOG_NOMEM)));
+		return;
+	}
+	for (tok = strtok_r(str, " ,", &save); tok;
+			tok = strtok_r(NULL, " ,", &save)){
+		lvl = strchr(tok, ':');
+		if( !lvl){
+			SU_DEBUG_2(("log_subsys: \"%s\" has no level\n", tok));
+			continue;
+		}
+		*lvl++ = '\0';
+		for (i=0; i<sizeof(svd_log_subsys)/sizeof(svd_log_subsys[0]); i++){
+			if( !strcmp(tok, svd_log_subsys[i].name)){
+				su_log_set_level (svd_log_subsys[i].log, strtol(lvl, NULL, 10));
+				break;
+			}
+		}
+		if(i == sizeof(svd_log_subsys)/sizeof(svd_log_subsys[0])){
+			SU_DEBUG_2(("log_subsys: unknown subsystem \"%s\"\n", tok));
+		}
+	}
+	free(str);
+}/*}}}*/
+
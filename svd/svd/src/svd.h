@@ -8,6 +8,7 @@
 
 typedef struct svd_s svd_t;
 typedef struct svd_chan_s svd_chan_t;
+typedef struct svd_call_s svd_call_t;
 typedef struct sip_account_s sip_account_t;
 
 /* define type of context pointers for callbacks */
@@ -30,12 +31,17 @@ typedef struct sip_account_s sip_account_t;
 /** dial round buffer size for digits in queue. */
 #define DIAL_RBUF_LEN 15
 
+/** Preloaded block of the call arena (the call strings, SDP and headers
+ * of the usual call fit it). */
+#define CALL_ARENA_PRELOAD 2048
+
 /* Includes {{{*/
 #include "config.h"
 #include "ab_api.h"
 #include "sofia.h"
 #include "svd_log.h"
 #include "svd_cfg.h"
+#include "svd_lat.h"
 
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -44,8 +50,6 @@ typedef struct sip_account_s sip_account_t;
 #include <errno.h>
 #include <pthread.h>
 
-
-#include "drv_tapi_io.h"
 /*}}}*/
 
 /** Channel context structure - store channel info / status / etc.*/
@@ -58,6 +62,8 @@ struct svd_chan_s
 	} dial_status; /**< Dial status and values, gets in dial process.*/
 	
 	unsigned char off_hook; /**<The channel is off hook */
+	unsigned char conf_pending; /**< Reloaded config waits for the idle channel.*/
+	unsigned char tones_pending; /**< Tones wait for the idle device.*/
 
 	codec_t vcod; /**< voice coder */
 	codec_t fcod; /**< faxmodem coder */
@@ -67,24 +73,76 @@ struct svd_chan_s
 	int te_payload;  /**< payload for telephone events */
 	int rtp_sfd; /**< RTP socket file descriptor.*/
 	int rtp_port; /**< Local RTP port.*/
+	unsigned long rtp_rx; /**< RTP packets got from the remote.*/
 
-	sip_account_t * account; //**<Account used by this call */
-	int remote_port; /**< Remote RTP port.*/
-	char * remote_host; /**< Remote RTP host.*/
-	char * remote_sip; /**< Remote sip address. */
-	int outgoing_call; /**<Current call is outgoing. */
 	int call_established; /**< Other party replied/ we replied. */
 	time_t call_start; /**< To show the duration of the call. */
 
 	int local_wait_idx; /**< Local wait index.*/
 	int remote_wait_idx; /**< Remote wait index.*/
 
-	nua_handle_t * op_handle;/**< NUA handle for channel.*/
+	nua_handle_t * op_handle;/**< NUA handle for channel (call->nh).*/
+	svd_call_t * call; /**< Call the channel is bound to or NULL.*/
+	svd_chan_t * call_next; /**< Next channel of the same call.*/
 
 	su_timer_t * dtmf_tmr; /**< Collect dtmf timer. */
+	unsigned long long dtmf_due; /**< Collect dtmf timer deadline (loop lag). */
+
+	struct lat_call_s lat; /**< Call setup milestones. */
+
+	/** Media parameters the DSP channel is tuned with.*/
+	struct media_cache_s {
+		unsigned char valid; /**< Tuned and not changed since.*/
+		codec_t vcod; /**< Voice coder.*/
+		codec_t fcod; /**< Faxmodem coder.*/
+		int te_payload; /**< Telephone events payload.*/
+		jb_prms_t jb; /**< Jitter buffer parameters.*/
+		rtp_session_prms_t rtpp; /**< Gains, VAD and HPF.*/
+		unsigned long fast; /**< Activations with WLEC tuning only.*/
+		unsigned long full; /**< Activations with tuning.*/
+	} media_cache;
 	
 };/*}}}*/
 
+/** Call context - state shared by all channels bound to one NUA handle.*/
+struct svd_call_s
+{/*{{{*/
+	su_home_t home[1]; /**< Call arena, everything of the call is allocated
+			here and freed with the call (should be the first).*/
+	nua_handle_t * nh; /**< NUA handle of the call.*/
+	sip_account_t * account; /**< Account used by this call.*/
+	int outgoing; /**< The call is outgoing.*/
+	char * remote_sip; /**< Remote sip address.*/
+	char * remote_host; /**< Remote RTP host.*/
+	int remote_port; /**< Remote RTP port.*/
+	struct sockaddr_storage remote_addr; /**< Remote RTP address in the RTP
+			sockets family (\ref svd_media_remote_set()).*/
+	socklen_t remote_addr_len; /**< Length of remote_addr, 0 - not set.*/
+	int remote_af; /**< Family of the remote host (AF_INET6 / AF_INET).*/
+	char * call_id; /**< Call-ID of the dialog (for the handoff).*/
+	char * contact; /**< Remote target of the dialog (for the handoff).*/
+	unsigned long cseq; /**< Last CSeq of our requests in the dialog.*/
+	unsigned char adopted; /**< Taken from the previous svd, NUA has
+			no dialog for it (\ref svd_handoff_apply()).*/
+	unsigned long long start_us; /**< Call creation (wall clock, for CDR).*/
+	unsigned long long answer_us; /**< Call answer (wall clock) or 0.*/
+	int status; /**< Last final SIP status of the call or 0.*/
+	unsigned char media; /**< Media was activated for the call.*/
+	svd_chan_t * chans; /**< Bound channels in channels order.*/
+	int chans_num; /**< Bound channels count.*/
+	svd_call_t * hash_next; /**< Next call in the hash bucket.*/
+};/*}}}*/
+
+/** Arenas of the finished calls.*/
+struct call_mem_stat_s
+{/*{{{*/
+	unsigned long calls; /**< Finished calls.*/
+	unsigned long long allocs; /**< Allocations of all calls.*/
+	unsigned long long bytes; /**< Allocated bytes of all calls.*/
+	unsigned long max_allocs; /**< Most allocations of one call.*/
+	unsigned long max_bytes; /**< Most bytes of one call.*/
+};/*}}}*/
+
 /** Routine main context structure.*/
 struct svd_s
 {/*{{{*/
@@ -92,7 +150,11 @@ struct svd_s
 	su_home_t home[1];	/**< Our memory home.*/
 	nua_t * nua;		/**< Pointer to NUA object.*/
 	ab_t * ab;		/**< Pointer to ATA Boards object.*/
+	svd_call_t ** call_hash; /**< Calls by NUA handle (svd_call_bind()).*/
+	unsigned int call_mask; /**< Hash buckets count - 1.*/
 	int ifd; /**< Interface socket file deskriptor. */
+	struct lat_stat_s lat; /**< Setup latency of calls without account. */
+	struct call_mem_stat_s call_mem; /**< Arenas of the finished calls. */
 };/*}}}*/
 
 #endif /* __SVD_H__ */
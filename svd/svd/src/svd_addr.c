@@ -0,0 +1,193 @@
+/**
+ * @file svd_addr.c
+ * RTP addresses implementation.
+ * It containes the dual-stack socket and address helpers of the media.
+ */
+
+/* Includes {{{ */
+#include "svd_addr.h"
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+/*}}}*/
+
+/**
+ * Open the datagram socket (dual-stack if possible).
+ *
+ * \param[out] af 	family of the socket (AF_INET6 / AF_INET).
+ * \return
+ * 		socket or -1 on error (errno is set).
+ * \remark
+ * 		AF_INET6 socket has IPV6_V6ONLY off, so it takes IPv4 peers as
+ * 		the mapped addresses. Without IPv6 in the kernel it is AF_INET.
+ */
+int
+svd_addr_socket (int * const af)
+{/*{{{*/
+	int v6only = 0;
+	int fd;
+	int err;
+
+	*af = AF_INET6;
+	fd = socket(AF_INET6, SOCK_DGRAM, 0);
+	if(fd == -1 && (errno == EAFNOSUPPORT || errno == EPROTONOSUPPORT)){
+		*af = AF_INET;
+		return socket(AF_INET, SOCK_DGRAM, 0);
+	}
+	if(fd == -1){
+		return -1;
+	}
+	if(setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, sizeof(v6only))){
+		err = errno;
+		close(fd);
+		errno = err;
+		return -1;
+	}
+	return fd;
+}/*}}}*/
+
+/**
+ * Fill the wildcard address of the family with the port.
+ *
+ * \param[in] af 	address family (AF_INET6 / AF_INET).
+ * \param[in] port 	port in host byte order.
+ * \param[out] sa 	address.
+ * \param[out] len 	address length.
+ */
+void
+svd_addr_any (int const af, int const port,
+		struct sockaddr_storage * const sa, socklen_t * const len)
+{/*{{{*/
+	memset(sa, 0, sizeof(*sa));
+	if(af == AF_INET6){
+		struct sockaddr_in6 * a6 = (struct sockaddr_in6 *)sa;
+		a6->sin6_family = AF_INET6;
+		a6->sin6_port = htons(port);
+		a6->sin6_addr = in6addr_any;
+		*len = sizeof(*a6);
+	} else {
+		struct sockaddr_in * a4 = (struct sockaddr_in *)sa;
+		a4->sin_family = AF_INET;
+		a4->sin_port = htons(port);
+		a4->sin_addr.s_addr = htonl(INADDR_ANY);
+		*len = sizeof(*a4);
+	}
+}/*}}}*/
+
+/**
+ * Resolve the numeric host and port to the sockets family address.
+ *
+ * \param[in] host 		numeric IPv6 or IPv4 address.
+ * \param[in] port 		port in host byte order.
+ * \param[in] sock_af 	family of the sending socket.
+ * \param[out] sa 		address for sendto().
+ * \param[out] len 		address length.
+ * \param[out] host_af 	family of the host (AF_UNSPEC if it is not
+ * 		an address).
+ * \retval -1	the host is not a numeric address.
+ * \retval -2	the host is IPv6 and the socket is IPv4.
+ * \retval 0 	if etherything is ok.
+ * \remark
+ * 		IPv4 hosts become the mapped addresses for AF_INET6 sockets.
+ * 		Nothing is resolved with the DNS.
+ */
+int
+svd_addr_resolve (char const * const host, int const port,
+		int const sock_af, struct sockaddr_storage * const sa,
+		socklen_t * const len, int * const host_af)
+{/*{{{*/
+	struct sockaddr_in6 * a6 = (struct sockaddr_in6 *)sa;
+	struct sockaddr_in * a4 = (struct sockaddr_in *)sa;
+	struct in6_addr in6;
+	struct in_addr in4;
+
+	memset(sa, 0, sizeof(*sa));
+	*len = 0;
+	*host_af = AF_UNSPEC;
+
+	if       (inet_pton (AF_INET6, host, &in6) == 1){
+		*host_af = AF_INET6;
+		if(sock_af != AF_INET6){
+			return -2;
+		}
+		a6->sin6_family = AF_INET6;
+		a6->sin6_port = htons(port);
+		a6->sin6_addr = in6;
+		*len = sizeof(*a6);
+	} else if(inet_pton (AF_INET, host, &in4) == 1){
+		*host_af = AF_INET;
+		if(sock_af == AF_INET6){
+			/* ::ffff:a.b.c.d */
+			a6->sin6_family = AF_INET6;
+			a6->sin6_port = htons(port);
+			a6->sin6_addr.s6_addr[10] = 0xff;
+			a6->sin6_addr.s6_addr[11] = 0xff;
+			memcpy(&a6->sin6_addr.s6_addr[12], &in4, sizeof(in4));
+			*len = sizeof(*a6);
+		} else {
+			a4->sin_family = AF_INET;
+			a4->sin_port = htons(port);
+			a4->sin_addr = in4;
+			*len = sizeof(*a4);
+		}
+	} else {
+		return -1;
+	}
+	return 0;
+}/*}}}*/
+
+/**
+ * Get the local address of the interface.
+ *
+ * \param[in] ifname 	interface name (NULL or "" - any interface).
+ * \param[in] af 		address family (AF_INET6 / AF_INET).
+ * \param[out] buf 		address string (can be NULL to check only).
+ * \param[in] size 		buf size.
+ * \retval -1	the interface has no global address of the family.
+ * \retval 0 	if etherything is ok.
+ * \remark
+ * 		IPv6 link-local and loopback addresses are skipped.
+ */
+int
+svd_addr_local (char const * const ifname, int const af,
+		char * const buf, size_t const size)
+{/*{{{*/
+	struct ifaddrs * ifs = NULL;
+	struct ifaddrs * ifa;
+	int err = -1;
+
+	if(getifaddrs (&ifs)){
+		goto __exit;
+	}
+	for (ifa = ifs; ifa; ifa = ifa->ifa_next){
+		void const * addr;
+		if( !ifa->ifa_addr || ifa->ifa_addr->sa_family != af ||
+				(ifname && ifname[0] && strcmp(ifa->ifa_name, ifname))){
+			continue;
+		}
+		if(af == AF_INET6){
+			struct in6_addr const * a6 =
+					&((struct sockaddr_in6 *)ifa->ifa_addr)->sin6_addr;
+			if(IN6_IS_ADDR_LINKLOCAL(a6) || IN6_IS_ADDR_LOOPBACK(a6)){
+				continue;
+			}
+			addr = a6;
+		} else {
+			addr = &((struct sockaddr_in *)ifa->ifa_addr)->sin_addr;
+		}
+		if(buf && !inet_ntop (af, addr, buf, size)){
+			continue;
+		}
+		err = 0;
+		break;
+	}
+__exit:
+	if(ifs){
+		freeifaddrs (ifs);
+	}
+	return err;
+}/*}}}*/
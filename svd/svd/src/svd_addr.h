@@ -0,0 +1,32 @@
+/**
+ * @file svd_addr.h
+ * RTP addresses.
+ * It containes the dual-stack socket and address helpers of the media,
+ * 		they do not use sofia-sip (bench/addr_test.c builds them alone).
+ */
+#ifndef __SVD_ADDR_H__
+#define __SVD_ADDR_H__
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+/** @defgroup ADDR RTP addresses.
+ *  RTP sockets are AF_INET6 with IPV6_V6ONLY off if the kernel has IPv6,
+ *  IPv4 peers are reached through the mapped addresses (::ffff:a.b.c.d).
+ *  @{*/
+/** Open the datagram socket (dual-stack if possible).*/
+int svd_addr_socket (int * const af);
+/** Fill the wildcard address of the family with the port.*/
+void svd_addr_any (int const af, int const port,
+		struct sockaddr_storage * const sa, socklen_t * const len);
+/** Resolve the numeric host and port to the sockets family address.*/
+int svd_addr_resolve (char const * const host, int const port,
+		int const sock_af, struct sockaddr_storage * const sa,
+		socklen_t * const len, int * const host_af);
+/** Get the local address of the interface.*/
+int svd_addr_local (char const * const ifname, int const af,
+		char * const buf, size_t const size);
+/** @}*/
+
+#endif /* __SVD_ADDR_H__ */
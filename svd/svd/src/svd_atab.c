@@ -11,6 +11,15 @@
 #include "svd_ua.h"
 #include "svd_atab.h"
 #include "svd_led.h"
+#include "svd_flight.h"
+#include "svd_loop.h"
+#include "svd_rec.h"
+#include "svd_handoff.h"
+#include "svd_boot.h"
+#include "svd_cdr.h"
+#include "svd_uring.h"
+#include "svd_addr.h"
+#include "svd_relay.h"
 
 #include <stddef.h>
 #include <stdlib.h>
@@ -22,8 +31,6 @@
 #include <sys/socket.h>
 #include <netinet/ip.h>
 #include <net/if.h>
-
-#include "drv_tapi_io.h"
 /*}}}*/
 
 /** @defgroup MEDIA_INT Media helpers (internals).
@@ -41,20 +48,42 @@ int svd_prepare_chan_codecs( ab_chan_t * const chan, jb_prms_t ** jpb );
 /** Handle events on ATA board.*/
 static int svd_atab_handler (su_root_magic_t * root, su_wait_t * w,
 		su_wakeup_arg_t * user_data);
+/** Timed \ref svd_atab_handler for the root.*/
+static int svd_atab_handler_timed (su_root_magic_t * root, su_wait_t * w,
+		su_wakeup_arg_t * user_data);
 /** Process FXS Offhook event.*/
 static int svd_handle_event_FXS_OFFHOOK
-		( svd_t * const svd, int const chan_idx );
+		( svd_t * const svd, int const chan_idx, long const data );
 /** Process FXS Onhook event.*/
 static int svd_handle_event_FXS_ONHOOK
-		( svd_t * const svd, int const chan_idx );
+		( svd_t * const svd, int const chan_idx, long const data );
 /** Process FXS digit event.*/
 static int svd_handle_event_FXS_DIGIT_X
 		( svd_t * const svd, int const chan_idx, long const data );
 /** Process FXS Faxmodem CED event.*/
 static int svd_handle_event_FM_CED
 		( svd_t * const svd, int const chan_idx, long const data );
+/** Board event handler.*/
+typedef int (*atab_evt_handler_f)
+		( svd_t * const svd, int const chan_idx, long const data );
+/** Handlers of event types (NULL - only logged).*/
+static atab_evt_handler_f const atab_evt_handler [ab_dev_event_COUNT] = {
+	[ab_dev_event_FXS_DIGIT_TONE] = svd_handle_event_FXS_DIGIT_X,
+	[ab_dev_event_FXS_DIGIT_PULSE] = svd_handle_event_FXS_DIGIT_X,
+	[ab_dev_event_FXS_ONHOOK] = svd_handle_event_FXS_ONHOOK,
+	[ab_dev_event_FXS_OFFHOOK] = svd_handle_event_FXS_OFFHOOK,
+	[ab_dev_event_FM_CED] = svd_handle_event_FM_CED,
+};
+/** Board events statistics.*/
+static struct atab_evt_stats_s g_evt_stats;
 /** @}*/
 
+/** Event types names (see \ref ab_dev_event_e).*/
+char const * const atab_evt_name [ab_dev_event_COUNT] = {
+	"none", "uncatched", "fxo_ringing", "digit_tone", "digit_pulse",
+	"onhook", "offhook", "ced", "coder", "tone",
+};
+
 
 
 /** @defgroup DIAL_SEQ Dial Sequence (internals).
@@ -82,8 +111,16 @@ static int svd_media_tapi_handle_local_data (su_root_magic_t * root,
 /** Move RTP data from RTP socket to channel.*/
 static int svd_media_tapi_handle_remote_data (su_root_magic_t * root,
 		su_wait_t * w, su_wakeup_arg_t * user_data );
+/** Timed \ref svd_media_tapi_handle_local_data for the root.*/
+static int svd_media_tapi_local_timed (su_root_magic_t * root,
+		su_wait_t * w, su_wakeup_arg_t * user_data );
+/** Timed \ref svd_media_tapi_handle_remote_data for the root.*/
+static int svd_media_tapi_remote_timed (su_root_magic_t * root,
+		su_wait_t * w, su_wakeup_arg_t * user_data );
 /** Open RTP socket.*/
 static int svd_media_tapi_open_rtp (svd_chan_t * const chan_ctx);
+/** Address family of the RTP sockets (AF_INET6 sockets are dual-stack).*/
+static int g_rtp_af = AF_INET;
 /** @}*/
 
 
@@ -96,6 +133,16 @@ static int svd_media_tapi_open_rtp (svd_chan_t * const chan_ctx);
 static int svd_chans_init ( svd_t * const svd );
 /** Attach callback for ATA devices.*/
 static int attach_dev_cb ( svd_t * const svd );
+/** Set the channels tones and caller id after the first loop round.*/
+static void svd_chans_conf_cb (su_root_magic_t * magic, su_timer_t * t,
+		su_timer_arg_t * arg);
+/** Timer of \ref svd_chans_conf_cb.*/
+static su_timer_t * g_chans_conf_tmr;
+/** Program the tones to the device if all its channels are idle.*/
+static int svd_dev_tones_idle (svd_t * const svd, ab_dev_t * const dev);
+/** Queue the call detail record of the finished call.*/
+static void svd_call_cdr (svd_t const * const svd,
+		svd_chan_t const * const chan_ctx, svd_call_t const * const call);
 /** @}*/
 
 
@@ -121,6 +168,13 @@ DFS
 	assert (svd);
 	assert (svd->ab);
 
+	/* channels register the media on the ring if it is set up */
+	if(g_conf.media_engine && !strcmp(g_conf.media_engine, "uring") &&
+			svd_uring_init (svd)){
+		SU_DEBUG_1 (("Media engine: uring is not available, poll is used\n"
+				VA_NONE));
+	}
+
 	/** it uses !!g_conf to get route_id_len */
 	err = svd_chans_init (svd);
 	if (err){
@@ -133,11 +187,20 @@ DFS
 		SU_DEBUG_0 ((LOG_FNC_A("dev callback attach error")));
 		goto __exit_fail;
 	}
+
+	/* the registrations are sent first */
+	g_chans_conf_tmr = su_timer_create (su_root_task(svd->root), 0);
+	if( !g_chans_conf_tmr ||
+			su_timer_set_interval (g_chans_conf_tmr, svd_chans_conf_cb,
+			NULL, 0)){
+		SU_DEBUG_1 ((LOG_FNC_A ("channels config timer fails, set it now")));
+		svd_chans_conf_cb (svd, NULL, NULL);
+	}
 DFE
 	return 0;
 __exit_fail:
 DFE
-	SU_DEBUG_0 ((">> reason [%d]: %s\n",ab_g_err_idx,ab_g_err_str));
+	SU_DEBUG_0 ((">> reason [%d]: %s\n",ab_err_idx(),ab_err_str()));
 	return -1;
 }/*}}}*/
 
@@ -158,6 +221,11 @@ DFS
 		goto __exit;
 	}
 
+	if (g_chans_conf_tmr){
+		su_timer_destroy(g_chans_conf_tmr);
+		g_chans_conf_tmr = NULL;
+	}
+
 	/* ab_chans_magic_destroy */
 	j = svd->ab->chans_num;
 	for( i = 0; i < j; i++ ){
@@ -171,6 +239,11 @@ DFS
 			curr_chan = NULL;
 		}
 	}
+	svd_uring_destroy ();
+	if (svd->call_hash){
+		free (svd->call_hash);
+		svd->call_hash = NULL;
+	}
 __exit:
 DFE
 	return;
@@ -187,6 +260,8 @@ svd_media_register (svd_t * const svd, ab_chan_t * const chan)
 {/*{{{*/
 	su_wait_t wait[1];
 	svd_chan_t * chan_ctx;
+	struct sockaddr_storage sa;
+	socklen_t sa_len;
 	int ret;
 DFS
 	if( (!chan) || (!chan->ctx)){
@@ -197,6 +272,31 @@ DFS
 
 	chan_ctx = chan->ctx;
 
+	/* socket of the previous svd keeps the port the remotes send to */
+	ret = svd_handoff_rtp_sfd (chan_ctx->chan_idx, &chan_ctx->rtp_port);
+	if (ret == -1){
+		ret = svd_media_tapi_open_rtp (chan_ctx);
+	}
+	if (ret == -1){
+		goto __exit_fail;
+	}
+	chan_ctx->rtp_sfd = ret;
+
+	/* handed off sockets keep the family of the previous svd */
+	sa_len = sizeof(sa);
+	if( !getsockname (chan_ctx->rtp_sfd, (struct sockaddr *)&sa, &sa_len)){
+		g_rtp_af = sa.ss_family;
+	}
+
+	/* the ring relays both directions without the root waits */
+	if(svd_uring_on ()){
+		if( !svd_uring_chan_add (chan)){
+			goto __exit;
+		}
+		SU_DEBUG_2 (("[%02d] uring arm fails, channel uses poll\n",
+				chan->abs_idx));
+	}
+
 	ret = su_wait_create(wait, chan->rtp_fd, SU_WAIT_IN);
 	if (ret){
 		SU_DEBUG_0 ((LOG_FNC_A ("su_wait_create() fails" ) ));
@@ -204,19 +304,13 @@ DFS
 	}
 
 	ret = su_root_register (svd->root, wait,
-			svd_media_tapi_handle_local_data, chan, 0);
+			svd_media_tapi_local_timed, chan, 0);
 	if (ret == -1){
 		SU_DEBUG_0 ((LOG_FNC_A ("su_root_register() fails" ) ));
 		goto __exit_fail;
 	}
 	chan_ctx->local_wait_idx = ret;
 
-	ret = svd_media_tapi_open_rtp (chan_ctx);
-	if (ret == -1){
-		goto __exit_fail;
-	}
-	chan_ctx->rtp_sfd = ret;
-
 	ret = su_wait_create(wait, chan_ctx->rtp_sfd, SU_WAIT_IN);
 	if (ret){
 		SU_DEBUG_0 ((LOG_FNC_A ("su_wait_create() fails" ) ));
@@ -224,12 +318,13 @@ DFS
 	}
 
 	ret = su_root_register (svd->root, wait,
-			svd_media_tapi_handle_remote_data, chan, 0);
+			svd_media_tapi_remote_timed, chan, 0);
 	if (ret == -1) {
 		SU_DEBUG_0 ((LOG_FNC_A ("su_root_register() fails" ) ));
 		goto __exit_fail;
 	}
 	chan_ctx->remote_wait_idx = ret;
+__exit:
 DFE
 	return 0;
 __exit_fail:
@@ -253,6 +348,8 @@ DFS
 
 	chan_ctx = chan->ctx;
 
+	/* cancels are submitted before the socket is closed */
+	svd_uring_chan_del (chan);
 	if(chan_ctx->local_wait_idx != -1){
 		su_root_deregister (svd->root, chan_ctx->local_wait_idx);
 		chan_ctx->local_wait_idx = -1;
@@ -280,15 +377,22 @@ void
 svd_clear_call (svd_t * const svd, ab_chan_t * const chan)
 {/*{{{*/
 	svd_chan_t * chan_ctx = chan->ctx;
+	svd_call_t * call = chan_ctx->call;
+	char setup [LAT_STR_LEN];
 	int size;
 DFS
+	/* call setup latency */
+	svd_lat_finish (&chan_ctx->lat,
+			call && call->account ? &call->account->lat : &svd->lat,
+			setup, sizeof(setup));
 	
 	if (chan_ctx->call_established) {
-		SU_DEBUG_2(("Channel %d ending %s call to %s account %s duration %Ld\n",
-			   chan_ctx->chan_idx+1,chan_ctx->outgoing_call ? "outgoing" : "incoming",
-	                   chan_ctx->remote_sip,
-			   chan_ctx->account ? chan_ctx->account->name : "?",
-			   time(NULL)-chan_ctx->call_start));
+		SU_DEBUG_2(("Channel %d ending %s call to %s account %s duration %Ld setup [%s]\n",
+			   chan_ctx->chan_idx+1,
+			   call && call->outgoing ? "outgoing" : "incoming",
+			   call ? call->remote_sip : NULL,
+			   call && call->account ? call->account->name : "?",
+			   time(NULL)-chan_ctx->call_start, setup));
 		chan_ctx->call_established = 0;
 		
 	}
@@ -297,6 +401,17 @@ DFS
 	size = sizeof(chan_ctx->dial_status.digits);
 	memset (chan_ctx->dial_status.digits, 0, size);
 
+	/* CALL, the handle goes with its last channel
+	 * (before the SDP reset, the call record takes the codec) */
+	if(call){
+		nua_handle_t * nh = call->nh;
+		int last = call->chans_num == 1;
+		svd_call_unbind (svd, chan_ctx);
+		if(last){
+			nua_handle_destroy (nh);
+		}
+	}
+
 	/* SDP */
 	chan_ctx->sdp_payload = -1;
 	chan_ctx->te_payload = -1;
@@ -305,25 +420,358 @@ DFS
 	memset(&chan_ctx->vcod, 0, sizeof(chan_ctx->vcod));
 	memset(&chan_ctx->fcod, 0, sizeof(chan_ctx->fcod));
 
-	chan_ctx->remote_port = 0;
-	if(chan_ctx->remote_host){
-		su_free (svd->home, chan_ctx->remote_host);
-		chan_ctx->remote_host = NULL;
+	/* reloaded config waits for this moment */
+	svd_chan_conf_idle (svd, chan);
+DFE
+}/*}}}*/
+
+/**
+ * Hash bucket of the handle.
+ *
+ * \param[in] svd 	routine context structure.
+ * \param[in] nh 	NUA handle.
+ * \return
+ * 		bucket index in svd->call_hash.
+ */
+static inline unsigned int
+svd_call_bucket (svd_t const * const svd, nua_handle_t const * const nh)
+{/*{{{*/
+	/* handles are allocated objects, low bits carry nothing */
+	return ((unsigned int)((unsigned long)nh >> 4) * 2654435761U) &
+			svd->call_mask;
+}/*}}}*/
+
+/**
+ * Get the call of the NUA handle.
+ *
+ * \param[in] svd 	routine context structure.
+ * \param[in] nh 	NUA handle.
+ * \return
+ * 		call or NULL if no channel is bound to nh.
+ */
+svd_call_t *
+svd_call_find (svd_t const * const svd, nua_handle_t const * const nh)
+{/*{{{*/
+	svd_call_t * call;
+
+	if( !nh){
+		return NULL;
 	}
-	if(chan_ctx->remote_sip){
-		su_free (svd->home, chan_ctx->remote_sip);
-		chan_ctx->remote_sip = NULL;
+	call = svd->call_hash[svd_call_bucket(svd, nh)];
+	while(call && call->nh != nh){
+		call = call->hash_next;
 	}
+	return call;
+}/*}}}*/
 
-	/* HANDLE */
-	if(chan_ctx->op_handle){
-		nua_handle_destroy (chan_ctx->op_handle);
-		chan_ctx->op_handle = NULL;
+/**
+ * Bind the channel to the call of the NUA handle.
+ *
+ * \param[in] svd 		routine context structure.
+ * \param[in] chan_ctx 	channel context.
+ * \param[in] nh 		NUA handle.
+ * \param[in] account 	account of the call (used if the call is new).
+ * \return
+ * 		the call or NULL on error.
+ * \remark
+ * 		The call is created on the first channel bound to nh. The channel
+ * 		leaves its previous call if it has one.
+ */
+svd_call_t *
+svd_call_bind (svd_t * const svd, svd_chan_t * const chan_ctx,
+		nua_handle_t * const nh, sip_account_t * const account)
+{/*{{{*/
+	svd_call_t * call;
+	svd_chan_t ** pp;
+
+	if(chan_ctx->call){
+		if(chan_ctx->call->nh == nh){
+			return chan_ctx->call;
+		}
+		svd_call_unbind (svd, chan_ctx);
 	}
-	
-	/* SIP ACCOUNT */
-	chan_ctx->account = NULL;
-DFE
+
+	call = svd_call_find (svd, nh);
+	if( !call){
+		call = svd_call_new (svd, account);
+		if( !call){
+			goto __exit_fail;
+		}
+		svd_call_handle (svd, call, nh);
+	}
+
+	/* keep the channels in order */
+	pp = &call->chans;
+	while(*pp && (*pp)->chan_idx < chan_ctx->chan_idx){
+		pp = &(*pp)->call_next;
+	}
+	chan_ctx->call_next = *pp;
+	*pp = chan_ctx;
+	call->chans_num++;
+
+	chan_ctx->call = call;
+	chan_ctx->op_handle = nh;
+	return call;
+__exit_fail:
+	return NULL;
+}/*}}}*/
+
+/**
+ * Unbind the channel from its call.
+ *
+ * \param[in] svd 		routine context structure.
+ * \param[in] chan_ctx 	channel context.
+ * \remark
+ * 		The call is freed with its last channel, the handle is not
+ * 		destroyed here.
+ */
+void
+svd_call_unbind (svd_t * const svd, svd_chan_t * const chan_ctx)
+{/*{{{*/
+	svd_call_t * call = chan_ctx->call;
+	svd_chan_t ** pp;
+
+	if( !call){
+		return;
+	}
+	pp = &call->chans;
+	while(*pp && *pp != chan_ctx){
+		pp = &(*pp)->call_next;
+	}
+	if(*pp){
+		*pp = chan_ctx->call_next;
+		call->chans_num--;
+	}
+	chan_ctx->call_next = NULL;
+	chan_ctx->call = NULL;
+	chan_ctx->op_handle = NULL;
+
+	if(call->chans_num){
+		return;
+	}
+	if(svd_cdr_on()){
+		svd_call_cdr (svd, chan_ctx, call);
+	}
+	svd_call_free (svd, call);
+}/*}}}*/
+
+/**
+ * Create the call arena.
+ *
+ * \param[in] svd 		routine context structure.
+ * \param[in] account 	account of the call.
+ * \return
+ * 		the call or NULL on error.
+ * \remark
+ * 		The call is the clone of svd->home, the strings, headers and SDP
+ * 		of the call should be allocated in call->home, they are freed
+ * 		with the call by \ref svd_call_free(). The call has no handle
+ * 		until \ref svd_call_handle().
+ */
+svd_call_t *
+svd_call_new (svd_t * const svd, sip_account_t * const account)
+{/*{{{*/
+	svd_call_t * call;
+
+	call = su_home_clone (svd->home, sizeof(*call));
+	if( !call){
+		SU_DEBUG_0 ((LOG_FNC_A (LOG_NOMEM_A("call") ) ));
+		return NULL;
+	}
+	su_home_init_stats (call->home);
+	su_home_preload (call->home, 1, CALL_ARENA_PRELOAD);
+	call->account = account;
+	call->start_us = svd_cdr_now ();
+	return call;
+}/*}}}*/
+
+/**
+ * Give the handle to the call.
+ *
+ * \param[in] svd 		routine context structure.
+ * \param[in] call 		call from \ref svd_call_new().
+ * \param[in] nh 		NUA handle of the call.
+ * \remark
+ * 		\ref svd_call_find() finds the call by the handle from now.
+ */
+void
+svd_call_handle (svd_t * const svd, svd_call_t * const call,
+		nua_handle_t * const nh)
+{/*{{{*/
+	unsigned int const b = svd_call_bucket (svd, nh);
+
+	call->nh = nh;
+	call->hash_next = svd->call_hash[b];
+	svd->call_hash[b] = call;
+}/*}}}*/
+
+/**
+ * Free the call with everything it allocated.
+ *
+ * \param[in] svd 		routine context structure.
+ * \param[in] call 		call without channels.
+ * \remark
+ * 		The arena usage is added to svd->call_mem, the handle is not
+ * 		destroyed here.
+ */
+void
+svd_call_free (svd_t * const svd, svd_call_t * const call)
+{/*{{{*/
+	struct call_mem_stat_s * const ms = &svd->call_mem;
+	unsigned long allocs;
+	unsigned long bytes;
+	svd_call_t ** cp;
+
+	if(call->nh){
+		cp = &svd->call_hash[svd_call_bucket(svd, call->nh)];
+		while(*cp && *cp != call){
+			cp = &(*cp)->hash_next;
+		}
+		if(*cp){
+			*cp = call->hash_next;
+		}
+	}
+
+	svd_call_mem (call, &allocs, &bytes);
+	ms->calls++;
+	ms->allocs += allocs;
+	ms->bytes += bytes;
+	if(allocs > ms->max_allocs){
+		ms->max_allocs = allocs;
+	}
+	if(bytes > ms->max_bytes){
+		ms->max_bytes = bytes;
+	}
+	su_home_unref (call->home);
+}/*}}}*/
+
+/**
+ * Get the call arena usage.
+ *
+ * \param[in] call 		call.
+ * \param[out] allocs 	allocations since the call creation.
+ * \param[out] bytes 	bytes allocated since the call creation.
+ */
+void
+svd_call_mem (svd_call_t * const call, unsigned long * const allocs,
+		unsigned long * const bytes)
+{/*{{{*/
+	su_home_stat_t hs;
+
+	memset(&hs, 0, sizeof(hs));
+	su_home_get_stats (call->home, 0, &hs, sizeof(hs));
+	*allocs = hs.hs_allocs.hsa_number;
+	*bytes = hs.hs_allocs.hsa_bytes;
+}/*}}}*/
+
+/**
+ * Record the rejected call and free it.
+ *
+ * \param[in] svd 		routine context structure.
+ * \param[in] call 		incoming call without channels.
+ * \param[in] status 	final SIP status sent to the caller.
+ * \remark
+ * 		The record has no channel (chan is 0), the handle is not
+ * 		destroyed here.
+ */
+void
+svd_call_reject (svd_t * const svd, svd_call_t * const call,
+		int const status)
+{/*{{{*/
+	call->status = status;
+	if(svd_cdr_on()){
+		svd_call_cdr (svd, NULL, call);
+	}
+	svd_call_free (svd, call);
+}/*}}}*/
+
+/**
+ * Queue the call detail record of the finished call.
+ *
+ * \param[in] svd 		routine context structure.
+ * \param[in] chan_ctx 	last channel of the call or NULL if the call
+ * 		had no channels.
+ * \param[in] call 		call to record.
+ * \remark
+ * 		The media statistics are the last ones of the channel, they are
+ * 		refreshed when the media is switched off.
+ */
+static void
+svd_call_cdr (svd_t const * const svd, svd_chan_t const * const chan_ctx,
+		svd_call_t const * const call)
+{/*{{{*/
+	struct cdr_rec_s rec;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.chan = chan_ctx ? chan_ctx->chan_idx + 1 : 0;
+	rec.dir = call->outgoing ? cdr_dir_OUT : cdr_dir_IN;
+	rec.media = call->media;
+	rec.adopted = call->adopted;
+	rec.status = call->status;
+	rec.start_us = call->start_us;
+	rec.answer_us = call->answer_us;
+	rec.end_us = svd_cdr_now ();
+	if(call->account){
+		snprintf(rec.account, sizeof(rec.account), "%s", call->account->name);
+	}
+	if(call->remote_sip){
+		snprintf(rec.remote, sizeof(rec.remote), "%s", call->remote_sip);
+	}
+	if(call->call_id){
+		snprintf(rec.call_id, sizeof(rec.call_id), "%s", call->call_id);
+	}
+	if( !chan_ctx){
+		svd_cdr_put (&rec);
+		return;
+	}
+	snprintf(rec.codec, sizeof(rec.codec), "%s", chan_ctx->sdp_cod_name);
+	if(call->media){
+		ab_chan_t const * const chan = &svd->ab->chans[chan_ctx->chan_idx];
+		struct ab_chan_jb_stat_s const * const jb = &chan->statistics.jb_stat;
+		struct ab_chan_rtcp_stat_s const * const rtcp =
+				&chan->statistics.rtcp_stat;
+
+		rec.jb_packets = jb->nPackets;
+		rec.jb_invalid = jb->nInvalid;
+		rec.jb_late = jb->nLate;
+		rec.jb_early = jb->nEarly;
+		rec.jb_resync = jb->nResync;
+		rec.jb_max_delay = jb->nMaxPODelay;
+		rec.rtcp_psent = rtcp->psent;
+		rec.rtcp_osent = rtcp->osent;
+		rec.rtcp_lost = rtcp->lost;
+		rec.rtcp_jitter = rtcp->jitter;
+		rec.rtcp_fraction = rtcp->fraction;
+	}
+	svd_cdr_put (&rec);
+}/*}}}*/
+
+/**
+ * Get the first channel bound to the NUA handle.
+ *
+ * \param[in] svd 	routine context structure.
+ * \param[in] nh 	NUA handle.
+ * \return
+ * 		channel context or NULL if no channel is bound to nh.
+ */
+svd_chan_t *
+svd_nh_chan (svd_t const * const svd, nua_handle_t const * const nh)
+{/*{{{*/
+	svd_call_t * call = svd_call_find (svd, nh);
+	return call ? call->chans : NULL;
+}/*}}}*/
+
+/**
+ * Get the next channel bound to the same NUA handle.
+ *
+ * \param[in] chan_ctx 	channel got from \ref svd_nh_chan() or this function.
+ * \return
+ * 		channel context or NULL if there is no more.
+ */
+svd_chan_t *
+svd_nh_chan_next (svd_chan_t const * const chan_ctx)
+{/*{{{*/
+	return chan_ctx->call_next;
 }/*}}}*/
 
 /**
@@ -366,6 +814,9 @@ DFE
  * \sa ab_chan_media_deactivate().
  * \remark
  * 		It also tuning RTP modes and WLEC according to channel parameters.
+ * 		If the codecs, payloads and parameters are the same as on the
+ * 		previous activation, the DSP channel is still tuned with them and
+ * 		only WLEC is switched on again (deactivation switches it off).
  */
 int
 ab_chan_media_activate ( ab_chan_t * const chan )
@@ -373,6 +824,7 @@ ab_chan_media_activate ( ab_chan_t * const chan )
 	int err;
 	jb_prms_t * jbp = NULL;
 	svd_chan_t * ctx = chan->ctx;
+	struct media_cache_s * mc = &ctx->media_cache;
 
 	err = svd_prepare_chan_codecs (chan, &jbp);
 	if(err){
@@ -381,35 +833,61 @@ ab_chan_media_activate ( ab_chan_t * const chan )
 		goto __exit;
 	}
 
+	if(mc->valid &&
+			!memcmp(&mc->vcod, &ctx->vcod, sizeof(mc->vcod)) &&
+			!memcmp(&mc->fcod, &ctx->fcod, sizeof(mc->fcod)) &&
+			mc->te_payload == ctx->te_payload &&
+			!memcmp(&mc->jb, jbp, sizeof(mc->jb)) &&
+			!memcmp(&mc->rtpp, &g_conf.audio_prms[chan->abs_idx],
+					sizeof(mc->rtpp))){
+		/* DSP channel is tuned already */
+		mc->fast++;
+		goto __wlec;
+	}
+	mc->valid = 0;
+	mc->full++;
+
 	/* RTP */
 	err = ab_chan_media_rtp_tune (chan, &ctx->vcod, &ctx->fcod,
 			&g_conf.audio_prms[chan->abs_idx], ctx->te_payload);
 	if(err){
-		SU_DEBUG_1(("Media_tune error : %s",ab_g_err_str));
+		SU_DEBUG_1(("Media_tune error : %s",ab_err_str()));
 		goto __exit;
 	}
 
 	/* Jitter Buffer */
 	err = ab_chan_media_jb_tune (chan, jbp);
 	if(err){
-		SU_DEBUG_1(("JB_tune error : %s",ab_g_err_str));
+		SU_DEBUG_1(("JB_tune error : %s",ab_err_str()));
 		goto __exit;
 	}
 
+	/* remember the tuning for the next call */
+	memcpy(&mc->vcod, &ctx->vcod, sizeof(mc->vcod));
+	memcpy(&mc->fcod, &ctx->fcod, sizeof(mc->fcod));
+	mc->te_payload = ctx->te_payload;
+	memcpy(&mc->jb, jbp, sizeof(mc->jb));
+	memcpy(&mc->rtpp, &g_conf.audio_prms[chan->abs_idx], sizeof(mc->rtpp));
+	mc->valid = 1;
+
+__wlec:
 	/* WLEC */
 	err = ab_chan_media_wlec_tune(chan, &g_conf.wlec_prms[chan->abs_idx]);
 	if (err) {
-		SU_DEBUG_1(("WLEC activate error : %s",ab_g_err_str));
+		SU_DEBUG_1(("WLEC activate error : %s",ab_err_str()));
 		goto __exit;
 	}
 
 	err = ab_chan_media_switch (chan, 1);
 	if(err){
-		SU_DEBUG_1(("Media activate error : %s",ab_g_err_str));
+		SU_DEBUG_1(("Media activate error : %s",ab_err_str()));
+		mc->valid = 0;
 		goto __exit;
 	}
 
 __exit:
+	svd_flight_put (flight_type_MEDIA_ON, chan->abs_idx, ctx->sdp_payload,
+			err, ctx->op_handle);
 	return err;
 }/*}}}*/
 
@@ -419,17 +897,19 @@ __exit:
  * 		\retval 0 	if etherything ok.
  * \sa ab_chan_media_activate().
  * \remark
- * 		It also tuning RTP modes and WLEC according to channel parameters.
+ * 		It stops the coder and switches WLEC off, RTP and JB tuning stays
+ * 		on the DSP channel for the next call.
  */
 int
 ab_chan_media_deactivate ( ab_chan_t * const chan )
 {/*{{{*/
-	int err;
 	wlec_t wc;
+	int err;
 
 	err = ab_chan_media_switch (chan, 0);
 	if(err){
-		SU_DEBUG_1(("Media deactivate error : %s",ab_g_err_str));
+		SU_DEBUG_1(("Media deactivate error : %s",ab_err_str()));
+		((svd_chan_t *)chan->ctx)->media_cache.valid = 0;
 		goto __exit;
 	}
 
@@ -438,10 +918,12 @@ ab_chan_media_deactivate ( ab_chan_t * const chan )
 	wc.mode = wlec_mode_OFF;
 	err = ab_chan_media_wlec_tune(chan, &wc);
 	if (err) {
-		SU_DEBUG_1(("WLEC deactivate error : %s",ab_g_err_str));
+		SU_DEBUG_1(("WLEC deactivate error : %s",ab_err_str()));
 		goto __exit;
 	}
 __exit:
+	svd_flight_put (flight_type_MEDIA_OFF, chan->abs_idx, 0, err,
+			((svd_chan_t *)chan->ctx)->op_handle);
 	return err;
 }/*}}}*/
 
@@ -524,10 +1006,89 @@ int svd_set_cid( ab_chan_t * const chan, const char *cid)
 	SU_DEBUG_9(("Channel %d, mapped caller id standard: %s to: %d\n",chan->abs_idx, cid, standard));
 	int err=ab_chan_cid_standard(chan, standard);
 	if (err)
-	  SU_DEBUG_9(("%s\n",ab_g_err_str));
+	  SU_DEBUG_9(("%s\n",ab_err_str()));
 	return err;
 }
 
+/**
+ * Apply the reloaded channel config if the channel is idle.
+ *
+ * \param[in] svd 		svd context structure.
+ * \param[in,out] chan 	channel to operate on it.
+ * \retval 0 	nothing waits.
+ * \retval 1 	channel (or other channel of its device) is busy, config
+ * 		still waits.
+ * \remark
+ * 		Caller id standard is set when the channel is on hook without the
+ * 		call (\ref svd_clear_call() calls it again). The tone table is per
+ * 		device, the compiled tones are programmed once when all the device
+ * 		channels are idle.
+ */
+int
+svd_chan_conf_idle (svd_t * const svd, ab_chan_t * const chan)
+{/*{{{*/
+	svd_chan_t * ctx = chan->ctx;
+
+	if( !ctx->conf_pending && !ctx->tones_pending){
+		return 0;
+	}
+	if(ctx->off_hook || ctx->call){
+		return 1;
+	}
+	if(ctx->conf_pending && g_conf.chan_cid[ctx->chan_idx]) {
+		SU_DEBUG_2(("Setting caller id standard for channel %d to %s\n",
+				ctx->chan_idx+1, g_conf.chan_cid[ctx->chan_idx]));
+		if (svd_set_cid(chan, g_conf.chan_cid[ctx->chan_idx])) {
+			SU_DEBUG_0(("Invalid caller id %s\n",
+					g_conf.chan_cid[ctx->chan_idx]));
+		}
+	}
+	ctx->conf_pending = 0;
+	if(ctx->tones_pending){
+		/* waits if other channel of the device is busy */
+		return svd_dev_tones_idle (svd, chan->parent);
+	}
+	return 0;
+}/*}}}*/
+
+/**
+ * Program the tones to the device if all its channels are idle.
+ *
+ * \param[in] svd 		svd context structure.
+ * \param[in] dev 		device of the channels.
+ * \retval 0 	tones are programmed (or nothing waits).
+ * \retval 1 	some channel of the device is busy.
+ * \remark
+ * 		The pending flag of all the device channels is cleared.
+ */
+static int
+svd_dev_tones_idle (svd_t * const svd, ab_dev_t * const dev)
+{/*{{{*/
+	int i;
+	int t;
+
+	for (i=0; i<svd->ab->chans_num; i++){
+		ab_chan_t * chan = &svd->ab->chans[i];
+		svd_chan_t * ctx = chan->ctx;
+		if(chan->parent == dev && (ctx->off_hook || ctx->call)){
+			return 1;
+		}
+	}
+	for (t=ab_chan_tone_DIAL; t<ab_chan_tone_COUNT; t++){
+		if(ab_dev_set_tone (dev, t, &g_conf.tones[t])){
+			SU_DEBUG_1 (("Device %d tone %d: %s\n", dev->idx, t,
+					ab_err_str()));
+		}
+	}
+	for (i=0; i<svd->ab->chans_num; i++){
+		ab_chan_t * chan = &svd->ab->chans[i];
+		if(chan->parent == dev){
+			((svd_chan_t *)chan->ctx)->tones_pending = 0;
+		}
+	}
+	return 0;
+}/*}}}*/
+
 /**
  * \param[in] ct codec type.
  * \param[in] cn codec sdp name.
@@ -593,6 +1154,13 @@ __exit_fail:
  * \param[in] user_data 	device on witch event occures.
  * 		\retval -1	if somthing nasty happens.
  * 		\retval 0 	if etherything ok.
+ * \remark
+ * 		All pending events are got in batches of \ref ATAB_EVT_BATCH and
+ * 		dispatched through \ref atab_evt_handler. The handler failure
+ * 		does not drop the rest of the already got events. On TAPI the
+ * 		batch is still one ioctl per event (see ab_dev_event_get_batch()),
+ * 		"get_events" shows the backend calls as "gets". Per event logs are
+ * 		compiled in with the tracing only (\c SVD_TRACE).
  * \todo
  * 		In ideal world it should be reenterable or mutexes should be used.
  */
@@ -601,71 +1169,86 @@ svd_atab_handler (svd_t * svd, su_wait_t * w, su_wakeup_arg_t * user_data)
 {/*{{{*/
 DFS
 	ab_dev_t * ab_dev = (ab_dev_t *) user_data;
-	ab_dev_event_t evt;
-	unsigned char chan_av;
+	ab_dev_event_t evts [ATAB_EVT_BATCH];
+	unsigned char chans_av [ATAB_EVT_BATCH];
+	struct atab_evt_stat_s * st;
+	enum ab_dev_event_e id;
+	unsigned long long start;
+	unsigned long dur;
+	int dev_idx = ab_dev->idx - 1;
 	int chan_idx;
-	int dev_idx;
+	int evts_n;
+	int failed = 0;
 	int err;
+	int i;
 
 do{
-	memset(&evt, 0, sizeof(evt));
-
-	err = ab_dev_event_get( ab_dev, &evt, &chan_av );
-	if( err ){
-		SU_DEBUG_1 ((LOG_FNC_A (ab_g_err_str) ));
+	evts_n = ab_dev_event_get_batch (ab_dev, evts, chans_av, ATAB_EVT_BATCH);
+	if(evts_n < 0){
+		SU_DEBUG_1 ((LOG_FNC_A (ab_err_str()) ));
 		goto __exit_fail;
+	} else if( !evts_n){
+		break;
+	}
+	g_evt_stats.batches++;
+	if(evts_n > g_evt_stats.batch_max){
+		g_evt_stats.batch_max = evts_n;
+	}
+#ifdef SVD_TRACE
+	if(evts_n > 1){
+		SU_DEBUG_8 (("Got %d events in one time: on [%d]\n",
+				evts_n, dev_idx ));
 	}
+#endif
+
+	for (i=0; i<evts_n; i++){
+		ab_dev_event_t const * evt = &evts[i];
+		if (chans_av[i]){
+			/* in evt.ch we have proper number of the chan */
+			chan_idx = dev_idx * svd->ab->chans_per_dev + evt->ch;
+		} else {
+			/* in evt.ch we do not have proper number of the chan because
+			 * the event is the device event - not the chan event
+			 */
+			chan_idx = dev_idx * svd->ab->chans_per_dev;
+		}
+		svd_flight_put (flight_type_ATAB, chan_idx, evt->id, evt->data, NULL);
+		if(svd_rec_on()){
+			svd_rec_evt (chan_idx, dev_idx, evt, chans_av[i]);
+		}
+
+		id = evt->id;
+		if((unsigned)id >= ab_dev_event_COUNT){
+			id = ab_dev_event_UNCATCHED;
+		}
+#ifdef SVD_TRACE
+		SU_DEBUG_8 (("Got %s event: 0x%lX on [%d/%d]\n",
+				atab_evt_name[id], evt->data, dev_idx, evt->ch ));
+#endif
 
-	dev_idx = ab_dev->idx - 1;
-	if (chan_av){
-		/* in evt.ch we have proper number of the chan */
-		chan_idx = dev_idx * svd->ab->chans_per_dev + evt.ch;
-	} else {
-		/* in evt.ch we do not have proper number of the chan because
-		 * the event is the device event - not the chan event
-		 */
-		chan_idx = dev_idx * svd->ab->chans_per_dev;
-	}
-
-	if        (evt.id == ab_dev_event_FXS_OFFHOOK){
-		SU_DEBUG_8 (("Got fxs offhook event: 0x%lX on [%d/%d]\n",
-				evt.data, dev_idx,evt.ch ));
-		err = svd_handle_event_FXS_OFFHOOK(svd, chan_idx);
-	} else if(evt.id == ab_dev_event_FXS_ONHOOK){
-		SU_DEBUG_8 (("Got fxs onhook event: 0x%lX on [%d/%d]\n",
-				evt.data, dev_idx,evt.ch ));
-		err = svd_handle_event_FXS_ONHOOK(svd, chan_idx);
-	} else if(evt.id == ab_dev_event_FXS_DIGIT_TONE ||
-			  evt.id == ab_dev_event_FXS_DIGIT_PULSE){
-		err = svd_handle_event_FXS_DIGIT_X(svd, chan_idx, evt.data);
-	} else if(evt.id == ab_dev_event_FXO_RINGING){
-		/* shouldn't happen */
-		SU_DEBUG_8 (("Got fxo ringing event: 0x%lX on [%d/%d]\n",
-				evt.data, dev_idx,evt.ch ));
 		err = 0;
-	} else if(evt.id == ab_dev_event_FM_CED){
-		SU_DEBUG_8 (("Got CED event: 0x%lX on [%d/%d]\n",
-				evt.data, dev_idx,evt.ch ));
-		err = svd_handle_event_FM_CED (svd, chan_idx, evt.data);
-	} else if(evt.id == ab_dev_event_COD){
-		SU_DEBUG_8 (("Got coder event: 0x%lX on [%d/%d]\n",
-				evt.data,dev_idx,evt.ch ));
-	} else if(evt.id == ab_dev_event_TONE){
-		SU_DEBUG_8 (("Got tone event: 0x%lX on [%d/%d]\n",
-				evt.data,dev_idx,evt.ch ));
-	} else if(evt.id == ab_dev_event_UNCATCHED){
-		SU_DEBUG_8 (("Got unknown event : 0x%lX on [%d/%d]\n",
-				evt.data, dev_idx,evt.ch ));
-	}
-	if(evt.more){
-		SU_DEBUG_8 (("Got more then one event in one time: on [%d/%d]\n",
-				dev_idx,evt.ch ));
+		start = svd_loop_now ();
+		if(atab_evt_handler[id]){
+			err = atab_evt_handler[id](svd, chan_idx, evt->data);
+		}
+		dur = svd_loop_now () - start;
+
+		st = &g_evt_stats.evt[id];
+		st->n++;
+		st->sum_us += dur;
+		if(dur > st->max_us){
+			st->max_us = dur;
+		}
+		if(err){
+			st->errors++;
+			failed = 1;
+		}
 	}
-	if (err){
+} while(evts[evts_n-1].more);
+
+	if(failed){
 		goto __exit_fail;
 	}
-} while(evt.more);
-
 DFE
 	return 0;
 __exit_fail:
@@ -673,37 +1256,68 @@ DFE
 	return -1;
 }/*}}}*/
 
+/**
+ * \return 	board events statistics since start.
+ */
+struct atab_evt_stats_s const *
+svd_atab_evt_stats (void)
+{/*{{{*/
+	return &g_evt_stats;
+}/*}}}*/
+
+/**
+ * Timed wrapper of \ref svd_atab_handler.
+ *
+ * \param[in] svd 			svd context structure.
+ * \param[in] w 			wait object, that emits.
+ * \param[in] user_data 	device on witch event occures.
+ * \return 	handler return value.
+ */
+static int
+svd_atab_handler_timed (svd_t * svd, su_wait_t * w, su_wakeup_arg_t * user_data)
+{/*{{{*/
+	unsigned long long loop_start;
+	int ret;
+
+	loop_start = svd_loop_enter (loop_cb_ATAB, 0);
+	ret = svd_atab_handler (svd, w, user_data);
+	svd_loop_leave (loop_cb_ATAB, loop_start);
+	return ret;
+}/*}}}*/
+
 /**
  * \param[in] svd 		svd context structure.
  * \param[in] chan_idx 	channel on which event occures.
+ * \param[in] data 		event data (not used).
  * 		\retval -1	if somthing nasty happens.
  * 		\retval 0 	if etherything ok.
  */
 static int
-svd_handle_event_FXS_OFFHOOK( svd_t * const svd, int const chan_idx )
+svd_handle_event_FXS_OFFHOOK( svd_t * const svd, int const chan_idx,
+		long const data )
 {/*{{{*/
 	ab_chan_t * ab_chan = &svd->ab->chans[chan_idx];
 	svd_chan_t * chan_ctx = ab_chan->ctx;
 	int call_answered;
 	int err;
-	int i;
 DFS
 	chan_ctx->off_hook = 1;
+	svd_lat_mark (&chan_ctx->lat, lat_mark_OFFHOOK);
 	/* stop ringing all lines that were ringing for this call*/
 	if (chan_ctx->op_handle) {
-		for (i=0; i<g_conf.channels; i++) {
-			ab_chan_t * chan = &svd->ab->chans[i];
-			svd_chan_t * ctx = chan->ctx;
-			if (chan_ctx->op_handle == ctx->op_handle)
-			    ab_FXS_line_ring(chan, ab_chan_ring_MUTE, NULL, NULL);
+		svd_chan_t * ctx = svd_nh_chan (svd, chan_ctx->op_handle);
+		while (ctx) {
+			ab_chan_t * chan = &svd->ab->chans[ctx->chan_idx];
+			svd_chan_t * next = svd_nh_chan_next (ctx);
+			ab_FXS_line_ring(chan, ab_chan_ring_MUTE, NULL, NULL);
 			/* remove association with this call if it's not this line answering */
 			if (chan_idx != ctx->chan_idx) {
-			    ctx->op_handle = NULL;
+			    svd_call_unbind (svd, ctx);
 			    if (g_conf.chan_led[ctx->chan_idx])
 				led_off(g_conf.chan_led[ctx->chan_idx]);
 			    svd_clear_call(svd, chan);
 			}
-		    
+			ctx = next;
 		}
 	}
 	
@@ -730,6 +1344,8 @@ DFS
 	err = ab_FXS_line_tone (ab_chan, ab_chan_tone_DIAL);
 	if(err){
 		SU_DEBUG_2(("can`t play dialtone on [%02d]\n",ab_chan->abs_idx));
+	} else {
+		svd_lat_mark (&chan_ctx->lat, lat_mark_DIALTONE);
 	}
 	SU_DEBUG_8(("play dialtone on [%02d]\n",ab_chan->abs_idx));
 __exit_success:
@@ -743,11 +1359,13 @@ DFE
 /**
  * \param[in] svd 		svd context structure.
  * \param[in] chan_idx 	channel on which event occures.
+ * \param[in] data 		event data (not used).
  * 		\retval -1	if somthing nasty happens.
  * 		\retval 0 	if etherything ok.
  */
 static int
-svd_handle_event_FXS_ONHOOK( svd_t * const svd, int const chan_idx )
+svd_handle_event_FXS_ONHOOK( svd_t * const svd, int const chan_idx,
+		long const data )
 {/*{{{*/
 	ab_chan_t * ab_chan = &svd->ab->chans[chan_idx];
 	svd_chan_t * chan_ctx = ab_chan->ctx;
@@ -814,7 +1432,7 @@ DFS
 
 	if( chan_ctx->op_handle ){
 		/* already connected, send dtmf info (rfc2976) if account configured for that */
-		if (chan_ctx->account->dtmf == dtmf_info) {
+		if (chan_ctx->call->account->dtmf == dtmf_info) {
 			int tone = (data >> 8);
 			char pd[INFO_STR_LENGTH];
 
@@ -867,7 +1485,7 @@ DFS
 		err = ab_chan_fax_pass_through_start (ab_chan);
 		if( err){
 			SU_DEBUG_3(("can`t start fax_pass_through on [%02d]: %s\n",
-					ab_chan->abs_idx, ab_g_err_str));
+					ab_chan->abs_idx, ab_err_str()));
 			goto __exit_fail;
 		} else {
 			SU_DEBUG_3(("fax_pass_through started on [%02d]\n",
@@ -898,6 +1516,17 @@ DFS
 
 	chans_num = svd->ab->chans_num;
 	g_conf.channels = chans_num;
+
+	/* handle hash, 2 buckets per channel at least */
+	svd->call_mask = 3;
+	while (svd->call_mask + 1 < 2 * chans_num){
+		svd->call_mask = (svd->call_mask << 1) | 1;
+	}
+	svd->call_hash = calloc(svd->call_mask + 1, sizeof(*svd->call_hash));
+	if( !svd->call_hash){
+		SU_DEBUG_0 ((LOG_FNC_A (LOG_NOMEM_A("svd->call_hash") ) ));
+		goto __exit_fail;
+	}
 	for (i=0; i<chans_num; i++){
 		ab_chan_t * curr_chan;
 		svd_chan_t * chan_ctx;
@@ -911,30 +1540,29 @@ DFS
 		memset (chan_ctx, 0, sizeof(*chan_ctx));
 		chan_ctx->chan_idx = i;
 
-		/* setup tones */
-		if (g_conf.dial_tone)
-			ab_FXS_set_tone(curr_chan, ab_chan_tone_DIAL, g_conf.dial_tone);
-		if (g_conf.busy_tone)
-			ab_FXS_set_tone(curr_chan, ab_chan_tone_BUSY, g_conf.busy_tone);
-		if (g_conf.ring_tone)
-			ab_FXS_set_tone(curr_chan, ab_chan_tone_RINGBACK, g_conf.ring_tone);
-
 	 	/* SDP */
 		chan_ctx->rtp_sfd = -1;
-		chan_ctx->remote_host = NULL;
 
 		/* MEDIA REGISTER */
 		svd_media_register (svd, curr_chan);
 
 	 	/* HANDLE */
 		chan_ctx->op_handle = NULL;
+		chan_ctx->call = NULL;
+		chan_ctx->call_next = NULL;
+		chan_ctx->conf_pending = 0;
 
 		/* ALL OTHER */
-		chan_ctx->dtmf_tmr = su_timer_create(su_root_task(svd->root), 4000);
+		chan_ctx->dtmf_tmr = su_timer_create(su_root_task(svd->root),
+				DTMF_TIMEOUT_MS);
 		if( !chan_ctx->dtmf_tmr){
 			SU_DEBUG_1 (( LOG_FNC_A ("su_timer_create() dtmf fails" ) ));
 		}
 		svd_clear_call (svd, curr_chan);
+
+		/* tones and caller id wait for \ref svd_chans_conf_cb */
+		chan_ctx->conf_pending = 1;
+		chan_ctx->tones_pending = 1;
 	}
 DFE
 	return 0;
@@ -943,6 +1571,31 @@ DFE
 	return -1;
 }/*}}}*/
 
+/**
+ * Set the channels tones and caller id after the first loop round.
+ *
+ * \param[in] magic	svd pointer.
+ * \param[in] t		initiator timer (NULL if called directly).
+ * \param[in] arg	not used.
+ * \remark
+ * 		The first round sends the registrations queued in svd_create().
+ * 		Busy channels (adopted calls) get the config on svd_clear_call().
+ */
+static void
+svd_chans_conf_cb (su_root_magic_t * magic, su_timer_t * t,
+		su_timer_arg_t * arg)
+{/*{{{*/
+	svd_t * svd = magic;
+	int i;
+DFS
+	svd_boot_begin (boot_phase_CHANS_CONF);
+	for (i=0; i<svd->ab->chans_num; i++){
+		svd_chan_conf_idle (svd, &svd->ab->chans[i]);
+	}
+	svd_boot_end (boot_phase_CHANS_CONF);
+DFE
+}/*}}}*/
+
 /**
  * \param[in] svd	svd context structure to attach callbacks on ab->devs.
  * 		\retval -1	if somthing nasty happens.
@@ -966,7 +1619,8 @@ DFS
 			goto __exit_fail;
 		}
 
-		err = su_root_register( svd->root, wait, svd_atab_handler, curr_dev, 0);
+		err = su_root_register( svd->root, wait, svd_atab_handler_timed,
+				curr_dev, 0);
 		if (err == -1){
 			SU_DEBUG_0 ((LOG_FNC_A ("su_root_register() fails" ) ));
 			goto __exit_fail;
@@ -990,7 +1644,11 @@ dtmf_timer_cb (su_root_magic_t *magic, su_timer_t *t, su_timer_arg_t *arg)
 {/*{{{*/
 	svd_t * svd = magic;
 	svd_chan_t * chan_ctx = arg;
+	unsigned long long loop_start;
+
+	loop_start = svd_loop_enter (loop_cb_DTMF_TMR, chan_ctx->dtmf_due);
 	svd_handle_digit(svd, chan_ctx->chan_idx, PLACE_CALL_MARKER);
+	svd_loop_leave (loop_cb_DTMF_TMR, loop_start);
 }/*}}}*/
 
 /**
@@ -1009,10 +1667,12 @@ svd_handle_digit( svd_t * const svd, int const chan_idx, long const digit )
 	int err = 0;
 DFS
 	if (digit != PLACE_CALL_MARKER){
+		svd_lat_mark (&chan_ctx->lat, lat_mark_LAST_DIGIT);
 		/* put input digits to buffer */
 		chan_ctx->dial_status.digits[ *net_idx ] = digit;
 		++(*net_idx);
 		/* start timer */
+		chan_ctx->dtmf_due = svd_loop_now() + DTMF_TIMEOUT_MS * 1000ULL;
 		err = su_timer_set(chan_ctx->dtmf_tmr, dtmf_timer_cb, chan_ctx);
 		if (err){
 			SU_DEBUG_2 (("su_timer_set ERROR on [%02d] : %d (dtmf_tmr)\n",
@@ -1061,32 +1721,26 @@ svd_media_tapi_handle_local_data (su_root_magic_t * root, su_wait_t * w,
 {/*{{{*/
 	ab_chan_t * chan = user_data;
 	svd_chan_t * chan_ctx = chan->ctx;
-	struct sockaddr_in target_sock_addr;
+	svd_call_t * call = chan_ctx->call;
 	unsigned char buf [BUFF_PER_RTP_PACK_SIZE];
 	int rode;
 	int sent;
 
-	if (chan_ctx->remote_port == 0 ||
-			chan_ctx->remote_host == NULL){
+	/* the address is resolved once per remote SDP */
+	if (call == NULL || call->remote_addr_len == 0){
 		rode = read(chan->rtp_fd, buf, sizeof(buf));
 		SU_DEBUG_2(("HLD:%d|",rode));
 		goto __exit_success;
 	}
 
-	memset(&target_sock_addr, 0, sizeof(target_sock_addr));
-
-	target_sock_addr.sin_family = AF_INET;
-	target_sock_addr.sin_port = htons(chan_ctx->remote_port);
-	inet_aton (chan_ctx->remote_host, &target_sock_addr.sin_addr);
-	rode = read(chan->rtp_fd, buf, sizeof(buf));
+	rode = svd_relay_to_net (chan->rtp_fd, chan_ctx->rtp_sfd,
+			(struct sockaddr *)&call->remote_addr, call->remote_addr_len,
+			buf, sizeof(buf), &sent);
 
 	if (rode == 0){
 		SU_DEBUG_2 ((LOG_FNC_A("wrong event")));
 		goto __exit_fail;
 	} else if(rode > 0){
-		// should not block
-		sent = sendto(chan_ctx->rtp_sfd, buf, rode, 0,
-				(struct sockaddr *)&target_sock_addr, sizeof(target_sock_addr));
 		if (sent == -1){
 			SU_DEBUG_2 (("HLD() ERROR : sent() : %d(%s)\n",
 					errno, strerror(errno)));
@@ -1097,6 +1751,12 @@ svd_media_tapi_handle_local_data (su_root_magic_t * root, su_wait_t * w,
 					rode, sent));
 			goto __exit_fail;
 		}
+		if( !chan_ctx->lat.t[lat_mark_FIRST_RTP]){
+			svd_lat_mark (&chan_ctx->lat, lat_mark_FIRST_RTP);
+		}
+		if(svd_rec_on()){
+			svd_rec_rtp (chan_ctx->chan_idx, rec_rtp_dir_TX, buf, rode);
+		}
 	} else {
 		SU_DEBUG_2 (("HLD() ERROR : read() : %d(%s)\n",
 				errno, strerror(errno)));
@@ -1127,14 +1787,13 @@ svd_media_tapi_handle_remote_data (su_root_magic_t * root, su_wait_t * w,
 
 	assert( chan_ctx->rtp_sfd != -1 );
 
-	received = recv(chan_ctx->rtp_sfd, buf, sizeof(buf), 0);
+	received = svd_relay_to_board (chan_ctx->rtp_sfd, chan->rtp_fd,
+			buf, sizeof(buf), &writed);
 
 	if (received == 0){
 		SU_DEBUG_2 ((LOG_FNC_A("wrong event")));
 		goto __exit_fail;
 	} else if (received > 0){
-		/* should not block */
-		writed = write(chan->rtp_fd, buf, received);
 		if (writed == -1){
 			SU_DEBUG_2 (("HRD() ERROR: write() : %d(%s)\n",
 					errno, strerror(errno)));
@@ -1145,6 +1804,10 @@ svd_media_tapi_handle_remote_data (su_root_magic_t * root, su_wait_t * w,
 					received, writed));
 			goto __exit_fail;
 		}
+		chan_ctx->rtp_rx++;
+		if(svd_rec_on()){
+			svd_rec_rtp (chan_ctx->chan_idx, rec_rtp_dir_RX, buf, received);
+		}
 	} else {
 		SU_DEBUG_2 (("HRD() ERROR : recv() : %d(%s)\n",
 				errno, strerror(errno)));
@@ -1155,6 +1818,48 @@ __exit_fail:
 	return -1;
 }/*}}}*/
 
+/**
+ * Timed wrapper of \ref svd_media_tapi_handle_local_data.
+ *
+ * \param[in] 	root 		root object that contain wait object.
+ * \param[in] 	w			wait object that emits.
+ * \param[in] 	user_data	channel that gives RTP data.
+ * \return 	handler return value.
+ */
+static int
+svd_media_tapi_local_timed (su_root_magic_t * root, su_wait_t * w,
+		su_wakeup_arg_t * user_data)
+{/*{{{*/
+	unsigned long long loop_start;
+	int ret;
+
+	loop_start = svd_loop_enter (loop_cb_MEDIA_LOCAL, 0);
+	ret = svd_media_tapi_handle_local_data (root, w, user_data);
+	svd_loop_leave (loop_cb_MEDIA_LOCAL, loop_start);
+	return ret;
+}/*}}}*/
+
+/**
+ * Timed wrapper of \ref svd_media_tapi_handle_remote_data.
+ *
+ * \param[in] 		root 		root object that contain wait object.
+ * \param[in] 		w			wait object that emits.
+ * \param[in,out]	user_data	channel that receives RTP data from socket.
+ * \return 	handler return value.
+ */
+static int
+svd_media_tapi_remote_timed (su_root_magic_t * root, su_wait_t * w,
+		su_wakeup_arg_t * user_data)
+{/*{{{*/
+	unsigned long long loop_start;
+	int ret;
+
+	loop_start = svd_loop_enter (loop_cb_MEDIA_REMOTE, 0);
+	ret = svd_media_tapi_handle_remote_data (root, w, user_data);
+	svd_loop_leave (loop_cb_MEDIA_REMOTE, loop_start);
+	return ret;
+}/*}}}*/
+
 /**
  * \param[in,out] chan_ctx 	channel context on which open socket, and set
  * 		socket parameters.
@@ -1169,16 +1874,19 @@ svd_media_tapi_open_rtp (svd_chan_t * const chan_ctx)
 {/*{{{*/
 	int i;
 	long ports_count;
-	struct sockaddr_in my_addr;
+	struct sockaddr_storage my_addr;
+	socklen_t my_addr_len;
 #ifndef DONT_BIND_TO_DEVICE
 	struct ifreq ifr;
 #endif
 	int sock_fd;
+	int af;
 	int rtp_binded = 0;
 	int err;
 	int tos = 0;
 DFS
-	sock_fd = socket(AF_INET, SOCK_DGRAM, 0);
+	/* dual-stack socket takes IPv4 peers as mapped addresses */
+	sock_fd = svd_addr_socket (&af);
 	if (sock_fd == -1) {
 		SU_DEBUG_1 (("OPEN_RTP() ERROR : socket() : %d(%s)\n",
 				errno, strerror(errno)));
@@ -1188,14 +1896,17 @@ DFS
 	//tos = g_conf.rtp_tos & IPTOS_TOS_MASK;
 	tos = g_conf.rtp_tos & 0xFF;
 	err = setsockopt(sock_fd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos));
+	if( !err && af == AF_INET6){
+		err = setsockopt(sock_fd, IPPROTO_IPV6, IPV6_TCLASS, &tos, sizeof(tos));
+	}
 	if( err){
 		SU_DEBUG_2(("Can`t set TOS :%s",strerror(errno)));
 	}
 
 #ifndef DONT_BIND_TO_DEVICE
 	/* Set SO_BINDTODEVICE for right ip using */
-	if (chan_ctx->account) {
-		strcpy(ifr.ifr_name, chan_ctx->account->rtp_interface);
+	if (chan_ctx->call && chan_ctx->call->account) {
+		strcpy(ifr.ifr_name, chan_ctx->call->account->rtp_interface);
 	} else {
 		strcpy(ifr.ifr_name, "lo");
 	}
@@ -1208,11 +1919,8 @@ DFS
 	/* Bind socket to appropriate address */
 	ports_count = g_conf.rtp_port_last - g_conf.rtp_port_first + 1;
 	for (i = 0; i < ports_count; i++) {
-		memset(&my_addr, 0, sizeof(my_addr));
-		my_addr.sin_family = AF_INET;
-		my_addr.sin_port = htons(g_conf.rtp_port_first + i);
-		my_addr.sin_addr.s_addr = htonl(INADDR_ANY);
-		if ((bind(sock_fd, (struct sockaddr *)&my_addr, sizeof(my_addr))) != -1) {
+		svd_addr_any (af, g_conf.rtp_port_first + i, &my_addr, &my_addr_len);
+		if ((bind(sock_fd, (struct sockaddr *)&my_addr, my_addr_len)) != -1) {
 			chan_ctx->rtp_port = g_conf.rtp_port_first + i;
 			rtp_binded = 1;
 			break;
@@ -1252,7 +1960,7 @@ svd_media_tapi_rtp_sock_rebinddev (svd_chan_t * const ctx)
 DFS
 #ifndef DONT_BIND_TO_DEVICE
 	/* use account interface */
-	strcpy(ifr.ifr_name, ctx->account->rtp_interface);
+	strcpy(ifr.ifr_name, ctx->call->account->rtp_interface);
 	SU_DEBUG_0 (("THE NAME OF THE DEVICE : %s\n",ifr.ifr_name));
 	if(setsockopt (ctx->rtp_sfd, SOL_SOCKET, SO_BINDTODEVICE, &ifr,
 			sizeof (ifr)) < 0 ){
@@ -1268,3 +1976,55 @@ DFE
 	return -1;
 #endif
 }/*}}}*/
+
+/**
+ * Address family of the RTP sockets.
+ *
+ * \return
+ * 		AF_INET6 for the dual-stack sockets, AF_INET if the kernel has
+ * 		no IPv6.
+ */
+int
+svd_media_af (void)
+{/*{{{*/
+	return g_rtp_af;
+}/*}}}*/
+
+/**
+ * Resolve the remote RTP host and port of the call.
+ *
+ * \param[in,out] call 	call with remote_host and remote_port from SDP.
+ * \retval -1	the host is not a numeric address of the usable family.
+ * \retval 0 	if etherything is ok.
+ * \remark
+ * 		It fills call->remote_addr for sendto() in the RTP sockets family,
+ * 		IPv4 hosts become mapped addresses on the dual-stack sockets.
+ * 		The media handlers do not send while remote_addr_len is 0.
+ */
+int
+svd_media_remote_set (svd_call_t * const call)
+{/*{{{*/
+	int err;
+
+	memset(&call->remote_addr, 0, sizeof(call->remote_addr));
+	call->remote_addr_len = 0;
+	call->remote_af = AF_UNSPEC;
+	if( !call->remote_host || !call->remote_port){
+		goto __exit_fail;
+	}
+
+	err = svd_addr_resolve (call->remote_host, call->remote_port, g_rtp_af,
+			&call->remote_addr, &call->remote_addr_len, &call->remote_af);
+	if       (err == -2){
+		SU_DEBUG_2 (("IPv6 remote %s, but RTP sockets are IPv4\n",
+				call->remote_host));
+		goto __exit_fail;
+	} else if(err){
+		SU_DEBUG_2 (("Remote RTP host %s is not an address\n",
+				call->remote_host));
+		goto __exit_fail;
+	}
+	return 0;
+__exit_fail:
+	return -1;
+}/*}}}*/
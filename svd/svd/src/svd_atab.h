@@ -22,6 +22,75 @@ void svd_clear_call(svd_t * const svd, ab_chan_t * const chan);
 int get_FF_FXS_idx ( ab_t const * const ab, char const self_chan_idx );
 /** Set caller id standard.*/
 int svd_set_cid( ab_chan_t * const chan, const char *cid);
+/** Apply the reloaded channel config if the channel is idle.*/
+int svd_chan_conf_idle (svd_t * const svd, ab_chan_t * const chan);
+/** @}*/
+
+/** @defgroup CALLS Calls by NUA handle.
+ *  @ingroup ATA_B
+ *  Every NUA handle in use has the call object with the state shared
+ *  by its channels (account, remote party, remote RTP address). Calls
+ *  are chained in the hash buckets by the handle, so the NUA callbacks
+ *  find the channels of the call without scanning all of them. One call
+ *  can hold several channels (incoming call rings all channels of the
+ *  account), they follow in channels order.
+ *  @{*/
+/** Bind the channel to the call of the NUA handle.*/
+svd_call_t * svd_call_bind (svd_t * const svd, svd_chan_t * const chan_ctx,
+		nua_handle_t * const nh, sip_account_t * const account);
+/** Unbind the channel from its call.*/
+void svd_call_unbind (svd_t * const svd, svd_chan_t * const chan_ctx);
+/** Create the call arena.*/
+svd_call_t * svd_call_new (svd_t * const svd, sip_account_t * const account);
+/** Give the handle to the call.*/
+void svd_call_handle (svd_t * const svd, svd_call_t * const call,
+		nua_handle_t * const nh);
+/** Free the call with everything it allocated.*/
+void svd_call_free (svd_t * const svd, svd_call_t * const call);
+/** Record the rejected call and free it.*/
+void svd_call_reject (svd_t * const svd, svd_call_t * const call,
+		int const status);
+/** Get the call arena usage.*/
+void svd_call_mem (svd_call_t * const call, unsigned long * const allocs,
+		unsigned long * const bytes);
+/** Get the call of the NUA handle.*/
+svd_call_t * svd_call_find (svd_t const * const svd,
+		nua_handle_t const * const nh);
+/** Get the first channel bound to the NUA handle.*/
+svd_chan_t * svd_nh_chan (svd_t const * const svd,
+		nua_handle_t const * const nh);
+/** Get the next channel bound to the same NUA handle.*/
+svd_chan_t * svd_nh_chan_next (svd_chan_t const * const chan_ctx);
+/** @}*/
+
+/** @defgroup ATA_EVT_STAT ATA board events statistics.
+ *  @ingroup ATA_B
+ *  Every event type handled by svd_atab_handler is counted with
+ *  its handling time.
+ *  @{*/
+/** Events got from the device in one ab_dev_event_get_batch() call.*/
+#define ATAB_EVT_BATCH 16
+
+/** Statistics of one event type.*/
+struct atab_evt_stat_s {/*{{{*/
+	unsigned long n; /**< Events count.*/
+	unsigned long errors; /**< Handler failures.*/
+	unsigned long long sum_us; /**< Sum of handling times (us).*/
+	unsigned long max_us; /**< Maximum handling time (us).*/
+};/*}}}*/
+
+/** Board events statistics.*/
+struct atab_evt_stats_s {/*{{{*/
+	struct atab_evt_stat_s evt [ab_dev_event_COUNT]; /**< Per event type.*/
+	unsigned long batches; /**< Batches got from the devices.*/
+	unsigned long batch_max; /**< Maximum events in one batch.*/
+};/*}}}*/
+
+/** Event types names (for logs and interface).*/
+extern char const * const atab_evt_name [ab_dev_event_COUNT];
+
+/** Get the board events statistics.*/
+struct atab_evt_stats_s const * svd_atab_evt_stats (void);
 /** @}*/
 
 
@@ -34,6 +103,10 @@ int svd_media_register (svd_t * const svd, ab_chan_t * const chan);
 void svd_media_unregister (svd_t * const svd, ab_chan_t * const chan);
 /** Re-SO_BINDTODEVICE on rtp-socket of the channel.*/
 int svd_media_tapi_rtp_sock_rebinddev (svd_chan_t * const ctx);
+/** Address family of the RTP sockets.*/
+int svd_media_af (void);
+/** Resolve the remote RTP host and port of the call.*/
+int svd_media_remote_set (svd_call_t * const call);
 /** Start encoding / decoding on given channel.*/
 int ab_chan_media_activate ( ab_chan_t * const chan );
 /** Stop encoding / decoding on given channel.*/
@@ -44,6 +117,8 @@ cod_prms_t const * svd_cod_prms_get(enum cod_type_e ct ,char const * const cn);
 
 /** Wait for seconds after ring on fxo before sent CANCEL to hotlined FXS. */
 #define RING_WAIT_DROP 5
+/** Wait for the next digit before placing the call (ms). */
+#define DTMF_TIMEOUT_MS 4000
 
 #endif /* __SVD_ATAB_H__ */
 
@@ -0,0 +1,413 @@
+/**
+ * @file svd_boot.c
+ * Startup phases implementation.
+ * It containes the phases timings, the board thread and the dns thread.
+ */
+
+/* Includes {{{ */
+#include "svd.h"
+#include "svd_cfg.h"
+#include "svd_loop.h"
+#include "svd_boot.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+/*}}}*/
+
+/** Maximum length of the registrar host (with '\\0').*/
+#define BOOT_HOST_LEN 128
+
+/** Phases names.*/
+char const * const boot_phase_name [boot_phase_COUNT] = {
+	"daemon", "board_open", "board_start", "conf", "dns", "sip",
+	"register", "board_wait", "atab", "chans_conf",
+};
+
+/** Startup context.*/
+static struct boot_s {/*{{{*/
+	struct boot_stat_s st; /**< Statistics.*/
+	ab_t * ab; /**< Board to start.*/
+	pthread_t board_thread; /**< Board thread.*/
+	unsigned char board_run; /**< Board thread is running.*/
+	int board_err; /**< ab_start() result.*/
+	char board_err_str [ERR_STR_LENGTH]; /**< ab_start() error reason.*/
+	char hosts [BOOT_DNS_HOSTS_MAX][BOOT_HOST_LEN]; /**< Hosts to resolve.*/
+	pthread_mutex_t dns_lock; /**< Guards dns results.*/
+	pthread_cond_t dns_cond; /**< Signals the dns thread end.*/
+	unsigned char dns_run; /**< Dns thread is running.*/
+} g_boot = {
+	.dns_lock = PTHREAD_MUTEX_INITIALIZER,
+	.dns_cond = PTHREAD_COND_INITIALIZER,
+};/*}}}*/
+
+/** Board thread.*/
+static void * boot_board_thread (void * arg);
+/** Dns thread.*/
+static void * boot_dns_thread (void * arg);
+/** Get the host of the registrar address.*/
+static int boot_host_get (char const * uri, char * const host);
+/** Add the registrar host to resolve.*/
+static void boot_host_add (char const * const uri);
+
+/**
+ * Remember the svd start time.
+ *
+ * \remark
+ * 		It should be called first in main, all times count from it.
+ */
+void
+svd_boot_init (void)
+{/*{{{*/
+	memset(&g_boot.st, 0, sizeof(g_boot.st));
+	g_boot.st.t0 = svd_loop_now();
+}/*}}}*/
+
+/**
+ * Mark the phase start.
+ *
+ * \param[in] phase 	phase to mark.
+ * \remark
+ * 		Helper threads mark their own phases only.
+ */
+void
+svd_boot_begin (enum boot_phase_e const phase)
+{/*{{{*/
+	g_boot.st.ph[phase].begin_us = svd_loop_now() - g_boot.st.t0;
+}/*}}}*/
+
+/**
+ * Mark the phase end.
+ *
+ * \param[in] phase 	phase to mark.
+ */
+void
+svd_boot_end (enum boot_phase_e const phase)
+{/*{{{*/
+	g_boot.st.ph[phase].end_us = svd_loop_now() - g_boot.st.t0;
+	g_boot.st.ph[phase].done = 1;
+}/*}}}*/
+
+/**
+ * Start the board in the board thread.
+ *
+ * \param[in] ab 	board from ab_create_open().
+ * \remark
+ * 		The main thread should not use the board and libab until
+ * 		\ref svd_boot_board_wait(). If the thread can not be created,
+ * 		the board starts here.
+ */
+void
+svd_boot_board_start (ab_t * const ab)
+{/*{{{*/
+	int err;
+
+	g_boot.ab = ab;
+	/* pthread_create() returns the error, errno is not set */
+	err = pthread_create(&g_boot.board_thread, NULL, boot_board_thread, NULL);
+	if(err){
+		SU_DEBUG_2 (("Board thread: %s, starting in place\n",
+				strerror(err)));
+		boot_board_thread (NULL);
+		return;
+	}
+	g_boot.board_run = 1;
+}/*}}}*/
+
+/**
+ * Wait for the board thread.
+ *
+ * \retval 0 	the board is started (or was not started here)
+ * \retval other 	ab_start() error (\ref svd_boot_board_err() tells
+ * 		the reason)
+ */
+int
+svd_boot_board_wait (void)
+{/*{{{*/
+	svd_boot_begin (boot_phase_BOARD_WAIT);
+	if(g_boot.board_run){
+		pthread_join(g_boot.board_thread, NULL);
+		g_boot.board_run = 0;
+	}
+	svd_boot_end (boot_phase_BOARD_WAIT);
+	return g_boot.board_err;
+}/*}}}*/
+
+/**
+ * Reason of the ab_start() failure.
+ *
+ * \return 	error string saved in the board thread ("" if no error).
+ * \remark
+ * 		Valid after \ref svd_boot_board_wait(), ab_err_str() of the
+ * 		main thread does not see the board thread errors.
+ */
+char const *
+svd_boot_board_err (void)
+{/*{{{*/
+	return g_boot.board_err_str;
+}/*}}}*/
+
+/**
+ * Resolve the enabled accounts registrars in the dns thread.
+ *
+ * \remark
+ * 		It uses \ref g_conf. The addresses are not used, the resolving
+ * 		fills the resolver cache (dnsmasq) before the SIP stack asks for
+ * 		the same names.
+ */
+void
+svd_boot_dns_start (void)
+{/*{{{*/
+	pthread_t thread;
+	int err;
+	int i;
+
+	for (i=0; i<su_vector_len(g_conf.sip_account); i++){
+		sip_account_t * acc = su_vector_item(g_conf.sip_account, i);
+		if( !acc->enabled){
+			continue;
+		}
+		boot_host_add (acc->outbound_proxy);
+		boot_host_add (acc->registrar);
+	}
+	if( !g_boot.st.dns_hosts){
+		return;
+	}
+
+	svd_boot_begin (boot_phase_DNS);
+	g_boot.dns_run = 1;
+	err = pthread_create(&thread, NULL, boot_dns_thread, NULL);
+	if(err){
+		SU_DEBUG_2 (("Dns thread: %s\n", strerror(err)));
+		g_boot.dns_run = 0;
+		return;
+	}
+	pthread_detach(thread);
+}/*}}}*/
+
+/**
+ * Wait for the dns thread (\ref BOOT_DNS_WAIT_MS at most).
+ *
+ * \remark
+ * 		The thread is detached, it finishes on its own if the resolver
+ * 		is slower.
+ */
+void
+svd_boot_dns_wait (void)
+{/*{{{*/
+	struct timespec due;
+
+	clock_gettime(CLOCK_REALTIME, &due);
+	due.tv_sec += BOOT_DNS_WAIT_MS / 1000;
+	due.tv_nsec += (BOOT_DNS_WAIT_MS % 1000) * 1000000L;
+	if(due.tv_nsec >= 1000000000L){
+		due.tv_sec++;
+		due.tv_nsec -= 1000000000L;
+	}
+
+	pthread_mutex_lock(&g_boot.dns_lock);
+	while(g_boot.dns_run){
+		if(pthread_cond_timedwait(&g_boot.dns_cond, &g_boot.dns_lock, &due)
+				== ETIMEDOUT){
+			SU_DEBUG_2 (("Registrars are not resolved in %d ms\n",
+					BOOT_DNS_WAIT_MS));
+			break;
+		}
+	}
+	pthread_mutex_unlock(&g_boot.dns_lock);
+}/*}}}*/
+
+/**
+ * Mark the main loop start and log the phases.
+ */
+void
+svd_boot_ready (void)
+{/*{{{*/
+	struct boot_phase_s const * ph;
+	char buf [512];
+	int len;
+	int i;
+
+	g_boot.st.ready_us = svd_loop_now() - g_boot.st.t0;
+
+	pthread_mutex_lock(&g_boot.dns_lock);
+	len = snprintf(buf, sizeof(buf), "Startup %lu us:", g_boot.st.ready_us);
+	for (i=0; i<boot_phase_COUNT && len<sizeof(buf); i++){
+		ph = &g_boot.st.ph[i];
+		if( !ph->done){
+			continue;
+		}
+		len += snprintf(buf+len, sizeof(buf)-len, " %s %lu-%lu",
+				boot_phase_name[i], ph->begin_us, ph->end_us);
+	}
+	pthread_mutex_unlock(&g_boot.dns_lock);
+	SU_DEBUG_3(("%s\n", buf));
+	if(g_boot.st.dns_failed){
+		SU_DEBUG_2 (("%d of %d registrars hosts are not resolved\n",
+				g_boot.st.dns_failed, g_boot.st.dns_hosts));
+	}
+}/*}}}*/
+
+/**
+ * Mark the registration success.
+ *
+ * \remark
+ * 		The first one is logged and kept in the statistics.
+ */
+void
+svd_boot_registered (void)
+{/*{{{*/
+	if(g_boot.st.first_reg_us){
+		return;
+	}
+	g_boot.st.first_reg_us = svd_loop_now() - g_boot.st.t0;
+	SU_DEBUG_3 (("First registration %lu us after the start\n",
+			g_boot.st.first_reg_us));
+}/*}}}*/
+
+/**
+ * Get the startup statistics.
+ *
+ * \return 	statistics.
+ * \remark
+ * 		Used from the main loop, when the dns thread is surely done.
+ */
+struct boot_stat_s const *
+svd_boot_stat (void)
+{/*{{{*/
+	return &g_boot.st;
+}/*}}}*/
+
+/**
+ * Board thread.
+ *
+ * \param[in] arg 	not used.
+ * \return 	NULL.
+ */
+static void *
+boot_board_thread (void * arg)
+{/*{{{*/
+	svd_boot_begin (boot_phase_BOARD_START);
+	g_boot.board_err = ab_start (g_boot.ab);
+	if(g_boot.board_err){
+		/* libab errors are per thread, keep the reason for the main one */
+		snprintf(g_boot.board_err_str, sizeof(g_boot.board_err_str),
+				"%s", ab_err_str());
+	}
+	svd_boot_end (boot_phase_BOARD_START);
+	return NULL;
+}/*}}}*/
+
+/**
+ * Dns thread.
+ *
+ * \param[in] arg 	not used.
+ * \return 	NULL.
+ */
+static void *
+boot_dns_thread (void * arg)
+{/*{{{*/
+	struct addrinfo hints;
+	struct addrinfo * res;
+	int failed = 0;
+	int i;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+
+	for (i=0; i<g_boot.st.dns_hosts; i++){
+		if(getaddrinfo(g_boot.hosts[i], NULL, &hints, &res)){
+			failed++;
+			continue;
+		}
+		freeaddrinfo(res);
+	}
+
+	pthread_mutex_lock(&g_boot.dns_lock);
+	g_boot.st.dns_failed = failed;
+	svd_boot_end (boot_phase_DNS);
+	g_boot.dns_run = 0;
+	pthread_cond_signal(&g_boot.dns_cond);
+	pthread_mutex_unlock(&g_boot.dns_lock);
+	return NULL;
+}/*}}}*/
+
+/**
+ * Get the host of the registrar address.
+ *
+ * \param[in] uri 	address like "sip:user@host:port;params" or "host".
+ * \param[out] host 	host part (\ref BOOT_HOST_LEN bytes).
+ * \retval 0 	host is found
+ * \retval -1 	no host in the address
+ */
+static int
+boot_host_get (char const * uri, char * const host)
+{/*{{{*/
+	char const * at;
+	char const * end;
+	int len;
+
+	while(*uri == ' ' || *uri == '<'){
+		uri++;
+	}
+	if       ( !strncasecmp(uri, "sips:", 5)){
+		uri += 5;
+	} else if( !strncasecmp(uri, "sip:", 4)){
+		uri += 4;
+	}
+	at = strchr(uri, '@');
+	end = strpbrk(uri, ";>?");
+	if(at && ( !end || at < end)){
+		uri = at + 1;
+	}
+	if(*uri == '['){
+		uri++;
+		end = strchr(uri, ']');
+	} else {
+		end = strpbrk(uri, ":;>?/ ");
+	}
+	len = end ? end - uri : strlen(uri);
+	if(len <= 0 || len >= BOOT_HOST_LEN){
+		return -1;
+	}
+	memcpy(host, uri, len);
+	host[len] = '\0';
+	return 0;
+}/*}}}*/
+
+/**
+ * Add the registrar host to resolve.
+ *
+ * \param[in] uri 	registrar or proxy address (can be NULL).
+ * \remark
+ * 		Duplicates are skipped, \ref BOOT_DNS_HOSTS_MAX hosts at most.
+ */
+static void
+boot_host_add (char const * const uri)
+{/*{{{*/
+	char * host;
+	int i;
+
+	if( !uri || g_boot.st.dns_hosts >= BOOT_DNS_HOSTS_MAX){
+		return;
+	}
+	host = g_boot.hosts[g_boot.st.dns_hosts];
+	if(boot_host_get (uri, host)){
+		return;
+	}
+	for (i=0; i<g_boot.st.dns_hosts; i++){
+		if( !strcasecmp(g_boot.hosts[i], host)){
+			return;
+		}
+	}
+	g_boot.st.dns_hosts++;
+}/*}}}*/
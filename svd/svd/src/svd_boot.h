@@ -0,0 +1,84 @@
+/**
+ * @file svd_boot.h
+ * Startup phases timings and parallel initialization.
+ * It containes the phases timings and the helper threads of the startup.
+ */
+#ifndef __SVD_BOOT_H__
+#define __SVD_BOOT_H__
+
+#include "ab_api.h"
+
+/** @defgroup BOOT Startup phases.
+ *  The board is opened first, then its slow start (firmware, coefficients,
+ *  channels) runs in the board thread while the main thread parses the
+ *  configuration and creates the SIP stack, and the dns thread resolves
+ *  the registrars to warm the resolver cache. The registrations are sent
+ *  before the main thread waits for the board, the channels tones and
+ *  caller id are set after the first main loop round.
+ *  Times are monotonic us since the svd start (\ref svd_boot_init()).
+ *  @{*/
+/** How long the registrations wait for the registrars resolving (ms).*/
+#define BOOT_DNS_WAIT_MS 2000
+/** Maximum registrars hosts to resolve.*/
+#define BOOT_DNS_HOSTS_MAX 16
+
+/** Startup phases.*/
+enum boot_phase_e {/*{{{*/
+	boot_phase_DAEMON, /**< Daemonization */
+	boot_phase_BOARD_OPEN, /**< Board nodes open and channels structures */
+	boot_phase_BOARD_START, /**< Board start (board thread) */
+	boot_phase_CONF, /**< Configuration parsing */
+	boot_phase_DNS, /**< Registrars resolving (dns thread) */
+	boot_phase_SIP, /**< Root and SIP stack creation */
+	boot_phase_REGISTER, /**< Registrations sending */
+	boot_phase_BOARD_WAIT, /**< Main thread waits for the board start */
+	boot_phase_ATAB, /**< Channels contexts and board callbacks */
+	boot_phase_CHANS_CONF, /**< Channels tones and caller id */
+	boot_phase_COUNT, /**< Phases count */
+};/*}}}*/
+
+/** Timings of one phase.*/
+struct boot_phase_s {/*{{{*/
+	unsigned long begin_us; /**< Phase start.*/
+	unsigned long end_us; /**< Phase end.*/
+	unsigned char done; /**< The phase has finished.*/
+};/*}}}*/
+
+/** Startup statistics.*/
+struct boot_stat_s {/*{{{*/
+	unsigned long long t0; /**< svd start (\ref svd_loop_now() scale).*/
+	struct boot_phase_s ph [boot_phase_COUNT]; /**< Phases.*/
+	unsigned long ready_us; /**< Main loop start.*/
+	unsigned long first_reg_us; /**< First registration, 0 - not yet.*/
+	int dns_hosts; /**< Registrars hosts to resolve.*/
+	int dns_failed; /**< Hosts not resolved.*/
+};/*}}}*/
+
+/** Phases names (for logs and interface).*/
+extern char const * const boot_phase_name [boot_phase_COUNT];
+
+/** Remember the svd start time.*/
+void svd_boot_init (void);
+/** Mark the phase start.*/
+void svd_boot_begin (enum boot_phase_e const phase);
+/** Mark the phase end.*/
+void svd_boot_end (enum boot_phase_e const phase);
+/** Start the board in the board thread.*/
+void svd_boot_board_start (ab_t * const ab);
+/** Wait for the board thread.*/
+int  svd_boot_board_wait (void);
+/** Reason of the ab_start() failure (after \ref svd_boot_board_wait).*/
+char const * svd_boot_board_err (void);
+/** Resolve the enabled accounts registrars in the dns thread.*/
+void svd_boot_dns_start (void);
+/** Wait for the dns thread (\ref BOOT_DNS_WAIT_MS at most).*/
+void svd_boot_dns_wait (void);
+/** Mark the main loop start and log the phases.*/
+void svd_boot_ready (void);
+/** Mark the registration success.*/
+void svd_boot_registered (void);
+/** Get the startup statistics.*/
+struct boot_stat_s const * svd_boot_stat (void);
+/** @}*/
+
+#endif /* __SVD_BOOT_H__ */
@@ -0,0 +1,398 @@
+/**
+ * @file svd_cdr.c
+ * Call detail records implementation.
+ * It containes the records queue and the writer thread, that appends
+ * 		them to the file, syncs and rotates it.
+ */
+
+/* Includes {{{ */
+#include "svd.h"
+#include "svd_cdr.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+/*}}}*/
+
+/** Maximum length of the file name (with the rotation suffix).*/
+#define CDR_PATH_LEN 256
+
+/** Writer context.*/
+static struct cdr_s {/*{{{*/
+	char path [CDR_PATH_LEN]; /**< File name.*/
+	off_t size_max; /**< Rotate the file bigger then it.*/
+	int files; /**< Rotated files count.*/
+	int sync_s; /**< Sync period.*/
+	int fd; /**< Current file.*/
+	off_t size; /**< Current file size.*/
+	unsigned char dirty; /**< Written and not synced.*/
+	time_t synced; /**< Last sync time.*/
+	pthread_t thread; /**< Writer thread.*/
+	unsigned char running; /**< Writer thread is alive.*/
+	pthread_mutex_t lock; /**< Guards the queue.*/
+	pthread_cond_t cond; /**< Wakes the writer.*/
+	unsigned char stop; /**< Writer should write the queue and exit.*/
+	struct cdr_rec_s q [CDR_QUEUE_LEN]; /**< Queued records.*/
+	int q_len; /**< Queued records count.*/
+	unsigned long dropped; /**< Records lost (both threads, atomic).*/
+	unsigned long written; /**< Written records (writer thread only).*/
+} g_cdr = {
+	.fd = -1,
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};/*}}}*/
+
+/** Open the file, cut the partial record, write the header to the new one.*/
+static int cdr_file_open (void);
+/** Rename the file to FILE.1 and open the new one.*/
+static int cdr_rotate (void);
+/** Sync the file if it has unsynced records.*/
+static void cdr_sync (void);
+/** Append the records to the file.*/
+static void cdr_write (struct cdr_rec_s const * const recs, int const num);
+/** Writer thread.*/
+static void * cdr_writer (void * arg);
+
+/**
+ * Start the writer on the file.
+ *
+ * \param[in] path 		file name.
+ * \param[in] size_kb 	rotate the file bigger then it, 0 - \ref CDR_SIZE_DF.
+ * \param[in] files 	rotated files count, 0 - \ref CDR_FILES_DF.
+ * \param[in] sync_s 	sync period, 0 - \ref CDR_SYNC_DF.
+ * \retval 0 	etherything is fine
+ * \retval -1 	error occures
+ * \remark
+ * 		It should be called after daemonization, because threads
+ * 		do not survive fork().
+ */
+int
+svd_cdr_open (char const * const path, int const size_kb,
+		int const files, int const sync_s)
+{/*{{{*/
+	int err;
+
+	if(g_cdr.running){
+		return 0;
+	}
+	if(strlen(path) + 4 >= sizeof(g_cdr.path)){
+		SU_DEBUG_1 (("CDR file name is too long: %s\n", path));
+		goto __exit_fail;
+	}
+	strcpy(g_cdr.path, path);
+	g_cdr.size_max = (off_t)(size_kb > 0 ? size_kb : CDR_SIZE_DF) * 1024;
+	g_cdr.files = files > 0 ? files : CDR_FILES_DF;
+	g_cdr.sync_s = sync_s > 0 ? sync_s : CDR_SYNC_DF;
+	g_cdr.q_len = 0;
+	g_cdr.stop = 0;
+
+	if(cdr_file_open ()){
+		goto __exit_fail;
+	}
+	g_cdr.running = 1;
+	err = pthread_create(&g_cdr.thread, NULL, cdr_writer, NULL);
+	if(err){
+		SU_DEBUG_1 (("CDR writer thread: %s\n", strerror(err)));
+		g_cdr.running = 0;
+		close(g_cdr.fd);
+		g_cdr.fd = -1;
+		goto __exit_fail;
+	}
+	return 0;
+__exit_fail:
+	return -1;
+}/*}}}*/
+
+/**
+ * Write the queued records, sync and close the file.
+ */
+void
+svd_cdr_close (void)
+{/*{{{*/
+	if( !g_cdr.running){
+		return;
+	}
+	pthread_mutex_lock(&g_cdr.lock);
+	g_cdr.stop = 1;
+	pthread_cond_signal(&g_cdr.cond);
+	pthread_mutex_unlock(&g_cdr.lock);
+	pthread_join(g_cdr.thread, NULL);
+	g_cdr.running = 0;
+
+	cdr_sync ();
+	close(g_cdr.fd);
+	g_cdr.fd = -1;
+	if(g_cdr.dropped){
+		SU_DEBUG_2 (("CDR: %lu records written, %lu dropped\n",
+				g_cdr.written, g_cdr.dropped));
+	}
+}/*}}}*/
+
+/**
+ * Check if the records are written.
+ *
+ * \retval 0 	records are off
+ * \retval 1 	records are on
+ */
+int
+svd_cdr_on (void)
+{/*{{{*/
+	return g_cdr.running;
+}/*}}}*/
+
+/**
+ * Queue the record.
+ *
+ * \param[in,out] rec 	record, the mark and length are set here.
+ * \remark
+ * 		It never waits for the file: if the queue is full the record is
+ * 		dropped and counted.
+ */
+void
+svd_cdr_put (struct cdr_rec_s * const rec)
+{/*{{{*/
+	if( !g_cdr.running){
+		return;
+	}
+	rec->mark = CDR_REC_MARK;
+	rec->len = sizeof(*rec);
+
+	pthread_mutex_lock(&g_cdr.lock);
+	if(g_cdr.q_len < CDR_QUEUE_LEN){
+		memcpy(&g_cdr.q[g_cdr.q_len++], rec, sizeof(*rec));
+		pthread_cond_signal(&g_cdr.cond);
+	} else {
+		__sync_fetch_and_add(&g_cdr.dropped, 1);
+	}
+	pthread_mutex_unlock(&g_cdr.lock);
+}/*}}}*/
+
+/**
+ * Wall clock time in us.
+ *
+ * \return 	us since the epoch.
+ */
+unsigned long long
+svd_cdr_now (void)
+{/*{{{*/
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (unsigned long long)tv.tv_sec * 1000000ULL + tv.tv_usec;
+}/*}}}*/
+
+/**
+ * Open the file, cut the partial record, write the header to the new one.
+ *
+ * \retval 0 	etherything is fine
+ * \retval -1 	error occures
+ * \remark
+ * 		The file of other format is rotated away.
+ */
+static int
+cdr_file_open (void)
+{/*{{{*/
+	struct cdr_file_hdr_s hdr;
+	struct stat st;
+	off_t tail;
+
+	g_cdr.fd = open(g_cdr.path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if(g_cdr.fd == -1){
+		SU_DEBUG_1 (("CDR file \"%s\": %s\n", g_cdr.path, strerror(errno)));
+		goto __exit_fail;
+	}
+	if(fstat(g_cdr.fd, &st)){
+		SU_DEBUG_1 (("CDR file \"%s\": %s\n", g_cdr.path, strerror(errno)));
+		goto __exit_close;
+	}
+	g_cdr.size = st.st_size;
+
+	if(g_cdr.size){
+		if(pread(g_cdr.fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+				hdr.magic != CDR_MAGIC || hdr.version != CDR_VERSION ||
+				hdr.rec_len != sizeof(struct cdr_rec_s)){
+			SU_DEBUG_2 (("CDR file \"%s\" has other format, rotating it\n",
+					g_cdr.path));
+			return cdr_rotate ();
+		}
+		tail = (g_cdr.size - sizeof(hdr)) % sizeof(struct cdr_rec_s);
+		if(tail){
+			/* the power was lost in the middle of the record */
+			SU_DEBUG_2 (("CDR file \"%s\": cut %ld bytes of the partial "
+					"record\n", g_cdr.path, (long)tail));
+			g_cdr.size -= tail;
+			if(ftruncate(g_cdr.fd, g_cdr.size)){
+				SU_DEBUG_1 (("CDR file \"%s\": %s\n",
+						g_cdr.path, strerror(errno)));
+				goto __exit_close;
+			}
+		}
+		return 0;
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = CDR_MAGIC;
+	hdr.version = CDR_VERSION;
+	hdr.rec_len = sizeof(struct cdr_rec_s);
+	hdr.created_us = svd_cdr_now ();
+	if(write(g_cdr.fd, &hdr, sizeof(hdr)) != sizeof(hdr)){
+		SU_DEBUG_1 (("CDR file \"%s\" header: %s\n",
+				g_cdr.path, strerror(errno)));
+		goto __exit_close;
+	}
+	g_cdr.size = sizeof(hdr);
+	g_cdr.dirty = 1;
+	return 0;
+__exit_close:
+	close(g_cdr.fd);
+	g_cdr.fd = -1;
+__exit_fail:
+	return -1;
+}/*}}}*/
+
+/**
+ * Rename the file to FILE.1 and open the new one.
+ *
+ * \retval 0 	etherything is fine
+ * \retval -1 	error occures (records are not written until the next try)
+ * \remark
+ * 		FILE.1 goes to FILE.2 and so on, the oldest one is overwritten.
+ */
+static int
+cdr_rotate (void)
+{/*{{{*/
+	char from [CDR_PATH_LEN + 16];
+	char to [CDR_PATH_LEN + 16];
+	int i;
+
+	if(g_cdr.fd != -1){
+		cdr_sync ();
+		close(g_cdr.fd);
+		g_cdr.fd = -1;
+	}
+	for (i=g_cdr.files-1; i>0; i--){
+		snprintf(from, sizeof(from), "%s.%d", g_cdr.path, i);
+		snprintf(to, sizeof(to), "%s.%d", g_cdr.path, i+1);
+		if(rename(from, to) && errno != ENOENT){
+			SU_DEBUG_2 (("CDR rotate \"%s\": %s\n", from, strerror(errno)));
+		}
+	}
+	snprintf(to, sizeof(to), "%s.1", g_cdr.path);
+	if(rename(g_cdr.path, to) && errno != ENOENT){
+		SU_DEBUG_1 (("CDR rotate \"%s\": %s\n", g_cdr.path, strerror(errno)));
+		goto __exit_fail;
+	}
+	return cdr_file_open ();
+__exit_fail:
+	return -1;
+}/*}}}*/
+
+/**
+ * Sync the file if it has unsynced records.
+ */
+static void
+cdr_sync (void)
+{/*{{{*/
+	if(g_cdr.fd == -1 || !g_cdr.dirty){
+		return;
+	}
+	if(fdatasync(g_cdr.fd)){
+		SU_DEBUG_2 (("CDR sync: %s\n", strerror(errno)));
+	}
+	g_cdr.dirty = 0;
+	g_cdr.synced = time(NULL);
+}/*}}}*/
+
+/**
+ * Append the records to the file.
+ *
+ * \param[in] recs 	records.
+ * \param[in] num 	records count.
+ * \remark
+ * 		The file is rotated before the record that does not fit it.
+ */
+static void
+cdr_write (struct cdr_rec_s const * const recs, int const num)
+{/*{{{*/
+	size_t const len = sizeof(*recs);
+	ssize_t wr;
+	int i;
+
+	for (i=0; i<num; i++){
+		if(g_cdr.fd == -1 || g_cdr.size + len > g_cdr.size_max){
+			if(cdr_rotate ()){
+				__sync_fetch_and_add(&g_cdr.dropped, num - i);
+				return;
+			}
+		}
+		wr = write(g_cdr.fd, &recs[i], len);
+		if(wr != len){
+			SU_DEBUG_1 (("CDR write: %s\n",
+					wr < 0 ? strerror(errno) : "short write"));
+			if(wr > 0){
+				/* cut the partial record */
+				if(ftruncate(g_cdr.fd, g_cdr.size)){
+					SU_DEBUG_1 (("CDR file \"%s\": %s\n",
+							g_cdr.path, strerror(errno)));
+				}
+			}
+			__sync_fetch_and_add(&g_cdr.dropped, num - i);
+			return;
+		}
+		g_cdr.size += len;
+		g_cdr.dirty = 1;
+		g_cdr.written++;
+	}
+}/*}}}*/
+
+/**
+ * Writer thread.
+ *
+ * \param[in] arg 	not used.
+ * \return 	NULL.
+ * \remark
+ * 		It takes the whole queue at once, writes it out of the lock and
+ * 		syncs the file every \c cdr_sync seconds and at the exit.
+ */
+static void *
+cdr_writer (void * arg)
+{/*{{{*/
+	struct cdr_rec_s recs [CDR_QUEUE_LEN];
+	struct timespec due;
+	int stop;
+	int num;
+
+	g_cdr.synced = time(NULL);
+	for(;;){
+		pthread_mutex_lock(&g_cdr.lock);
+		while( !g_cdr.q_len && !g_cdr.stop){
+			clock_gettime(CLOCK_REALTIME, &due);
+			due.tv_sec += g_cdr.sync_s;
+			if(pthread_cond_timedwait(&g_cdr.cond, &g_cdr.lock, &due)
+					== ETIMEDOUT){
+				break;
+			}
+		}
+		num = g_cdr.q_len;
+		memcpy(recs, g_cdr.q, num * sizeof(recs[0]));
+		g_cdr.q_len = 0;
+		stop = g_cdr.stop;
+		pthread_mutex_unlock(&g_cdr.lock);
+
+		cdr_write (recs, num);
+		if(stop){
+			break;
+		}
+		if(time(NULL) - g_cdr.synced >= g_cdr.sync_s){
+			cdr_sync ();
+		}
+	}
+	return NULL;
+}/*}}}*/
@@ -0,0 +1,99 @@
+/**
+ * @file svd_cdr.h
+ * Call detail records.
+ * It containes the binary format of the records (shared with
+ * 		svd_cdr_dump) and functions to write them.
+ */
+#ifndef __SVD_CDR_H__
+#define __SVD_CDR_H__
+
+#include <stdint.h>
+
+/** @defgroup CDR Call detail records.
+ *  With "option cdr_file" svd appends one record per finished call to the
+ *  file. The records are queued by the main loop and written by the
+ *  writer thread, the file is synced every \c cdr_sync seconds and
+ *  rotated to FILE.1 ... FILE.N when it grows over \c cdr_size KB.
+ *  The file is \ref cdr_file_hdr_s followed by fixed size \ref cdr_rec_s
+ *  records, a partial record left by the power loss is cut on the next
+ *  open. Numbers are in host byte order, strings are '\\0' terminated.
+ *  svd_cdr_dump exports the files to JSON.
+ *  @{*/
+/** File magic ("SVDC").*/
+#define CDR_MAGIC 0x43445653UL
+/** File format version.*/
+#define CDR_VERSION 1
+/** Record mark (the reader checks it with the record length).*/
+#define CDR_REC_MARK 0xCD01
+/** Default maximum file size (KB).*/
+#define CDR_SIZE_DF 256
+/** Default rotated files count.*/
+#define CDR_FILES_DF 4
+/** Default sync period (s).*/
+#define CDR_SYNC_DF 10
+/** Records the main loop can queue before the writer takes them.*/
+#define CDR_QUEUE_LEN 64
+
+/** Call directions.*/
+enum cdr_dir_e {/*{{{*/
+	cdr_dir_IN, /**< Incoming call */
+	cdr_dir_OUT, /**< Outgoing call */
+};/*}}}*/
+
+/** File header.*/
+struct cdr_file_hdr_s {/*{{{*/
+	uint32_t magic; /**< \ref CDR_MAGIC.*/
+	uint16_t version; /**< \ref CDR_VERSION.*/
+	uint16_t rec_len; /**< sizeof(struct cdr_rec_s).*/
+	uint64_t created_us; /**< Wall clock time of the file creation (us).*/
+};/*}}}*/
+
+/** One finished call.*/
+struct cdr_rec_s {/*{{{*/
+	uint16_t mark; /**< \ref CDR_REC_MARK.*/
+	uint16_t len; /**< sizeof(struct cdr_rec_s).*/
+	uint8_t chan; /**< Channel number (from 1, 0 - rejected call).*/
+	uint8_t dir; /**< \ref cdr_dir_e value.*/
+	uint8_t media; /**< Media was active, jb and rtcp fields are valid.*/
+	uint8_t adopted; /**< Call was taken from the previous svd.*/
+	uint64_t start_us; /**< Call creation, wall clock (us).*/
+	uint64_t answer_us; /**< Answer, wall clock (us), 0 - not answered.*/
+	uint64_t end_us; /**< Call end, wall clock (us).*/
+	int32_t status; /**< Last final SIP status (0 - no final response).*/
+	char account [32]; /**< Account name.*/
+	char remote [128]; /**< Remote SIP URI.*/
+	char call_id [80]; /**< Call-ID.*/
+	char codec [32]; /**< SDP codec name.*/
+	/* jitter buffer of the last connection */
+	uint32_t jb_packets; /**< Received packets.*/
+	uint16_t jb_invalid; /**< Invalid packets.*/
+	uint16_t jb_late; /**< Late packets.*/
+	uint16_t jb_early; /**< Early packets.*/
+	uint16_t jb_resync; /**< Resynchronizations.*/
+	uint16_t jb_max_delay; /**< Maximum playout delay (ms).*/
+	uint16_t jb_pad; /**< Zero.*/
+	/* rtcp of the last connection */
+	uint32_t rtcp_psent; /**< Sent packets.*/
+	uint32_t rtcp_osent; /**< Sent octets.*/
+	uint32_t rtcp_lost; /**< Packets lost by the receiver.*/
+	uint32_t rtcp_jitter; /**< Interarrival jitter.*/
+	uint8_t rtcp_fraction; /**< Fraction lost.*/
+	uint8_t pad [3]; /**< Zero.*/
+};/*}}}*/
+
+#ifndef SVD_CDR_NO_WRITER
+/** Start the writer on the file.*/
+int  svd_cdr_open (char const * const path, int const size_kb,
+		int const files, int const sync_s);
+/** Write the queued records, sync and close the file.*/
+void svd_cdr_close (void);
+/** Check if the records are written.*/
+int  svd_cdr_on (void);
+/** Queue the record.*/
+void svd_cdr_put (struct cdr_rec_s * const rec);
+/** Wall clock time in us.*/
+unsigned long long svd_cdr_now (void);
+#endif /* SVD_CDR_NO_WRITER */
+/** @}*/
+
+#endif /* __SVD_CDR_H__ */
@@ -0,0 +1,273 @@
+/**
+ * @file svd_cdr_dump.c
+ * Main file of the svd_cdr_dump programm.
+ * It containes the call detail records reader and the JSON export.
+ *
+ * The files (option cdr_file of svd and its rotated FILE.1 ... FILE.N)
+ * are read in the given order and exported as one JSON array of calls.
+ * Records with the wrong mark or length (a broken tail) end the file.
+ */
+
+/* Includes {{{ */
+#define SVD_CDR_NO_WRITER
+#include "svd_cdr.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <getopt.h>
+/*}}}*/
+
+/** Export context.*/
+static struct {/*{{{*/
+	FILE * out; /**< JSON output.*/
+	unsigned long recs; /**< Exported records.*/
+	unsigned char lines; /**< One object per line instead of the array.*/
+} g_cd;/*}}}*/
+
+/** Print the JSON string.*/
+static void cd_str (char const * const name, char const * const str,
+		int const size);
+/** Print the wall clock time as the number and the ISO string.*/
+static void cd_time (char const * const name, unsigned long long const us);
+/** Milliseconds between two times.*/
+static unsigned long long cd_ms (unsigned long long const from,
+		unsigned long long const to);
+/** Export one record.*/
+static void cd_rec (struct cdr_rec_s const * const r);
+/** Export the file.*/
+static int cd_file (char const * const path);
+/** Show help message.*/
+static void show_help (void);
+
+/**
+ * Print the JSON string.
+ *
+ * \param[in] name 	field name.
+ * \param[in] str 	field value (can be without '\\0').
+ * \param[in] size 	value buffer size.
+ */
+static void
+cd_str (char const * const name, char const * const str, int const size)
+{/*{{{*/
+	int i;
+
+	fprintf(g_cd.out, ",\"%s\":\"", name);
+	for (i=0; i<size && str[i]; i++){
+		unsigned char const c = str[i];
+		if(c == '"' || c == '\\'){
+			fprintf(g_cd.out, "\\%c", c);
+		} else if(c < 0x20){
+			fprintf(g_cd.out, "\\u%04x", c);
+		} else {
+			fputc(c, g_cd.out);
+		}
+	}
+	fputc('"', g_cd.out);
+}/*}}}*/
+
+/**
+ * Print the wall clock time as the number and the ISO string.
+ *
+ * \param[in] name 	field name.
+ * \param[in] us 	us since the epoch, 0 - null.
+ */
+static void
+cd_time (char const * const name, unsigned long long const us)
+{/*{{{*/
+	char buf [32];
+	time_t t = us / 1000000ULL;
+	struct tm tm;
+
+	if( !us){
+		fprintf(g_cd.out, ",\"%s\":null", name);
+		return;
+	}
+	gmtime_r(&t, &tm);
+	strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+	fprintf(g_cd.out, ",\"%s\":\"%s.%03luZ\"", name, buf,
+			(unsigned long)(us % 1000000ULL) / 1000);
+}/*}}}*/
+
+/**
+ * Milliseconds between two times.
+ *
+ * \param[in] from 	first time (us), 0 - not reached.
+ * \param[in] to 	second time (us).
+ * \return 	ms or 0 if the first time is not reached or is later.
+ */
+static unsigned long long
+cd_ms (unsigned long long const from, unsigned long long const to)
+{/*{{{*/
+	return (from && to > from) ? (to - from) / 1000 : 0;
+}/*}}}*/
+
+/**
+ * Export one record.
+ *
+ * \param[in] r 	record.
+ */
+static void
+cd_rec (struct cdr_rec_s const * const r)
+{/*{{{*/
+	unsigned long long const start = r->start_us;
+	unsigned long long const answer = r->answer_us;
+	unsigned long long const end = r->end_us;
+
+	if(g_cd.recs && !g_cd.lines){
+		fprintf(g_cd.out, ",\n");
+	}
+	fprintf(g_cd.out, "{\"chan\":%u,\"dir\":\"%s\"",
+			r->chan, r->dir == cdr_dir_OUT ? "out" : "in");
+	cd_str ("account", r->account, sizeof(r->account));
+	cd_str ("remote", r->remote, sizeof(r->remote));
+	cd_str ("call_id", r->call_id, sizeof(r->call_id));
+	cd_time ("start", r->start_us);
+	cd_time ("answer", r->answer_us);
+	cd_time ("end", r->end_us);
+	/* setup is the time to the answer or to the end of unanswered call,
+	 * the clock can be stepped back during the call */
+	fprintf(g_cd.out, ",\"setup_ms\":%llu,\"duration_ms\":%llu",
+			cd_ms (start, answer ? answer : end), cd_ms (answer, end));
+	fprintf(g_cd.out, ",\"status\":%d,\"adopted\":%s",
+			r->status, r->adopted ? "true" : "false");
+	cd_str ("codec", r->codec, sizeof(r->codec));
+	if(r->media){
+		fprintf(g_cd.out, ",\"jb\":{\"packets\":%u,\"invalid\":%u,"
+				"\"late\":%u,\"early\":%u,\"resync\":%u,\"max_delay\":%u}",
+				r->jb_packets, r->jb_invalid, r->jb_late, r->jb_early,
+				r->jb_resync, r->jb_max_delay);
+		fprintf(g_cd.out, ",\"rtcp\":{\"sent_packets\":%u,\"sent_octets\":%u,"
+				"\"lost\":%u,\"fraction\":%u,\"jitter\":%u}",
+				r->rtcp_psent, r->rtcp_osent, r->rtcp_lost,
+				r->rtcp_fraction, r->rtcp_jitter);
+	} else {
+		fprintf(g_cd.out, ",\"jb\":null,\"rtcp\":null");
+	}
+	fprintf(g_cd.out, "}%s", g_cd.lines ? "\n" : "");
+	g_cd.recs++;
+}/*}}}*/
+
+/**
+ * Export the file.
+ *
+ * \param[in] path 	file name.
+ * \retval 0 	etherything is fine
+ * \retval -1 	error occures
+ */
+static int
+cd_file (char const * const path)
+{/*{{{*/
+	struct cdr_file_hdr_s hdr;
+	struct cdr_rec_s r;
+	unsigned long n = 0;
+	FILE * f;
+	int err = -1;
+
+	f = fopen(path, "rb");
+	if( !f){
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		goto __exit;
+	}
+	if(fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != CDR_MAGIC){
+		fprintf(stderr, "%s: not a call records file\n", path);
+		goto __exit;
+	}
+	if(hdr.version != CDR_VERSION || hdr.rec_len != sizeof(r)){
+		fprintf(stderr, "%s: version %u record %u, expected %u / %u\n",
+				path, hdr.version, hdr.rec_len, CDR_VERSION,
+				(unsigned)sizeof(r));
+		goto __exit;
+	}
+	while(fread(&r, sizeof(r), 1, f) == 1){
+		if(r.mark != CDR_REC_MARK || r.len != sizeof(r)){
+			fprintf(stderr, "%s: broken record %lu, the rest is skipped\n",
+					path, n);
+			break;
+		}
+		cd_rec (&r);
+		n++;
+	}
+	err = 0;
+__exit:
+	if(f){
+		fclose(f);
+	}
+	return err;
+}/*}}}*/
+
+/**
+ * Show help message.
+ */
+static void
+show_help( void )
+{/*{{{*/
+	fprintf( stdout,
+"\
+Usage: %s [OPTION] FILE...\n\
+Export svd call detail records (option cdr_file) to JSON.\n\
+\n\
+  -h, --help         display this help and exit\n\
+  -l, --lines        one JSON object per line instead of the array\n\
+\n\
+	Execution example :\n\
+	%s /tmp/svd.cdr.1 /tmp/svd.cdr\n\
+	Means, that you export the previous and the current file\n\
+			as one array.\n\
+"
+		, "svd_cdr_dump", "svd_cdr_dump");
+}/*}}}*/
+
+/**
+ * Main.
+ * \param[in] argc 	arguments count
+ * \param[in] argv 	arguments values
+ * \retval 0 	etherything is fine
+ * \retval -1 	error occures
+ */
+int
+main (int argc, char ** argv)
+{/*{{{*/
+	int option_IDX;
+	int option_rez;
+	int err = 0;
+	int i;
+	char * short_options = "hl";
+	struct option long_options[ ] = {
+		{ "help", no_argument, NULL, 'h' },
+		{ "lines", no_argument, NULL, 'l' },
+		{ NULL, 0, NULL, 0 }
+		};
+
+	memset(&g_cd, 0, sizeof(g_cd));
+	g_cd.out = stdout;
+
+	while ((option_rez = getopt_long ( argc, argv, short_options,
+			long_options, &option_IDX)) != -1) {
+		if(option_rez == 'l'){
+			g_cd.lines = 1;
+		} else {
+			show_help();
+			return -1;
+		}
+	}
+	if(optind >= argc){
+		show_help();
+		return -1;
+	}
+
+	if( !g_cd.lines){
+		fprintf(g_cd.out, "[\n");
+	}
+	for (i=optind; i<argc; i++){
+		if(cd_file (argv[i])){
+			err = -1;
+		}
+	}
+	if( !g_cd.lines){
+		fprintf(g_cd.out, "%s]\n", g_cd.recs ? "\n" : "");
+	}
+	return err;
+}/*}}}*/
@@ -11,6 +11,7 @@
 #include "svd_log.h"
 #include "svd_led.h"
 #include "svd_atab.h"
+#include "svd_ua.h"
 
 #include <uci.h>
 #include <ucimap.h>
@@ -83,6 +84,12 @@ static unsigned char g_err_no;
 
 ab_t * global_ab;
 
+/**
+ * Config is parsed for svd_conf_reload(), the board and the leds are
+ * left as is until the changes are applied.
+ */
+static unsigned char g_conf_reloading;
+
 /**
  * Converts a string representation of a codec name to a codec type.
  *
@@ -124,6 +131,10 @@ sip_free(void * elem)
 		free (account->outbound_proxy);
 	if (account->user_agent)
 		free (account->user_agent);
+	if (account->outgoing_priority)
+		free (account->outgoing_priority);
+	if (account->ring_incoming)
+		free (account->ring_incoming);
 #ifndef DONT_BIND_TO_DEVICE
 	if (account->rtp_interface)
 		free (account->rtp_interface);
@@ -153,6 +164,9 @@ dialplan_free(void * elem)
 struct uci_main {
 	struct ucimap_section_data map;
 	int log_level;
+	char *log_file;
+	char *log_subsys;
+	int slow_handler_ms;
 	int rtp_port_first;
 	int rtp_port_last;
 	int sip_tos;
@@ -162,7 +176,13 @@ struct uci_main {
 	char *dial_tone;
 	char *ring_tone;
 	char *busy_tone;
+	char *tone_zone;
 	char *cid_intnl_prefix;
+	char *cdr_file;
+	int cdr_size;
+	int cdr_files;
+	int cdr_sync;
+	char *media_engine;
 };
 
 static int
@@ -177,6 +197,11 @@ main_add(struct uci_map *map, void *section)
 	struct uci_main *a = section;
 	
 	g_conf.log_level = a->log_level;
+	if (a->log_file)
+		g_conf.log_file = strdup(a->log_file);
+	if (a->log_subsys)
+		g_conf.log_subsys = strdup(a->log_subsys);
+	g_conf.slow_handler_ms = a->slow_handler_ms;
 	g_conf.rtp_port_first = a->rtp_port_first;
 	g_conf.rtp_port_last = a->rtp_port_last;
 	g_conf.sip_tos = a->sip_tos;
@@ -184,7 +209,8 @@ main_add(struct uci_map *map, void *section)
 	if (a->led) {
 		g_conf.voip_led = strdup(a->led);
 		/* turn it off immediately */
-		led_off(a->led);
+		if (!g_conf_reloading)
+			led_off(a->led);
 	}
 	if (a->local_ip)
 		g_conf.local_ip = strdup(a->local_ip);
@@ -194,8 +220,17 @@ main_add(struct uci_map *map, void *section)
 		g_conf.ring_tone = strdup(a->ring_tone);
 	if (a->busy_tone)
 		g_conf.busy_tone = strdup(a->busy_tone);
+	if (a->tone_zone)
+		g_conf.tone_zone = strdup(a->tone_zone);
 	if (a->cid_intnl_prefix)
 		g_conf.cid_intnl_prefix = strdup(a->cid_intnl_prefix);
+	if (a->cdr_file)
+		g_conf.cdr_file = strdup(a->cdr_file);
+	g_conf.cdr_size = a->cdr_size;
+	g_conf.cdr_files = a->cdr_files;
+	g_conf.cdr_sync = a->cdr_sync;
+	if (a->media_engine)
+		g_conf.media_engine = strdup(a->media_engine);
 	return 0;
 }
 
@@ -205,6 +240,18 @@ static struct uci_optmap main_uci_map[] =
 		UCIMAP_OPTION(struct uci_main, log_level),
 		.type = UCIMAP_INT,
 		.name = "log_level",
+	},{
+		UCIMAP_OPTION(struct uci_main, log_file),
+		.type = UCIMAP_STRING,
+		.name = "log_file",
+	},{
+		UCIMAP_OPTION(struct uci_main, log_subsys),
+		.type = UCIMAP_STRING,
+		.name = "log_subsys",
+	},{
+		UCIMAP_OPTION(struct uci_main, slow_handler_ms),
+		.type = UCIMAP_INT,
+		.name = "slow_handler_ms",
 	},{
 		UCIMAP_OPTION(struct uci_main, rtp_port_first),
 		.type = UCIMAP_INT,
@@ -241,10 +288,34 @@ static struct uci_optmap main_uci_map[] =
 		UCIMAP_OPTION(struct uci_main, busy_tone),
 		.type = UCIMAP_STRING,
 		.name = "busy_tone",
+	},{
+		UCIMAP_OPTION(struct uci_main, tone_zone),
+		.type = UCIMAP_STRING,
+		.name = "tone_zone",
 	},{
 		UCIMAP_OPTION(struct uci_main, cid_intnl_prefix),
 		.type = UCIMAP_STRING,
 		.name = "cid_intnl_prefix",
+	},{
+		UCIMAP_OPTION(struct uci_main, cdr_file),
+		.type = UCIMAP_STRING,
+		.name = "cdr_file",
+	},{
+		UCIMAP_OPTION(struct uci_main, cdr_size),
+		.type = UCIMAP_INT,
+		.name = "cdr_size",
+	},{
+		UCIMAP_OPTION(struct uci_main, cdr_files),
+		.type = UCIMAP_INT,
+		.name = "cdr_files",
+	},{
+		UCIMAP_OPTION(struct uci_main, cdr_sync),
+		.type = UCIMAP_INT,
+		.name = "cdr_sync",
+	},{
+		UCIMAP_OPTION(struct uci_main, media_engine),
+		.type = UCIMAP_STRING,
+		.name = "media_engine",
 	},
 };
 
@@ -305,6 +376,12 @@ account_add(struct uci_map *map, void *section)
 		goto __exit_fail;
 	}
 	memset(s, 0, sizeof(*s));
+	s->outgoing_priority = calloc(g_conf.channels, sizeof(*s->outgoing_priority));
+	s->ring_incoming = calloc(CHSET_WORDS(g_conf.channels), sizeof(chset_t));
+	if( !s->outgoing_priority || !s->ring_incoming){
+		SU_DEBUG_0((LOG_FNC_A(LOG_NOMEM)));
+		goto __exit_fail;
+	}
 	
 	/* required fields */
 	if (!a->user || !a->domain || !a->password
@@ -390,11 +467,12 @@ account_add(struct uci_map *map, void *section)
 	}
 	if (a->ring_incoming && a->ring_incoming->n_items > 0) {
 		for (i=0; i<a->ring_incoming->n_items && i<g_conf.channels; i++)
-			s->ring_incoming[i] = a->ring_incoming->item[i].b;
+			if (a->ring_incoming->item[i].b)
+				chset_add(s->ring_incoming, i);
 	} else {
 		/* no ring incoming specified, ring all channels */
 		for (i=0; i<g_conf.channels; i++)
-			s->ring_incoming[i] = 1;
+			chset_add(s->ring_incoming, i);
 	}
 	s->enabled = 1;
 	/* no way to check for absence of an option, so use option disabled instead of enabled */
@@ -845,19 +923,17 @@ channel_add(struct uci_map *map, void *section)
 		}
 	}
 	
-	/* caller id standard */
+	/* caller id standard (set with the tones, the board is not ready yet) */
 	if (a->cid) {
-		SU_DEBUG_0(("Setting caller id standard for channel %d to %s\n", a->channel+1, a->cid));
-		if (svd_set_cid(&global_ab->chans[a->channel], a->cid)) {
-			SU_DEBUG_0(("Invalid caller id %s\n",a->cid));
-		}
+		g_conf.chan_cid[a->channel] = strdup(a->cid);
 	}
 	
 	/* led */
 	if (a->led) {
 		g_conf.chan_led[a->channel] = strdup(a->led);
 		/* turn it off immediately */
-		led_off(a->led);
+		if (!g_conf_reloading)
+			led_off(a->led);
 	}
 		
 	return 0;
@@ -942,6 +1018,8 @@ uci_config_load(void)
 	struct uci_package *pkg;
 
 	ucimap_init(&svd_map);
+	if (g_so.confdir)
+		uci_set_confdir(ctx, g_so.confdir);
 	ret = uci_load(ctx, "svd", &pkg);
 	if (ret) {
 		char *errmsg;
@@ -962,6 +1040,23 @@ uci_config_load(void)
  *  @ingroup CFG_M
  *  This functions using while reading config file.
  *  @{*/
+/** Allocate \ref g_conf tables and set the defaults.*/
+static int conf_create (int const channels, su_home_t * home);
+/** Check the required options of \ref g_conf.*/
+static int conf_check (void);
+/** Compile the tones of the zone and the custom tones.*/
+static int conf_tones (void);
+/** Free the config structure.*/
+static void conf_free (svd_conf_s * const c, int const leds);
+/** Apply the changes of the main options.*/
+static void conf_reload_main (svd_conf_s * const c,
+		struct conf_reload_s * const r);
+/** Apply the changes of the accounts and the dial plan.*/
+static int conf_reload_accounts (svd_t * const svd, svd_conf_s * const c,
+		struct conf_reload_s * const r);
+/** Apply the changes of the channels parameters.*/
+static void conf_reload_chans (svd_t * const svd, svd_conf_s * const c,
+		struct conf_reload_s * const r, int const tones);
 /** Init AUDIO parameters configuration.*/
 static void audio_defaults (void);
 /** Init WLEC defaults.*/
@@ -993,11 +1088,15 @@ startup_init( int argc, char ** argv )
 {/*{{{*/
 	int option_IDX;
 	int option_rez;
-	char * short_options = "hVfd:";
+	char * short_options = "hVfsd:r:C:H:";
 	struct option long_options[ ] = {
 		{ "help", no_argument, NULL, 'h' },
 		{ "version", no_argument, NULL, 'V' },
 		{ "foreground", no_argument, NULL, 'f' },
+		{ "sim", no_argument, NULL, 's' },
+		{ "record", required_argument, NULL, 'r' },
+		{ "confdir", required_argument, NULL, 'C' },
+		{ "handoff", required_argument, NULL, 'H' },
 		{ "debug", required_argument, NULL, 'd' },
 		{ NULL, 0, NULL, 0 }
 		};
@@ -1009,6 +1108,10 @@ startup_init( int argc, char ** argv )
 	g_so.version = 0;
 	g_so.debug_level = -1;
 	g_so.foreground = 0;
+	g_so.sim = 0;
+	g_so.rec_path = NULL;
+	g_so.confdir = NULL;
+	g_so.handoff_fd = -1;
 
 	/* INIT FROM SYSTEM CONFIG FILE "/etc/routine" */
 	/* INIT FROM SYSTEM ENVIRONMENT */
@@ -1042,6 +1145,24 @@ startup_init( int argc, char ** argv )
 				g_so.foreground = 1;
 				break;
 			}
+			case 's': {
+				g_so.sim = 1;
+				break;
+			}
+			case 'r': {
+				g_so.rec_path = optarg;
+				break;
+			}
+			case 'C': {
+				g_so.confdir = optarg;
+				break;
+			}
+			case 'H': {
+				g_so.handoff_fd = strtol(optarg, NULL, 10);
+				/* the new svd stays attached to the old one parent */
+				g_so.foreground = 1;
+				break;
+			}
 			case '?' :{
 				/* unknown option found */
 				g_err_no = ERR_UNKNOWN_OPTION;
@@ -1085,32 +1206,74 @@ int
 svd_conf_init( ab_t const * const ab, su_home_t * home )
 {/*{{{*/
 	int err = -1;
+
+	global_ab = (ab_t *)ab;
+	if(conf_create (ab->chans_num, home)){
+		goto __exit;
+	}
+	if(uci_config_load()){
+		goto __exit;
+	}
+	err = conf_check();
+__exit:
+	conf_show();
+	return err;
+}/*}}}*/
+
+/**
+ * Allocate \ref g_conf tables and set the default values.
+ *
+ * \param[in] channels 	channels count.
+ * \param[in] home 		home for the vectors.
+ * \retval 0 success.
+ * \retval -1 in error case.
+ */
+static int
+conf_create (int const channels, su_home_t * home)
+{/*{{{*/
 	/* default presets */
 	memset (&g_conf, 0, sizeof(g_conf));
 
-	global_ab = (ab_t *)ab;
-	g_conf.channels = ab->chans_per_dev;
+	g_conf.channels = channels;
+	g_conf.audio_prms = calloc(g_conf.channels, sizeof(*g_conf.audio_prms));
+	g_conf.wlec_prms = calloc(g_conf.channels, sizeof(*g_conf.wlec_prms));
+	g_conf.chan_led = calloc(g_conf.channels, sizeof(*g_conf.chan_led));
+	g_conf.chan_cid = calloc(g_conf.channels, sizeof(*g_conf.chan_cid));
+	if( !g_conf.audio_prms || !g_conf.wlec_prms || !g_conf.chan_led ||
+			!g_conf.chan_cid){
+		SU_DEBUG_0((LOG_FNC_A(LOG_NOMEM)));
+		goto __exit_fail;
+	}
 
 	g_conf.sip_account = su_vector_create(home,sip_free);
 	if( !g_conf.sip_account ){
 		SU_DEBUG_0((LOG_FNC_A(LOG_NOMEM)));
-		goto __exit;
+		goto __exit_fail;
 	}
 	
 	g_conf.dial_plan = su_vector_create(home, dialplan_free);
 	if( !g_conf.dial_plan ){
 		SU_DEBUG_0((LOG_FNC_A(LOG_NOMEM)));
-		goto __exit;
+		goto __exit_fail;
 	}
 
 	codec_defaults();
 	audio_defaults();
-	wlec_defaults(ab);
-	
-	if(uci_config_load()){
-		goto __exit;
-	}
-	
+	wlec_defaults(global_ab);
+	return 0;
+__exit_fail:
+	return -1;
+}/*}}}*/
+
+/**
+ * Check the required options of \ref g_conf.
+ *
+ * \retval 0 all options are here.
+ * \retval -1 some option is missing.
+ */
+static int
+conf_check (void)
+{/*{{{*/
 	bool at_least_one_account = false;
 	int i;
 	for (i=0; i<su_vector_len(g_conf.sip_account); i++) {
@@ -1121,10 +1284,13 @@ svd_conf_init( ab_t const * const ab, su_home_t * home )
 		}
 	}
 
+	if (conf_tones ()) {
+		return -1;
+	}
+
 	if (g_conf.rtp_port_first && g_conf.rtp_port_last && g_conf.sip_tos &&
 	    g_conf.rtp_tos && at_least_one_account) {
-		err = 0;
-		goto __exit;
+		return 0;
 	}
 	
 	if (!g_conf.rtp_port_first)
@@ -1137,9 +1303,53 @@ svd_conf_init( ab_t const * const ab, su_home_t * home )
 		SU_DEBUG_0(("Missing/invalid \"option rtp_tos\" in \"config main\"\n" VA_NONE));
 	if (!at_least_one_account)
 		SU_DEBUG_0(("No accounts defined/enabled\n" VA_NONE));
+	return -1;
+}/*}}}*/
 
-__exit:
-	conf_show();
+/**
+ * Compile the tones of the zone and the custom tones.
+ *
+ * \retval 0 	etherything is fine
+ * \retval -1 	unknown zone or custom tone error
+ * \remark
+ * 		Tones are compiled once per config load to \ref g_conf tones,
+ * 		the custom ones replace the tones of the zone.
+ */
+static int
+conf_tones (void)
+{/*{{{*/
+	char const * custom [ab_chan_tone_COUNT] = {
+		[ab_chan_tone_DIAL] = g_conf.dial_tone,
+		[ab_chan_tone_BUSY] = g_conf.busy_tone,
+		[ab_chan_tone_RINGBACK] = g_conf.ring_tone,
+	};
+	char const * opt [ab_chan_tone_COUNT] = {
+		[ab_chan_tone_DIAL] = "dial_tone",
+		[ab_chan_tone_BUSY] = "busy_tone",
+		[ab_chan_tone_RINGBACK] = "ring_tone",
+	};
+	ab_tone_zone_t const * zone;
+	int err = 0;
+	int i;
+
+	zone = ab_tone_zone_find (g_conf.tone_zone ?
+			g_conf.tone_zone : AB_TONE_ZONE_DF);
+	if ( !zone) {
+		SU_DEBUG_0(("Invalid \"option tone_zone\" in \"config main\": %s\n",
+				g_conf.tone_zone));
+		return -1;
+	}
+	memcpy(g_conf.tones, zone->tones, sizeof(g_conf.tones));
+
+	for (i=0; i<ab_chan_tone_COUNT; i++) {
+		if ( !custom[i])
+			continue;
+		if (ab_tone_parse (custom[i], &g_conf.tones[i])) {
+			SU_DEBUG_0(("Invalid \"option %s\" in \"config main\": %s\n",
+					opt[i], ab_err_str()));
+			err = -1;
+		}
+	}
 	return err;
 }/*}}}*/
 
@@ -1167,6 +1377,18 @@ conf_show( void )
 		SU_DEBUG_3(("log[%d]\n", g_conf.log_level));
 	}
 
+	if( g_conf.log_file ){
+		SU_DEBUG_3(("log_file[%s]\n", g_conf.log_file));
+	} else {
+		SU_DEBUG_3(("log_file[syslog]\n" VA_NONE));
+	}
+
+	if( g_conf.log_subsys ){
+		SU_DEBUG_3(("log_subsys[%s]\n", g_conf.log_subsys));
+	}
+
+	SU_DEBUG_3(("slow_handler_ms[%d]\n", g_conf.slow_handler_ms));
+
 	if( g_conf.local_ip ){
 		SU_DEBUG_3(("local_ip[%s]\n", g_conf.local_ip));
 	} else {
@@ -1191,12 +1413,26 @@ conf_show( void )
 		SU_DEBUG_3(("busy_tone[]\n" VA_NONE));
 	}
 
+	SU_DEBUG_3(("tone_zone[%s]\n", g_conf.tone_zone ?
+			g_conf.tone_zone : AB_TONE_ZONE_DF));
+
 	if( g_conf.cid_intnl_prefix ){
 		SU_DEBUG_3(("cid_intnl_prefix[%s]\n", g_conf.cid_intnl_prefix));
 	} else {
 		SU_DEBUG_3(("cid_intnl_prefix[]\n" VA_NONE));
 	}
 
+	if( g_conf.cdr_file ){
+		SU_DEBUG_3(("cdr_file[%s] size[%d] files[%d] sync[%d]\n",
+				g_conf.cdr_file, g_conf.cdr_size,
+				g_conf.cdr_files, g_conf.cdr_sync));
+	} else {
+		SU_DEBUG_3(("cdr_file[]\n" VA_NONE));
+	}
+
+	SU_DEBUG_3(("media_engine[%s]\n", g_conf.media_engine ?
+			g_conf.media_engine : "poll"));
+
 	SU_DEBUG_3(("led[%s]\n", g_conf.voip_led));
 	SU_DEBUG_3(("ports[%ld:%ld]\n",
 			g_conf.rtp_port_first,
@@ -1244,7 +1480,7 @@ conf_show( void )
 		for (j=0; j<g_conf.channels; j++){
 		      SU_DEBUG_3(("\t\tchannel %d:%d\n",
 				j,  
-				curr_sip_rec->ring_incoming[j]
+				chset_has(curr_sip_rec->ring_incoming, j)
 				));
 		}
 		SU_DEBUG_3((	"\tOutgoing priority:\n" VA_NONE));
@@ -1288,30 +1524,481 @@ conf_show( void )
  */
 void
 svd_conf_destroy (void)
+{/*{{{*/
+	conf_free (&g_conf, 1);
+}/*}}}*/
+
+/**
+ * Free the config structure.
+ *
+ * \param[in,out] c 	config to free.
+ * \param[in] leds 	turn the configured leds off.
+ */
+static void
+conf_free (svd_conf_s * const c, int const leds)
 {/*{{{*/
 	int i;
 	
-	if (g_conf.dial_plan)
-	  su_vector_destroy(g_conf.dial_plan);
+	if (c->dial_plan)
+	  su_vector_destroy(c->dial_plan);
 	
-	if (g_conf.sip_account)
-	  su_vector_destroy(g_conf.sip_account);
+	if (c->sip_account)
+	  su_vector_destroy(c->sip_account);
 	
-	if (g_conf.voip_led) {
-	  led_off(g_conf.voip_led);
-	  free(g_conf.voip_led);
+	if (c->voip_led) {
+	  if (leds)
+	    led_off(c->voip_led);
+	  free(c->voip_led);
 	}
-	if (g_conf.local_ip)
-	  free(g_conf.local_ip);
+	if (c->local_ip)
+	  free(c->local_ip);
+	if (c->log_file)
+	  free(c->log_file);
+	if (c->log_subsys)
+	  free(c->log_subsys);
+	if (c->dial_tone)
+	  free(c->dial_tone);
+	if (c->ring_tone)
+	  free(c->ring_tone);
+	if (c->busy_tone)
+	  free(c->busy_tone);
+	if (c->tone_zone)
+	  free(c->tone_zone);
+	if (c->cid_intnl_prefix)
+	  free(c->cid_intnl_prefix);
+	if (c->cdr_file)
+	  free(c->cdr_file);
+	if (c->media_engine)
+	  free(c->media_engine);
 	
-	for (i=0; i<g_conf.channels; i++) {
-	  if (g_conf.chan_led[i]) {
-	    led_off(g_conf.chan_led[i]);
-	    free(g_conf.chan_led[i]);
+	for (i=0; c->chan_led && i<c->channels; i++) {
+	  if (c->chan_led[i]) {
+	    if (leds)
+	      led_off(c->chan_led[i]);
+	    free(c->chan_led[i]);
 	  }
 	}
+	for (i=0; c->chan_cid && i<c->channels; i++) {
+	  if (c->chan_cid[i])
+	    free(c->chan_cid[i]);
+	}
+	if (c->chan_led)
+	  free(c->chan_led);
+	if (c->chan_cid)
+	  free(c->chan_cid);
+	if (c->audio_prms)
+	  free(c->audio_prms);
+	if (c->wlec_prms)
+	  free(c->wlec_prms);
 	
-	memset(&g_conf, 0, sizeof(g_conf));
+	memset(c, 0, sizeof(*c));
+}/*}}}*/
+
+/** Exchange two values of the same type.*/
+#define CONF_SWAP(a,b) do { \
+	__typeof__(a) conf_swap_tmp = (a); (a) = (b); (b) = conf_swap_tmp; \
+} while (0)
+
+/**
+ * Compare two optional strings.
+ *
+ * \param[in] a 	string or NULL.
+ * \param[in] b 	string or NULL.
+ * \retval 1 	strings are equal (or both are NULL).
+ * \retval 0 	strings differ.
+ */
+static int
+conf_str_eq (char const * const a, char const * const b)
+{/*{{{*/
+	if (!a || !b)
+		return a == b;
+	return !strcmp(a, b);
+}/*}}}*/
+
+/**
+ * Reads the config files again and applies the changes to \ref g_conf.
+ *
+ * \param[in] svd 	svd context structure.
+ * \param[out] res 	what is changed (can be NULL).
+ * \retval 0 success.
+ * \retval -1 the new config is wrong, the running one is kept.
+ * \remark
+ * 		The new config is parsed into the fresh structure and compared
+ * 		with the running one. Just the changed accounts register again,
+ * 		the dial plan is replaced in one step, the media parameters
+ * 		are taken at the next media activation and the tones / caller id
+ * 		wait for the idle channel. Active calls are not touched.
+ * 		Options of the SIP stack and the RTP sockets need the restart.
+ */
+int
+svd_conf_reload( svd_t * const svd, struct conf_reload_s * const res )
+{/*{{{*/
+	svd_conf_s fresh;
+	svd_conf_s old;
+	struct conf_reload_s r;
+	int tones;
+	int err;
+DFS
+	memset(&r, 0, sizeof(r));
+
+	/* parse into the fresh config */
+	old = g_conf;
+	g_conf_reloading = 1;
+	err = conf_create (old.channels, svd->home);
+	if( !err){
+		err = uci_config_load();
+	}
+	if( !err){
+		err = conf_check();
+	}
+	g_conf_reloading = 0;
+	fresh = g_conf;
+	g_conf = old;
+	if(err){
+		SU_DEBUG_1(("Config reload failed, running config is kept\n" VA_NONE));
+		goto __exit;
+	}
+
+	/* apply the differences to the running config */
+	tones = memcmp(g_conf.tones, fresh.tones, sizeof(g_conf.tones));
+	conf_reload_main (&fresh, &r);
+	err = conf_reload_accounts (svd, &fresh, &r);
+	if(err){
+		goto __exit;
+	}
+	if (memcmp(g_conf.codecs, fresh.codecs, sizeof(g_conf.codecs)) ||
+			memcmp(&g_conf.fax, &fresh.fax, sizeof(g_conf.fax))) {
+		memcpy(g_conf.codecs, fresh.codecs, sizeof(g_conf.codecs));
+		memcpy(&g_conf.fax, &fresh.fax, sizeof(g_conf.fax));
+		r.codecs = 1;
+	}
+	conf_reload_chans (svd, &fresh, &r, tones);
+
+	SU_DEBUG_2(("Config reloaded: accounts +%d ~%d =%d -%d, dial plan %d, "
+			"codecs %d, channels %d (%d pending), restart needed %d\n",
+			r.accounts_added, r.accounts_changed, r.accounts_updated,
+			r.accounts_removed, r.dial_plan, r.codecs, r.chans,
+			r.chans_pending, r.restart));
+	conf_show();
+__exit:
+	conf_free (&fresh, 0);
+	if (res)
+		*res = r;
+DFE
+	return err;
+}/*}}}*/
+
+/**
+ * Apply the changes of the main options.
+ *
+ * \param[in,out] c 	fresh config, changed values are moved from it.
+ * \param[in,out] r 	reload results.
+ */
+static void
+conf_reload_main (svd_conf_s * const c, struct conf_reload_s * const r)
+{/*{{{*/
+	/* stack, sockets and loop options are taken at the start only */
+	if (!conf_str_eq(g_conf.local_ip, c->local_ip) ||
+			g_conf.sip_tos != c->sip_tos ||
+			g_conf.rtp_tos != c->rtp_tos ||
+			g_conf.rtp_port_first != c->rtp_port_first ||
+			g_conf.rtp_port_last != c->rtp_port_last ||
+			g_conf.log_level != c->log_level ||
+			!conf_str_eq(g_conf.log_file, c->log_file) ||
+			!conf_str_eq(g_conf.log_subsys, c->log_subsys) ||
+			g_conf.slow_handler_ms != c->slow_handler_ms ||
+			!conf_str_eq(g_conf.cdr_file, c->cdr_file) ||
+			g_conf.cdr_size != c->cdr_size ||
+			g_conf.cdr_files != c->cdr_files ||
+			g_conf.cdr_sync != c->cdr_sync ||
+			!conf_str_eq(g_conf.media_engine, c->media_engine)) {
+		SU_DEBUG_2(("Config reload: main network/log/cdr/media options are "
+				"changed, restart svd to apply them\n" VA_NONE));
+		r->restart++;
+	}
+
+	CONF_SWAP(g_conf.cid_intnl_prefix, c->cid_intnl_prefix);
+	CONF_SWAP(g_conf.dial_tone, c->dial_tone);
+	CONF_SWAP(g_conf.ring_tone, c->ring_tone);
+	CONF_SWAP(g_conf.busy_tone, c->busy_tone);
+	CONF_SWAP(g_conf.tone_zone, c->tone_zone);
+	memcpy(g_conf.tones, c->tones, sizeof(g_conf.tones));
+
+	if (!conf_str_eq(g_conf.voip_led, c->voip_led)) {
+		int i;
+		int registered = 0;
+		if (g_conf.voip_led)
+			led_off(g_conf.voip_led);
+		CONF_SWAP(g_conf.voip_led, c->voip_led);
+		for (i=0; i<su_vector_len(g_conf.sip_account); i++) {
+			sip_account_t * acc = su_vector_item(g_conf.sip_account, i);
+			if (acc->registered)
+				registered = 1;
+		}
+		if (g_conf.voip_led) {
+			if (registered)
+				led_on(g_conf.voip_led);
+			else
+				led_off(g_conf.voip_led);
+		}
+	}
+}/*}}}*/
+
+/**
+ * Check if the account should register again to apply the changes.
+ *
+ * \param[in] a 	running account.
+ * \param[in] b 	fresh account.
+ * \retval 1 	registration options differ.
+ * \retval 0 	registration options are the same.
+ */
+static int
+conf_account_reg_differs (sip_account_t const * const a,
+		sip_account_t const * const b)
+{/*{{{*/
+	return !conf_str_eq(a->registrar, b->registrar) ||
+			!conf_str_eq(a->user_name, b->user_name) ||
+			!conf_str_eq(a->user_pass, b->user_pass) ||
+			!conf_str_eq(a->user_URI, b->user_URI) ||
+			!conf_str_eq(a->display, b->display) ||
+			!conf_str_eq(a->outbound_proxy, b->outbound_proxy) ||
+			!conf_str_eq(a->user_agent, b->user_agent);
+}/*}}}*/
+
+/**
+ * Check if the account call options differ.
+ *
+ * \param[in] a 	running account.
+ * \param[in] b 	fresh account.
+ * \retval 1 	call options differ.
+ * \retval 0 	call options are the same.
+ */
+static int
+conf_account_calls_differ (sip_account_t const * const a,
+		sip_account_t const * const b)
+{/*{{{*/
+	return !conf_str_eq(a->sip_domain, b->sip_domain) ||
+#ifndef DONT_BIND_TO_DEVICE
+			!conf_str_eq(a->rtp_interface, b->rtp_interface) ||
+#endif
+			memcmp(a->codecs, b->codecs, sizeof(a->codecs)) ||
+			a->dtmf != b->dtmf ||
+			memcmp(a->outgoing_priority, b->outgoing_priority,
+					g_conf.channels * sizeof(*a->outgoing_priority)) ||
+			memcmp(a->ring_incoming, b->ring_incoming,
+					CHSET_WORDS(g_conf.channels) * sizeof(chset_t));
+}/*}}}*/
+
+/**
+ * Apply the changes of the accounts and the dial plan.
+ *
+ * \param[in] svd 	svd context structure.
+ * \param[in,out] c 	fresh config, used values are moved from it.
+ * \param[in,out] r 	reload results.
+ * \retval 0 success.
+ * \retval -1 no memory, nothing is changed.
+ * \remark
+ * 		Accounts are matched by the name. Calls and registrations
+ * 		point to the running account structures, so the changed values
+ * 		are moved into them and the structures stay. Removed accounts
+ * 		are disabled and unregistered, they stay in the table (so do
+ * 		the indexes the dial plan uses) until the restart.
+ */
+static int
+conf_reload_accounts (svd_t * const svd, svd_conf_s * const c,
+		struct conf_reload_s * const r)
+{/*{{{*/
+	int old_n = su_vector_len(g_conf.sip_account);
+	int new_n = su_vector_len(c->sip_account);
+	int * remap = NULL;
+	unsigned char * kept = NULL;
+	int lost = 0;
+	int i;
+	int j;
+
+	remap = calloc(new_n + 1, sizeof(*remap));
+	kept = calloc(old_n + 1, sizeof(*kept));
+	if( !remap || !kept){
+		SU_DEBUG_0((LOG_FNC_A(LOG_NOMEM)));
+		goto __exit_fail;
+	}
+
+	for (i=0; i<new_n; i++) {
+		sip_account_t * n = su_vector_item(c->sip_account, i);
+		sip_account_t * o = NULL;
+		int reg;
+		int calls;
+		int was_enabled;
+
+		for (j=0; j<old_n; j++) {
+			o = su_vector_item(g_conf.sip_account, j);
+			if (!strcmp(o->name, n->name))
+				break;
+		}
+		if (j == old_n) {
+			/* new account, move it to the running table */
+			o = malloc(sizeof(*o));
+			if( !o){
+				SU_DEBUG_0((LOG_FNC_A(LOG_NOMEM)));
+				lost = 1;
+				continue;
+			}
+			*o = *n;
+			memset(n, 0, sizeof(*n));
+			if (su_vector_append(g_conf.sip_account, o)) {
+				*n = *o;
+				free(o);
+				lost = 1;
+				continue;
+			}
+			remap[i] = su_vector_len(g_conf.sip_account) - 1;
+			svd_account_register (svd, o);
+			r->accounts_added++;
+			continue;
+		}
+		kept[j] = 1;
+		remap[i] = j;
+
+		reg = conf_account_reg_differs (o, n);
+		calls = conf_account_calls_differ (o, n);
+		was_enabled = o->enabled;
+		if (!reg && !calls && was_enabled == n->enabled)
+			continue;
+
+		CONF_SWAP(o->registrar, n->registrar);
+		CONF_SWAP(o->user_name, n->user_name);
+		CONF_SWAP(o->user_pass, n->user_pass);
+		CONF_SWAP(o->user_URI, n->user_URI);
+		CONF_SWAP(o->display, n->display);
+		CONF_SWAP(o->outbound_proxy, n->outbound_proxy);
+		CONF_SWAP(o->user_agent, n->user_agent);
+		CONF_SWAP(o->sip_domain, n->sip_domain);
+#ifndef DONT_BIND_TO_DEVICE
+		CONF_SWAP(o->rtp_interface, n->rtp_interface);
+#endif
+		CONF_SWAP(o->outgoing_priority, n->outgoing_priority);
+		CONF_SWAP(o->ring_incoming, n->ring_incoming);
+		memcpy(o->codecs, n->codecs, sizeof(o->codecs));
+		o->dtmf = n->dtmf;
+		o->enabled = n->enabled;
+
+		if (was_enabled && !o->enabled) {
+			svd_account_unregister (svd, o);
+			r->accounts_removed++;
+		} else if (o->enabled && (!was_enabled || reg)) {
+			/* old handle un-REGISTERs, the answer registers the new one */
+			svd_account_register (svd, o);
+			r->accounts_changed++;
+		} else {
+			r->accounts_updated++;
+		}
+	}
+	for (j=0; j<old_n; j++) {
+		sip_account_t * o = su_vector_item(g_conf.sip_account, j);
+		if (kept[j] || !o->enabled)
+			continue;
+		o->enabled = 0;
+		svd_account_unregister (svd, o);
+		r->accounts_removed++;
+	}
+
+	/* dial plan refers to the accounts by the running table index */
+	if (lost) {
+		SU_DEBUG_1(("Config reload: not all accounts are added, "
+				"dial plan is kept\n" VA_NONE));
+		goto __exit;
+	}
+	for (i=0; i<su_vector_len(c->dial_plan); i++) {
+		struct dplan_record_s * d = su_vector_item(c->dial_plan, i);
+		d->account = remap[d->account];
+	}
+	if (su_vector_len(c->dial_plan) != su_vector_len(g_conf.dial_plan)) {
+		r->dial_plan = 1;
+	}
+	for (i=0; !r->dial_plan && i<su_vector_len(c->dial_plan); i++) {
+		struct dplan_record_s * d = su_vector_item(c->dial_plan, i);
+		struct dplan_record_s * e = su_vector_item(g_conf.dial_plan, i);
+		r->dial_plan = strcmp(d->prefix, e->prefix) ||
+				strcmp(d->replace, e->replace) ||
+				d->account != e->account;
+	}
+	if (r->dial_plan) {
+		CONF_SWAP(g_conf.dial_plan, c->dial_plan);
+	}
+
+__exit:
+	free(remap);
+	free(kept);
+	return 0;
+__exit_fail:
+	if (remap)
+		free(remap);
+	if (kept)
+		free(kept);
+	return -1;
+}/*}}}*/
+
+/**
+ * Apply the changes of the channels parameters.
+ *
+ * \param[in] svd 	svd context structure.
+ * \param[in,out] c 	fresh config, changed values are moved from it.
+ * \param[in,out] r 	reload results.
+ * \param[in] tones 	tones are changed.
+ * \remark
+ * 		Audio and WLEC parameters are compared with the DSP tuning on
+ * 		the next media activation, so the calls in progress keep the old
+ * 		ones. Tones and caller id are set on the idle channel.
+ */
+static void
+conf_reload_chans (svd_t * const svd, svd_conf_s * const c,
+		struct conf_reload_s * const r, int const tones)
+{/*{{{*/
+	int i;
+
+	for (i=0; i<g_conf.channels; i++) {
+		ab_chan_t * chan = &svd->ab->chans[i];
+		svd_chan_t * ctx = chan->ctx;
+		int changed = 0;
+
+		if (memcmp(&g_conf.audio_prms[i], &c->audio_prms[i],
+				sizeof(g_conf.audio_prms[i]))) {
+			memcpy(&g_conf.audio_prms[i], &c->audio_prms[i],
+					sizeof(g_conf.audio_prms[i]));
+			changed = 1;
+		}
+		if (memcmp(&g_conf.wlec_prms[i], &c->wlec_prms[i],
+				sizeof(g_conf.wlec_prms[i]))) {
+			memcpy(&g_conf.wlec_prms[i], &c->wlec_prms[i],
+					sizeof(g_conf.wlec_prms[i]));
+			changed = 1;
+		}
+		if (!conf_str_eq(g_conf.chan_led[i], c->chan_led[i])) {
+			if (g_conf.chan_led[i])
+				led_off(g_conf.chan_led[i]);
+			CONF_SWAP(g_conf.chan_led[i], c->chan_led[i]);
+			if (g_conf.chan_led[i]) {
+				if (ctx->off_hook)
+					led_on(g_conf.chan_led[i]);
+				else
+					led_off(g_conf.chan_led[i]);
+			}
+			changed = 1;
+		}
+		if (!conf_str_eq(g_conf.chan_cid[i], c->chan_cid[i])) {
+			CONF_SWAP(g_conf.chan_cid[i], c->chan_cid[i]);
+			ctx->conf_pending = 1;
+			changed = 1;
+		}
+		if (tones) {
+			ctx->tones_pending = 1;
+			changed = 1;
+		}
+		if (changed)
+			r->chans++;
+		if (svd_chan_conf_idle (svd, chan))
+			r->chans_pending++;
+	}
 }/*}}}*/
 
 /**
@@ -1586,7 +2273,7 @@ audio_defaults( void )
 	curr_rec->dec_dB = 0;
 	curr_rec->VAD_cfg = vad_cfg_OFF;
 	curr_rec->HPF_is_ON = 0;
-	for (i=1; i<CHANS_MAX; i++){
+	for (i=1; i<g_conf.channels; i++){
 		curr_rec = &g_conf.audio_prms[i];
 		memcpy(curr_rec, &g_conf.audio_prms[0], sizeof(*curr_rec));
 	}
@@ -1602,7 +2289,7 @@ wlec_defaults( ab_t const * const ab )
 	ab_chan_t * cc; /* current channel */
 	int i;
 	/* Standart params for all chans */
-	for (i=0; i<CHANS_MAX; i++){
+	for (i=0; i<g_conf.channels; i++){
 		curr_rec = &g_conf.wlec_prms[i];
 		cc = ab->pchans[i];
 		if( !cc) {
@@ -1668,6 +2355,11 @@ Mandatory arguments to long options are mandatory for short options too.\n\
   -V, --version      displey current version and license info\n\
   -d, --debug        set the debug level (form 0 to 9)\n\
   -f, --foreground   run in foreground (don't daemonize)\n\
+  -s, --sim          use the simulated board (see libab ab_sim.c)\n\
+  -r, --record FILE  record board events, RTP and SIP to FILE (svd_replay)\n\
+  -C, --confdir DIR  read the uci svd config from DIR, not /etc/config\n\
+  -H, --handoff FD   take the board and calls from the running svd\n\
+                     (set by \"svd_if handoff[]\", not for manual use)\n\
 \n\
 	Execution example :\n\
 	%s -d9\n\
@@ -11,6 +11,7 @@
 #include "ab_api.h"
 #include "sofia.h"
 #include "svd.h"
+#include "svd_lat.h"
 
 /** @defgroup CFG_DF Default values.
  *  @ingroup CFG_M
@@ -30,6 +31,45 @@
 #define PLACE_CALL_MARKER '#'
 /** @}*/
 
+/** @defgroup CHSET Channels sets.
+ *  @ingroup CFG_M
+ *  Bit per channel, the set of \ref g_conf channels takes
+ *  CHSET_WORDS(g_conf.channels) words.
+ *  @{*/
+/** Channels set word.*/
+typedef unsigned long chset_t;
+/** Channels in one word.*/
+#define CHSET_BITS (8 * sizeof(chset_t))
+/** Words for n channels.*/
+#define CHSET_WORDS(n) (((n) + CHSET_BITS - 1) / CHSET_BITS)
+
+/**
+ * Add the channel to the set.
+ *
+ * \param[in,out] set 	channels set.
+ * \param[in] ch 		channel index.
+ */
+static inline void
+chset_add (chset_t * const set, int const ch)
+{/*{{{*/
+	set[ch / CHSET_BITS] |= 1UL << (ch % CHSET_BITS);
+}/*}}}*/
+
+/**
+ * Check if the channel is in the set.
+ *
+ * \param[in] set 	channels set.
+ * \param[in] ch 	channel index.
+ * \retval 0 	channel is not in the set.
+ * \retval 1 	channel is in the set.
+ */
+static inline int
+chset_has (chset_t const * const set, int const ch)
+{/*{{{*/
+	return (set[ch / CHSET_BITS] >> (ch % CHSET_BITS)) & 1;
+}/*}}}*/
+/** @}*/
+
 /** @defgroup STARTUP Startup configuration.
  *  \ref g_so struct (startup options) and functions to manipulate with it.
  *  @{*/
@@ -37,6 +77,9 @@
 COMMAND LINE KEYS:
   -h, --help		display this help and exit
   -V, --version		show version and exit
+  -s, --sim		use the simulated board instead of TAPI
+  -r, --record FILE	record events and traffic to FILE
+  -H, --handoff FD	take the board and calls from the running svd
 */
 
 /** Startup keys set. */
@@ -45,6 +88,10 @@ typedef struct {
 	unsigned char version; /**< Show version and exit. */
 	unsigned char foreground; /**< do not daemonize */
 	char debug_level; /**< Logging level in debug mode. */
+	unsigned char sim; /**< use the simulated board backend */
+	char const * rec_path; /**< record traffic to this file (or NULL) */
+	char const * confdir; /**< uci config directory (or NULL for default) */
+	int handoff_fd; /**< socket to the handed off svd (or -1) */
 } _startup_options;
 extern _startup_options g_so;
 
@@ -69,8 +116,23 @@ void startup_destroy( int argc, char ** argv );
 #define IP_LEN_MAX	16 /* xxx.xxx.xxx.xxx\0 */
 /*}}}*/
 
+/** What \ref svd_conf_reload() has changed.*/
+struct conf_reload_s {/*{{{*/
+	int accounts_added; /**< New accounts.*/
+	int accounts_changed; /**< Accounts registered again (or enabled).*/
+	int accounts_updated; /**< Accounts changed without registration.*/
+	int accounts_removed; /**< Accounts removed or disabled.*/
+	int dial_plan; /**< Dial plan is replaced.*/
+	int codecs; /**< Codecs parameters are changed.*/
+	int chans; /**< Channels with changed parameters.*/
+	int chans_pending; /**< Of them wait for the idle channel.*/
+	int restart; /**< Changed options that need the restart.*/
+};/*}}}*/
+
 /** Reads config files and init \ref g_conf structure.*/
 int  svd_conf_init( ab_t const * const ab, su_home_t * home );
+/** Reads config files again and applies the changes to \ref g_conf.*/
+int  svd_conf_reload( svd_t * const svd, struct conf_reload_s * const res );
 /** Show the config information from \ref g_conf.*/
 void conf_show( void );
 /** Destroy \ref g_conf.*/
@@ -114,14 +176,16 @@ struct sip_account_s {
 #ifndef DONT_BIND_TO_DEVICE
 	char *rtp_interface; /**<interface to use for rtp traffic */
 #endif
-	int outgoing_priority[CHANS_MAX]; /**< priority of this account for outgoing calls, per channel (lower number takes precedence, 0 don't use) */
-	unsigned char ring_incoming[CHANS_MAX]; /**< which channels to ring for incoming calls */
+	int * outgoing_priority; /**< priority of this account for outgoing calls, per channel (lower number takes precedence, 0 don't use), g_conf.channels items */
+	chset_t * ring_incoming; /**< which channels to ring for incoming calls */
 	unsigned char registered; /**< Account correctly registered.*/
 	char * registration_reply; /**<Last registration reply received from registrar-> */
 	char * sip_contact; /**< Sip contact received from registrar to be used in invite> */
 	nua_handle_t * op_reg; /**< Pointer to NUA Handle for registration.*/
 	su_timer_t * reg_tmr; /**< Registration retry timer. */
+	unsigned long long reg_due; /**< Retry timer deadline (loop lag).*/
 	dtmf_type_e dtmf; /**<How to send dtmf */
+	struct lat_stat_s lat; /**< Call setup latency histograms.*/
 };
 /** Fax parameters.*/
 struct fax_s {
@@ -135,6 +199,9 @@ typedef struct {/*{{{*/
 	int channels; /**<Number of configured channels (from svd_chans_init). */
 	char * local_ip; /**< local ip for the nua stack or NULL.*/
 	char log_level; /**< If log_level = -1 - do not log anything.*/
+	char * log_file; /**< Write logs to this file instead of syslog.*/
+	char * log_subsys; /**< Per-subsystem levels ("nua:3 tport:1").*/
+	int slow_handler_ms; /**< Log main loop handlers longer then it.*/
 	struct fax_s fax;/**< Fax parameters.*/ /* FIXME */
 	unsigned long rtp_port_first; /**< Min ports range bound for RTP.*/
 	unsigned long rtp_port_last; /**< Max ports range bound for RTP.*/
@@ -142,16 +209,24 @@ typedef struct {/*{{{*/
 	codec_t codecs[COD_MAS_SIZE];/**< Codecs definitions.*/
 	su_vector_t *  sip_account; /**< SIP settings for registration.*/
 	su_vector_t * dial_plan; /**< Dial plan.*/
-	struct rtp_session_prms_s audio_prms [CHANS_MAX]; /**< AUDIO channel params.*/
-	struct wlec_s       wlec_prms    [CHANS_MAX]; /**< WLEC channel parameters.*/
+	struct rtp_session_prms_s * audio_prms; /**< AUDIO channel params (channels items).*/
+	struct wlec_s       * wlec_prms; /**< WLEC channel parameters (channels items).*/
 	char * voip_led; /** Name of the main voip led */
-	char * chan_led [CHANS_MAX]; /**Name of the led for each channel*/
+	char ** chan_led; /**Name of the led for each channel (channels items)*/
+	char ** chan_cid; /**< Caller id standard for each channel (channels items) or NULL.*/
 	unsigned char sip_tos; /** Type of Service byte for sip-packets.*/
 	unsigned char rtp_tos; /** Type of Service byte for rtp-packets.*/
 	char * dial_tone; /* Custom dial tone (asterisk style string). */
 	char * ring_tone; /* Custom ringing tone (asterisk style string). */
 	char * busy_tone; /* Custom busy tone (asterisk style string). */
+	char * tone_zone; /* Tone zone name or NULL (AB_TONE_ZONE_DF). */
+	ab_tone_t tones [ab_chan_tone_COUNT]; /* Zone tones with the custom ones (compiled). */
 	char * cid_intnl_prefix; /* Replace + with this string in caller id */
+	char * cdr_file; /**< Call detail records file or NULL.*/
+	int cdr_size; /**< Rotate the records file bigger then it (KB).*/
+	int cdr_files; /**< Rotated records files count.*/
+	int cdr_sync; /**< Records file sync period (s).*/
+	char * media_engine; /**< Media engine ("poll" or "uring") or NULL (poll).*/
 } svd_conf_s;
 extern svd_conf_s g_conf;/*}}}*/
 
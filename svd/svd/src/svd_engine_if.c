@@ -207,6 +207,16 @@ svd_if_srv_parse (char const * const str, struct svdif_msg_s * const msg,
 		{"shutdown",      ch_t_NONE  , msg_fmt_CLI},
 		{"get_regs",      ch_t_NONE  , msg_fmt_JSON},
 		{"get_chans",     ch_t_NONE  , msg_fmt_JSON},
+		{"get_flight",    ch_t_NONE  , msg_fmt_CLI},
+		{"get_lat",       ch_t_NONE  , msg_fmt_JSON},
+		{"get_loop",      ch_t_NONE  , msg_fmt_JSON},
+		{"get_ioctl",     ch_t_NONE  , msg_fmt_JSON},
+		{"get_events",    ch_t_NONE  , msg_fmt_JSON},
+		{"reload",        ch_t_NONE  , msg_fmt_JSON},
+		{"handoff",       ch_t_NONE  , msg_fmt_JSON},
+		{"get_startup",   ch_t_NONE  , msg_fmt_JSON},
+		{"get_call_mem",  ch_t_NONE  , msg_fmt_JSON},
+		{"get_log",       ch_t_NONE  , msg_fmt_JSON},
 	};
 	char pstr[MAX_MSG_SIZE] = {0,};
 	char *command = NULL;
@@ -236,6 +246,16 @@ svd_if_srv_parse (char const * const str, struct svdif_msg_s * const msg,
 	if( (msg->type == msg_type_GET_JB_STAT_TOTAL) ||
 		(msg->type == msg_type_REGISTRATIONS) ||
 		(msg->type == msg_type_CHANNELS) ||
+		(msg->type == msg_type_FLIGHT) ||
+		(msg->type == msg_type_LATENCY) ||
+		(msg->type == msg_type_LOOP) ||
+		(msg->type == msg_type_IOCTL) ||
+		(msg->type == msg_type_EVENTS) ||
+		(msg->type == msg_type_RELOAD) ||
+		(msg->type == msg_type_HANDOFF) ||
+		(msg->type == msg_type_STARTUP) ||
+		(msg->type == msg_type_CALL_MEM) ||
+		(msg->type == msg_type_LOG) ||
 		(msg->type == msg_type_SHUTDOWN)){
 		/* nothing to do */
 	} else {/* jb/rtcp stat */
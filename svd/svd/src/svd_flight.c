@@ -0,0 +1,197 @@
+/**
+ * @file svd_flight.c
+ * Flight recorder implementation.
+ * It containes the recorder ring, records decoder and crash dump.
+ */
+
+/* Includes {{{ */
+#include "svd.h"
+#include "svd_flight.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+/*}}}*/
+
+/** The recorder ring.*/
+struct flight_s g_flight;
+
+/** Crash signal handler.*/
+static void svd_flight_crash (int signum);
+/** Write one decoded record to the file descriptor.*/
+static int svd_flight_write_rec (struct flight_rec_s const * const r,
+		void * arg);
+
+/** Records types names.*/
+static char const * const flight_type_name [flight_type_COUNT] = {
+	"none", "atab", "nua", "media_on", "media_off", "reg", "reg_up", "reg_down",
+};
+
+/** Ata board events names (\ref ab_dev_event_e).*/
+static char const * const flight_atab_name [] = {
+	"none", "uncatched", "fxo_ringing", "digit_tone", "digit_pulse",
+	"onhook", "offhook", "fm_ced", "cod", "tone",
+};
+
+/**
+ * Init the ring and install crash signals handler.
+ *
+ * \remark
+ * 		Handler dumps the decoded ring to \ref FLIGHT_DUMP_FILE and
+ * 		re-raises the signal with default action.
+ */
+void
+svd_flight_init (void)
+{/*{{{*/
+	struct sigaction sa;
+	struct timespec mono;
+
+	memset(&g_flight, 0, sizeof(g_flight));
+	clock_gettime(CLOCK_MONOTONIC, &mono);
+	g_flight.mono_to_real = time(NULL) - mono.tv_sec;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = svd_flight_crash;
+	sa.sa_flags = SA_RESETHAND;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGSEGV, &sa, NULL);
+	sigaction(SIGBUS, &sa, NULL);
+	sigaction(SIGILL, &sa, NULL);
+	sigaction(SIGFPE, &sa, NULL);
+	sigaction(SIGABRT, &sa, NULL);
+}/*}}}*/
+
+/**
+ * Decode the record to the text line.
+ *
+ * \param[in] r 	record to decode
+ * \param[out] buf 	buffer for the line
+ * \param[in] size 	buffer size
+ * \return 	line length
+ * \remark
+ * 		Line is "HH:MM:SS.uuuuuu type chN event args" with '\\n' at the end,
+ * 		time is UTC (gmtime_r() takes no locks, it is used on crash).
+ */
+int
+svd_flight_decode (struct flight_rec_s const * const r,
+		char * const buf, int const size)
+{/*{{{*/
+	char const * tn = "?";
+	char ev[32];
+	time_t t = r->sec + g_flight.mono_to_real;
+	struct tm tm;
+	int len;
+
+	gmtime_r(&t, &tm);
+	if(r->type < flight_type_COUNT){
+		tn = flight_type_name[r->type];
+	}
+
+	if(r->type == flight_type_ATAB){
+		if(r->a >= 0 && r->a < sizeof(flight_atab_name)/sizeof(*flight_atab_name)){
+			snprintf(ev, sizeof(ev), "%s", flight_atab_name[r->a]);
+		} else {
+			snprintf(ev, sizeof(ev), "%ld", r->a);
+		}
+		if(r->a == ab_dev_event_FXS_DIGIT_TONE ||
+				r->a == ab_dev_event_FXS_DIGIT_PULSE){
+			len = snprintf(buf, size, "%02d:%02d:%02d.%06lu %s ch%d %s '%c'\n",
+					tm.tm_hour, tm.tm_min, tm.tm_sec, r->nsec/1000,
+					tn, r->chan+1, ev, (char)(r->b & 0xFF));
+			goto __exit;
+		}
+	} else if(r->type == flight_type_NUA){
+		snprintf(ev, sizeof(ev), "%s", nua_event_name(r->a));
+	} else {
+		snprintf(ev, sizeof(ev), "%ld", r->a);
+	}
+
+	len = snprintf(buf, size, "%02d:%02d:%02d.%06lu %s ch%d %s %ld h:%lx\n",
+			tm.tm_hour, tm.tm_min, tm.tm_sec, r->nsec/1000,
+			tn, r->chan+1, ev, r->b, r->tag);
+__exit:
+	if(len >= size){
+		len = size-1;
+	}
+	return len;
+}/*}}}*/
+
+/**
+ * Call the function for every record from the oldest to the newest.
+ *
+ * \param[in] func 	function to call, non-zero return stops the walk
+ * \param[in] arg 	argument for the function
+ * \return 	the last \c func return value
+ */
+int
+svd_flight_foreach (int (*func)(struct flight_rec_s const * const r,
+		void * arg), void * arg)
+{/*{{{*/
+	unsigned long i;
+	unsigned long first = 0;
+	int err = 0;
+
+	if(g_flight.pos > FLIGHT_RECS){
+		first = g_flight.pos - FLIGHT_RECS;
+	}
+	for (i=first; i<g_flight.pos; i++){
+		err = func(&g_flight.recs[i & (FLIGHT_RECS-1)], arg);
+		if(err){
+			break;
+		}
+	}
+	return err;
+}/*}}}*/
+
+/**
+ * Crash signal handler.
+ *
+ * \param[in] signum 	signal number
+ * \remark
+ * 		It is the best effort dump, formatting is not async-signal-safe
+ * 		in theory, but uses no allocations.
+ */
+static void
+svd_flight_crash (int signum)
+{/*{{{*/
+	char head [FLIGHT_LINE_LEN];
+	int fd;
+	int len;
+
+	fd = open(FLIGHT_DUMP_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd != -1){
+		len = snprintf(head, sizeof(head), "svd crashed with signal %d, "
+				"%lu events recorded (UTC)\n", signum, g_flight.pos);
+		if(write(fd, head, len) == len){
+			svd_flight_foreach (svd_flight_write_rec, &fd);
+		}
+		close(fd);
+	}
+	raise(signum);
+}/*}}}*/
+
+/**
+ * Write one decoded record to the file descriptor.
+ *
+ * \param[in] r 	record
+ * \param[in] arg 	pointer to the file descriptor
+ * \retval 0 	etherything is fine
+ * \retval -1 	write error
+ */
+static int
+svd_flight_write_rec (struct flight_rec_s const * const r, void * arg)
+{/*{{{*/
+	char line [FLIGHT_LINE_LEN];
+	int len;
+
+	len = svd_flight_decode (r, line, sizeof(line));
+	if(write(*(int *)arg, line, len) != len){
+		return -1;
+	}
+	return 0;
+}/*}}}*/
+
@@ -0,0 +1,94 @@
+/**
+ * @file svd_flight.h
+ * Flight recorder.
+ * It containes the always-on binary ring of timestamped events (hook,
+ * 		digits, SIP, media and registrations) and its decoder.
+ */
+#ifndef __SVD_FLIGHT_H__
+#define __SVD_FLIGHT_H__
+
+#include <time.h>
+
+/** @defgroup FLIGHT Flight recorder.
+ *  Events are written to the fixed-size ring from the main loop only,
+ *  so recording is just a timestamp and a few stores.
+ *  @{*/
+/** Records count in the ring (should be a power of 2).*/
+#define FLIGHT_RECS 1024
+/** File to dump the ring to on crash.*/
+#define FLIGHT_DUMP_FILE "/var/svd/flight.log"
+/** Maximum length of the decoded record.*/
+#define FLIGHT_LINE_LEN 128
+
+/** Recorded event types.*/
+enum flight_type_e {/*{{{*/
+	flight_type_NONE, /**< Empty record */
+	flight_type_ATAB, /**< svd_atab_handler event (a - event, b - data) */
+	flight_type_NUA, /**< svd_nua_callback event (a - event, b - status) */
+	flight_type_MEDIA_ON, /**< Media activated (a - payload, b - error) */
+	flight_type_MEDIA_OFF, /**< Media deactivated (a - 0, b - error) */
+	flight_type_REG, /**< Registration reply (a - account, b - status) */
+	flight_type_REG_UP, /**< Account became registered (a - account) */
+	flight_type_REG_DOWN, /**< Account lost registration (a - account) */
+	flight_type_COUNT, /**< Types count */
+};/*}}}*/
+
+/** One record.*/
+struct flight_rec_s {/*{{{*/
+	unsigned long sec; /**< Monotonic seconds.*/
+	unsigned long nsec; /**< Monotonic nanoseconds.*/
+	unsigned short type; /**< \ref flight_type_e value.*/
+	int chan; /**< Channel index or -1.*/
+	long a; /**< First argument (see \ref flight_type_e).*/
+	long b; /**< Second argument (see \ref flight_type_e).*/
+	unsigned long tag; /**< NUA handle or other correlation value.*/
+};/*}}}*/
+
+/** Recorder ring.*/
+struct flight_s {/*{{{*/
+	struct flight_rec_s recs [FLIGHT_RECS]; /**< Records.*/
+	unsigned long pos; /**< Next record to write.*/
+	time_t mono_to_real; /**< Add to monotonic seconds to get wall time.*/
+};/*}}}*/
+extern struct flight_s g_flight;
+
+/** Init the ring and install crash handler.*/
+void svd_flight_init (void);
+/** Decode the record to the text line.*/
+int  svd_flight_decode (struct flight_rec_s const * const r,
+		char * const buf, int const size);
+/** Call the function for every record from the oldest to the newest.*/
+int  svd_flight_foreach (int (*func)(struct flight_rec_s const * const r,
+		void * arg), void * arg);
+
+/**
+ * Record one event.
+ *
+ * \param[in] type 	event type
+ * \param[in] chan 	channel index or -1
+ * \param[in] a 	first argument
+ * \param[in] b 	second argument
+ * \param[in] tag 	handle or other value to correlate records
+ * \remark
+ * 		It should be called from the main loop thread only.
+ */
+static inline void
+svd_flight_put (enum flight_type_e const type, int const chan,
+		long const a, long const b, void const * const tag)
+{/*{{{*/
+	struct flight_rec_s * r;
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	r = &g_flight.recs[g_flight.pos++ & (FLIGHT_RECS-1)];
+	r->sec = ts.tv_sec;
+	r->nsec = ts.tv_nsec;
+	r->type = type;
+	r->chan = chan;
+	r->a = a;
+	r->b = b;
+	r->tag = (unsigned long)tag;
+}/*}}}*/
+/** @}*/
+
+#endif /* __SVD_FLIGHT_H__ */
@@ -0,0 +1,1184 @@
+/**
+ * @file svd_handoff.c
+ * Handoff to the new svd binary implementation.
+ * It containes the sender of the running svd state and the new svd side
+ * that takes the board, the RTP sockets and the calls.
+ */
+
+/* Includes {{{ */
+#include "svd.h"
+#include "svd_handoff.h"
+#include "svd_atab.h"
+#include "svd_ua.h"
+#include "svd_rec.h"
+#include "svd_cdr.h"
+#include "svd_uring.h"
+#include "svd_logring.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+/*}}}*/
+
+/** Handoff state of both sides.*/
+static struct handoff_s {/*{{{*/
+	int argc; /**< Command line arguments count.*/
+	char ** argv; /**< Command line arguments.*/
+	unsigned char pending; /**< Handoff is requested (running svd).*/
+	unsigned char on; /**< State is taken (new svd).*/
+	int chans; /**< Channels count of the taken board.*/
+	int devs; /**< Devices count of the taken board.*/
+	int * fds; /**< Taken board descriptors (devs + chans items).*/
+	int * be_fds; /**< Their backend descriptors (-1 if none).*/
+	unsigned char * media_up; /**< Taken media state by channel index.*/
+	struct handoff_chan_s * chan; /**< Taken channels by index.*/
+	int * sfd; /**< Taken RTP sockets by channel index.*/
+	struct handoff_account_s * acc; /**< Taken accounts.*/
+	int acc_num; /**< Taken accounts count.*/
+	su_timer_t * idle_tmr; /**< Adopted calls RTP check timer.*/
+	unsigned long * idle_rx; /**< RTP packets at the previous check.*/
+	int * idle_ms; /**< Time without RTP (-1 if BYE is sent).*/
+} g_handoff;/*}}}*/
+
+/** Fill the message header.*/
+static void handoff_hdr (struct handoff_hdr_s * const h,
+		enum handoff_msg_e const type, ab_t const * const ab, int const accounts);
+/** Send the message with descriptors (async-signal-safe).*/
+static int handoff_sendmsg (int const sfd, void const * const msg,
+		int const len, int const * const fds, int const fds_num);
+/** Send the message with descriptors.*/
+static int handoff_send (int const sfd, void const * const msg, int const len,
+		int const * const fds, int const fds_num);
+/** Receive the message with descriptors.*/
+static int handoff_recv (int const sfd, void * const msg, int const len,
+		enum handoff_msg_e const type, int * const fds, int const fds_max,
+		int * const fds_num);
+/** Wait for the ack of the new svd (async-signal-safe).*/
+static int handoff_ack_wait (int const sfd);
+/** Wait for the sender exit.*/
+static void handoff_wait_eof (int const sfd);
+/** Fill the channel message from the channel and its call.*/
+static void handoff_chan_fill (svd_t * const svd, ab_chan_t const * const chan,
+		struct handoff_chan_s * const m);
+/** Send the state and wait for the new svd (the forked sender).*/
+static int handoff_sender (int const sfd, ab_t const * const ab,
+		int const * const fds, struct handoff_chan_s * const chans,
+		struct handoff_account_s * const accs, int const acc_num);
+/** Adopt the established call of the previous svd on the channel.*/
+static int handoff_adopt (svd_t * const svd, ab_chan_t * const chan,
+		struct handoff_chan_s const * const m);
+/** Check the adopted calls RTP.*/
+static void handoff_idle_cb (su_root_magic_t * magic, su_timer_t * t,
+		su_timer_arg_t * arg);
+/** Free the taken state.*/
+static void handoff_free (void);
+
+/**
+ * Remember the command line to exec the new svd with.
+ *
+ * \param[in] argc 	arguments count.
+ * \param[in] argv 	arguments values.
+ */
+void
+svd_handoff_argv (int const argc, char ** const argv)
+{/*{{{*/
+	g_handoff.argc = argc;
+	g_handoff.argv = argv;
+}/*}}}*/
+
+/**
+ * Stop the main loop to hand svd off.
+ *
+ * \param[in] svd 	svd context structure.
+ * \retval 0 	if etherything ok.
+ * \retval -1 	if the handoff is not possible.
+ * \remark
+ * 		main() calls \ref svd_handoff_exec() when the loop stops.
+ */
+int
+svd_handoff_request (svd_t * const svd)
+{/*{{{*/
+	if(g_handoff.pending){
+		SU_DEBUG_2(("Handoff is requested already\n" VA_NONE));
+		goto __exit_fail;
+	}
+	if( !g_handoff.argv){
+		SU_DEBUG_1(("Handoff: no command line to exec\n" VA_NONE));
+		goto __exit_fail;
+	}
+	if(access (g_handoff.argv[0], X_OK)){
+		SU_DEBUG_1(("Handoff: can`t exec \"%s\": %s\n",
+				g_handoff.argv[0], strerror(errno)));
+		goto __exit_fail;
+	}
+	SU_DEBUG_2(("Handoff to \"%s\" requested\n", g_handoff.argv[0]));
+	g_handoff.pending = 1;
+	su_root_break (svd->root);
+	return 0;
+__exit_fail:
+	return -1;
+}/*}}}*/
+
+/**
+ * Check if the handoff is requested.
+ *
+ * \retval 0 	svd goes on.
+ * \retval 1 	svd should be handed off.
+ */
+int
+svd_handoff_pending (void)
+{/*{{{*/
+	return g_handoff.pending;
+}/*}}}*/
+
+/**
+ * Fork the sender of the state and exec the new svd in this process.
+ *
+ * \param[in] svd 	svd context structure.
+ * \retval -1 	if the handoff failed before the point of no return,
+ * 		svd goes on.
+ * \remark
+ * 		The state is taken in this process, the sender child just passes
+ * 		it, so it does not touch the SIP stack and the board. This process
+ * 		closes all descriptors but the socketpair end before exec, the
+ * 		sender keeps them open until the new svd takes them.
+ * 		The logring flusher, the CDR writer and the ring live on in this
+ * 		process until exec, the fork can catch their locks (the malloc and
+ * 		the log ones) taken, so the sender runs async-signal-safe calls
+ * 		only: all messages are built here, it sends them and waits for
+ * 		the ack without logs and allocations.
+ */
+int
+svd_handoff_exec (svd_t * const svd)
+{/*{{{*/
+	ab_t * ab = svd->ab;
+	struct handoff_chan_s * chans = NULL;
+	struct handoff_account_s * accs = NULL;
+	int * fds = NULL;
+	char ** argv = NULL;
+	int acc_num = su_vector_len (g_conf.sip_account);
+	/* devices cfg_fd, channels rtp_fd, RTP sockets and backend fds */
+	int fds_num = ab->devs_num + 3 * ab->chans_num;
+	int sv[2] = {-1, -1};
+	char fd_str [16];
+	pid_t pid;
+	int fd_max;
+	int i;
+	int j;
+DFS
+	g_handoff.pending = 0;
+
+	if(ab->devs_num > HANDOFF_FDS_MAX){
+		SU_DEBUG_1(("Handoff: %d devices, the limit is %d\n",
+				ab->devs_num, HANDOFF_FDS_MAX));
+		goto __exit_fail;
+	}
+	chans = calloc (ab->chans_num, sizeof(*chans));
+	accs = calloc (acc_num + 1, sizeof(*accs));
+	fds = calloc (fds_num, sizeof(*fds));
+	argv = calloc (g_handoff.argc + 3, sizeof(*argv));
+	if( !chans || !accs || !fds || !argv){
+		SU_DEBUG_0 ((LOG_FNC_A (LOG_NOMEM)));
+		goto __exit_fail;
+	}
+
+	/* the state is taken here, the sender does not touch the stack */
+	for (i=0; i<ab->devs_num; i++){
+		fds[i] = ab->devs[i].cfg_fd;
+	}
+	for (i=0; i<ab->chans_num; i++){
+		svd_chan_t const * chan_ctx = ab->chans[i].ctx;
+		fds[ab->devs_num + i] = ab->chans[i].rtp_fd;
+		fds[ab->devs_num + ab->chans_num + i] = chan_ctx->rtp_sfd;
+		fds[ab->devs_num + 2 * ab->chans_num + i] = ab->chans[i].be_fd;
+		handoff_chan_fill (svd, &ab->chans[i], &chans[i]);
+		chans[i].media_up = ab->chans[i].statistics.is_up;
+		chans[i].has_sfd = chan_ctx->rtp_sfd != -1;
+		chans[i].has_be_fd = ab->chans[i].be_fd != -1;
+	}
+	for (i=0; i<acc_num; i++){
+		sip_account_t * account = su_vector_item (g_conf.sip_account, i);
+		handoff_hdr (&accs[i].h, handoff_msg_ACCOUNT, ab, acc_num);
+		snprintf (accs[i].name, sizeof(accs[i].name), "%s", account->name);
+		accs[i].registered = account->registered;
+	}
+
+	/* the same command line without the previous handoff key */
+	for (i=0, j=0; i<g_handoff.argc; i++){
+		char const * a = g_handoff.argv[i];
+		if( !strcmp(a, "-H") || !strcmp(a, "--handoff")){
+			i++;
+			continue;
+		} else if( !strncmp(a, "-H", 2) || !strncmp(a, "--handoff=", 10)){
+			continue;
+		}
+		argv[j++] = g_handoff.argv[i];
+	}
+
+	if(socketpair (AF_UNIX, SOCK_SEQPACKET, 0, sv)){
+		SU_DEBUG_1(("Handoff: socketpair() : %s\n", strerror(errno)));
+		goto __exit_fail;
+	}
+	snprintf (fd_str, sizeof(fd_str), "%d", sv[1]);
+	argv[j++] = "-H";
+	argv[j++] = fd_str;
+	argv[j] = NULL;
+
+	/* records of the old svd end here */
+	svd_rec_close ();
+
+	/* the ring receives are cancelled before the sender gets the sockets,
+	 * the forked sender keeps the ring descriptor */
+	if(svd_uring_on ()){
+		for (i=0; i<ab->chans_num; i++){
+			svd_uring_chan_del (&ab->chans[i]);
+		}
+	}
+
+	pid = fork ();
+	if(pid < 0){
+		SU_DEBUG_1(("Handoff: fork() : %s\n", strerror(errno)));
+		for (i=0; svd_uring_on () && i<ab->chans_num; i++){
+			svd_chan_t const * chan_ctx = ab->chans[i].ctx;
+			/* channels without the root waits were on the ring */
+			if(chan_ctx->local_wait_idx == -1){
+				svd_uring_chan_add (&ab->chans[i]);
+			}
+		}
+		goto __exit_fail;
+	} else if(pid == 0){
+		/* async-signal-safe calls only from here */
+		close (sv[1]);
+		_exit (handoff_sender (sv[0], ab, fds, chans, accs, acc_num) ?
+				EXIT_FAILURE : EXIT_SUCCESS);
+	}
+	SU_DEBUG_2(("Handoff: sender %d, exec \"%s\"\n", pid, argv[0]));
+
+	/* no way back from here, the sender holds the descriptors */
+	close (sv[0]);
+	svd_cdr_close ();
+	svd_uring_destroy ();
+	/* queued log lines are written before the log descriptors are closed */
+	svd_logring_destroy ();
+	fd_max = sysconf (_SC_OPEN_MAX);
+	if(fd_max < 0){
+		fd_max = 1024;
+	}
+	for (i=3; i<fd_max; i++){
+		if(i != sv[1]){
+			close (i);
+		}
+	}
+	execv (argv[0], argv);
+	/* the log descriptors are closed too */
+	fprintf (stderr, "svd handoff: exec \"%s\" : %s\n", argv[0], strerror(errno));
+	_exit (EXIT_FAILURE);
+
+__exit_fail:
+	if(sv[0] != -1){
+		close (sv[0]);
+		close (sv[1]);
+	}
+	free (chans);
+	free (accs);
+	free (fds);
+	free (argv);
+DFE
+	return -1;
+}/*}}}*/
+
+/**
+ * Take the state from the sender of the previous svd.
+ *
+ * \param[in] fd 	socketpair end from "-H" key.
+ * \retval 0 	if etherything ok.
+ * \retval -1 	if somthing nasty happens, svd should start from scratch.
+ * \remark
+ * 		It waits for the sender exit after the ack, so the SIP port
+ * 		and the interface socket are free for the new svd.
+ */
+int
+svd_handoff_recv (int const fd)
+{/*{{{*/
+	struct handoff_hdr_s h;
+	struct handoff_chan_s m;
+	pid_t sender = 0;
+	int cfds [3];
+	int fds_num;
+	int i;
+	int err;
+DFS
+	err = handoff_recv (fd, &h, sizeof(h), handoff_msg_HDR, NULL, 0, NULL);
+	if(err){
+		goto __exit_fail;
+	}
+	sender = h.pid;
+	if(h.chans <= 0 || h.devs <= 0 || h.accounts < 0){
+		SU_DEBUG_1(("Handoff: bad board %d/%d\n", h.devs, h.chans));
+		goto __exit_fail;
+	}
+	g_handoff.chans = h.chans;
+	g_handoff.devs = h.devs;
+	g_handoff.acc_num = h.accounts;
+	g_handoff.fds = calloc (h.devs + h.chans, sizeof(*g_handoff.fds));
+	g_handoff.be_fds = calloc (h.devs + h.chans, sizeof(*g_handoff.be_fds));
+	g_handoff.chan = calloc (h.chans, sizeof(*g_handoff.chan));
+	g_handoff.sfd = calloc (h.chans, sizeof(*g_handoff.sfd));
+	g_handoff.media_up = calloc (h.chans, sizeof(*g_handoff.media_up));
+	g_handoff.acc = calloc (h.accounts + 1, sizeof(*g_handoff.acc));
+	if( !g_handoff.fds || !g_handoff.be_fds || !g_handoff.chan ||
+			!g_handoff.sfd || !g_handoff.media_up || !g_handoff.acc){
+		SU_DEBUG_0 ((LOG_FNC_A (LOG_NOMEM)));
+		goto __exit_fail;
+	}
+	for (i=0; i<h.devs + h.chans; i++){
+		g_handoff.fds[i] = g_handoff.be_fds[i] = -1;
+	}
+	for (i=0; i<h.chans; i++){
+		g_handoff.sfd[i] = -1;
+	}
+
+	/* devices descriptors */
+	err = handoff_recv (fd, &h, sizeof(h), handoff_msg_BOARD,
+			g_handoff.fds, h.devs, &fds_num);
+	if(err || fds_num != g_handoff.devs){
+		SU_DEBUG_1(("Handoff: got %d devices descriptors of %d\n",
+				err ? 0 : fds_num, g_handoff.devs));
+		goto __exit_fail;
+	}
+
+	/* channels with their streams and RTP sockets */
+	for (i=0; i<g_handoff.chans; i++){
+		err = handoff_recv (fd, &m, sizeof(m), handoff_msg_CHAN,
+				cfds, 3, &fds_num);
+		if(err){
+			goto __exit_fail;
+		}
+		if(m.chan_idx < 0 || m.chan_idx >= g_handoff.chans ||
+				fds_num != 1 + !!m.has_sfd + !!m.has_be_fd ||
+				g_handoff.fds[g_handoff.devs + m.chan_idx] != -1){
+			SU_DEBUG_1(("Handoff: bad channel %d\n", m.chan_idx));
+			while(fds_num--){
+				close (cfds[fds_num]);
+			}
+			goto __exit_fail;
+		}
+		/* strings come from the other binary */
+		m.account[sizeof(m.account)-1] = '\0';
+		m.sdp_cod_name[sizeof(m.sdp_cod_name)-1] = '\0';
+		m.remote_host[sizeof(m.remote_host)-1] = '\0';
+		m.remote_sip[sizeof(m.remote_sip)-1] = '\0';
+		m.call_id[sizeof(m.call_id)-1] = '\0';
+		m.local[sizeof(m.local)-1] = '\0';
+		m.remote[sizeof(m.remote)-1] = '\0';
+		m.contact[sizeof(m.contact)-1] = '\0';
+		memcpy(&g_handoff.chan[m.chan_idx], &m, sizeof(m));
+		g_handoff.fds[g_handoff.devs + m.chan_idx] = cfds[0];
+		g_handoff.sfd[m.chan_idx] = m.has_sfd ? cfds[1] : -1;
+		g_handoff.be_fds[g_handoff.devs + m.chan_idx] = m.has_be_fd ?
+				cfds[fds_num-1] : -1;
+		g_handoff.media_up[m.chan_idx] = m.media_up;
+	}
+
+	/* registrations */
+	for (i=0; i<g_handoff.acc_num; i++){
+		err = handoff_recv (fd, &g_handoff.acc[i], sizeof(g_handoff.acc[i]),
+				handoff_msg_ACCOUNT, NULL, 0, NULL);
+		if(err){
+			goto __exit_fail;
+		}
+		g_handoff.acc[i].name[HANDOFF_NAME_MAX-1] = '\0';
+	}
+	err = handoff_recv (fd, &h, sizeof(h), handoff_msg_END, NULL, 0, NULL);
+	if(err){
+		goto __exit_fail;
+	}
+
+	/* all is taken, the sender can go */
+	handoff_hdr (&h, handoff_msg_ACK, NULL, 0);
+	err = handoff_send (fd, &h, sizeof(h), NULL, 0);
+	if(err){
+		goto __exit_fail;
+	}
+	handoff_wait_eof (fd);
+	waitpid (sender, NULL, 0);
+	close (fd);
+
+	g_handoff.on = 1;
+	SU_DEBUG_2(("Handoff: took %d devices, %d channels, %d accounts\n",
+			g_handoff.devs, g_handoff.chans, g_handoff.acc_num));
+DFE
+	return 0;
+__exit_fail:
+	/* the sender fails on the closed socketpair and exits */
+	shutdown (fd, SHUT_WR);
+	handoff_wait_eof (fd);
+	if(sender > 0){
+		waitpid (sender, NULL, 0);
+	}
+	close (fd);
+	for (i=0; g_handoff.fds && i<g_handoff.devs + g_handoff.chans; i++){
+		if(g_handoff.fds[i] != -1){
+			close (g_handoff.fds[i]);
+		}
+		if(g_handoff.be_fds[i] != -1){
+			close (g_handoff.be_fds[i]);
+		}
+	}
+	handoff_free ();
+DFE
+	return -1;
+}/*}}}*/
+
+/**
+ * Check if the state is taken from the previous svd.
+ *
+ * \retval 0 	svd starts from scratch.
+ * \retval 1 	svd continues the previous one.
+ */
+int
+svd_handoff_on (void)
+{/*{{{*/
+	return g_handoff.on;
+}/*}}}*/
+
+/**
+ * Create the board on the taken descriptors.
+ *
+ * \param[in] backend 	backend of the board.
+ * \return
+ * 		board or NULL on error (the descriptors are closed).
+ * \remark
+ * 		The DSP is not started again, the media of the taken channels
+ * 		stays as it is.
+ */
+ab_t *
+svd_handoff_board (enum ab_backend_e const backend)
+{/*{{{*/
+	ab_t * ab;
+
+	ab = ab_create_adopt (backend, g_handoff.fds,
+			g_handoff.devs + g_handoff.chans, g_handoff.be_fds,
+			g_handoff.media_up);
+	/* the board owns them now */
+	free (g_handoff.fds);
+	g_handoff.fds = NULL;
+	free (g_handoff.be_fds);
+	g_handoff.be_fds = NULL;
+	return ab;
+}/*}}}*/
+
+/**
+ * Get the taken RTP socket of the channel.
+ *
+ * \param[in] chan_idx 	channel index.
+ * \param[out] rtp_port 	local port of the socket.
+ * \return
+ * 		socket or -1 if there is no taken one (it is given once).
+ */
+int
+svd_handoff_rtp_sfd (int const chan_idx, int * const rtp_port)
+{/*{{{*/
+	int sfd;
+
+	if( !g_handoff.sfd || chan_idx < 0 || chan_idx >= g_handoff.chans ||
+			g_handoff.sfd[chan_idx] == -1){
+		return -1;
+	}
+	sfd = g_handoff.sfd[chan_idx];
+	g_handoff.sfd[chan_idx] = -1;
+	*rtp_port = g_handoff.chan[chan_idx].rtp_port;
+	return sfd;
+}/*}}}*/
+
+/**
+ * Register the accounts, the accounts registered by the previous svd
+ * 		continue their bindings without un-REGISTER.
+ *
+ * \param[in] svd 	svd context structure.
+ */
+void
+svd_handoff_register (svd_t * const svd)
+{/*{{{*/
+	int i;
+	int j;
+DFS
+	for (i=0; i<su_vector_len(g_conf.sip_account); i++) {
+		sip_account_t * account = su_vector_item(g_conf.sip_account, i);
+		for (j=0; j<g_handoff.acc_num; j++){
+			if( !strcmp(g_handoff.acc[j].name, account->name)){
+				break;
+			}
+		}
+		if(j < g_handoff.acc_num && g_handoff.acc[j].registered){
+			svd_account_continue (svd, account);
+		} else {
+			svd_account_register (svd, account);
+		}
+	}
+DFE
+}/*}}}*/
+
+/**
+ * Restore the channels state and adopt the established calls.
+ *
+ * \param[in] svd 	svd context structure.
+ * \retval 0 	if etherything ok.
+ * \retval -1 	if some call is not adopted (it is dropped).
+ */
+int
+svd_handoff_apply (svd_t * const svd)
+{/*{{{*/
+	ab_t * ab = svd->ab;
+	int adopted = 0;
+	int dropped = 0;
+	int i;
+DFS
+	for (i=0; i<g_handoff.chans && i<ab->chans_num; i++){
+		struct handoff_chan_s const * m = &g_handoff.chan[i];
+		ab_chan_t * chan = &ab->chans[i];
+		svd_chan_t * chan_ctx = chan->ctx;
+
+		chan_ctx->off_hook = m->off_hook;
+		if( !m->call){
+			continue;
+		}
+		if(handoff_adopt (svd, chan, m)){
+			dropped++;
+			ab_chan_media_deactivate (chan);
+			if(chan_ctx->off_hook){
+				ab_FXS_line_tone (chan, ab_chan_tone_BUSY);
+			}
+			continue;
+		}
+		adopted++;
+	}
+
+	if(adopted){
+		g_handoff.idle_rx = calloc (ab->chans_num, sizeof(*g_handoff.idle_rx));
+		g_handoff.idle_ms = calloc (ab->chans_num, sizeof(*g_handoff.idle_ms));
+		g_handoff.idle_tmr = su_timer_create (su_root_task(svd->root),
+				HANDOFF_IDLE_CHECK_MS);
+		if( !g_handoff.idle_rx || !g_handoff.idle_ms || !g_handoff.idle_tmr){
+			SU_DEBUG_1 ((LOG_FNC_A ("adopted calls RTP check fails" ) ));
+		} else {
+			su_timer_set (g_handoff.idle_tmr, handoff_idle_cb, NULL);
+		}
+	}
+	SU_DEBUG_2(("Handoff: %d calls adopted, %d dropped\n", adopted, dropped));
+	handoff_free ();
+DFE
+	return dropped ? -1 : 0;
+}/*}}}*/
+
+/**
+ * Hang up the adopted call with the BYE built from its dialog.
+ *
+ * \param[in] svd 	svd context structure.
+ * \param[in] chan 	channel of the adopted call.
+ * \remark
+ * 		NUA has no dialog for the call, so BYE goes as the request of
+ * 		"unknown" method in the handle made with the dialog Call-ID, tags
+ * 		and CSeq. The call is cleared on its answer (\ref svd_handoff_r_bye()).
+ */
+void
+svd_handoff_bye (svd_t * const svd, ab_chan_t * const chan)
+{/*{{{*/
+	svd_chan_t * chan_ctx = chan->ctx;
+	svd_call_t * call = chan_ctx->call;
+	char cseq [32];
+DFS
+	if(g_handoff.idle_ms){
+		if(g_handoff.idle_ms[chan_ctx->chan_idx] < 0){
+			/* BYE is sent already */
+			goto __exit;
+		}
+		g_handoff.idle_ms[chan_ctx->chan_idx] = -1;
+	}
+	ab_chan_media_deactivate (chan);
+
+	call->cseq++;
+	snprintf (cseq, sizeof(cseq), "%lu BYE", call->cseq);
+	nua_method (call->nh,
+			NUTAG_METHOD ("BYE"),
+			TAG_IF (call->contact, NUTAG_URL (call->contact)),
+			SIPTAG_CSEQ_STR (cseq),
+			TAG_END());
+	SU_DEBUG_3(("BYE of adopted call on [%02d] sent\n", chan->abs_idx));
+__exit:
+DFE
+	return;
+}/*}}}*/
+
+/**
+ * Answer to the BYE of the adopted call.
+ *
+ * \param[in] svd 		svd context structure.
+ * \param[in] nh 		handle of the call.
+ * \param[in] status 	status of the answer.
+ * \remark
+ * 		Any final answer ends the call, the remote have no dialog for it
+ * 		or it is ended now.
+ */
+void
+svd_handoff_r_bye (svd_t * const svd, nua_handle_t * const nh,
+		int const status)
+{/*{{{*/
+	svd_call_t * call = svd_call_find (svd, nh);
+	svd_chan_t * chan_ctx;
+DFS
+	if( !call || !call->adopted || status < 200){
+		goto __exit;
+	}
+	SU_DEBUG_3(("got answer on BYE of adopted call: %03d\n", status));
+	/* the handle goes with the last channel */
+	while((chan_ctx = svd_nh_chan (svd, nh))){
+		svd_clear_call (svd, &svd->ab->chans[chan_ctx->chan_idx]);
+	}
+__exit:
+DFE
+	return;
+}/*}}}*/
+
+/**
+ * Fill the message header.
+ *
+ * \param[out] h 		header to fill.
+ * \param[in] type 		message type.
+ * \param[in] ab 		board (NULL for the new svd side).
+ * \param[in] accounts 	accounts count.
+ */
+static void
+handoff_hdr (struct handoff_hdr_s * const h, enum handoff_msg_e const type,
+		ab_t const * const ab, int const accounts)
+{/*{{{*/
+	memset(h, 0, sizeof(*h));
+	h->magic = HANDOFF_MAGIC;
+	h->version = HANDOFF_VERSION;
+	h->type = type;
+	h->pid = getpid ();
+	if(ab){
+		h->chans = ab->chans_num;
+		h->devs = ab->devs_num;
+	}
+	h->accounts = accounts;
+}/*}}}*/
+
+/**
+ * Send the message with descriptors.
+ *
+ * \param[in] sfd 		socketpair end.
+ * \param[in] msg 		message.
+ * \param[in] len 		message length.
+ * \param[in] fds 		descriptors to pass.
+ * \param[in] fds_num 	descriptors count (0 if none).
+ * \retval 0 	if etherything ok.
+ * \retval -1 	if somthing nasty happens (errno is set).
+ * \remark
+ * 		It is async-signal-safe (no logs and allocations), the forked
+ * 		sender uses it.
+ */
+static int
+handoff_sendmsg (int const sfd, void const * const msg, int const len,
+		int const * const fds, int const fds_num)
+{/*{{{*/
+	union {
+		struct cmsghdr align;
+		char buf [CMSG_SPACE(HANDOFF_FDS_MAX * sizeof(int))];
+	} cbuf;
+	struct msghdr mh;
+	struct iovec iov;
+	struct cmsghdr * cm;
+
+	if(fds_num > HANDOFF_FDS_MAX){
+		errno = EINVAL;
+		return -1;
+	}
+	memset(&mh, 0, sizeof(mh));
+	iov.iov_base = (void *)msg;
+	iov.iov_len = len;
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	if(fds_num){
+		memset(&cbuf, 0, sizeof(cbuf));
+		mh.msg_control = cbuf.buf;
+		mh.msg_controllen = CMSG_SPACE(fds_num * sizeof(int));
+		cm = CMSG_FIRSTHDR(&mh);
+		cm->cmsg_level = SOL_SOCKET;
+		cm->cmsg_type = SCM_RIGHTS;
+		cm->cmsg_len = CMSG_LEN(fds_num * sizeof(int));
+		memcpy(CMSG_DATA(cm), fds, fds_num * sizeof(int));
+	}
+	if(sendmsg (sfd, &mh, MSG_NOSIGNAL) != len){
+		return -1;
+	}
+	return 0;
+}/*}}}*/
+
+/**
+ * Send the message with descriptors and log the failure.
+ *
+ * \param[in] sfd 		socketpair end.
+ * \param[in] msg 		message.
+ * \param[in] len 		message length.
+ * \param[in] fds 		descriptors to pass.
+ * \param[in] fds_num 	descriptors count (0 if none).
+ * \retval 0 	if etherything ok.
+ * \retval -1 	if somthing nasty happens.
+ */
+static int
+handoff_send (int const sfd, void const * const msg, int const len,
+		int const * const fds, int const fds_num)
+{/*{{{*/
+	if(handoff_sendmsg (sfd, msg, len, fds, fds_num)){
+		SU_DEBUG_1(("Handoff: sendmsg() : %s\n", strerror(errno)));
+		return -1;
+	}
+	return 0;
+}/*}}}*/
+
+/**
+ * Receive the message of the given type with descriptors.
+ *
+ * \param[in] sfd 		socketpair end.
+ * \param[out] msg 		message buffer.
+ * \param[in] len 		message length.
+ * \param[in] type 		expected message type.
+ * \param[out] fds 		got descriptors (NULL if none are expected).
+ * \param[in] fds_max 	fds buffer items.
+ * \param[out] fds_num 	got descriptors count (NULL if none are expected).
+ * \retval 0 	if etherything ok.
+ * \retval -1 	if somthing nasty happens, got descriptors are closed.
+ */
+static int
+handoff_recv (int const sfd, void * const msg, int const len,
+		enum handoff_msg_e const type, int * const fds, int const fds_max,
+		int * const fds_num)
+{/*{{{*/
+	struct handoff_hdr_s const * h = msg;
+	struct pollfd pfd;
+	struct msghdr mh;
+	struct iovec iov;
+	struct cmsghdr * cm;
+	char * cbuf = NULL;
+	int * got = NULL;
+	int got_num = 0;
+	int cbuf_len;
+	int rcv;
+	int i;
+
+	if(fds_num){
+		*fds_num = 0;
+	}
+	cbuf_len = CMSG_SPACE((fds_max ? fds_max : 1) * sizeof(int));
+	cbuf = calloc (1, cbuf_len);
+	if( !cbuf){
+		SU_DEBUG_0 ((LOG_FNC_A (LOG_NOMEM)));
+		goto __exit_fail;
+	}
+
+	pfd.fd = sfd;
+	pfd.events = POLLIN;
+	rcv = poll (&pfd, 1, HANDOFF_TIMEOUT_MS);
+	if(rcv <= 0){
+		SU_DEBUG_1(("Handoff: no message %d : %s\n", type,
+				rcv ? strerror(errno) : "timeout"));
+		goto __exit_fail;
+	}
+
+	memset(&mh, 0, sizeof(mh));
+	iov.iov_base = msg;
+	iov.iov_len = len;
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	mh.msg_control = cbuf;
+	mh.msg_controllen = cbuf_len;
+	rcv = recvmsg (sfd, &mh, 0);
+	for (cm = CMSG_FIRSTHDR(&mh); cm; cm = CMSG_NXTHDR(&mh, cm)){
+		if(cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS){
+			got = (int *)CMSG_DATA(cm);
+			got_num = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+			break;
+		}
+	}
+	if(rcv != len || (mh.msg_flags & (MSG_TRUNC | MSG_CTRUNC))){
+		SU_DEBUG_1(("Handoff: message %d : got %d of %d bytes%s\n", type,
+				rcv, len, (mh.msg_flags & MSG_CTRUNC) ?
+				", descriptors are cut" : ""));
+		goto __exit_fail;
+	}
+	if(h->magic != HANDOFF_MAGIC || h->version != HANDOFF_VERSION ||
+			h->type != type){
+		SU_DEBUG_1(("Handoff: message %d : got %d of version %d\n",
+				type, h->type, h->version));
+		goto __exit_fail;
+	}
+	if(got_num > fds_max || (got_num && !fds)){
+		goto __exit_fail;
+	}
+	if(got_num){
+		memcpy(fds, got, got_num * sizeof(int));
+		*fds_num = got_num;
+	}
+	free (cbuf);
+	return 0;
+__exit_fail:
+	for (i=0; i<got_num; i++){
+		close (got[i]);
+	}
+	free (cbuf);
+	return -1;
+}/*}}}*/
+
+/**
+ * Wait for the ack of the new svd.
+ *
+ * \param[in] sfd 	socketpair end.
+ * \retval 0 	if the ack is got.
+ * \retval -1 	if the new svd failed, closed the socketpair or is silent.
+ * \remark
+ * 		It is async-signal-safe (no logs and allocations), the forked
+ * 		sender uses it.
+ */
+static int
+handoff_ack_wait (int const sfd)
+{/*{{{*/
+	struct handoff_hdr_s h;
+	struct pollfd pfd;
+
+	pfd.fd = sfd;
+	pfd.events = POLLIN;
+	if(poll (&pfd, 1, HANDOFF_TIMEOUT_MS) != 1 ||
+			recv (sfd, &h, sizeof(h), 0) != sizeof(h)){
+		return -1;
+	}
+	if(h.magic != HANDOFF_MAGIC || h.version != HANDOFF_VERSION ||
+			h.type != handoff_msg_ACK){
+		return -1;
+	}
+	return 0;
+}/*}}}*/
+
+/**
+ * Wait for the sender exit (the socketpair is closed).
+ *
+ * \param[in] sfd 	socketpair end.
+ */
+static void
+handoff_wait_eof (int const sfd)
+{/*{{{*/
+	struct pollfd pfd;
+	char c;
+
+	pfd.fd = sfd;
+	pfd.events = POLLIN;
+	while(poll (&pfd, 1, HANDOFF_TIMEOUT_MS) > 0){
+		if(recv (sfd, &c, sizeof(c), 0) <= 0){
+			return;
+		}
+	}
+	SU_DEBUG_1(("Handoff: the sender does not exit\n" VA_NONE));
+}/*}}}*/
+
+/**
+ * Fill the channel message from the channel and its call.
+ *
+ * \param[in] svd 	svd context structure.
+ * \param[in] chan 	channel.
+ * \param[out] m 	message to fill.
+ * \remark
+ * 		Only the established calls with the known dialog are handed off,
+ * 		the calls in setup are dropped by the new svd.
+ */
+static void
+handoff_chan_fill (svd_t * const svd, ab_chan_t const * const chan,
+		struct handoff_chan_s * const m)
+{/*{{{*/
+	svd_chan_t const * chan_ctx = chan->ctx;
+	svd_call_t const * call = chan_ctx->call;
+	sip_to_t const * local;
+	sip_to_t const * remote;
+	char * str;
+
+	memset(m, 0, sizeof(*m));
+	handoff_hdr (&m->h, handoff_msg_CHAN, NULL, 0);
+	m->chan_idx = chan_ctx->chan_idx;
+	m->rtp_port = chan_ctx->rtp_port;
+	m->off_hook = chan_ctx->off_hook;
+
+	if( !call || !chan_ctx->call_established || !call->call_id ||
+			!call->account || !call->remote_host){
+		return;
+	}
+	local = nua_handle_local (call->nh);
+	remote = nua_handle_remote (call->nh);
+	if( !local || !remote){
+		return;
+	}
+	m->call = 1;
+	m->outgoing = call->outgoing;
+	m->remote_port = call->remote_port;
+	m->sdp_payload = chan_ctx->sdp_payload;
+	m->te_payload = chan_ctx->te_payload;
+	m->call_start = chan_ctx->call_start;
+	m->cseq = call->cseq;
+	snprintf (m->account, sizeof(m->account), "%s", call->account->name);
+	snprintf (m->sdp_cod_name, sizeof(m->sdp_cod_name), "%s",
+			chan_ctx->sdp_cod_name);
+	snprintf (m->remote_host, sizeof(m->remote_host), "%s", call->remote_host);
+	snprintf (m->remote_sip, sizeof(m->remote_sip), "%s",
+			call->remote_sip ? call->remote_sip : "");
+	snprintf (m->call_id, sizeof(m->call_id), "%s", call->call_id);
+	snprintf (m->contact, sizeof(m->contact), "%s",
+			call->contact ? call->contact : "");
+	str = sip_header_as_string (call->home, (sip_header_t const *)local);
+	if(str){
+		snprintf (m->local, sizeof(m->local), "%s", str);
+		su_free (call->home, str);
+	}
+	str = sip_header_as_string (call->home, (sip_header_t const *)remote);
+	if(str){
+		snprintf (m->remote, sizeof(m->remote), "%s", str);
+		su_free (call->home, str);
+	}
+	if( !m->local[0] || !m->remote[0]){
+		m->call = 0;
+	}
+}/*}}}*/
+
+/**
+ * Send the state and wait for the ack of the new svd.
+ *
+ * \param[in] sfd 		socketpair end.
+ * \param[in] ab 		board.
+ * \param[in] fds 		devices cfg_fd, channels rtp_fd, RTP sockets and
+ * 		backend descriptors.
+ * \param[in] chans 	channels messages.
+ * \param[in] accs 		accounts messages.
+ * \param[in] acc_num 	accounts count.
+ * \retval 0 	if etherything ok.
+ * \retval -1 	if somthing nasty happens.
+ * \remark
+ * 		It runs in the forked sender, it exits after the ack and the
+ * 		new svd gets the SIP port. The messages are built by the parent,
+ * 		only the sender pid is set here, the calls are async-signal-safe
+ * 		(the new svd logs the failures).
+ */
+static int
+handoff_sender (int const sfd, ab_t const * const ab,
+		int const * const fds, struct handoff_chan_s * const chans,
+		struct handoff_account_s * const accs, int const acc_num)
+{/*{{{*/
+	struct handoff_hdr_s h;
+	int cfds [3];
+	int n;
+	int i;
+
+	handoff_hdr (&h, handoff_msg_HDR, ab, acc_num);
+	if(handoff_sendmsg (sfd, &h, sizeof(h), NULL, 0)){
+		goto __exit_fail;
+	}
+	h.type = handoff_msg_BOARD;
+	if(handoff_sendmsg (sfd, &h, sizeof(h), fds, ab->devs_num)){
+		goto __exit_fail;
+	}
+	/* one message per channel, SCM_RIGHTS has a small descriptors limit */
+	for (i=0; i<ab->chans_num; i++){
+		chans[i].h.pid = h.pid;
+		cfds[0] = fds[ab->devs_num + i];
+		n = 1;
+		if(chans[i].has_sfd){
+			cfds[n++] = fds[ab->devs_num + ab->chans_num + i];
+		}
+		if(chans[i].has_be_fd){
+			cfds[n++] = fds[ab->devs_num + 2 * ab->chans_num + i];
+		}
+		if(handoff_sendmsg (sfd, &chans[i], sizeof(chans[i]), cfds, n)){
+			goto __exit_fail;
+		}
+	}
+	for (i=0; i<acc_num; i++){
+		accs[i].h.pid = h.pid;
+		if(handoff_sendmsg (sfd, &accs[i], sizeof(accs[i]), NULL, 0)){
+			goto __exit_fail;
+		}
+	}
+	h.type = handoff_msg_END;
+	if(handoff_sendmsg (sfd, &h, sizeof(h), NULL, 0)){
+		goto __exit_fail;
+	}
+	return handoff_ack_wait (sfd);
+__exit_fail:
+	return -1;
+}/*}}}*/
+
+/**
+ * Adopt the established call of the previous svd on the channel.
+ *
+ * \param[in] svd 	svd context structure.
+ * \param[in] chan 	channel of the call.
+ * \param[in] m 	taken channel message.
+ * \retval 0 	if etherything ok.
+ * \retval -1 	if the call can`t be adopted.
+ * \remark
+ * 		The new handle carries the dialog Call-ID and tags, so the BYE
+ * 		goes in the dialog. The DSP channel runs the call media already,
+ * 		it is just switched on (it is no-op on the taken TAPI channel).
+ */
+static int
+handoff_adopt (svd_t * const svd, ab_chan_t * const chan,
+		struct handoff_chan_s const * const m)
+{/*{{{*/
+	svd_chan_t * chan_ctx = chan->ctx;
+	sip_account_t * account = NULL;
+	nua_handle_t * nh;
+	svd_call_t * call;
+	int i;
+
+	for (i=0; i<su_vector_len(g_conf.sip_account); i++) {
+		sip_account_t * acc = su_vector_item(g_conf.sip_account, i);
+		if( !strcmp(acc->name, m->account)){
+			account = acc;
+			break;
+		}
+	}
+	if( !account){
+		SU_DEBUG_1(("Handoff: no account \"%s\" for the call on [%02d]\n",
+				m->account, chan->abs_idx));
+		goto __exit_fail;
+	}
+
+	nh = nua_handle (svd->nua, account,
+			SIPTAG_CALL_ID_STR (m->call_id),
+			SIPTAG_FROM_STR (m->local),
+			SIPTAG_TO_STR (m->remote),
+			TAG_END());
+	if( !nh){
+		SU_DEBUG_1(("Handoff: can`t create handle for [%02d]\n", chan->abs_idx));
+		goto __exit_fail;
+	}
+	call = svd_call_bind (svd, chan_ctx, nh, account);
+	if( !call){
+		nua_handle_destroy (nh);
+		goto __exit_fail;
+	}
+	call->adopted = 1;
+	call->outgoing = m->outgoing;
+	call->remote_sip = su_strdup (call->home, m->remote_sip);
+	call->remote_host = su_strdup (call->home, m->remote_host);
+	call->remote_port = m->remote_port;
+	svd_media_remote_set (call);
+	call->call_id = su_strdup (call->home, m->call_id);
+	if(m->contact[0]){
+		call->contact = su_strdup (call->home, m->contact);
+	}
+	call->cseq = m->cseq;
+
+	chan_ctx->sdp_payload = m->sdp_payload;
+	chan_ctx->te_payload = m->te_payload;
+	snprintf (chan_ctx->sdp_cod_name, sizeof(chan_ctx->sdp_cod_name), "%s",
+			m->sdp_cod_name);
+	chan_ctx->call_start = m->call_start;
+	chan_ctx->call_established = 1;
+	call->answer_us = (unsigned long long)m->call_start * 1000000ULL;
+	call->start_us = call->answer_us;
+	call->media = 1;
+
+	if(ab_chan_media_switch (chan, 1)){
+		SU_DEBUG_1(("Handoff: media switch error on [%02d] : %s\n",
+				chan->abs_idx, ab_err_str()));
+	}
+	SU_DEBUG_2(("Channel %d adopted %s call to %s account %s\n",
+			chan_ctx->chan_idx+1, call->outgoing ? "outgoing" : "incoming",
+			call->remote_sip, account->name));
+	return 0;
+__exit_fail:
+	return -1;
+}/*}}}*/
+
+/**
+ * Check the adopted calls RTP, the call without RTP from the remote
+ * 		is ended.
+ *
+ * \param[in] magic 	svd context structure.
+ * \param[in] t 		the timer.
+ * \param[in] arg 		unused.
+ * \remark
+ * 		NUA answers the BYE of the remote on the adopted call itself
+ * 		(481, it knows no dialog), so the silence is the only sign.
+ * 		The timer stops when no adopted call is left.
+ */
+static void
+handoff_idle_cb (su_root_magic_t * magic, su_timer_t * t, su_timer_arg_t * arg)
+{/*{{{*/
+	svd_t * svd = magic;
+	int left = 0;
+	int i;
+
+	for (i=0; i<svd->ab->chans_num; i++){
+		ab_chan_t * chan = &svd->ab->chans[i];
+		svd_chan_t * chan_ctx = chan->ctx;
+		if( !chan_ctx->call || !chan_ctx->call->adopted){
+			continue;
+		}
+		left++;
+		if(g_handoff.idle_ms[i] < 0){
+			continue;
+		}
+		if(chan_ctx->rtp_rx != g_handoff.idle_rx[i]){
+			g_handoff.idle_rx[i] = chan_ctx->rtp_rx;
+			g_handoff.idle_ms[i] = 0;
+			continue;
+		}
+		g_handoff.idle_ms[i] += HANDOFF_IDLE_CHECK_MS;
+		if(g_handoff.idle_ms[i] < HANDOFF_RTP_IDLE_S * 1000){
+			continue;
+		}
+		SU_DEBUG_2(("No RTP on adopted call on [%02d] for %d s, ending it\n",
+				chan->abs_idx, HANDOFF_RTP_IDLE_S));
+		svd_handoff_bye (svd, chan);
+		if(chan_ctx->off_hook && ab_FXS_line_tone (chan, ab_chan_tone_BUSY)){
+			SU_DEBUG_2(("can`t playing busy tone on [%02d]\n",
+					chan->abs_idx));
+		}
+	}
+	if(left){
+		su_timer_set (t, handoff_idle_cb, NULL);
+	}
+}/*}}}*/
+
+/**
+ * Free the taken state, the not used RTP sockets are closed.
+ */
+static void
+handoff_free (void)
+{/*{{{*/
+	int i;
+
+	if(g_handoff.sfd){
+		for (i=0; i<g_handoff.chans; i++){
+			if(g_handoff.sfd[i] != -1){
+				close (g_handoff.sfd[i]);
+			}
+		}
+		free (g_handoff.sfd);
+		g_handoff.sfd = NULL;
+	}
+	free (g_handoff.fds);
+	g_handoff.fds = NULL;
+	free (g_handoff.be_fds);
+	g_handoff.be_fds = NULL;
+	free (g_handoff.media_up);
+	g_handoff.media_up = NULL;
+	free (g_handoff.chan);
+	g_handoff.chan = NULL;
+	free (g_handoff.acc);
+	g_handoff.acc = NULL;
+	g_handoff.acc_num = 0;
+}/*}}}*/
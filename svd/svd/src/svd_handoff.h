@@ -0,0 +1,129 @@
+/**
+ * @file svd_handoff.h
+ * Handoff of the running svd to the new svd binary.
+ * It containes the handoff messages and the functions of both sides.
+ */
+#ifndef __SVD_HANDOFF_H__
+#define __SVD_HANDOFF_H__
+
+#include "svd.h"
+
+#include <stdint.h>
+
+/** @defgroup HANDOFF Handoff to the new svd binary.
+ *  "svd_if handoff[]" stops the main loop, svd forks the sender and
+ *  execs its binary again with "-H FD" in the same process (procd keeps
+ *  the pid). The sender passes the board descriptors and the RTP sockets
+ *  (SCM_RIGHTS), the channels, the established calls dialogs and the
+ *  registrations over the unix socketpair, waits for the ack and exits
+ *  without BYE and un-REGISTER. The new svd takes the board without
+ *  starting the DSP, relays the media of the adopted calls and ends them
+ *  with the BYE built from the saved dialog.
+ *  All messages are \ref handoff_hdr_s followed by the type payload,
+ *  numbers are in host byte order. The layout is checked with
+ *  \ref HANDOFF_VERSION, bump it on every change.
+ *  @{*/
+/** Messages magic ("SVDH").*/
+#define HANDOFF_MAGIC 0x48445653UL
+/** Messages format version.*/
+#define HANDOFF_VERSION 3
+/** Maximum length of the dialog strings (with '\\0').*/
+#define HANDOFF_STR_MAX 256
+/** Maximum length of the remote RTP host (with '\\0').*/
+#define HANDOFF_HOST_MAX 64
+/** Maximum length of the account name (with '\\0').*/
+#define HANDOFF_NAME_MAX 64
+/** Descriptors limit of one message (the board devices).*/
+#define HANDOFF_FDS_MAX 64
+/** How long the sides wait for each other (ms).*/
+#define HANDOFF_TIMEOUT_MS 5000
+/** Adopted call ends if no RTP comes from the remote so long (s).*/
+#define HANDOFF_RTP_IDLE_S 30
+/** Adopted calls RTP check period (ms).*/
+#define HANDOFF_IDLE_CHECK_MS 5000
+
+/** Message types.*/
+enum handoff_msg_e {/*{{{*/
+	handoff_msg_HDR, /**< Header only, starts the handoff */
+	handoff_msg_BOARD, /**< Header only with the devices fds */
+	handoff_msg_CHAN, /**< \ref handoff_chan_s with the channel fds */
+	handoff_msg_ACCOUNT, /**< \ref handoff_account_s */
+	handoff_msg_END, /**< Header only, all is sent */
+	handoff_msg_ACK, /**< Header only, the new svd took all */
+};/*}}}*/
+
+/** Message header.*/
+struct handoff_hdr_s {/*{{{*/
+	uint32_t magic; /**< \ref HANDOFF_MAGIC.*/
+	uint16_t version; /**< \ref HANDOFF_VERSION.*/
+	uint16_t type; /**< \ref handoff_msg_e value.*/
+	int32_t pid; /**< Sender pid (the new svd reaps it).*/
+	int32_t chans; /**< Channels count of the board.*/
+	int32_t devs; /**< Devices count of the board.*/
+	int32_t accounts; /**< Accounts count.*/
+};/*}}}*/
+
+/** Channel, the fds are its rtp_fd, the RTP socket (if it is open) and
+ *  the backend descriptor (if the backend has it, see ab_chan_t be_fd).*/
+struct handoff_chan_s {/*{{{*/
+	struct handoff_hdr_s h; /**< Header.*/
+	int32_t chan_idx; /**< Channel index.*/
+	int32_t rtp_port; /**< Local RTP port.*/
+	uint8_t off_hook; /**< The channel is off hook.*/
+	uint8_t call; /**< Established call follows.*/
+	uint8_t outgoing; /**< The call is outgoing.*/
+	uint8_t media_up; /**< Media is switched on.*/
+	uint8_t has_sfd; /**< The RTP socket is passed.*/
+	uint8_t has_be_fd; /**< The backend descriptor is passed.*/
+	int32_t remote_port; /**< Remote RTP port.*/
+	int32_t sdp_payload; /**< SDP selected payload.*/
+	int32_t te_payload; /**< Telephone events payload.*/
+	int64_t call_start; /**< Call start (time()).*/
+	uint32_t cseq; /**< Last CSeq of our requests in the dialog.*/
+	char account [HANDOFF_NAME_MAX]; /**< Account name of the call.*/
+	char sdp_cod_name [COD_NAME_LEN]; /**< SDP selected codec.*/
+	char remote_host [HANDOFF_HOST_MAX]; /**< Remote RTP host.*/
+	char remote_sip [HANDOFF_STR_MAX]; /**< Remote sip address.*/
+	char call_id [HANDOFF_STR_MAX]; /**< Call-ID of the dialog.*/
+	char local [HANDOFF_STR_MAX]; /**< Local party with tag.*/
+	char remote [HANDOFF_STR_MAX]; /**< Remote party with tag.*/
+	char contact [HANDOFF_STR_MAX]; /**< Remote target URI.*/
+};/*}}}*/
+
+/** Account registration.*/
+struct handoff_account_s {/*{{{*/
+	struct handoff_hdr_s h; /**< Header.*/
+	char name [HANDOFF_NAME_MAX]; /**< Account name.*/
+	uint8_t registered; /**< The account is registered.*/
+};/*}}}*/
+
+/** Remember the command line to exec the new svd with.*/
+void svd_handoff_argv (int const argc, char ** const argv);
+/** Stop the main loop to hand svd off.*/
+int  svd_handoff_request (svd_t * const svd);
+/** The handoff is requested.*/
+int  svd_handoff_pending (void);
+/** Fork the sender and exec the new svd (returns on error only).*/
+int  svd_handoff_exec (svd_t * const svd);
+
+/** Take the state from the sender (new svd side).*/
+int  svd_handoff_recv (int const fd);
+/** The state is taken from the previous svd.*/
+int  svd_handoff_on (void);
+/** Create the board on the taken descriptors.*/
+ab_t * svd_handoff_board (enum ab_backend_e const backend);
+/** Get the taken RTP socket of the channel.*/
+int  svd_handoff_rtp_sfd (int const chan_idx, int * const rtp_port);
+/** Continue the registrations of the previous svd.*/
+void svd_handoff_register (svd_t * const svd);
+/** Restore the channels and adopt the established calls.*/
+int  svd_handoff_apply (svd_t * const svd);
+
+/** Hang up the adopted call with the BYE built from its dialog.*/
+void svd_handoff_bye (svd_t * const svd, ab_chan_t * const chan);
+/** Answer to the BYE of the adopted call.*/
+void svd_handoff_r_bye (svd_t * const svd, nua_handle_t * const nh,
+		int const status);
+/** @}*/
+
+#endif /* __SVD_HANDOFF_H__ */
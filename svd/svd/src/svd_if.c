@@ -32,6 +32,16 @@ Mandatory arguments to long options are mandatory for short options too.\n\
 	shutdown[]\n\
 	get_regs[]\n\
 	get_chans[]\n\
+	get_flight[]\n\
+	get_lat[]\n\
+	get_loop[]\n\
+	get_ioctl[]\n\
+	get_events[]\n\
+	reload[]\n\
+	handoff[]\n\
+	get_startup[]\n\
+	get_call_mem[]\n\
+	get_log[]\n\
 	Execution example :\n\
 	echo \'get_jb_stat[4;*]\' %s\n\
 	Means, that you want to get jitter buffer statistics from the\n\
@@ -18,8 +18,6 @@
 #define MAX_MSG_SIZE 256
 /** Maximum error message length passed to functions */
 #define ERR_MSG_SIZE 256
-/** Chans number to work with */
-#define CHANS_MAX 32
 
 #define ARG_DEF  "*"
 #define CHAN_ALL "all"
@@ -42,6 +40,16 @@ enum msg_type_e {/*{{{*/
 	msg_type_SHUTDOWN, /**< Close all connections and prepare for exit */
 	msg_type_REGISTRATIONS, /**<Get status of sip registrations */
 	msg_type_CHANNELS, /**<Get status of channels */
+	msg_type_FLIGHT, /**< Dump the flight recorder */
+	msg_type_LATENCY, /**< Get call setup latency histograms */
+	msg_type_LOOP, /**< Get main loop handlers statistics */
+	msg_type_IOCTL, /**< Get applied / suppressed channel ioctls */
+	msg_type_EVENTS, /**< Get board events counters and handling time */
+	msg_type_RELOAD, /**< Reload the configuration */
+	msg_type_HANDOFF, /**< Hand the running svd off to the new binary */
+	msg_type_STARTUP, /**< Get startup phases timings */
+	msg_type_CALL_MEM, /**< Get calls memory usage */
+	msg_type_LOG, /**< Get log ring counters */
 	msg_type_COUNT, /**< count of messages */
 };/*}}}*/
 /** Given channel in the message */
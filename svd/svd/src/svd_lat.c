@@ -0,0 +1,120 @@
+/**
+ * @file svd_lat.c
+ * Call setup latency tracing implementation.
+ * It containes milestones stamping and histograms accounting.
+ */
+
+/* Includes {{{ */
+#include "svd_lat.h"
+
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+/*}}}*/
+
+/** Intervals names.*/
+char const * const lat_iv_name [lat_iv_COUNT] = {
+	"dialtone", "postdial", "provisional", "ok", "out_media",
+	"ring", "in_media", "ok_rtp", "answer_rtp",
+};
+
+/** Milestones for every interval: from, to.*/
+static enum lat_mark_e const lat_iv_marks [lat_iv_COUNT][2] = {
+	{lat_mark_OFFHOOK,   lat_mark_DIALTONE},
+	{lat_mark_LAST_DIGIT,lat_mark_INVITE},
+	{lat_mark_INVITE,    lat_mark_PROVISIONAL},
+	{lat_mark_INVITE,    lat_mark_OK},
+	{lat_mark_OK,        lat_mark_MEDIA},
+	{lat_mark_IN_INVITE, lat_mark_RING},
+	{lat_mark_ANSWER,    lat_mark_MEDIA},
+	{lat_mark_OK,        lat_mark_FIRST_RTP},
+	{lat_mark_ANSWER,    lat_mark_FIRST_RTP},
+};
+
+/**
+ * Stamp the call milestone with the monotonic clock.
+ *
+ * \param[in,out] c 	call milestones
+ * \param[in] m 		milestone to stamp
+ * \remark
+ * 		Only the first stamp counts, except the \c lat_mark_LAST_DIGIT,
+ * 		that is moved by every digit.
+ */
+void
+svd_lat_mark (struct lat_call_s * const c, enum lat_mark_e const m)
+{/*{{{*/
+	struct timespec ts;
+
+	if(c->t[m] && m != lat_mark_LAST_DIGIT){
+		return;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	c->t[m] = ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+	if(c->t[m] == 0){
+		c->t[m] = 1;
+	}
+	if(m == lat_mark_LAST_DIGIT && !c->t[lat_mark_FIRST_DIGIT]){
+		c->t[lat_mark_FIRST_DIGIT] = c->t[m];
+	}
+}/*}}}*/
+
+/**
+ * Add call intervals to the statistics, make the breakdown string and
+ * reset call milestones.
+ *
+ * \param[in,out] c 	call milestones
+ * \param[in,out] st 	statistics to add to (can be NULL)
+ * \param[out] buf 		buffer for the breakdown (can be NULL)
+ * \param[in] size 		buffer size
+ * \return 	count of measured intervals
+ * \remark
+ * 		Breakdown is the "name=Nms" list of reached intervals.
+ */
+int
+svd_lat_finish (struct lat_call_s * const c, struct lat_stat_s * const st,
+		char * const buf, int const size)
+{/*{{{*/
+	unsigned long long from;
+	unsigned long long to;
+	unsigned long us;
+	unsigned long ms;
+	int bucket;
+	int len = 0;
+	int cnt = 0;
+	int i;
+
+	if(buf && size){
+		buf[0] = '\0';
+	}
+	for (i=0; i<lat_iv_COUNT; i++){
+		from = c->t[lat_iv_marks[i][0]];
+		to = c->t[lat_iv_marks[i][1]];
+		if( !from || !to || to < from){
+			continue;
+		}
+		us = to - from;
+		cnt++;
+
+		if(st){
+			struct lat_hist_s * h = &st->iv[i];
+			ms = us / 1000;
+			for (bucket=0; ms && bucket<LAT_BUCKETS-1; bucket++){
+				ms >>= 1;
+			}
+			h->cnt[bucket]++;
+			h->n++;
+			h->sum_us += us;
+			if(us > h->max_us){
+				h->max_us = us;
+			}
+		}
+		if(buf && len < size){
+			len += snprintf(buf+len, size-len, "%s%s=%lums",
+					len ? " " : "", lat_iv_name[i], us / 1000);
+		}
+	}
+	memset(c, 0, sizeof(*c));
+	return cnt;
+}/*}}}*/
+
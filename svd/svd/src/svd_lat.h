@@ -0,0 +1,79 @@
+/**
+ * @file svd_lat.h
+ * Call setup latency tracing.
+ * It containes call setup milestones, per-account latency histograms
+ * 		and functions to fill them.
+ */
+#ifndef __SVD_LAT_H__
+#define __SVD_LAT_H__
+
+/** @defgroup LAT Call setup latency.
+ *  Every channel stamps the call setup milestones with the monotonic
+ *  clock, on the call clearing the intervals between them are added to
+ *  the account histograms.
+ *  @{*/
+/** Histogram buckets: [0;1) ms, [1;2) ms, [2;4) ms ... [2^15;2^16) ms, more.*/
+#define LAT_BUCKETS 18
+/** Maximum length of the breakdown string for the logs.*/
+#define LAT_STR_LEN 128
+
+/** Call setup milestones.*/
+enum lat_mark_e {/*{{{*/
+	lat_mark_OFFHOOK, /**< FXS offhook event */
+	lat_mark_DIALTONE, /**< Dial tone ioctl */
+	lat_mark_FIRST_DIGIT, /**< First dialled digit */
+	lat_mark_LAST_DIGIT, /**< Last dialled digit */
+	lat_mark_INVITE, /**< svd_invite_to() sends INVITE */
+	lat_mark_PROVISIONAL, /**< First 18x received */
+	lat_mark_OK, /**< 200 OK received */
+	lat_mark_IN_INVITE, /**< INVITE received */
+	lat_mark_RING, /**< Ring ioctl */
+	lat_mark_ANSWER, /**< Local answer (200 OK sent) */
+	lat_mark_MEDIA, /**< Media activated */
+	lat_mark_FIRST_RTP, /**< First RTP packet from the channel sent */
+	lat_mark_COUNT, /**< Milestones count */
+};/*}}}*/
+
+/** Measured intervals.*/
+enum lat_iv_e {/*{{{*/
+	lat_iv_DIALTONE, /**< Offhook to dial tone */
+	lat_iv_POSTDIAL, /**< Last digit to INVITE */
+	lat_iv_PROVISIONAL, /**< INVITE to first 18x */
+	lat_iv_OK, /**< INVITE to 200 OK */
+	lat_iv_OUT_MEDIA, /**< 200 OK to media activation */
+	lat_iv_RING, /**< INVITE received to ring ioctl */
+	lat_iv_IN_MEDIA, /**< Answer to media activation */
+	lat_iv_OUT_RTP, /**< 200 OK to first RTP packet sent */
+	lat_iv_IN_RTP, /**< Answer to first RTP packet sent */
+	lat_iv_COUNT, /**< Intervals count */
+};/*}}}*/
+
+/** Milestones of one call.*/
+struct lat_call_s {/*{{{*/
+	unsigned long long t [lat_mark_COUNT]; /**< Monotonic us, 0 - not reached.*/
+};/*}}}*/
+
+/** One interval histogram.*/
+struct lat_hist_s {/*{{{*/
+	unsigned long cnt [LAT_BUCKETS]; /**< Log2 ms buckets.*/
+	unsigned long n; /**< Samples count.*/
+	unsigned long long sum_us; /**< Sum of samples (us).*/
+	unsigned long max_us; /**< Maximum sample (us).*/
+};/*}}}*/
+
+/** Latency statistics of the account.*/
+struct lat_stat_s {/*{{{*/
+	struct lat_hist_s iv [lat_iv_COUNT]; /**< Histograms per interval.*/
+};/*}}}*/
+
+/** Intervals names (for logs and interface).*/
+extern char const * const lat_iv_name [lat_iv_COUNT];
+
+/** Stamp the call milestone.*/
+void svd_lat_mark (struct lat_call_s * const c, enum lat_mark_e const m);
+/** Add call intervals to statistics, make breakdown string and reset.*/
+int  svd_lat_finish (struct lat_call_s * const c, struct lat_stat_s * const st,
+		char * const buf, int const size);
+/** @}*/
+
+#endif /* __SVD_LAT_H__ */
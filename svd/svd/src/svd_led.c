@@ -1,4 +1,9 @@
-#include <stdio.h>
+/**
+ * @file svd_led.c
+ * Leds state manager implementation.
+ * It containes the leds table with the open sysfs files and the deferred
+ * updates timer.
+ */
 
 /*
 Meaning of the leds
@@ -6,70 +11,393 @@ Meaning of the leds
 
  VOIP : off - no account active/registered
         on - at least one account configured and registered
-        
+
  PHONEx: off - on hook
          on - off hook, no call active
-         slow blinking - off hook, call active        
+         slow blinking - off hook, call active
          fast blinking - ringing
 */
 
-static FILE *led_open(char *led, char* sub)
-{
-   char fname[100];
-   
-   snprintf(fname, sizeof(fname), "/sys/class/leds/%s/%s", led, sub);
-   return fopen(fname, "rb+");
-   
-}
-
-static FILE *led_trigger(char *led)
-{
-  return led_open(led, "trigger");
-}
-
-static void led_delay(char *led, int onoff, int msec)
-{
-  FILE *fp = led_open(led, onoff ? "delay_on" : "delay_off");
-  if (fp) {
-    fprintf(fp,"%d\n",msec);
-    fclose(fp);
-  }
-}
-
-void led_on(char *led)
-{
-
- FILE *fp;
- 
- fp = led_trigger(led);
- if (fp) {
-   fprintf(fp,"default-on\n");
-   fclose(fp);
- }
-}
-
-void led_off(char *led)
-{
-
- FILE *fp;
- 
- fp = led_trigger(led);
- if (fp) {
-   fprintf(fp,"none\n");
-   fclose(fp);
- }
-}
-
-void led_blink(char *led, int period)
-{
-
- FILE *fp;
- 
- fp = led_trigger(led);
- if (fp) {
-   fprintf(fp, "timer\n");
-   fclose(fp);
-   led_delay(led, 1, period/2);
-   led_delay(led, 0, period/2);
- }
-}
+/* Includes {{{ */
+#include "svd.h"
+#include "svd_loop.h"
+#include "svd_led.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+/*}}}*/
+
+/** Leds sysfs directory.*/
+#define LED_SYSFS_DIR "/sys/class/leds"
+
+/** Led states.*/
+enum led_state_e {/*{{{*/
+	led_state_UNKNOWN, /**< Not written yet */
+	led_state_OFF, /**< "none" trigger */
+	led_state_ON, /**< "default-on" trigger */
+	led_state_BLINK, /**< "timer" trigger */
+};/*}}}*/
+
+/** One led.*/
+struct led_s {/*{{{*/
+	struct led_s * next; /**< Next led in the table.*/
+	char * name; /**< Led name (own copy, the config can be reloaded).*/
+	int trigger_fd; /**< "trigger" file or -1.*/
+	int delay_on_fd; /**< "delay_on" file or -1 (timer trigger only).*/
+	int delay_off_fd; /**< "delay_off" file or -1 (timer trigger only).*/
+	unsigned char missing; /**< No such led, do not try to open it again.*/
+	enum led_state_e cur; /**< Applied state.*/
+	int cur_period; /**< Applied blink period.*/
+	enum led_state_e want; /**< Requested state.*/
+	int want_period; /**< Requested blink period.*/
+};/*}}}*/
+
+/** Leds context.*/
+static struct {/*{{{*/
+	enum led_backend_e backend; /**< Leds backend.*/
+	struct led_s * leds; /**< Leds table.*/
+	su_timer_t * tmr; /**< Deferred updates timer or NULL.*/
+	unsigned long long due; /**< Timer deadline.*/
+	unsigned char armed; /**< Timer is set.*/
+} g_led;/*}}}*/
+
+/** Find the led or add it to the table.*/
+static struct led_s * led_get (char const * const name);
+/** Open the led file.*/
+static int led_open (char const * const led, char const * const sub);
+/** Write the string to the led file.*/
+static int led_write (int const fd, char const * const str);
+/** Write the blink delays.*/
+static int led_delays (struct led_s * const led, int const period);
+/** Apply the requested led state.*/
+static void led_apply (struct led_s * const led);
+/** Request the led state.*/
+static void led_set (char const * const name, enum led_state_e const state,
+		int const period);
+/** Deferred updates timer callback.*/
+static void led_tmr_cb (su_root_magic_t * magic, su_timer_t * t,
+		su_timer_arg_t * arg);
+
+/**
+ * Choose the leds backend.
+ *
+ * \param[in] backend 	leds backend.
+ * \remark
+ * 		It should be called before the first led change.
+ */
+void
+svd_led_backend (enum led_backend_e const backend)
+{/*{{{*/
+	g_led.backend = backend;
+}/*}}}*/
+
+/**
+ * Start the deferred leds updates.
+ *
+ * \param[in] svd 	svd context with the root.
+ * \retval 0 	etherything is fine
+ * \retval -1 	error occures
+ */
+int
+svd_led_init (svd_t * const svd)
+{/*{{{*/
+	g_led.tmr = su_timer_create(su_root_task(svd->root), LED_DEFER_MS);
+	if( !g_led.tmr){
+		SU_DEBUG_1 ((LOG_FNC_A ("su_timer_create() leds fails" ) ));
+		goto __exit_fail;
+	}
+	g_led.armed = 0;
+	return 0;
+__exit_fail:
+	return -1;
+}/*}}}*/
+
+/**
+ * Apply the pending leds states and stop the deferred updates.
+ *
+ * \remark
+ * 		It should be called before the root destroying. The files stay
+ * 		open, the later changes are applied in place.
+ */
+void
+svd_led_destroy (void)
+{/*{{{*/
+	struct led_s * led;
+
+	if(g_led.tmr){
+		su_timer_destroy(g_led.tmr);
+		g_led.tmr = NULL;
+	}
+	g_led.armed = 0;
+	for (led = g_led.leds; led; led = led->next){
+		led_apply (led);
+	}
+}/*}}}*/
+
+/**
+ * Turns on named led.
+ *
+ * \param[in] led 	led name.
+ */
+void
+led_on(char *led)
+{/*{{{*/
+	led_set (led, led_state_ON, 0);
+}/*}}}*/
+
+/**
+ * Turns off named led.
+ *
+ * \param[in] led 	led name.
+ */
+void
+led_off(char *led)
+{/*{{{*/
+	led_set (led, led_state_OFF, 0);
+}/*}}}*/
+
+/**
+ * Blinks named led.
+ *
+ * \param[in] led 	led name.
+ * \param[in] period 	blink period in ms.
+ */
+void
+led_blink(char *led, int period)
+{/*{{{*/
+	led_set (led, led_state_BLINK, period);
+}/*}}}*/
+
+/**
+ * Find the led or add it to the table.
+ *
+ * \param[in] name 	led name.
+ * \return 	led or NULL on memory error.
+ */
+static struct led_s *
+led_get (char const * const name)
+{/*{{{*/
+	struct led_s * led;
+
+	for (led = g_led.leds; led; led = led->next){
+		if( !strcmp(led->name, name)){
+			return led;
+		}
+	}
+	led = calloc(1, sizeof(*led));
+	if( !led){
+		goto __exit_fail;
+	}
+	led->name = strdup(name);
+	if( !led->name){
+		free(led);
+		goto __exit_fail;
+	}
+	led->trigger_fd = -1;
+	led->delay_on_fd = -1;
+	led->delay_off_fd = -1;
+	led->next = g_led.leds;
+	g_led.leds = led;
+	return led;
+__exit_fail:
+	SU_DEBUG_2 (("Led %s: not enough memory\n", name));
+	return NULL;
+}/*}}}*/
+
+/**
+ * Open the led file.
+ *
+ * \param[in] led 	led name.
+ * \param[in] sub 	file name in the led directory.
+ * \return 	file descriptor or -1.
+ */
+static int
+led_open (char const * const led, char const * const sub)
+{/*{{{*/
+	char fname[100];
+
+	snprintf(fname, sizeof(fname), LED_SYSFS_DIR"/%s/%s", led, sub);
+	return open(fname, O_WRONLY | O_CLOEXEC);
+}/*}}}*/
+
+/**
+ * Write the string to the led file.
+ *
+ * \param[in] fd 	open led file.
+ * \param[in] str 	value with '\\n'.
+ * \retval 0 	etherything is fine
+ * \retval -1 	error occures
+ * \remark
+ * 		Sysfs attributes take the whole value from the offset 0.
+ */
+static int
+led_write (int const fd, char const * const str)
+{/*{{{*/
+	size_t const len = strlen(str);
+
+	if(fd < 0 || pwrite(fd, str, len, 0) != len){
+		return -1;
+	}
+	return 0;
+}/*}}}*/
+
+/**
+ * Write the blink delays.
+ *
+ * \param[in] led 	led in the timer trigger.
+ * \param[in] period 	blink period in ms.
+ * \retval 0 	etherything is fine
+ * \retval -1 	error occures
+ * \remark
+ * 		The timer trigger creates its delay files on every switch to it,
+ * 		so they are opened after the switch and closed on the switch from it.
+ */
+static int
+led_delays (struct led_s * const led, int const period)
+{/*{{{*/
+	char val [16];
+
+	if(led->delay_on_fd < 0){
+		led->delay_on_fd = led_open (led->name, "delay_on");
+	}
+	if(led->delay_off_fd < 0){
+		led->delay_off_fd = led_open (led->name, "delay_off");
+	}
+	snprintf(val, sizeof(val), "%d\n", period/2);
+	if(led_write (led->delay_on_fd, val) || led_write (led->delay_off_fd, val)){
+		return -1;
+	}
+	return 0;
+}/*}}}*/
+
+/**
+ * Apply the requested led state.
+ *
+ * \param[in] led 	led to update.
+ * \remark
+ * 		Nothing is written if the led already has the requested state.
+ */
+static void
+led_apply (struct led_s * const led)
+{/*{{{*/
+	char const * trigger;
+
+	if(led->want == led_state_UNKNOWN || (led->want == led->cur &&
+			(led->want != led_state_BLINK ||
+			led->want_period == led->cur_period))){
+		return;
+	}
+	if(g_led.backend == led_backend_NONE || led->missing){
+		led->cur = led->want;
+		led->cur_period = led->want_period;
+		return;
+	}
+
+	if(led->trigger_fd < 0){
+		led->trigger_fd = led_open (led->name, "trigger");
+		if(led->trigger_fd < 0){
+			SU_DEBUG_3 (("Led %s is not found, skip it\n", led->name));
+			led->missing = 1;
+			return;
+		}
+	}
+
+	if(led->cur != led->want){
+		if(led->cur == led_state_BLINK || led->cur == led_state_UNKNOWN){
+			if(led->delay_on_fd >= 0){
+				close(led->delay_on_fd);
+				led->delay_on_fd = -1;
+			}
+			if(led->delay_off_fd >= 0){
+				close(led->delay_off_fd);
+				led->delay_off_fd = -1;
+			}
+		}
+		if       (led->want == led_state_ON){
+			trigger = "default-on\n";
+		} else if(led->want == led_state_OFF){
+			trigger = "none\n";
+		} else {
+			trigger = "timer\n";
+		}
+		if(led_write (led->trigger_fd, trigger)){
+			SU_DEBUG_2 (("Led %s trigger write error\n", led->name));
+			return;
+		}
+	}
+	if(led->want == led_state_BLINK && led_delays (led, led->want_period)){
+		SU_DEBUG_2 (("Led %s delays write error\n", led->name));
+		/* trigger may be changed already, rewrite all on the next try */
+		led->cur = led_state_UNKNOWN;
+		return;
+	}
+	led->cur = led->want;
+	led->cur_period = led->want_period;
+}/*}}}*/
+
+/**
+ * Request the led state.
+ *
+ * \param[in] name 	led name.
+ * \param[in] state 	new state.
+ * \param[in] period 	blink period in ms (\ref led_state_BLINK only).
+ * \remark
+ * 		The state is applied in place before \ref svd_led_init() and
+ * 		from the timer after it.
+ */
+static void
+led_set (char const * const name, enum led_state_e const state,
+		int const period)
+{/*{{{*/
+	struct led_s * led;
+
+	if( !name || !name[0]){
+		return;
+	}
+	led = led_get (name);
+	if( !led){
+		return;
+	}
+	led->want = state;
+	led->want_period = (state == led_state_BLINK) ? period : 0;
+
+	if( !g_led.tmr){
+		led_apply (led);
+		return;
+	}
+	if(g_led.armed){
+		return;
+	}
+	g_led.due = svd_loop_now() + LED_DEFER_MS * 1000ULL;
+	if(su_timer_set(g_led.tmr, led_tmr_cb, NULL)){
+		SU_DEBUG_2 ((LOG_FNC_A ("su_timer_set() leds fails" ) ));
+		led_apply (led);
+		return;
+	}
+	g_led.armed = 1;
+}/*}}}*/
+
+/**
+ * Deferred updates timer callback.
+ *
+ * \param[in] magic 	svd pointer.
+ * \param[in] t 		leds timer.
+ * \param[in] arg 		not used.
+ */
+static void
+led_tmr_cb (su_root_magic_t * magic, su_timer_t * t, su_timer_arg_t * arg)
+{/*{{{*/
+	struct led_s * led;
+	unsigned long long start;
+
+	start = svd_loop_enter (loop_cb_LED_TMR, g_led.due);
+	g_led.armed = 0;
+	for (led = g_led.leds; led; led = led->next){
+		led_apply (led);
+	}
+	svd_loop_leave (loop_cb_LED_TMR, start);
+}/*}}}*/
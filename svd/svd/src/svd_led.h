@@ -1,13 +1,37 @@
 /**
  * @file svd_led.h
- * Utility functions to manage ledsConfiguration interface.
+ * Utility functions to manage leds.
  */
 
 #ifndef __SVD_LED_H__
 #define __SVD_LED_H__
 
+#include "svd.h"
+
+/** @defgroup LED Leds state manager.
+ *  Each named led keeps its sysfs files open and remembers the applied
+ *  state, so the same state is not written again. After \ref svd_led_init()
+ *  the changes are applied from a timer \ref LED_DEFER_MS later, a burst of
+ *  changes (e.g. a ring cadence start or a reload) writes the last state
+ *  only. Before it (configuration parsing) they are applied in place.
+ *  @{*/
 #define LED_SLOW_BLINK 1000
 #define LED_FAST_BLINK 100
+/** How long the led changes are coalesced (ms).*/
+#define LED_DEFER_MS 50
+
+/** Leds backends.*/
+enum led_backend_e {/*{{{*/
+	led_backend_SYSFS, /**< /sys/class/leds/ */
+	led_backend_NONE, /**< No leds (simulated board, hosts without leds) */
+};/*}}}*/
+
+/** Choose the leds backend.*/
+void svd_led_backend (enum led_backend_e const backend);
+/** Start the deferred leds updates.*/
+int  svd_led_init (svd_t * const svd);
+/** Apply the pending leds states and stop the deferred updates.*/
+void svd_led_destroy (void);
 
 /** Turns on named led.*/
 void led_on(char *led);
@@ -15,5 +39,6 @@ void led_on(char *led);
 void led_off(char *led);
 /** Blinks named led.*/
 void led_blink(char *led, int period);
+/** @}*/
 
-#endif /* __SVD_LED_H__ */
\ No newline at end of file
+#endif /* __SVD_LED_H__ */
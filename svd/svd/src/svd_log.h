@@ -35,6 +35,16 @@
 	#define DEBUG_CODE(code)
 #endif
 
+/** @defgroup TRACE Function tracing.
+ *  @ingroup LOG_MACRO
+ *  Function start/end markers are compiled in only if \c SVD_TRACE is
+ *  defined (configure --enable-trace). In release builds \ref DFS and
+ *  \ref DFE are empty and SU_DEBUG_9 is dropped by \c SU_DEBUG_MAX
+ *  (see sofia.h), so the event and relay paths do not pay for them.
+ *  With \c SVD_TRACE_TLS (configure --enable-trace=thread) every thread
+ *  keeps its own \ref g_f_offset.
+ *  @{*/
+#ifdef SVD_TRACE
 /** Function start marker.*/
 #define DFS												\
 	do {												\
@@ -48,9 +58,20 @@
 		g_f_offset--; 									\
 		SU_DEBUG_9(("^^^^^^^^\n" VA_NONE));		\
 	}while(0);
+#else
+/** Function start marker (tracing is off).*/
+#define DFS
+/** Function end marker (tracing is off).*/
+#define DFE
+#endif
 
 /** Function start/end offset current value.*/
+#ifdef SVD_TRACE_TLS
+extern __thread unsigned int g_f_offset;
+#else
 extern unsigned int g_f_offset;
+#endif
+/** @}*/
 /** @}*/
 
 #endif /* __SVD_LOG_H__ */
@@ -0,0 +1,375 @@
+/**
+ * @file svd_logring.c
+ * Asynchronous log ring implementation.
+ * It containes the bounded lock-free ring of log lines and the flusher
+ * 		thread, that takes them out and writes to syslog or to a file.
+ */
+
+/* Includes {{{ */
+#include "svd_logring.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+/*}}}*/
+
+/** @defgroup LOGRING_I Log ring internals.
+ *  @ingroup LOGRING
+ *  Ring slots and flusher state.
+ *  @{*/
+/** Slot index mask.*/
+#define LOGRING_MASK (LOGRING_SLOTS-1)
+/** Flusher writes the file target by chunks of this size.*/
+#define LOGRING_WBUF_SIZE 4096
+
+/** One ring slot.
+ * \c seq tells the slot state: it is equal to the position that may write it,
+ * and position+1 when the line is ready to read (bounded MPMC queue scheme).
+ */
+struct logring_slot_s {
+	volatile unsigned long seq; /**< Slot sequence number.*/
+	int len; /**< Line length without '\\0'.*/
+	char line [LOGRING_LINE_LEN]; /**< Formatted line.*/
+};
+
+/** Ring and flusher context.*/
+static struct logring_s {
+	struct logring_slot_s slots [LOGRING_SLOTS]; /**< Ring slots.*/
+	volatile unsigned long head; /**< Next position to write.*/
+	unsigned long tail; /**< Next position to read (flusher only).*/
+	volatile int running; /**< Flusher thread is alive.*/
+	volatile int stop; /**< Flusher should drain the ring and exit.*/
+	volatile int wake_pending; /**< Somebody already posted the semaphore.*/
+	sem_t wake; /**< Flusher wakeup semaphore.*/
+	pthread_t thread; /**< Flusher thread.*/
+	pthread_mutex_t target_lock; /**< Guards target changes against writes.*/
+	enum logring_target_e target; /**< Current target.*/
+	int fd; /**< Target file descriptor for logring_target_FD.*/
+	volatile unsigned long written; /**< Lines passed to the target.*/
+	volatile unsigned long dropped; /**< Lines lost on overflow.*/
+	volatile unsigned long truncated; /**< Lines cutted on put.*/
+	volatile unsigned long batches; /**< Non-empty flusher passes.*/
+	unsigned long dropped_reported; /**< Dropped value in the last report.*/
+} g_lr = {
+	.target = logring_target_FD,
+	.fd = STDERR_FILENO,
+	.target_lock = PTHREAD_MUTEX_INITIALIZER,
+};
+/** @}*/
+
+/** Flusher thread main function.*/
+static void * logring_flusher (void * arg);
+/** Take all ready lines out of the ring and write them.*/
+static int logring_drain (void);
+/** Write the line directly to the target.*/
+static void logring_write_line (char const * const line, int const len);
+
+/**
+ * Create the ring and start the flusher thread.
+ *
+ * \retval 0 	etherything is fine
+ * \retval -1 	error occures
+ * \remark
+ * 		It should be called after daemonization, because threads
+ * 		do not survive fork().
+ * 		Until it called (or if it fails) lines are written synchronously.
+ */
+int
+svd_logring_create (void)
+{/*{{{*/
+	int i;
+
+	if(g_lr.running){
+		return 0;
+	}
+
+	for (i=0; i<LOGRING_SLOTS; i++){
+		g_lr.slots[i].seq = i;
+		g_lr.slots[i].len = 0;
+	}
+	g_lr.head = 0;
+	g_lr.tail = 0;
+	g_lr.stop = 0;
+	g_lr.wake_pending = 0;
+
+	if(sem_init(&g_lr.wake, 0, 0)){
+		goto __exit_fail;
+	}
+	g_lr.running = 1;
+	if(pthread_create(&g_lr.thread, NULL, logring_flusher, NULL)){
+		g_lr.running = 0;
+		sem_destroy(&g_lr.wake);
+		goto __exit_fail;
+	}
+	return 0;
+__exit_fail:
+	return -1;
+}/*}}}*/
+
+/**
+ * Stop the flusher thread.
+ *
+ * \remark
+ * 		Flusher writes all lines remaining in the ring before exit and
+ * 		reports the dropped lines count if any.
+ */
+void
+svd_logring_destroy (void)
+{/*{{{*/
+	if( !g_lr.running){
+		return;
+	}
+	g_lr.stop = 1;
+	sem_post(&g_lr.wake);
+	pthread_join(g_lr.thread, NULL);
+	g_lr.running = 0;
+	sem_destroy(&g_lr.wake);
+
+	pthread_mutex_lock(&g_lr.target_lock);
+	if(g_lr.target == logring_target_FD && g_lr.fd != STDERR_FILENO){
+		close(g_lr.fd);
+		g_lr.fd = STDERR_FILENO;
+	}
+	pthread_mutex_unlock(&g_lr.target_lock);
+}/*}}}*/
+
+/**
+ * Choose the target for the log lines.
+ *
+ * \param[in] target 	syslog or file descriptor target
+ * \param[in] path 		file name for \c logring_target_FD,
+ * 		\c NULL means stderr
+ * \retval 0 	etherything is fine
+ * \retval -1 	file can`t be opened, target stays unchanged
+ * \remark
+ * 		Lines already in the ring go to the new target.
+ */
+int
+svd_logring_target (enum logring_target_e const target,
+		char const * const path)
+{/*{{{*/
+	int fd = STDERR_FILENO;
+
+	if(target == logring_target_FD && path){
+		fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+		if(fd == -1){
+			goto __exit_fail;
+		}
+	}
+
+	pthread_mutex_lock(&g_lr.target_lock);
+	if(g_lr.target == logring_target_FD && g_lr.fd != STDERR_FILENO){
+		close(g_lr.fd);
+	}
+	g_lr.target = target;
+	g_lr.fd = fd;
+	pthread_mutex_unlock(&g_lr.target_lock);
+
+	return 0;
+__exit_fail:
+	return -1;
+}/*}}}*/
+
+/**
+ * Put one formatted line to the ring.
+ *
+ * \param[in] line 	line with indentation (should not be '\\0' terminated)
+ * \param[in] len 	line length (not more then LOGRING_LINE_LEN-1)
+ * \param[in] truncated	line was cutted by the caller
+ * \remark
+ * 		It never blocks: if the ring is full the line is dropped and
+ * 		counted, the flusher will report the count later.
+ * 		It wakes the flusher when the ring becomes half full.
+ */
+void
+svd_logring_put (char const * const line, int const len, int const truncated)
+{/*{{{*/
+	struct logring_slot_s * slot;
+	unsigned long pos;
+	long dif;
+
+	if( !g_lr.running){
+		/* no flusher yet - write it here */
+		logring_write_line (line, len);
+		return;
+	}
+
+	if(truncated){
+		__sync_fetch_and_add(&g_lr.truncated, 1);
+	}
+
+	pos = g_lr.head;
+	for(;;){
+		slot = &g_lr.slots[pos & LOGRING_MASK];
+		dif = (long)slot->seq - (long)pos;
+		if(dif == 0){
+			if(__sync_bool_compare_and_swap(&g_lr.head, pos, pos+1)){
+				break;
+			}
+			pos = g_lr.head;
+		} else if(dif < 0){
+			/* ring is full */
+			__sync_fetch_and_add(&g_lr.dropped, 1);
+			goto __wake;
+		} else {
+			pos = g_lr.head;
+		}
+	}
+
+	memcpy(slot->line, line, len);
+	slot->len = len;
+	__sync_synchronize();
+	slot->seq = pos + 1;
+
+	if(pos - g_lr.tail < LOGRING_SLOTS/2){
+		return;
+	}
+__wake:
+	if(__sync_bool_compare_and_swap(&g_lr.wake_pending, 0, 1)){
+		sem_post(&g_lr.wake);
+	}
+}/*}}}*/
+
+/**
+ * Get the ring counters.
+ *
+ * \param[out] st 	counters to fill
+ */
+void
+svd_logring_stat (struct logring_stat_s * const st)
+{/*{{{*/
+	st->written = g_lr.written;
+	st->dropped = g_lr.dropped;
+	st->truncated = g_lr.truncated;
+	st->batches = g_lr.batches;
+}/*}}}*/
+
+/**
+ * Flusher thread.
+ *
+ * \param[in] arg 	not used
+ * \retval NULL 	always
+ * \remark
+ * 		It wakes up every \ref LOGRING_FLUSH_PERIOD ms or on producers
+ * 		request and drains the ring.
+ */
+static void *
+logring_flusher (void * arg)
+{/*{{{*/
+	struct timespec ts;
+	char msg[LOGRING_LINE_LEN];
+	unsigned long dropped;
+	int len;
+
+	for(;;){
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_nsec += LOGRING_FLUSH_PERIOD * 1000000L;
+		if(ts.tv_nsec >= 1000000000L){
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000L;
+		}
+		while(sem_timedwait(&g_lr.wake, &ts) && errno == EINTR);
+		g_lr.wake_pending = 0;
+
+		if(logring_drain()){
+			g_lr.batches++;
+		}
+
+		dropped = g_lr.dropped;
+		if(dropped != g_lr.dropped_reported){
+			len = snprintf(msg, sizeof(msg),
+					"log ring overflow: %lu lines dropped (%lu total)\n",
+					dropped - g_lr.dropped_reported, dropped);
+			logring_write_line (msg, len);
+			g_lr.dropped_reported = dropped;
+		}
+
+		if(g_lr.stop){
+			/* lines put after the last drain */
+			logring_drain();
+			break;
+		}
+	}
+	return NULL;
+}/*}}}*/
+
+/**
+ * Take all ready lines out of the ring and write them to the target.
+ *
+ * \retval 	count of written lines
+ * \remark
+ * 		File target lines are collected to the buffer and written by
+ * 		one write() per \ref LOGRING_WBUF_SIZE bytes.
+ */
+static int
+logring_drain (void)
+{/*{{{*/
+	struct logring_slot_s * slot;
+	char wbuf[LOGRING_WBUF_SIZE];
+	int wlen = 0;
+	int count = 0;
+	int err;
+
+	pthread_mutex_lock(&g_lr.target_lock);
+	for(;;){
+		slot = &g_lr.slots[g_lr.tail & LOGRING_MASK];
+		if(slot->seq != g_lr.tail + 1){
+			/* empty or not written yet */
+			break;
+		}
+		__sync_synchronize();
+
+		if(g_lr.target == logring_target_SYSLOG){
+			syslog(LOG_INFO, "%.*s", slot->len, slot->line);
+		} else {
+			if(wlen + slot->len > sizeof(wbuf)){
+				err = write(g_lr.fd, wbuf, wlen);
+				wlen = 0;
+			}
+			memcpy(wbuf+wlen, slot->line, slot->len);
+			wlen += slot->len;
+		}
+
+		__sync_synchronize();
+		slot->seq = g_lr.tail + LOGRING_SLOTS;
+		g_lr.tail++;
+		count++;
+	}
+	if(wlen){
+		err = write(g_lr.fd, wbuf, wlen);
+	}
+	pthread_mutex_unlock(&g_lr.target_lock);
+
+	(void)err;
+	g_lr.written += count;
+	return count;
+}/*}}}*/
+
+/**
+ * Write one line to the current target synchronously.
+ *
+ * \param[in] line 	line to write
+ * \param[in] len 	line length
+ */
+static void
+logring_write_line (char const * const line, int const len)
+{/*{{{*/
+	int err;
+	pthread_mutex_lock(&g_lr.target_lock);
+	if(g_lr.target == logring_target_SYSLOG){
+		syslog(LOG_INFO, "%.*s", len, line);
+	} else {
+		err = write(g_lr.fd, line, len);
+		(void)err;
+	}
+	pthread_mutex_unlock(&g_lr.target_lock);
+}/*}}}*/
+
@@ -0,0 +1,49 @@
+/**
+ * @file svd_logring.h
+ * Asynchronous log ring.
+ * It containes the in-memory log ring and the background flusher,
+ * 		that writes whole log lines to syslog or to a file.
+ */
+#ifndef __SVD_LOGRING_H__
+#define __SVD_LOGRING_H__
+
+/** @defgroup LOGRING Asynchronous log ring.
+ *  Producers put formatted lines into lock-free slots, the flusher thread
+ *  takes them out in batches and writes them to the selected target.
+ *  @{*/
+/** Slots count in the ring (should be a power of 2).*/
+#define LOGRING_SLOTS 256
+/** Maximum length of one log line (with indentation and '\\0').*/
+#define LOGRING_LINE_LEN 256
+/** Flusher sleeps this time (in ms) if nobody wakes it earlier.*/
+#define LOGRING_FLUSH_PERIOD 100
+
+/** Where the flusher writes lines to.*/
+enum logring_target_e {
+	logring_target_SYSLOG, /**< vsyslog with LOG_INFO */
+	logring_target_FD, /**< stderr or opened log file */
+};
+
+/** Ring counters.*/
+struct logring_stat_s {
+	unsigned long written; /**< Lines passed to the target.*/
+	unsigned long dropped; /**< Lines lost because the ring was full.*/
+	unsigned long truncated; /**< Lines cutted to LOGRING_LINE_LEN.*/
+	unsigned long batches; /**< Flusher wakeups with some lines to write.*/
+};
+
+/** Create the ring and start the flusher thread.*/
+int  svd_logring_create (void);
+/** Flush everything and stop the flusher thread.*/
+void svd_logring_destroy (void);
+/** Choose the target for the next lines.*/
+int  svd_logring_target (enum logring_target_e const target,
+		char const * const path);
+/** Put one formatted line to the ring.*/
+void svd_logring_put (char const * const line, int const len,
+		int const truncated);
+/** Get the ring counters.*/
+void svd_logring_stat (struct logring_stat_s * const st);
+/** @}*/
+
+#endif /* __SVD_LOGRING_H__ */
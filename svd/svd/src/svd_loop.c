@@ -0,0 +1,248 @@
+/**
+ * @file svd_loop.c
+ * Main loop statistics implementation.
+ * It containes the lag probe and histograms accounting.
+ */
+
+/* Includes {{{ */
+#include "svd.h"
+#include "svd_loop.h"
+
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+/*}}}*/
+
+/** Callback types names.*/
+char const * const loop_cb_name [loop_cb_COUNT] = {
+	"atab", "media_local", "media_remote", "if", "nua",
+	"dtmf_tmr", "reg_tmr", "probe", "led_tmr",
+	"media_uring",
+};
+
+/** Loop statistics context.*/
+static struct loop_s {/*{{{*/
+	struct loop_cb_stat_s st [loop_cb_COUNT]; /**< Per callback type.*/
+	unsigned long slow_us; /**< Slow handler threshold.*/
+	unsigned long long round; /**< First handler start after poll or 0.*/
+	unsigned long long probe_due; /**< Probe timer deadline.*/
+	su_timer_t * probe; /**< Lag probe timer.*/
+} g_loop;/*}}}*/
+
+/** Called by the root before every poll.*/
+static void svd_loop_prepoll (su_prepoll_magic_t * magic, su_root_t * root);
+/** Lag probe timer callback.*/
+static void svd_loop_probe_cb (su_root_magic_t * magic, su_timer_t * t,
+		su_timer_arg_t * arg);
+/** Add the sample to the histogram.*/
+static void svd_loop_hist_add (struct loop_hist_s * const h,
+		unsigned long const us);
+
+/**
+ * Start the lag probe and set the slow handler threshold.
+ *
+ * \param[in] svd 		svd context with the root.
+ * \param[in] slow_ms 	threshold, 0 - use \ref LOOP_SLOW_MS_DF
+ * \retval 0 	etherything is fine
+ * \retval -1 	error occures
+ * \remark
+ * 		Probe timer is re-armed every \ref LOOP_PROBE_PERIOD ms,
+ * 		its lag is the lag of the whole loop.
+ */
+int
+svd_loop_init (svd_t * const svd, int const slow_ms)
+{/*{{{*/
+	memset(&g_loop, 0, sizeof(g_loop));
+	svd_loop_slow_ms (slow_ms);
+
+	su_root_set_prepoll (svd->root, svd_loop_prepoll, NULL);
+
+	g_loop.probe = su_timer_create(su_root_task(svd->root), LOOP_PROBE_PERIOD);
+	if( !g_loop.probe){
+		SU_DEBUG_1 ((LOG_FNC_A ("su_timer_create() probe fails" ) ));
+		goto __exit_fail;
+	}
+	g_loop.probe_due = svd_loop_now() + LOOP_PROBE_PERIOD * 1000;
+	if(su_timer_set(g_loop.probe, svd_loop_probe_cb, NULL)){
+		SU_DEBUG_1 ((LOG_FNC_A ("su_timer_set() probe fails" ) ));
+		goto __exit_fail;
+	}
+	return 0;
+__exit_fail:
+	return -1;
+}/*}}}*/
+
+/**
+ * Stop the lag probe.
+ *
+ * \remark
+ * 		It should be called before the root destroying.
+ */
+void
+svd_loop_destroy (void)
+{/*{{{*/
+	if(g_loop.probe){
+		su_timer_destroy(g_loop.probe);
+		g_loop.probe = NULL;
+	}
+}/*}}}*/
+
+/**
+ * Set the slow handler threshold.
+ *
+ * \param[in] slow_ms 	threshold, 0 - use \ref LOOP_SLOW_MS_DF
+ */
+void
+svd_loop_slow_ms (int const slow_ms)
+{/*{{{*/
+	g_loop.slow_us = (slow_ms > 0 ? slow_ms : LOOP_SLOW_MS_DF) * 1000UL;
+}/*}}}*/
+
+/**
+ * Stamp the handler start and account the lag.
+ *
+ * \param[in] type 	callback type
+ * \param[in] due 	timer deadline (us, \ref svd_loop_now() scale),
+ * 		0 for wait object handlers
+ * \return 	start time for \ref svd_loop_leave()
+ * \remark
+ * 		Wait object handler lag is the time since the first handler
+ * 		after the last poll: the time it waits for other handlers in the
+ * 		same round. \ref loop_cb_NUA has no lag.
+ */
+unsigned long long
+svd_loop_enter (enum loop_cb_e const type, unsigned long long const due)
+{/*{{{*/
+	unsigned long long now = svd_loop_now();
+	unsigned long long from = due;
+
+	if(type == loop_cb_NUA){
+		return now;
+	}
+	if( !from){
+		if( !g_loop.round){
+			g_loop.round = now;
+		}
+		from = g_loop.round;
+	}
+	svd_loop_hist_add (&g_loop.st[type].lag, now > from ? now - from : 0);
+	return now;
+}/*}}}*/
+
+/**
+ * Account the handler duration.
+ *
+ * \param[in] type 	callback type
+ * \param[in] start 	\ref svd_loop_enter() return value
+ * \remark
+ * 		Handlers longer then threshold are logged with the type name.
+ */
+void
+svd_loop_leave (enum loop_cb_e const type, unsigned long long const start)
+{/*{{{*/
+	struct loop_cb_stat_s * st = &g_loop.st[type];
+	unsigned long us = svd_loop_now() - start;
+
+	svd_loop_hist_add (&st->dur, us);
+	if(us >= g_loop.slow_us){
+		st->slow++;
+		SU_DEBUG_2(("slow handler %s: %lu ms (max %lu ms, %lu slow)\n",
+				loop_cb_name[type], us / 1000, st->dur.max_us / 1000,
+				st->slow));
+	}
+}/*}}}*/
+
+/**
+ * Get the statistics of callback type.
+ *
+ * \param[in] type 	callback type
+ * \return 	statistics
+ */
+struct loop_cb_stat_s const *
+svd_loop_stat (enum loop_cb_e const type)
+{/*{{{*/
+	return &g_loop.st[type];
+}/*}}}*/
+
+/**
+ * Lower bound of the histogram bucket.
+ *
+ * \param[in] idx 	bucket index
+ * \return 	lower bound (us)
+ * \remark
+ * 		Buckets 0-3 are 0,1,2,3 us, then every power of 2 is split
+ * 		to 4 equal buckets: 4,5,6,7, 8,10,12,14, 16,20,24,28 ...
+ */
+unsigned long
+svd_loop_bucket_low (int const idx)
+{/*{{{*/
+	if(idx < 4){
+		return idx;
+	}
+	return (4UL + (idx & 3)) << (idx / 4 - 1);
+}/*}}}*/
+
+/**
+ * Add the sample to the histogram.
+ *
+ * \param[in,out] h 	histogram
+ * \param[in] us 		sample (us)
+ */
+static void
+svd_loop_hist_add (struct loop_hist_s * const h, unsigned long const us)
+{/*{{{*/
+	int e = 0;
+	int idx;
+
+	if(us < 4){
+		idx = us;
+	} else {
+		while(us >> (e+1)){
+			e++;
+		}
+		idx = (e-1) * 4 + ((us >> (e-2)) & 3);
+		if(idx >= LOOP_BUCKETS){
+			idx = LOOP_BUCKETS-1;
+		}
+	}
+	h->cnt[idx]++;
+	h->n++;
+	h->sum_us += us;
+	if(us > h->max_us){
+		h->max_us = us;
+	}
+}/*}}}*/
+
+/**
+ * Called by the root before every poll.
+ *
+ * \param[in] magic 	not used
+ * \param[in] root 		not used
+ * \remark
+ * 		It starts the new handlers round.
+ */
+static void
+svd_loop_prepoll (su_prepoll_magic_t * magic, su_root_t * root)
+{/*{{{*/
+	g_loop.round = 0;
+}/*}}}*/
+
+/**
+ * Lag probe timer callback.
+ *
+ * \param[in] magic 	svd pointer.
+ * \param[in] t 		probe timer.
+ * \param[in] arg 		not used.
+ */
+static void
+svd_loop_probe_cb (su_root_magic_t * magic, su_timer_t * t,
+		su_timer_arg_t * arg)
+{/*{{{*/
+	unsigned long long start;
+
+	start = svd_loop_enter (loop_cb_PROBE, g_loop.probe_due);
+	g_loop.probe_due = start + LOOP_PROBE_PERIOD * 1000;
+	su_timer_set(t, svd_loop_probe_cb, NULL);
+	svd_loop_leave (loop_cb_PROBE, start);
+}/*}}}*/
+
@@ -0,0 +1,91 @@
+/**
+ * @file svd_loop.h
+ * Main loop statistics.
+ * It containes handlers duration and scheduling lag histograms per
+ * 		callback type and functions to fill them.
+ */
+#ifndef __SVD_LOOP_H__
+#define __SVD_LOOP_H__
+
+#include <time.h>
+
+/** @defgroup LOOP Main loop statistics.
+ *  Every callback svd registers on the su_root is wrapped with
+ *  \ref svd_loop_enter() and \ref svd_loop_leave(). Durations and lags
+ *  are accounted in the log-linear histograms (4 buckets per power of 2),
+ *  handlers longer than the threshold are logged with the callback name.
+ *  @{*/
+/** Histogram buckets (the last one is up to 2^25 us and more).*/
+#define LOOP_BUCKETS 96
+/** Period of the lag probe timer (ms).*/
+#define LOOP_PROBE_PERIOD 100
+/** Default slow handler threshold (ms).*/
+#define LOOP_SLOW_MS_DF 20
+
+/** Callback types.*/
+enum loop_cb_e {/*{{{*/
+	loop_cb_ATAB, /**< svd_atab_handler (board events) */
+	loop_cb_MEDIA_LOCAL, /**< RTP from the channel to the socket */
+	loop_cb_MEDIA_REMOTE, /**< RTP from the socket to the channel */
+	loop_cb_IF, /**< svd_if_handler (management interface) */
+	loop_cb_NUA, /**< svd_nua_callback (no lag, nua has own queue) */
+	loop_cb_DTMF_TMR, /**< Dial sequence timer */
+	loop_cb_REG_TMR, /**< Registration retry timer */
+	loop_cb_PROBE, /**< Lag probe timer (loop lag itself) */
+	loop_cb_LED_TMR, /**< Deferred leds updates timer */
+	loop_cb_MEDIA_URING, /**< RTP of all channels on the io_uring */
+	loop_cb_COUNT, /**< Types count */
+};/*}}}*/
+
+/** One histogram.*/
+struct loop_hist_s {/*{{{*/
+	unsigned long cnt [LOOP_BUCKETS]; /**< Log-linear us buckets.*/
+	unsigned long n; /**< Samples count.*/
+	unsigned long long sum_us; /**< Sum of samples (us).*/
+	unsigned long max_us; /**< Maximum sample (us).*/
+};/*}}}*/
+
+/** Statistics of one callback type.*/
+struct loop_cb_stat_s {/*{{{*/
+	struct loop_hist_s dur; /**< Handler duration.*/
+	struct loop_hist_s lag; /**< Scheduling lag.*/
+	unsigned long slow; /**< Handlers over the threshold.*/
+};/*}}}*/
+
+/** Callback types names (for logs and interface).*/
+extern char const * const loop_cb_name [loop_cb_COUNT];
+
+/** Start the lag probe and set the slow handler threshold.*/
+int  svd_loop_init (struct svd_s * const svd, int const slow_ms);
+/** Stop the lag probe.*/
+void svd_loop_destroy (void);
+/** Set the slow handler threshold.*/
+void svd_loop_slow_ms (int const slow_ms);
+/** Stamp the handler start and account the lag.*/
+unsigned long long svd_loop_enter (enum loop_cb_e const type,
+		unsigned long long const due);
+/** Account the handler duration.*/
+void svd_loop_leave (enum loop_cb_e const type,
+		unsigned long long const start);
+/** Get the statistics of callback type.*/
+struct loop_cb_stat_s const * svd_loop_stat (enum loop_cb_e const type);
+/** Lower bound (us) of the histogram bucket.*/
+unsigned long svd_loop_bucket_low (int const idx);
+
+/**
+ * Monotonic time in us.
+ *
+ * \return 	current time
+ * \remark
+ * 		Add the timer interval to get \c due for \ref svd_loop_enter().
+ */
+static inline unsigned long long
+svd_loop_now (void)
+{/*{{{*/
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}/*}}}*/
+/** @}*/
+
+#endif /* __SVD_LOOP_H__ */
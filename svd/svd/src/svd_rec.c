@@ -0,0 +1,222 @@
+/**
+ * @file svd_rec.c
+ * Traffic recorder implementation.
+ * It containes the recording file writer.
+ */
+
+/* Includes {{{ */
+#include "svd.h"
+#include "svd_rec.h"
+#include "svd_loop.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <sys/time.h>
+/*}}}*/
+
+/** The recorder.*/
+struct rec_s g_rec;
+
+/** Write one record.*/
+static void svd_rec_put (enum rec_type_e const type, int const chan,
+		void const * const data, int const len, char const * const text);
+
+/**
+ * Open the recording file.
+ *
+ * \param[in] path 	file to record to (truncated if exists).
+ * \param[in] chans 	channels count of the board.
+ * \retval 0 	if etherything ok.
+ * \retval -1 	if somthing nasty happens.
+ */
+int
+svd_rec_open (char const * const path, int const chans)
+{/*{{{*/
+	struct rec_file_hdr_s fh;
+	struct timeval tv;
+
+	g_rec.f = fopen(path, "w");
+	if( !g_rec.f){
+		SU_DEBUG_0(("Can`t open record file \"%s\": %s\n",
+				path, strerror(errno)));
+		goto __exit_fail;
+	}
+	setvbuf(g_rec.f, NULL, _IOFBF, REC_BUF_SIZE);
+
+	gettimeofday(&tv, NULL);
+	memset(&fh, 0, sizeof(fh));
+	fh.magic = REC_MAGIC;
+	fh.version = REC_VERSION;
+	fh.chans = chans;
+	fh.start_us = tv.tv_sec * 1000000ULL + tv.tv_usec;
+	if(fwrite(&fh, sizeof(fh), 1, g_rec.f) != 1){
+		SU_DEBUG_0(("Can`t write record file \"%s\": %s\n",
+				path, strerror(errno)));
+		fclose(g_rec.f);
+		g_rec.f = NULL;
+		goto __exit_fail;
+	}
+	g_rec.last_us = svd_loop_now();
+	g_rec.recs = 0;
+	SU_DEBUG_3(("Recording to \"%s\"\n", path));
+	return 0;
+__exit_fail:
+	return -1;
+}/*}}}*/
+
+/**
+ * Flush and close the recording file.
+ */
+void
+svd_rec_close (void)
+{/*{{{*/
+	if( !g_rec.f){
+		return;
+	}
+	SU_DEBUG_3(("Recorded %lu records\n", g_rec.recs));
+	fclose(g_rec.f);
+	g_rec.f = NULL;
+}/*}}}*/
+
+/**
+ * Record the board event.
+ *
+ * \param[in] chan_idx 	channel index.
+ * \param[in] dev_idx 	device index (from 0).
+ * \param[in] evt 		the event.
+ * \param[in] chan_av 	event is the channel event.
+ */
+void
+svd_rec_evt (int const chan_idx, int const dev_idx,
+		ab_dev_event_t const * const evt, int const chan_av)
+{/*{{{*/
+	struct rec_evt_s r;
+
+	memset(&r, 0, sizeof(r));
+	r.id = evt->id;
+	r.data = evt->data;
+	r.dev = dev_idx;
+	r.ch = evt->ch;
+	r.chan_av = chan_av;
+	r.more = evt->more;
+	svd_rec_put (rec_type_EVT, chan_idx, &r, sizeof(r), NULL);
+}/*}}}*/
+
+/**
+ * Record the RTP packet metadata.
+ *
+ * \param[in] chan_idx 	channel index.
+ * \param[in] dir 		packet direction.
+ * \param[in] pkt 		packet.
+ * \param[in] len 		packet length.
+ * \remark
+ * 		Voice is not recorded, only the RTP header fields.
+ */
+void
+svd_rec_rtp (int const chan_idx, enum rec_rtp_dir_e const dir,
+		unsigned char const * const pkt, int const len)
+{/*{{{*/
+	struct rec_rtp_s r;
+
+	memset(&r, 0, sizeof(r));
+	r.dir = dir;
+	r.len = len;
+	if(len >= 12){
+		r.pt = pkt[1];
+		r.seq = (pkt[2] << 8) | pkt[3];
+		r.ts = ((uint32_t)pkt[4] << 24) | (pkt[5] << 16) | (pkt[6] << 8) | pkt[7];
+	}
+	svd_rec_put (rec_type_RTP, chan_idx, &r, sizeof(r), NULL);
+}/*}}}*/
+
+/**
+ * Record the NUA event.
+ *
+ * \param[in] event 	nua event.
+ * \param[in] status 	status of the event.
+ * \param[in] phrase 	status phrase (can be NULL).
+ * \param[in] nh 		nua handle.
+ * \param[in] method 	CSeq method of the message (can be NULL).
+ * \param[in] call_id 	Call-ID of the message (can be NULL).
+ */
+void
+svd_rec_sip (int const event, int const status, char const * const phrase,
+		void const * const nh, char const * const method,
+		char const * const call_id)
+{/*{{{*/
+	struct rec_sip_s r;
+	char text [REC_SIP_TEXT_MAX];
+
+	memset(&r, 0, sizeof(r));
+	r.event = event;
+	r.status = status;
+	r.tag = (unsigned long)nh;
+	snprintf(text, sizeof(text), "%s\t%s\t%s", method ? method : "",
+			call_id ? call_id : "", phrase ? phrase : "");
+	svd_rec_put (rec_type_SIP, REC_CHAN_NONE, &r, sizeof(r), text);
+}/*}}}*/
+
+/**
+ * Write one record.
+ *
+ * \param[in] type 	record type.
+ * \param[in] chan 	channel index or \ref REC_CHAN_NONE.
+ * \param[in] data 	payload.
+ * \param[in] len 	payload length.
+ * \param[in] text 	string to put after the payload with '\\0' or NULL.
+ * \remark
+ * 		RTP records stay in the stdio buffer, others are flushed to
+ * 		keep the control flow on disk if svd dies. Recording stops on
+ * 		the first write error.
+ */
+static void
+svd_rec_put (enum rec_type_e const type, int const chan,
+		void const * const data, int const len, char const * const text)
+{/*{{{*/
+	struct rec_hdr_s h;
+	unsigned long long now;
+	unsigned long long delta;
+	uint32_t gap;
+	int tlen = text ? strlen(text) + 1 : 0;
+	int err = 0;
+
+	if( !g_rec.f){
+		return;
+	}
+	now = svd_loop_now();
+	delta = now - g_rec.last_us;
+	g_rec.last_us = now;
+
+	memset(&h, 0, sizeof(h));
+	if(delta > UINT32_MAX){
+		gap = delta / 1000000;
+		delta -= gap * 1000000ULL;
+		h.type = rec_type_GAP;
+		h.chan = REC_CHAN_NONE;
+		h.len = sizeof(gap);
+		err |= fwrite(&h, sizeof(h), 1, g_rec.f) != 1;
+		err |= fwrite(&gap, sizeof(gap), 1, g_rec.f) != 1;
+	}
+	h.delta_us = delta;
+	h.type = type;
+	h.chan = chan;
+	h.len = len + tlen;
+	err |= fwrite(&h, sizeof(h), 1, g_rec.f) != 1;
+	err |= fwrite(data, len, 1, g_rec.f) != 1;
+	if(tlen){
+		err |= fwrite(text, tlen, 1, g_rec.f) != 1;
+	}
+	if( !err && type != rec_type_RTP){
+		err = fflush(g_rec.f);
+	}
+	if(err){
+		SU_DEBUG_1(("Recording stopped: %s\n", strerror(errno)));
+		fclose(g_rec.f);
+		g_rec.f = NULL;
+		return;
+	}
+	g_rec.recs++;
+}/*}}}*/
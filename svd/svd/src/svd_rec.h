@@ -0,0 +1,131 @@
+/**
+ * @file svd_rec.h
+ * Traffic recorder.
+ * It containes the binary format of the recording (shared with
+ * 		svd_replay) and functions to write it.
+ */
+#ifndef __SVD_REC_H__
+#define __SVD_REC_H__
+
+#include "ab_api.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/** @defgroup REC Traffic recorder.
+ *  With "-r FILE" svd writes board events, RTP packets metadata and
+ *  NUA events to the file. svd_replay feeds the file back to svd running
+ *  on the simulated board and compares two recordings.
+ *  The file is \ref rec_file_hdr_s followed by records, every record
+ *  is \ref rec_hdr_s followed by \c len bytes of the type payload.
+ *  Numbers are in host byte order.
+ *  @{*/
+/** File magic ("SVDR").*/
+#define REC_MAGIC 0x52445653UL
+/** File format version.*/
+#define REC_VERSION 1
+/** Output buffer size (RTP records are not flushed one by one).*/
+#define REC_BUF_SIZE 65536
+/** Maximum length of the SIP record text (with '\\0').*/
+#define REC_SIP_TEXT_MAX 192
+/** Channel field value of the records without channel.*/
+#define REC_CHAN_NONE 0xFF
+
+/** Record types.*/
+enum rec_type_e {/*{{{*/
+	rec_type_NONE, /**< Not a record */
+	rec_type_GAP, /**< Pause longer than delta field (uint32_t seconds) */
+	rec_type_EVT, /**< Board event (\ref rec_evt_s) */
+	rec_type_RTP, /**< RTP packet metadata (\ref rec_rtp_s) */
+	rec_type_SIP, /**< NUA event (\ref rec_sip_s and text) */
+	rec_type_COUNT, /**< Types count */
+};/*}}}*/
+
+/** RTP packet directions.*/
+enum rec_rtp_dir_e {/*{{{*/
+	rec_rtp_dir_TX, /**< From the board to the network */
+	rec_rtp_dir_RX, /**< From the network to the board */
+};/*}}}*/
+
+/** File header.*/
+struct rec_file_hdr_s {/*{{{*/
+	uint32_t magic; /**< \ref REC_MAGIC.*/
+	uint16_t version; /**< \ref REC_VERSION.*/
+	uint16_t chans; /**< Channels count of the board.*/
+	uint64_t start_us; /**< Wall clock time of the start (us).*/
+};/*}}}*/
+
+/** Record header.*/
+struct rec_hdr_s {/*{{{*/
+	uint32_t delta_us; /**< Time since the previous record (us).*/
+	uint8_t type; /**< \ref rec_type_e value.*/
+	uint8_t chan; /**< Channel index or \ref REC_CHAN_NONE.*/
+	uint16_t len; /**< Payload length.*/
+};/*}}}*/
+
+/** Board event payload.*/
+struct rec_evt_s {/*{{{*/
+	int32_t id; /**< \ref ab_dev_event_e value.*/
+	int32_t data; /**< Event data.*/
+	uint8_t dev; /**< Device index (from 0).*/
+	uint8_t ch; /**< Channel in the device.*/
+	uint8_t chan_av; /**< Channel event (not device one).*/
+	uint8_t more; /**< More events were pending.*/
+};/*}}}*/
+
+/** RTP packet payload (the header fields and length only).*/
+struct rec_rtp_s {/*{{{*/
+	uint8_t dir; /**< \ref rec_rtp_dir_e value.*/
+	uint8_t pt; /**< Payload type with marker bit (0x80).*/
+	uint16_t seq; /**< Sequence number.*/
+	uint32_t ts; /**< Timestamp.*/
+	uint16_t len; /**< Packet length.*/
+	uint16_t pad; /**< Zero.*/
+};/*}}}*/
+
+/** NUA event payload, "METHOD\\tCALL-ID\\tPHRASE" text follows it.*/
+struct rec_sip_s {/*{{{*/
+	int16_t event; /**< nua_event_t value.*/
+	int16_t status; /**< Status of the event.*/
+	uint32_t tag; /**< NUA handle (to correlate records).*/
+};/*}}}*/
+
+#ifndef SVD_REC_NO_WRITER
+/** Recorder state.*/
+struct rec_s {/*{{{*/
+	FILE * f; /**< Output file (NULL if recording is off).*/
+	unsigned long long last_us; /**< Time of the previous record (us).*/
+	unsigned long recs; /**< Written records.*/
+};/*}}}*/
+extern struct rec_s g_rec;
+
+/** Open the recording file.*/
+int  svd_rec_open (char const * const path, int const chans);
+/** Flush and close the recording file.*/
+void svd_rec_close (void);
+/** Record the board event.*/
+void svd_rec_evt (int const chan_idx, int const dev_idx,
+		ab_dev_event_t const * const evt, int const chan_av);
+/** Record the RTP packet metadata.*/
+void svd_rec_rtp (int const chan_idx, enum rec_rtp_dir_e const dir,
+		unsigned char const * const pkt, int const len);
+/** Record the NUA event.*/
+void svd_rec_sip (int const event, int const status, char const * const phrase,
+		void const * const nh, char const * const method,
+		char const * const call_id);
+
+/**
+ * Check if recording is on.
+ *
+ * \retval 0 	recording is off
+ * \retval 1 	recording is on
+ */
+static inline int
+svd_rec_on (void)
+{/*{{{*/
+	return g_rec.f != NULL;
+}/*}}}*/
+#endif /* SVD_REC_NO_WRITER */
+/** @}*/
+
+#endif /* __SVD_REC_H__ */
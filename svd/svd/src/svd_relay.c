@@ -0,0 +1,79 @@
+/**
+ * @file svd_relay.c
+ * RTP relay steps implementation.
+ * It containes the per-packet relay of the poll media engine.
+ */
+
+/* Includes {{{ */
+#ifdef HAVE_CONFIG_H
+#include "sofia.h"
+#else
+#include <stdio.h>
+/* built alone (bench/trace_bench.c): the level check SU_DEBUG_9 does
+ * before su_llog(), the level is the bench one */
+extern unsigned int volatile svd_relay_log_level;
+#define SU_DEBUG_9(x) (svd_relay_log_level >= 9 ? (void)printf x : (void)0)
+#define VA_NONE "%s", ""
+#endif
+#include "svd_relay.h"
+#include "svd_log.h"
+
+#include <unistd.h>
+/*}}}*/
+
+/**
+ * Relay one packet from the board stream to the remote address.
+ *
+ * \param[in] rtp_fd 	board RTP stream.
+ * \param[in] sfd 		RTP socket.
+ * \param[in] addr 		remote address.
+ * \param[in] len 		remote address length.
+ * \param[out] buf 		packet buffer.
+ * \param[in] size 		buf size.
+ * \param[out] sent 	sendto() result (set if the packet is read).
+ * \return
+ * 		read() result: packet length, 0 on the wrong event or -1 on error
+ * 		(errno is set).
+ */
+int
+svd_relay_to_net (int const rtp_fd, int const sfd,
+		struct sockaddr const * const addr, socklen_t const len,
+		unsigned char * const buf, size_t const size, int * const sent)
+{/*{{{*/
+	int rode;
+DFS
+	rode = read(rtp_fd, buf, size);
+	if(rode > 0){
+		// should not block
+		*sent = sendto(sfd, buf, rode, 0, addr, len);
+	}
+DFE
+	return rode;
+}/*}}}*/
+
+/**
+ * Relay one packet from the RTP socket to the board stream.
+ *
+ * \param[in] sfd 		RTP socket.
+ * \param[in] rtp_fd 	board RTP stream.
+ * \param[out] buf 		packet buffer.
+ * \param[in] size 		buf size.
+ * \param[out] writed 	write() result (set if the packet is received).
+ * \return
+ * 		recv() result: packet length, 0 on the wrong event or -1 on error
+ * 		(errno is set).
+ */
+int
+svd_relay_to_board (int const sfd, int const rtp_fd,
+		unsigned char * const buf, size_t const size, int * const writed)
+{/*{{{*/
+	int received;
+DFS
+	received = recv(sfd, buf, size, 0);
+	if(received > 0){
+		/* should not block */
+		*writed = write(rtp_fd, buf, received);
+	}
+DFE
+	return received;
+}/*}}}*/
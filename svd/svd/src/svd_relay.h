@@ -0,0 +1,28 @@
+/**
+ * @file svd_relay.h
+ * RTP relay steps.
+ * It containes the per-packet relay of the poll media engine, it does
+ * 		not use sofia-sip (bench/trace_bench.c builds it alone at both
+ * 		trace levels).
+ */
+#ifndef __SVD_RELAY_H__
+#define __SVD_RELAY_H__
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+/** @defgroup RELAY RTP relay steps.
+ *  One packet from the board stream to the network or back, the media
+ *  handlers of svd_atab.c log the results and do the accounting.
+ *  @{*/
+/** Relay one packet from the board stream to the remote address.*/
+int svd_relay_to_net (int const rtp_fd, int const sfd,
+		struct sockaddr const * const addr, socklen_t const len,
+		unsigned char * const buf, size_t const size, int * const sent);
+/** Relay one packet from the RTP socket to the board stream.*/
+int svd_relay_to_board (int const sfd, int const rtp_fd,
+		unsigned char * const buf, size_t const size, int * const writed);
+/** @}*/
+
+#endif /* __SVD_RELAY_H__ */
@@ -0,0 +1,1634 @@
+/**
+ * @file svd_replay.c
+ * Main file of the svd_replay programm.
+ * It containes the recording reader, the replay driver with the
+ * 		local SIP stand-in and the recordings comparison.
+ *
+ * Replay feeds the recording (made with "svd -r") back to svd that runs
+ * on the simulated board: board events are injected through the board
+ * control socket at the recorded times (scaled by the speed), the SIP
+ * stand-in answers svd requests with the recorded statuses when the
+ * replay reaches the response records and sends the recorded incoming
+ * requests (INVITE, CANCEL, BYE) to svd. Received RTP headers are sent
+ * to the media address of the call with the zero payload.
+ * svd should use the stand-in address as registrar and proxy, record the
+ * replay with "-r" and compare two files with "svd_replay -d".
+ */
+
+/* Includes {{{ */
+#define SVD_REC_NO_WRITER
+#include "svd_rec.h"
+
+#include <sofia-sip/nua.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <getopt.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+/*}}}*/
+
+/** Default SIP stand-in port.*/
+#define RP_SIP_PORT_DF 5060
+/** Default time to wait for svd request before the response (ms).*/
+#define RP_WAIT_MS_DF 5000
+/** Board control socket reply timeout (ms).*/
+#define RP_CTL_TIMEOUT 1000
+/** Header values and URIs length.*/
+#define RP_STR 256
+/** SIP message length.*/
+#define RP_MSG 4096
+/** Requests from svd kept (pending and answered).*/
+#define RP_REQS 32
+/** Calls kept.*/
+#define RP_DLGS 16
+/** Channels (record channel field range).*/
+#define RP_CHANS 256
+/** Records to look ahead for resync after the difference.*/
+#define RP_RESYNC 16
+/** Differences to show.*/
+#define RP_DIFF_SHOW 10
+/** nua events to account.*/
+#define RP_NUA_EVENTS 128
+
+/** One record of the loaded file.*/
+struct rp_rec_s {/*{{{*/
+	unsigned long long t_us; /**< Time from the start.*/
+	struct rec_hdr_s h; /**< Header.*/
+	unsigned char const * data; /**< Payload.*/
+};/*}}}*/
+
+/** Loaded recording.*/
+struct rp_file_s {/*{{{*/
+	char const * path; /**< File name.*/
+	struct rec_file_hdr_s fh; /**< File header.*/
+	unsigned char * buf; /**< File content.*/
+	size_t size; /**< Content size.*/
+};/*}}}*/
+
+/** SIP record text fields.*/
+struct rp_sip_s {/*{{{*/
+	struct rec_sip_s r; /**< Fixed part.*/
+	char method [16]; /**< CSeq method or "".*/
+	char call_id [RP_STR]; /**< Call-ID or "".*/
+	char phrase [RP_STR]; /**< Status phrase.*/
+};/*}}}*/
+
+/** Request from svd states.*/
+enum rp_req_state_e {/*{{{*/
+	rp_req_FREE, /**< Not used */
+	rp_req_PENDING, /**< Waits for the response record */
+	rp_req_DONE, /**< Answered (kept for retransmissions) */
+};/*}}}*/
+
+/** Request from svd.*/
+struct rp_req_s {/*{{{*/
+	enum rp_req_state_e state; /**< State.*/
+	unsigned long long t_us; /**< Receive time.*/
+	char method [16]; /**< Method.*/
+	unsigned long cseq; /**< CSeq number.*/
+	char call_id [RP_STR]; /**< Call-ID.*/
+	char from [RP_STR]; /**< From value.*/
+	char to [RP_STR]; /**< To value.*/
+	char contact [RP_STR]; /**< Contact value.*/
+	char totag [32]; /**< Our To tag.*/
+	char vias [RP_MSG/4]; /**< Via header lines.*/
+	struct sockaddr_in src; /**< Where to answer.*/
+	struct sockaddr_in media; /**< Offered media address.*/
+	char rpl [RP_MSG]; /**< Final response.*/
+};/*}}}*/
+
+/** Call between svd and the stand-in.*/
+struct rp_dlg_s {/*{{{*/
+	int used; /**< Slot is used.*/
+	int uac; /**< Stand-in sent the INVITE.*/
+	int up; /**< 2xx is got / sent.*/
+	int chan; /**< Channel of the RTP records or -1.*/
+	unsigned int cseq; /**< Our last CSeq.*/
+	char rec_cid [RP_STR]; /**< Call-ID in the recording.*/
+	char cid [RP_STR]; /**< Call-ID of the replay.*/
+	char local [RP_STR]; /**< Our From / To value with tag.*/
+	char remote [RP_STR]; /**< svd From / To value.*/
+	char ruri [RP_STR]; /**< Request-URI of our INVITE.*/
+	char target [RP_STR]; /**< svd Contact URI.*/
+	char branch [32]; /**< Our INVITE branch.*/
+	struct sockaddr_in dst; /**< svd SIP address.*/
+	struct sockaddr_in media; /**< svd media address.*/
+};/*}}}*/
+
+/** Replay context.*/
+static struct rp_s {/*{{{*/
+	double speed; /**< Speed factor (0 - no delays).*/
+	int wait_ms; /**< Wait for the request before the response.*/
+	char const * ctl; /**< Board control socket path.*/
+	char addr [32]; /**< Stand-in IP address.*/
+	int port; /**< Stand-in SIP port.*/
+	int rtp_port; /**< Stand-in RTP port.*/
+	int sip_fd; /**< SIP socket.*/
+	int rtp_fd; /**< RTP socket.*/
+	int ctl_fd; /**< Board control client socket.*/
+	struct sockaddr_un ctl_addr; /**< Board control socket.*/
+	struct sockaddr_un own_addr; /**< Our control client address.*/
+	int svd_known; /**< svd address is known.*/
+	struct sockaddr_in svd_sip; /**< svd SIP address.*/
+	char svd_aor [RP_STR]; /**< Registered AOR URI.*/
+	char svd_contact [RP_STR]; /**< Registered Contact URI.*/
+	char answered [RP_STR]; /**< Methods with response records.*/
+	unsigned long long base_us; /**< Replay start (shifted by waits).*/
+	unsigned long seq; /**< Tags, branches and Call-IDs counter.*/
+	unsigned char talk [RP_CHANS]; /**< Talking is on.*/
+	struct rp_req_s reqs [RP_REQS]; /**< Requests from svd.*/
+	struct rp_dlg_s dlgs [RP_DLGS]; /**< Calls.*/
+	/* report */
+	unsigned long evts; /**< Injected events.*/
+	unsigned long evt_errs; /**< Injection failures.*/
+	unsigned long long late_sum; /**< Sum of records lateness (us).*/
+	unsigned long late_max; /**< Maximum record lateness (us).*/
+	unsigned long late_n; /**< Lateness samples.*/
+	unsigned long long waited; /**< Waited for requests (us).*/
+	unsigned long reqs_in; /**< Requests from svd.*/
+	unsigned long rsps_out; /**< Responses sent (recorded).*/
+	unsigned long auto_out; /**< Responses sent (not recorded method).*/
+	unsigned long reqs_out; /**< Requests sent to svd.*/
+	unsigned long rsps_in; /**< Responses from svd.*/
+	unsigned long skipped; /**< Records not replayable.*/
+	unsigned long missed; /**< Response records without the request.*/
+	unsigned long rtp_out; /**< RTP packets sent.*/
+	unsigned long rtp_in; /**< RTP packets received.*/
+} g_rp;
+
+/** Monotonic time in us.*/
+static unsigned long long
+rp_now (void)
+{/*{{{*/
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}/*}}}*/
+
+/**
+ * Add formatted string to the buffer.
+ *
+ * \param[in,out] buf 	buffer.
+ * \param[in,out] len 	used length.
+ * \param[in] fmt 		format.
+ */
+static void
+rp_cat (char * const buf, int * const len, char const * fmt, ...)
+{/*{{{*/
+	va_list ap;
+	int n;
+
+	if(*len >= RP_MSG){
+		return;
+	}
+	va_start(ap, fmt);
+	n = vsnprintf(buf + *len, RP_MSG - *len, fmt, ap);
+	va_end(ap);
+	*len += n;
+	if(*len > RP_MSG - 1){
+		*len = RP_MSG - 1;
+	}
+}/*}}}*/
+
+/**
+ * Load the recording.
+ *
+ * \param[in,out] f 	file (path is set).
+ * \retval 0 	if etherything ok.
+ * \retval -1 	if somthing nasty happens.
+ */
+static int
+rp_load (struct rp_file_s * const f)
+{/*{{{*/
+	FILE * fp;
+	long size;
+
+	fp = fopen(f->path, "r");
+	if( !fp){
+		fprintf(stderr, "%s: %s\n", f->path, strerror(errno));
+		goto __exit_fail;
+	}
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	if(size < (long)sizeof(f->fh)){
+		fprintf(stderr, "%s: too short\n", f->path);
+		goto __close;
+	}
+	f->buf = malloc(size);
+	if( !f->buf){
+		fprintf(stderr, "%s: not enough memory\n", f->path);
+		goto __close;
+	}
+	if(fread(f->buf, size, 1, fp) != 1){
+		fprintf(stderr, "%s: %s\n", f->path, strerror(errno));
+		goto __close;
+	}
+	fclose(fp);
+	memcpy(&f->fh, f->buf, sizeof(f->fh));
+	if(f->fh.magic != REC_MAGIC || f->fh.version != REC_VERSION){
+		fprintf(stderr, "%s: not a svd recording (or other version)\n",
+				f->path);
+		goto __exit_fail;
+	}
+	f->size = size;
+	return 0;
+__close:
+	fclose(fp);
+__exit_fail:
+	return -1;
+}/*}}}*/
+
+/**
+ * Get the next record.
+ *
+ * \param[in] f 		loaded file.
+ * \param[in,out] pos 	offset in the file (0 - from the start).
+ * \param[out] r 		record (t_us is accumulated).
+ * \retval 1 	record is got.
+ * \retval 0 	end of file (or truncated record).
+ * \remark
+ * 		Gap records are accounted and skipped.
+ */
+static int
+rp_next (struct rp_file_s const * const f, size_t * const pos,
+		struct rp_rec_s * const r)
+{/*{{{*/
+	uint32_t gap;
+
+	if( !*pos){
+		*pos = sizeof(f->fh);
+		r->t_us = 0;
+	}
+	while(*pos + sizeof(r->h) <= f->size){
+		memcpy(&r->h, f->buf + *pos, sizeof(r->h));
+		if(*pos + sizeof(r->h) + r->h.len > f->size){
+			break;
+		}
+		r->data = f->buf + *pos + sizeof(r->h);
+		*pos += sizeof(r->h) + r->h.len;
+		r->t_us += r->h.delta_us;
+		if(r->h.type == rec_type_GAP && r->h.len == sizeof(gap)){
+			memcpy(&gap, r->data, sizeof(gap));
+			r->t_us += gap * 1000000ULL;
+			continue;
+		}
+		return 1;
+	}
+	return 0;
+}/*}}}*/
+
+/**
+ * Decode the SIP record.
+ *
+ * \param[in] r 	record.
+ * \param[out] s 	decoded fields.
+ */
+static void
+rp_sip_decode (struct rp_rec_s const * const r, struct rp_sip_s * const s)
+{/*{{{*/
+	char text [REC_SIP_TEXT_MAX];
+	char * m;
+	char * c;
+	char * p;
+	int tlen;
+
+	memset(s, 0, sizeof(*s));
+	if(r->h.len < sizeof(s->r)){
+		return;
+	}
+	memcpy(&s->r, r->data, sizeof(s->r));
+	tlen = r->h.len - sizeof(s->r);
+	if(tlen >= (int)sizeof(text)){
+		tlen = sizeof(text) - 1;
+	}
+	memcpy(text, r->data + sizeof(s->r), tlen);
+	text[tlen] = '\0';
+
+	m = text;
+	c = strchr(m, '\t');
+	p = c ? strchr(c+1, '\t') : NULL;
+	if(c){
+		*c++ = '\0';
+	}
+	if(p){
+		*p++ = '\0';
+	}
+	snprintf(s->method, sizeof(s->method), "%s", m);
+	snprintf(s->call_id, sizeof(s->call_id), "%s", c ? c : "");
+	snprintf(s->phrase, sizeof(s->phrase), "%s", p ? p : "");
+}/*}}}*/
+
+/**
+ * Decode the record to the text line.
+ *
+ * \param[in] r 		record.
+ * \param[out] buf 		line buffer.
+ * \param[in] size 		buffer size.
+ */
+static void
+rp_rec_line (struct rp_rec_s const * const r, char * const buf, int const size)
+{/*{{{*/
+	struct rec_evt_s e;
+	struct rec_rtp_s p;
+	struct rp_sip_s s;
+	int n;
+
+	n = snprintf(buf, size, "%10.6f ", r->t_us / 1e6);
+	if(r->h.chan != REC_CHAN_NONE){
+		n += snprintf(buf+n, size-n, "ch%02d ", r->h.chan);
+	} else {
+		n += snprintf(buf+n, size-n, "---- ");
+	}
+	if(r->h.type == rec_type_EVT && r->h.len >= sizeof(e)){
+		memcpy(&e, r->data, sizeof(e));
+		snprintf(buf+n, size-n, "evt %d data 0x%X dev %d/%d%s",
+				e.id, e.data, e.dev, e.ch, e.more ? " more" : "");
+	} else if(r->h.type == rec_type_RTP && r->h.len >= sizeof(p)){
+		memcpy(&p, r->data, sizeof(p));
+		snprintf(buf+n, size-n, "rtp %s pt %d%s seq %u ts %u len %u",
+				p.dir == rec_rtp_dir_TX ? "tx" : "rx", p.pt & 0x7F,
+				p.pt & 0x80 ? "m" : "", p.seq, p.ts, p.len);
+	} else if(r->h.type == rec_type_SIP){
+		rp_sip_decode (r, &s);
+		snprintf(buf+n, size-n, "sip %s %d %s %s [%s]",
+				nua_event_name(s.r.event), s.r.status, s.method,
+				s.phrase, s.call_id);
+	} else {
+		snprintf(buf+n, size-n, "type %d len %d", r->h.type, r->h.len);
+	}
+}/*}}}*/
+
+/**
+ * Print the recording.
+ *
+ * \param[in] f 	loaded file.
+ */
+static void
+rp_list (struct rp_file_s const * const f)
+{/*{{{*/
+	struct rp_rec_s r;
+	char line [RP_STR*2];
+	size_t pos = 0;
+	time_t start = f->fh.start_us / 1000000;
+
+	printf("# %s: %d channels, started %s", f->path, f->fh.chans,
+			ctime(&start));
+	while(rp_next (f, &pos, &r)){
+		rp_rec_line (&r, line, sizeof(line));
+		printf("%s\n", line);
+	}
+}/*}}}*/
+
+/**
+ * Get the header value from the SIP message.
+ *
+ * \param[in] msg 		message.
+ * \param[in] name 		full header name.
+ * \param[in] compact 	compact header name or NULL.
+ * \param[out] val 		value buffer (RP_STR).
+ * \retval 1 	header found.
+ * \retval 0 	no header.
+ */
+static int
+rp_hdr (char const * const msg, char const * const name,
+		char const * const compact, char * const val)
+{/*{{{*/
+	char const * l = strstr(msg, "\r\n");
+	char const * v;
+	char const * e;
+	int nl = strlen(name);
+	int cl = compact ? strlen(compact) : 0;
+	int len;
+
+	while(l && strncmp(l, "\r\n\r\n", 4)){
+		l += 2;
+		v = NULL;
+		if( !strncasecmp(l, name, nl) && (l[nl] == ':' || l[nl] == ' ')){
+			v = l + nl;
+		} else if(cl && !strncasecmp(l, compact, cl) &&
+				(l[cl] == ':' || l[cl] == ' ')){
+			v = l + cl;
+		}
+		if(v){
+			while(*v == ' ' || *v == ':' || *v == '\t'){
+				v++;
+			}
+			e = strstr(v, "\r\n");
+			len = e ? e - v : (int)strlen(v);
+			if(len >= RP_STR){
+				len = RP_STR - 1;
+			}
+			memcpy(val, v, len);
+			val[len] = '\0';
+			return 1;
+		}
+		l = strstr(l, "\r\n");
+	}
+	val[0] = '\0';
+	return 0;
+}/*}}}*/
+
+/**
+ * Get the URI from header value ("<uri>" or "uri;params").
+ *
+ * \param[in] val 	header value.
+ * \param[out] uri 	URI buffer (RP_STR).
+ */
+static void
+rp_uri (char const * const val, char * const uri)
+{/*{{{*/
+	char const * b = strchr(val, '<');
+	char const * e;
+	int len;
+
+	if(b){
+		b++;
+		e = strchr(b, '>');
+	} else {
+		b = val;
+		e = strchr(b, ';');
+	}
+	len = e ? e - b : (int)strlen(b);
+	if(len >= RP_STR){
+		len = RP_STR - 1;
+	}
+	memcpy(uri, b, len);
+	uri[len] = '\0';
+}/*}}}*/
+
+/**
+ * Get the media address from the SDP body.
+ *
+ * \param[in] msg 	message.
+ * \param[out] sa 	address (port 0 if no SDP).
+ */
+static void
+rp_sdp_addr (char const * const msg, struct sockaddr_in * const sa)
+{/*{{{*/
+	char const * body = strstr(msg, "\r\n\r\n");
+	char const * c;
+	char const * m;
+	char host [64];
+
+	memset(sa, 0, sizeof(*sa));
+	sa->sin_family = AF_INET;
+	if( !body){
+		return;
+	}
+	c = strstr(body, "c=IN IP4 ");
+	m = strstr(body, "m=audio ");
+	if( !c || !m || sscanf(c + 9, "%63[0-9.]", host) != 1){
+		return;
+	}
+	inet_aton(host, &sa->sin_addr);
+	sa->sin_port = htons(strtol(m + 8, NULL, 10));
+}/*}}}*/
+
+/**
+ * Put the stand-in SDP to the buffer.
+ *
+ * \param[out] sdp 	buffer (RP_STR*2).
+ * \return 	SDP length.
+ */
+static int
+rp_sdp (char * const sdp)
+{/*{{{*/
+	return snprintf(sdp, RP_STR*2,
+			"v=0\r\n"
+			"o=replay %lu 1 IN IP4 %s\r\n"
+			"s=replay\r\n"
+			"c=IN IP4 %s\r\n"
+			"t=0 0\r\n"
+			"m=audio %d RTP/AVP 8 0 18 101\r\n"
+			"a=rtpmap:8 PCMA/8000\r\n"
+			"a=rtpmap:0 PCMU/8000\r\n"
+			"a=rtpmap:18 G729/8000\r\n"
+			"a=rtpmap:101 telephone-event/8000\r\n"
+			"a=sendrecv\r\n",
+			g_rp.seq, g_rp.addr, g_rp.addr, g_rp.rtp_port);
+}/*}}}*/
+
+/**
+ * Send the SIP message.
+ *
+ * \param[in] msg 	message.
+ * \param[in] len 	length.
+ * \param[in] dst 	destination.
+ */
+static void
+rp_sip_send (char const * const msg, int const len,
+		struct sockaddr_in const * const dst)
+{/*{{{*/
+	if(sendto(g_rp.sip_fd, msg, len, 0, (struct sockaddr const *)dst,
+			sizeof(*dst)) != len){
+		fprintf(stderr, "sip sendto: %s\n", strerror(errno));
+	}
+}/*}}}*/
+
+/**
+ * Find the call.
+ *
+ * \param[in] cid 	Call-ID.
+ * \param[in] rec 	cid is the recorded Call-ID (not the replay one).
+ * \return 	call or NULL.
+ */
+static struct rp_dlg_s *
+rp_dlg_find (char const * const cid, int const rec)
+{/*{{{*/
+	int i;
+	for (i=0; i<RP_DLGS; i++){
+		struct rp_dlg_s * d = &g_rp.dlgs[i];
+		if(d->used && !strcmp(rec ? d->rec_cid : d->cid, cid)){
+			return d;
+		}
+	}
+	return NULL;
+}/*}}}*/
+
+/**
+ * Allocate the call.
+ *
+ * \return 	cleared call or NULL if all are used.
+ */
+static struct rp_dlg_s *
+rp_dlg_new (void)
+{/*{{{*/
+	int i;
+	for (i=0; i<RP_DLGS; i++){
+		struct rp_dlg_s * d = &g_rp.dlgs[i];
+		if( !d->used){
+			memset(d, 0, sizeof(*d));
+			d->used = 1;
+			d->chan = -1;
+			return d;
+		}
+	}
+	return NULL;
+}/*}}}*/
+
+/**
+ * Send the response to svd request.
+ *
+ * \param[in,out] q 	request.
+ * \param[in] status 	status code.
+ * \param[in] phrase 	status phrase.
+ * \param[in] rec_cid 	Call-ID in the recording (for the INVITE answer).
+ */
+static void
+rp_respond (struct rp_req_s * const q, int const status,
+		char const * const phrase, char const * const rec_cid)
+{/*{{{*/
+	struct rp_dlg_s * d;
+	char msg [RP_MSG];
+	char sdp [RP_STR*2];
+	int invite = !strcmp(q->method, "INVITE");
+	int sdp_len = 0;
+	int len = 0;
+
+	if( !q->totag[0]){
+		snprintf(q->totag, sizeof(q->totag), "rp%lu", ++g_rp.seq);
+	}
+	rp_cat(msg, &len, "SIP/2.0 %d %s\r\n%s", status,
+			phrase && phrase[0] ? phrase : "Replay", q->vias);
+	rp_cat(msg, &len, "From: %s\r\n", q->from);
+	if(status > 100 && !strstr(q->to, "tag=")){
+		rp_cat(msg, &len, "To: %s;tag=%s\r\n", q->to, q->totag);
+	} else {
+		rp_cat(msg, &len, "To: %s\r\n", q->to);
+	}
+	rp_cat(msg, &len, "Call-ID: %s\r\nCSeq: %lu %s\r\n",
+			q->call_id, q->cseq, q->method);
+	if(invite && status > 100 && status < 300){
+		rp_cat(msg, &len, "Contact: <sip:replay@%s:%d>\r\n",
+				g_rp.addr, g_rp.port);
+	}
+	if( !strcmp(q->method, "REGISTER") && status < 300 && q->contact[0]){
+		rp_cat(msg, &len, "Contact: %s\r\nExpires: 3600\r\n", q->contact);
+	}
+	if(invite && status >= 200 && status < 300){
+		sdp_len = rp_sdp (sdp);
+		rp_cat(msg, &len, "Content-Type: application/sdp\r\n");
+	}
+	rp_cat(msg, &len, "Content-Length: %d\r\n\r\n%s", sdp_len,
+			sdp_len ? sdp : "");
+	rp_sip_send (msg, len, &q->src);
+
+	if(status < 200){
+		return;
+	}
+	q->state = rp_req_DONE;
+	memcpy(q->rpl, msg, len + 1);
+
+	if( !strcmp(q->method, "REGISTER") && status < 300){
+		rp_uri (q->to, g_rp.svd_aor);
+		rp_uri (q->contact, g_rp.svd_contact);
+		if( !g_rp.svd_known){
+			g_rp.svd_sip = q->src;
+			g_rp.svd_known = 1;
+		}
+	} else if(invite && status < 300 && !rp_dlg_find (q->call_id, 0)){
+		d = rp_dlg_new ();
+		if( !d){
+			return;
+		}
+		d->up = 1;
+		snprintf(d->rec_cid, sizeof(d->rec_cid), "%s", rec_cid ? rec_cid : "");
+		snprintf(d->cid, sizeof(d->cid), "%s", q->call_id);
+		snprintf(d->local, sizeof(d->local), "%s;tag=%s", q->to, q->totag);
+		snprintf(d->remote, sizeof(d->remote), "%s", q->from);
+		rp_uri (q->contact, d->target);
+		d->dst = q->src;
+		d->media = q->media;
+	} else if( !strcmp(q->method, "BYE")){
+		d = rp_dlg_find (q->call_id, 0);
+		if(d){
+			d->used = 0;
+		}
+	}
+}/*}}}*/
+
+/**
+ * Send the request to svd in the call.
+ *
+ * \param[in,out] d 	call.
+ * \param[in] method 	method.
+ * \param[in] ruri 		Request-URI.
+ * \param[in] cseq 		CSeq number.
+ * \param[in] branch 	Via branch or NULL for the new one.
+ */
+static void
+rp_request (struct rp_dlg_s * const d, char const * const method,
+		char const * const ruri, unsigned int const cseq,
+		char const * const branch)
+{/*{{{*/
+	char msg [RP_MSG];
+	char sdp [RP_STR*2];
+	char br [32];
+	int invite = !strcmp(method, "INVITE");
+	int sdp_len = 0;
+	int len = 0;
+
+	if(branch){
+		snprintf(br, sizeof(br), "%s", branch);
+	} else {
+		snprintf(br, sizeof(br), "z9hG4bKrp%lu", ++g_rp.seq);
+	}
+	rp_cat(msg, &len, "%s %s SIP/2.0\r\n"
+			"Via: SIP/2.0/UDP %s:%d;branch=%s;rport\r\n"
+			"Max-Forwards: 70\r\n"
+			"From: %s\r\nTo: %s\r\nCall-ID: %s\r\nCSeq: %u %s\r\n",
+			method, ruri, g_rp.addr, g_rp.port, br,
+			d->local, d->remote, d->cid, cseq, method);
+	if(invite){
+		snprintf(d->branch, sizeof(d->branch), "%s", br);
+		sdp_len = rp_sdp (sdp);
+		rp_cat(msg, &len, "Contact: <sip:replay@%s:%d>\r\n"
+				"Content-Type: application/sdp\r\n", g_rp.addr, g_rp.port);
+	}
+	rp_cat(msg, &len, "Content-Length: %d\r\n\r\n%s", sdp_len,
+			sdp_len ? sdp : "");
+	rp_sip_send (msg, len, &d->dst);
+	if(strcmp(method, "ACK")){
+		g_rp.reqs_out++;
+	}
+}/*}}}*/
+
+/**
+ * Process the response from svd.
+ *
+ * \param[in] msg 	message.
+ */
+static void
+rp_sip_rsp (char const * const msg)
+{/*{{{*/
+	struct rp_dlg_s * d;
+	char cid [RP_STR];
+	char cseq [RP_STR];
+	char to [RP_STR];
+	char contact [RP_STR];
+	char saved [RP_STR];
+	unsigned int num = 0;
+	int status = strtol(msg + 8, NULL, 10);
+
+	g_rp.rsps_in++;
+	rp_hdr (msg, "Call-ID", "i", cid);
+	rp_hdr (msg, "CSeq", NULL, cseq);
+	d = rp_dlg_find (cid, 0);
+	if( !d || !d->uac || !strstr(cseq, "INVITE") || status < 200){
+		return;
+	}
+	num = strtoul(cseq, NULL, 10);
+	rp_hdr (msg, "To", "t", to);
+	if(status < 300){
+		if( !d->up){
+			snprintf(d->remote, sizeof(d->remote), "%s", to);
+			if(rp_hdr (msg, "Contact", "m", contact)){
+				rp_uri (contact, d->target);
+			}
+			rp_sdp_addr (msg, &d->media);
+			d->up = 1;
+		}
+		rp_request (d, "ACK", d->target, num, NULL);
+	} else {
+		/* non-2xx ACK is in the INVITE transaction */
+		snprintf(saved, sizeof(saved), "%s", d->remote);
+		snprintf(d->remote, sizeof(d->remote), "%s", to);
+		rp_request (d, "ACK", d->ruri, num, d->branch);
+		snprintf(d->remote, sizeof(d->remote), "%s", saved);
+		d->used = 0;
+	}
+}/*}}}*/
+
+/**
+ * Process the request from svd.
+ *
+ * \param[in] msg 	message.
+ * \param[in] src 	sender address.
+ */
+static void
+rp_sip_req (char const * const msg, struct sockaddr_in const * const src)
+{/*{{{*/
+	struct rp_req_s * q = NULL;
+	struct rp_req_s * done = NULL;
+	char method [16];
+	char cid [RP_STR];
+	char cseq [RP_STR];
+	char const * l;
+	char const * e;
+	unsigned long num;
+	int vlen = 0;
+	int i;
+
+	if(sscanf(msg, "%15s", method) != 1 || !strcmp(method, "ACK")){
+		return;
+	}
+	rp_hdr (msg, "Call-ID", "i", cid);
+	rp_hdr (msg, "CSeq", NULL, cseq);
+	num = strtoul(cseq, NULL, 10);
+
+	for (i=0; i<RP_REQS; i++){
+		struct rp_req_s * r = &g_rp.reqs[i];
+		if(r->state != rp_req_FREE && r->cseq == num &&
+				!strcmp(r->method, method) && !strcmp(r->call_id, cid)){
+			/* retransmission */
+			if(r->state == rp_req_DONE){
+				rp_sip_send (r->rpl, strlen(r->rpl), &r->src);
+			}
+			return;
+		}
+		if( !q && r->state == rp_req_FREE){
+			q = r;
+		} else if(r->state == rp_req_DONE && (!done || r->t_us < done->t_us)){
+			done = r;
+		}
+	}
+	if( !q){
+		q = done;
+	}
+	if( !q){
+		fprintf(stderr, "too many pending requests, %s dropped\n", method);
+		return;
+	}
+	g_rp.reqs_in++;
+
+	memset(q, 0, sizeof(*q));
+	q->state = rp_req_PENDING;
+	q->t_us = rp_now();
+	q->src = *src;
+	q->cseq = num;
+	snprintf(q->method, sizeof(q->method), "%s", method);
+	snprintf(q->call_id, sizeof(q->call_id), "%s", cid);
+	rp_hdr (msg, "From", "f", q->from);
+	rp_hdr (msg, "To", "t", q->to);
+	rp_hdr (msg, "Contact", "m", q->contact);
+	/* all Via lines as they are */
+	l = strstr(msg, "\r\n");
+	while(l && strncmp(l, "\r\n\r\n", 4)){
+		l += 2;
+		e = strstr(l, "\r\n");
+		if(e && (!strncasecmp(l, "Via:", 4) || !strncasecmp(l, "v:", 2)) &&
+				vlen + (e - l) + 2 < (int)sizeof(q->vias)){
+			memcpy(q->vias + vlen, l, e - l + 2);
+			vlen += e - l + 2;
+		}
+		l = e;
+	}
+	q->vias[vlen] = '\0';
+
+	if( !strcmp(method, "INVITE")){
+		rp_sdp_addr (msg, &q->media);
+		rp_respond (q, 100, "Trying", NULL);
+	}
+	if( !strstr(g_rp.answered, method)){
+		/* the recording has no responses for it */
+		rp_respond (q, 200, "OK", NULL);
+		g_rp.auto_out++;
+	}
+}/*}}}*/
+
+/**
+ * Process one datagram on the stand-in sockets.
+ *
+ * \param[in] fd 	socket that is readable.
+ */
+static void
+rp_sock_in (int const fd)
+{/*{{{*/
+	char msg [RP_MSG];
+	struct sockaddr_in src;
+	socklen_t slen = sizeof(src);
+	int len;
+
+	len = recvfrom(fd, msg, sizeof(msg)-1, 0, (struct sockaddr *)&src, &slen);
+	if(len <= 0){
+		return;
+	}
+	if(fd == g_rp.rtp_fd){
+		g_rp.rtp_in++;
+		return;
+	}
+	msg[len] = '\0';
+	if( !strncmp(msg, "SIP/2.0 ", 8)){
+		rp_sip_rsp (msg);
+	} else {
+		rp_sip_req (msg, &src);
+	}
+}/*}}}*/
+
+/**
+ * Serve the stand-in sockets until the time.
+ *
+ * \param[in] due 	monotonic time (us).
+ */
+static void
+rp_serve (unsigned long long const due)
+{/*{{{*/
+	struct pollfd fds [2];
+	unsigned long long now;
+	int i;
+
+	fds[0].fd = g_rp.sip_fd;
+	fds[1].fd = g_rp.rtp_fd;
+	fds[0].events = fds[1].events = POLLIN;
+	do {
+		now = rp_now();
+		if(poll(fds, 2, now < due ? (due - now + 999) / 1000 : 0) <= 0){
+			continue;
+		}
+		for (i=0; i<2; i++){
+			if(fds[i].revents & POLLIN){
+				rp_sock_in (fds[i].fd);
+			}
+		}
+	} while(now < due);
+}/*}}}*/
+
+/**
+ * Find the oldest pending request of the method.
+ *
+ * \param[in] method 	method.
+ * \return 	request or NULL.
+ */
+static struct rp_req_s *
+rp_req_pending (char const * const method)
+{/*{{{*/
+	struct rp_req_s * q = NULL;
+	int i;
+	for (i=0; i<RP_REQS; i++){
+		struct rp_req_s * r = &g_rp.reqs[i];
+		if(r->state == rp_req_PENDING && !strcmp(r->method, method) &&
+				(!q || r->t_us < q->t_us)){
+			q = r;
+		}
+	}
+	return q;
+}/*}}}*/
+
+/**
+ * Send the command to the simulated board.
+ *
+ * \param[in] fmt 	command format.
+ * \retval 0 	board replied "ok".
+ * \retval -1 	error or no reply.
+ */
+static int
+rp_ctl (char const * fmt, ...)
+{/*{{{*/
+	char cmd [RP_STR];
+	char rpl [RP_STR];
+	struct pollfd pfd;
+	va_list ap;
+	int len;
+
+	va_start(ap, fmt);
+	len = vsnprintf(cmd, sizeof(cmd), fmt, ap);
+	va_end(ap);
+	if(sendto(g_rp.ctl_fd, cmd, len, 0, (struct sockaddr *)&g_rp.ctl_addr,
+			sizeof(g_rp.ctl_addr)) != len){
+		fprintf(stderr, "%s: %s\n", cmd, strerror(errno));
+		return -1;
+	}
+	pfd.fd = g_rp.ctl_fd;
+	pfd.events = POLLIN;
+	if(poll(&pfd, 1, RP_CTL_TIMEOUT) <= 0){
+		fprintf(stderr, "%s: no reply\n", cmd);
+		return -1;
+	}
+	len = recv(g_rp.ctl_fd, rpl, sizeof(rpl)-1, 0);
+	if(len < 0){
+		return -1;
+	}
+	rpl[len] = '\0';
+	if(strncmp(rpl, "ok", 2)){
+		fprintf(stderr, "%s: %s\n", cmd, rpl);
+		return -1;
+	}
+	return 0;
+}/*}}}*/
+
+/**
+ * Replay the board event.
+ *
+ * \param[in] r 	record.
+ */
+static void
+rp_play_evt (struct rp_rec_s const * const r)
+{/*{{{*/
+	struct rec_evt_s e;
+
+	memcpy(&e, r->data, sizeof(e));
+	if(rp_ctl ("event %d %d %d", r->h.chan, e.id, e.data)){
+		g_rp.evt_errs++;
+		return;
+	}
+	g_rp.evts++;
+	if(e.id == ab_dev_event_FXS_ONHOOK && g_rp.talk[r->h.chan]){
+		if( !rp_ctl ("talk %d 0", r->h.chan)){
+			g_rp.talk[r->h.chan] = 0;
+		}
+	}
+}/*}}}*/
+
+/**
+ * Replay the RTP packet.
+ *
+ * \param[in] r 	record.
+ * \remark
+ * 		Sent packets make the phone talk, received ones are sent to the
+ * 		call of the channel (the first call with media that has no
+ * 		channel is bound to it).
+ */
+static void
+rp_play_rtp (struct rp_rec_s const * const r)
+{/*{{{*/
+	struct rec_rtp_s p;
+	struct rp_dlg_s * d = NULL;
+	unsigned char pkt [RP_MSG];
+	uint32_t ssrc;
+	int len;
+	int i;
+
+	memcpy(&p, r->data, sizeof(p));
+	if(p.dir == rec_rtp_dir_TX){
+		if( !g_rp.talk[r->h.chan] && !rp_ctl ("talk %d 1", r->h.chan)){
+			g_rp.talk[r->h.chan] = 1;
+		}
+		return;
+	}
+	for (i=0; i<RP_DLGS; i++){
+		if(g_rp.dlgs[i].used && g_rp.dlgs[i].chan == r->h.chan){
+			d = &g_rp.dlgs[i];
+			break;
+		}
+	}
+	for (i=0; !d && i<RP_DLGS; i++){
+		if(g_rp.dlgs[i].used && g_rp.dlgs[i].up && g_rp.dlgs[i].chan == -1 &&
+				g_rp.dlgs[i].media.sin_port){
+			d = &g_rp.dlgs[i];
+			d->chan = r->h.chan;
+		}
+	}
+	if( !d || !d->media.sin_port){
+		return;
+	}
+	len = p.len < 12 ? 12 : p.len > sizeof(pkt) ? sizeof(pkt) : p.len;
+	memset(pkt, 0, len);
+	ssrc = 0x52500000 + r->h.chan;
+	pkt[0] = 0x80;
+	pkt[1] = p.pt;
+	pkt[2] = p.seq >> 8;
+	pkt[3] = p.seq;
+	pkt[4] = p.ts >> 24;
+	pkt[5] = p.ts >> 16;
+	pkt[6] = p.ts >> 8;
+	pkt[7] = p.ts;
+	pkt[8] = ssrc >> 24;
+	pkt[9] = ssrc >> 16;
+	pkt[10] = ssrc >> 8;
+	pkt[11] = ssrc;
+	if(sendto(g_rp.rtp_fd, pkt, len, 0, (struct sockaddr *)&d->media,
+			sizeof(d->media)) == len){
+		g_rp.rtp_out++;
+	}
+}/*}}}*/
+
+/**
+ * Replay the NUA event.
+ *
+ * \param[in] r 	record.
+ * \remark
+ * 		Responses without CSeq method are made by nua itself (timeouts
+ * 		etc.), authentication challenges are handled by nua, they are
+ * 		not replayed.
+ */
+static void
+rp_play_sip (struct rp_rec_s const * const r)
+{/*{{{*/
+	struct rp_sip_s s;
+	struct rp_req_s * q;
+	struct rp_dlg_s * d;
+	char const * name;
+	unsigned long long wait_start;
+
+	rp_sip_decode (r, &s);
+	name = nua_event_name(s.r.event);
+
+	if( !strncmp(name, "nua_r_", 6)){
+		if( !s.method[0] || s.r.status < 180 ||
+				s.r.status == 401 || s.r.status == 407){
+			return;
+		}
+		q = rp_req_pending (s.method);
+		if( !q){
+			wait_start = rp_now();
+			while( !q && rp_now() - wait_start < g_rp.wait_ms * 1000ULL){
+				rp_serve (rp_now() + 10000);
+				q = rp_req_pending (s.method);
+			}
+			/* keep the recorded distances after the wait */
+			g_rp.base_us += rp_now() - wait_start;
+			g_rp.waited += rp_now() - wait_start;
+		}
+		if( !q){
+			g_rp.missed++;
+			if(g_rp.missed <= RP_DIFF_SHOW){
+				printf("diverged at %.6f: no %s request for %s %d\n",
+						r->t_us / 1e6, s.method, name, s.r.status);
+			}
+			return;
+		}
+		rp_respond (q, s.r.status, s.phrase, s.call_id);
+		g_rp.rsps_out++;
+	} else if( !strcmp(name, "nua_i_invite")){
+		if(rp_dlg_find (s.call_id, 1)){
+			/* re-INVITE */
+			g_rp.skipped++;
+			return;
+		}
+		if( !g_rp.svd_known || !g_rp.svd_contact[0] || !(d = rp_dlg_new ())){
+			g_rp.skipped++;
+			printf("skipped at %.6f: incoming INVITE (svd is not registered)\n",
+					r->t_us / 1e6);
+			return;
+		}
+		d->uac = 1;
+		d->cseq = 1;
+		d->dst = g_rp.svd_sip;
+		snprintf(d->rec_cid, sizeof(d->rec_cid), "%s", s.call_id);
+		snprintf(d->cid, sizeof(d->cid), "rp%lu-%d@%s", ++g_rp.seq,
+				getpid(), g_rp.addr);
+		snprintf(d->local, sizeof(d->local), "<sip:replay@%s:%d>;tag=rp%lu",
+				g_rp.addr, g_rp.port, ++g_rp.seq);
+		snprintf(d->remote, sizeof(d->remote), "<%s>", g_rp.svd_aor);
+		snprintf(d->ruri, sizeof(d->ruri), "%s", g_rp.svd_contact);
+		snprintf(d->target, sizeof(d->target), "%s", g_rp.svd_contact);
+		rp_request (d, "INVITE", d->ruri, d->cseq, NULL);
+	} else if( !strcmp(name, "nua_i_cancel")){
+		d = rp_dlg_find (s.call_id, 1);
+		if(d && d->uac && !d->up){
+			rp_request (d, "CANCEL", d->ruri, d->cseq, d->branch);
+		}
+	} else if( !strcmp(name, "nua_i_bye")){
+		d = rp_dlg_find (s.call_id, 1);
+		if(d && d->up){
+			rp_request (d, "BYE", d->target, ++d->cseq, NULL);
+			d->used = 0;
+		} else {
+			g_rp.skipped++;
+		}
+	}
+}/*}}}*/
+
+/**
+ * Open the stand-in and board control sockets.
+ *
+ * \retval 0 	if etherything ok.
+ * \retval -1 	if somthing nasty happens.
+ */
+static int
+rp_open (void)
+{/*{{{*/
+	struct sockaddr_in sa;
+	socklen_t slen = sizeof(sa);
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	if( !inet_aton(g_rp.addr, &sa.sin_addr)){
+		fprintf(stderr, "bad address %s\n", g_rp.addr);
+		goto __exit_fail;
+	}
+	g_rp.sip_fd = socket(AF_INET, SOCK_DGRAM, 0);
+	g_rp.rtp_fd = socket(AF_INET, SOCK_DGRAM, 0);
+	g_rp.ctl_fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+	if(g_rp.sip_fd == -1 || g_rp.rtp_fd == -1 || g_rp.ctl_fd == -1){
+		perror("socket");
+		goto __exit_fail;
+	}
+	sa.sin_port = htons(g_rp.port);
+	if(bind(g_rp.sip_fd, (struct sockaddr *)&sa, sizeof(sa))){
+		perror("bind sip");
+		goto __exit_fail;
+	}
+	sa.sin_port = 0;
+	if(bind(g_rp.rtp_fd, (struct sockaddr *)&sa, sizeof(sa)) ||
+			getsockname(g_rp.rtp_fd, (struct sockaddr *)&sa, &slen)){
+		perror("bind rtp");
+		goto __exit_fail;
+	}
+	g_rp.rtp_port = ntohs(sa.sin_port);
+
+	/* bind to own path to get board replies */
+	g_rp.own_addr.sun_family = AF_UNIX;
+	snprintf(g_rp.own_addr.sun_path, sizeof(g_rp.own_addr.sun_path),
+			"%s.%d", g_rp.ctl, getpid());
+	unlink(g_rp.own_addr.sun_path);
+	if(bind(g_rp.ctl_fd, (struct sockaddr *)&g_rp.own_addr,
+			sizeof(g_rp.own_addr))){
+		perror("bind control");
+		goto __exit_fail;
+	}
+	g_rp.ctl_addr.sun_family = AF_UNIX;
+	strncpy(g_rp.ctl_addr.sun_path, g_rp.ctl, sizeof(g_rp.ctl_addr.sun_path)-1);
+	return 0;
+__exit_fail:
+	return -1;
+}/*}}}*/
+
+/**
+ * Replay the recording and print the report.
+ *
+ * \param[in] f 	loaded file.
+ * \retval 0 	replay did not diverge.
+ * \retval 1 	some records were not replayed.
+ * \retval -1 	if somthing nasty happens.
+ */
+static int
+rp_play (struct rp_file_s const * const f)
+{/*{{{*/
+	struct rp_rec_s r;
+	struct rp_sip_s s;
+	unsigned long long due;
+	unsigned long long now;
+	unsigned long long last_t = 0;
+	unsigned long pending = 0;
+	size_t pos = 0;
+	int i;
+
+	/* methods that have the recorded responses */
+	while(rp_next (f, &pos, &r)){
+		if(r.h.type != rec_type_SIP){
+			continue;
+		}
+		rp_sip_decode (&r, &s);
+		if(s.method[0] && !strncmp(nua_event_name(s.r.event), "nua_r_", 6) &&
+				!strstr(g_rp.answered, s.method) &&
+				strlen(g_rp.answered) + strlen(s.method) + 2 < RP_STR){
+			strcat(g_rp.answered, s.method);
+			strcat(g_rp.answered, " ");
+		}
+	}
+
+	if(rp_open ()){
+		return -1;
+	}
+	printf("# replay %s at %s:%d (rtp %d), speed %g\n", f->path,
+			g_rp.addr, g_rp.port, g_rp.rtp_port, g_rp.speed);
+
+	pos = 0;
+	g_rp.base_us = rp_now();
+	while(rp_next (f, &pos, &r)){
+		due = g_rp.speed > 0 ? g_rp.base_us + r.t_us / g_rp.speed : rp_now();
+		rp_serve (due);
+		now = rp_now();
+		if(now > due){
+			g_rp.late_sum += now - due;
+			if(now - due > g_rp.late_max){
+				g_rp.late_max = now - due;
+			}
+		}
+		g_rp.late_n++;
+		last_t = r.t_us;
+
+		if(r.h.type == rec_type_EVT && r.h.len >= sizeof(struct rec_evt_s)){
+			rp_play_evt (&r);
+		} else if(r.h.type == rec_type_RTP &&
+				r.h.len >= sizeof(struct rec_rtp_s)){
+			rp_play_rtp (&r);
+		} else if(r.h.type == rec_type_SIP){
+			rp_play_sip (&r);
+		}
+	}
+	/* let svd finish the last transactions */
+	rp_serve (rp_now() + g_rp.wait_ms * 1000ULL);
+
+	for (i=0; i<RP_REQS; i++){
+		if(g_rp.reqs[i].state == rp_req_PENDING){
+			pending++;
+			if(pending <= RP_DIFF_SHOW){
+				printf("diverged: %s %s is not answered in the recording\n",
+						g_rp.reqs[i].method, g_rp.reqs[i].call_id);
+			}
+		}
+	}
+	for (i=0; i<RP_CHANS; i++){
+		if(g_rp.talk[i]){
+			rp_ctl ("talk %d 0", i);
+		}
+	}
+	close(g_rp.ctl_fd);
+	unlink(g_rp.own_addr.sun_path);
+
+	printf("recorded: %.3f s, replayed: %.3f s, waited for svd: %.3f s\n",
+			last_t / 1e6, (rp_now() - g_rp.base_us + g_rp.waited) / 1e6,
+			g_rp.waited / 1e6);
+	printf("lateness: avg %lu us, max %lu us\n",
+			g_rp.late_n ? (unsigned long)(g_rp.late_sum / g_rp.late_n) : 0,
+			g_rp.late_max);
+	printf("board events: %lu injected, %lu failed\n", g_rp.evts,
+			g_rp.evt_errs);
+	printf("sip: %lu requests from svd, %lu recorded responses, "
+			"%lu auto responses, %lu requests to svd, %lu responses from svd\n",
+			g_rp.reqs_in, g_rp.rsps_out, g_rp.auto_out, g_rp.reqs_out,
+			g_rp.rsps_in);
+	printf("rtp: %lu sent, %lu received\n", g_rp.rtp_out, g_rp.rtp_in);
+	printf("divergence: %lu responses without request, %lu requests "
+			"not answered, %lu records skipped\n",
+			g_rp.missed, pending, g_rp.skipped);
+	return (g_rp.missed || pending || g_rp.evt_errs) ? 1 : 0;
+}/*}}}*/
+
+/** Control record (board event or NUA event) for comparison.*/
+struct rp_ctl_rec_s {/*{{{*/
+	unsigned long long t_us; /**< Time from the start.*/
+	unsigned long long react_us; /**< Time from the last board event.*/
+	int type; /**< rec_type_EVT or rec_type_SIP.*/
+	int chan; /**< Channel.*/
+	long a; /**< Event id / nua event.*/
+	long b; /**< Event data / status.*/
+	char method [16]; /**< SIP method.*/
+};/*}}}*/
+
+/** Recording prepared for comparison.*/
+struct rp_cmp_s {/*{{{*/
+	struct rp_ctl_rec_s * recs; /**< Control records.*/
+	int n; /**< Control records count.*/
+	unsigned long long dur_us; /**< Duration.*/
+	unsigned long rtp [RP_CHANS][2]; /**< RTP packets by channel and dir.*/
+};/*}}}*/
+
+/**
+ * Prepare the recording for comparison.
+ *
+ * \param[in] f 	loaded file.
+ * \param[out] c 	control records and counters.
+ * \retval 0 	if etherything ok.
+ * \retval -1 	if somthing nasty happens.
+ */
+static int
+rp_cmp_load (struct rp_file_s const * const f, struct rp_cmp_s * const c)
+{/*{{{*/
+	struct rp_rec_s r;
+	struct rp_sip_s s;
+	struct rec_evt_s e;
+	struct rec_rtp_s p;
+	unsigned long long last_evt = 0;
+	size_t pos = 0;
+	int max = 0;
+
+	memset(c, 0, sizeof(*c));
+	while(rp_next (f, &pos, &r)){
+		c->dur_us = r.t_us;
+		if(r.h.type == rec_type_RTP && r.h.len >= sizeof(p)){
+			memcpy(&p, r.data, sizeof(p));
+			if(p.dir <= rec_rtp_dir_RX){
+				c->rtp[r.h.chan][p.dir]++;
+			}
+			continue;
+		} else if(r.h.type != rec_type_EVT && r.h.type != rec_type_SIP){
+			continue;
+		}
+		if(c->n == max){
+			max = max ? max * 2 : 256;
+			c->recs = realloc(c->recs, max * sizeof(*c->recs));
+			if( !c->recs){
+				fprintf(stderr, "not enough memory\n");
+				return -1;
+			}
+		}
+		memset(&c->recs[c->n], 0, sizeof(c->recs[c->n]));
+		c->recs[c->n].t_us = r.t_us;
+		c->recs[c->n].type = r.h.type;
+		c->recs[c->n].chan = r.h.chan;
+		if(r.h.type == rec_type_EVT && r.h.len >= sizeof(e)){
+			memcpy(&e, r.data, sizeof(e));
+			c->recs[c->n].a = e.id;
+			c->recs[c->n].b = e.data;
+			last_evt = r.t_us;
+		} else {
+			rp_sip_decode (&r, &s);
+			c->recs[c->n].a = s.r.event;
+			c->recs[c->n].b = s.r.status;
+			c->recs[c->n].react_us = r.t_us - last_evt;
+			snprintf(c->recs[c->n].method, sizeof(c->recs[c->n].method),
+					"%s", s.method);
+		}
+		c->n++;
+	}
+	return 0;
+}/*}}}*/
+
+/** Check if two control records are the same event.*/
+static int
+rp_cmp_same (struct rp_ctl_rec_s const * const x,
+		struct rp_ctl_rec_s const * const y)
+{/*{{{*/
+	return x->type == y->type && x->a == y->a && x->b == y->b &&
+			(x->type == rec_type_SIP ? !strcmp(x->method, y->method) :
+			x->chan == y->chan);
+}/*}}}*/
+
+/**
+ * Put the control record to the text line.
+ *
+ * \param[in] x 	record or NULL.
+ * \param[out] buf 	line buffer (RP_STR).
+ */
+static void
+rp_cmp_line (struct rp_ctl_rec_s const * const x, char * const buf)
+{/*{{{*/
+	if( !x){
+		snprintf(buf, RP_STR, "(end)");
+	} else if(x->type == rec_type_EVT){
+		snprintf(buf, RP_STR, "%.6f ch%02d evt %ld data 0x%lX",
+				x->t_us / 1e6, x->chan, x->a, x->b);
+	} else {
+		snprintf(buf, RP_STR, "%.6f sip %s %ld %s", x->t_us / 1e6,
+				nua_event_name(x->a), x->b, x->method);
+	}
+}/*}}}*/
+
+/**
+ * Compare two recordings and print the report.
+ *
+ * \param[in] fa 	original recording.
+ * \param[in] fb 	replayed recording.
+ * \retval 0 	recordings have the same control flow.
+ * \retval 1 	recordings diverged.
+ * \retval -1 	if somthing nasty happens.
+ */
+static int
+rp_diff (struct rp_file_s const * const fa, struct rp_file_s const * const fb)
+{/*{{{*/
+	struct rp_cmp_s a;
+	struct rp_cmp_s b;
+	struct {
+		unsigned long n;
+		unsigned long long a_sum;
+		unsigned long long b_sum;
+		unsigned long a_max;
+		unsigned long b_max;
+	} react [RP_NUA_EVENTS];
+	char la [RP_STR];
+	char lb [RP_STR];
+	unsigned long diffs = 0;
+	unsigned long matched = 0;
+	int i = 0;
+	int j = 0;
+	int k;
+	int ret = -1;
+
+	memset(react, 0, sizeof(react));
+	if(rp_cmp_load (fa, &a) || rp_cmp_load (fb, &b)){
+		goto __exit;
+	}
+	while(i < a.n || j < b.n){
+		if(i < a.n && j < b.n && rp_cmp_same (&a.recs[i], &b.recs[j])){
+			if(a.recs[i].type == rec_type_SIP && a.recs[i].a >= 0 &&
+					a.recs[i].a < RP_NUA_EVENTS){
+				unsigned long ra = a.recs[i].react_us;
+				unsigned long rb = b.recs[j].react_us;
+				k = a.recs[i].a;
+				react[k].n++;
+				react[k].a_sum += ra;
+				react[k].b_sum += rb;
+				if(ra > react[k].a_max){
+					react[k].a_max = ra;
+				}
+				if(rb > react[k].b_max){
+					react[k].b_max = rb;
+				}
+			}
+			matched++;
+			i++;
+			j++;
+			continue;
+		}
+		diffs++;
+		if(diffs <= RP_DIFF_SHOW){
+			rp_cmp_line (i < a.n ? &a.recs[i] : NULL, la);
+			rp_cmp_line (j < b.n ? &b.recs[j] : NULL, lb);
+			printf("diverged at #%d/#%d:\n  - %s\n  + %s\n", i, j, la, lb);
+		}
+		/* resync: skip in the stream where the other one's record is near */
+		for (k=1; k<=RP_RESYNC; k++){
+			if(j < b.n && i+k < a.n && rp_cmp_same (&a.recs[i+k], &b.recs[j])){
+				i += k;
+				break;
+			}
+			if(i < a.n && j+k < b.n && rp_cmp_same (&a.recs[i], &b.recs[j+k])){
+				j += k;
+				break;
+			}
+		}
+		if(k > RP_RESYNC){
+			if(i < a.n){
+				i++;
+			}
+			if(j < b.n){
+				j++;
+			}
+		}
+	}
+
+	printf("control records: %d / %d, matched %lu, differences %lu\n",
+			a.n, b.n, matched, diffs);
+	printf("duration: %.3f s / %.3f s\n", a.dur_us / 1e6, b.dur_us / 1e6);
+	for (k=0; k<RP_CHANS; k++){
+		if(a.rtp[k][0] || a.rtp[k][1] || b.rtp[k][0] || b.rtp[k][1]){
+			printf("rtp ch%02d: tx %lu / %lu, rx %lu / %lu\n", k,
+					a.rtp[k][rec_rtp_dir_TX], b.rtp[k][rec_rtp_dir_TX],
+					a.rtp[k][rec_rtp_dir_RX], b.rtp[k][rec_rtp_dir_RX]);
+		}
+	}
+	printf("reaction (last board event -> sip event), avg / max us:\n");
+	for (k=0; k<RP_NUA_EVENTS; k++){
+		if( !react[k].n){
+			continue;
+		}
+		printf("  %-20s n %4lu  orig %8lu / %8lu  new %8lu / %8lu  %+.1f%%\n",
+				nua_event_name(k), react[k].n,
+				(unsigned long)(react[k].a_sum / react[k].n), react[k].a_max,
+				(unsigned long)(react[k].b_sum / react[k].n), react[k].b_max,
+				react[k].a_sum ? 100.0 * ((double)react[k].b_sum -
+				(double)react[k].a_sum) / react[k].a_sum : 0.0);
+	}
+	ret = diffs ? 1 : 0;
+__exit:
+	free(a.recs);
+	free(b.recs);
+	return ret;
+}/*}}}*/
+
+/**
+ * Show help message.
+ */
+static void
+show_help( void )
+{/*{{{*/
+	fprintf( stdout,
+"\
+Usage: %s [OPTION] FILE [NEW_FILE]\n\
+Replay the svd recording (svd -r FILE) to svd on the simulated board.\n\
+\n\
+  -h, --help         display this help and exit\n\
+  -l, --list         print the records of FILE and exit\n\
+  -d, --diff         compare FILE with NEW_FILE (replay recording) and exit\n\
+  -x, --speed X      replay speed factor (default 1, 0 - without delays)\n\
+  -a, --addr IP      SIP stand-in address (default 127.0.0.1)\n\
+  -p, --port PORT    SIP stand-in port (default %d)\n\
+  -c, --ctl PATH     simulated board control socket\n\
+  -w, --wait MS      wait for svd request before response (default %d)\n\
+\n\
+	Execution example :\n\
+	%s -x 2 field.rec & svd -s -f -r replay.rec\n\
+	%s -d field.rec replay.rec\n\
+	Means, that you replay the field recording twice faster to svd that\n\
+			uses the stand-in as registrar and compare the results.\n\
+"
+		, "svd_replay", RP_SIP_PORT_DF, RP_WAIT_MS_DF,
+		"svd_replay", "svd_replay");
+}/*}}}*/
+
+/**
+ * Main.
+ * \param[in] argc 	arguments count
+ * \param[in] argv 	arguments values
+ * \retval 0 	etherything is fine (no divergence)
+ * \retval 1 	replay or comparison diverged
+ * \retval -1 	error occures
+ */
+int
+main (int argc, char ** argv)
+{/*{{{*/
+	struct rp_file_s fa;
+	struct rp_file_s fb;
+	int option_IDX;
+	int option_rez;
+	int list = 0;
+	int diff = 0;
+	int err = -1;
+	char * short_options = "hldx:a:p:c:w:";
+	struct option long_options[ ] = {
+		{ "help", no_argument, NULL, 'h' },
+		{ "list", no_argument, NULL, 'l' },
+		{ "diff", no_argument, NULL, 'd' },
+		{ "speed", required_argument, NULL, 'x' },
+		{ "addr", required_argument, NULL, 'a' },
+		{ "port", required_argument, NULL, 'p' },
+		{ "ctl", required_argument, NULL, 'c' },
+		{ "wait", required_argument, NULL, 'w' },
+		{ NULL, 0, NULL, 0 }
+		};
+
+	memset(&fa, 0, sizeof(fa));
+	memset(&fb, 0, sizeof(fb));
+	memset(&g_rp, 0, sizeof(g_rp));
+	g_rp.speed = 1;
+	g_rp.port = RP_SIP_PORT_DF;
+	g_rp.wait_ms = RP_WAIT_MS_DF;
+	g_rp.ctl = getenv(AB_SIM_CTL_ENV);
+	if( !g_rp.ctl){
+		g_rp.ctl = AB_SIM_CTL_DF;
+	}
+	snprintf(g_rp.addr, sizeof(g_rp.addr), "127.0.0.1");
+
+	while ((option_rez = getopt_long ( argc, argv, short_options,
+			long_options, &option_IDX)) != -1) {
+		if       (option_rez == 'l'){
+			list = 1;
+		} else if(option_rez == 'd'){
+			diff = 1;
+		} else if(option_rez == 'x'){
+			g_rp.speed = strtod(optarg, NULL);
+		} else if(option_rez == 'a'){
+			snprintf(g_rp.addr, sizeof(g_rp.addr), "%s", optarg);
+		} else if(option_rez == 'p'){
+			g_rp.port = strtol(optarg, NULL, 10);
+		} else if(option_rez == 'c'){
+			g_rp.ctl = optarg;
+		} else if(option_rez == 'w'){
+			g_rp.wait_ms = strtol(optarg, NULL, 10);
+		} else {
+			show_help();
+			goto __exit;
+		}
+	}
+	if(optind >= argc || (diff && optind + 1 >= argc)){
+		show_help();
+		goto __exit;
+	}
+
+	fa.path = argv[optind];
+	if(rp_load (&fa)){
+		goto __exit;
+	}
+	if(list){
+		rp_list (&fa);
+		err = 0;
+	} else if(diff){
+		fb.path = argv[optind+1];
+		if(rp_load (&fb)){
+			goto __exit;
+		}
+		err = rp_diff (&fa, &fb);
+	} else {
+		err = rp_play (&fa);
+	}
+
+__exit:
+	free(fa.buf);
+	free(fb.buf);
+	return err;
+}/*}}}*/
@@ -9,6 +9,13 @@
 #include "svd_if.h"
 #include "svd_cfg.h"
 #include "svd_ua.h"
+#include "svd_flight.h"
+#include "svd_loop.h"
+#include "svd_atab.h"
+#include "svd_handoff.h"
+#include "svd_boot.h"
+#include "svd_logring.h"
+#include "svd_uring.h"
 
 #include <stddef.h>
 #include <stdlib.h>
@@ -25,6 +32,9 @@ int svd_create_interface(svd_t * svd);
 /** Interface handler.*/
 static int svd_if_handler(su_root_magic_t * root, su_wait_t * w,
 		su_wakeup_arg_t * user_data);
+/** Timed interface handler for the root.*/
+static int svd_if_handler_timed(su_root_magic_t * root, su_wait_t * w,
+		su_wakeup_arg_t * user_data);
 /** Execute given interface message.*/
 static int svd_exec_msg(svd_t * const svd, char const * const buf,
 		char ** const buff, int * const buff_sz);
@@ -40,6 +50,32 @@ static int svd_exec_shutdown(svd_t * svd, char ** const buff, int * const buff_s
 static int svd_exec_regs(svd_t * svd, char ** const buff, int * const buff_sz);
 /** Execute 'get_channels' command.*/
 static int svd_exec_channels(svd_t * svd, char ** const buff, int * const buff_sz);
+/** Execute 'get_flight' command.*/
+static int svd_exec_flight(svd_t * svd, char ** const buff, int * const buff_sz);
+/** Execute 'get_lat' command.*/
+static int svd_exec_lat(svd_t * svd, char ** const buff, int * const buff_sz);
+/** Put latency statistics of one account to buffer */
+static int svd_lat_tobuf(char const * const name, struct lat_stat_s const * const st,
+		char ** const buff, int * const buff_sz);
+/** Execute 'get_loop' command.*/
+static int svd_exec_loop(svd_t * svd, char ** const buff, int * const buff_sz);
+/** Put one loop histogram to buffer */
+static int svd_loop_hist_tobuf(char const * const name,
+		struct loop_hist_s const * const h, char ** const buff, int * const buff_sz);
+/** Execute 'get_ioctl' command.*/
+static int svd_exec_ioctl(svd_t * svd, char ** const buff, int * const buff_sz);
+/** Execute 'get_events' command.*/
+static int svd_exec_events(svd_t * svd, char ** const buff, int * const buff_sz);
+/** Execute 'reload' command.*/
+static int svd_exec_reload(svd_t * svd, char ** const buff, int * const buff_sz);
+/** Execute 'handoff' command.*/
+static int svd_exec_handoff(svd_t * svd, char ** const buff, int * const buff_sz);
+/** Execute 'get_startup' command.*/
+static int svd_exec_startup(svd_t * svd, char ** const buff, int * const buff_sz);
+/** Execute 'get_call_mem' command.*/
+static int svd_exec_call_mem(svd_t * svd, char ** const buff, int * const buff_sz);
+/** Execute 'get_log' command.*/
+static int svd_exec_log(svd_t * svd, char ** const buff, int * const buff_sz);
 /** Add to string another and resize it if necessary */
 static int svd_addtobuf(char ** const buf, int * const palc, char const * fmt, ...);
 /** Put chan rtcp statistics to buffer */
@@ -78,7 +114,7 @@ svd_create_interface(svd_t * svd)
 		SU_DEBUG_0 ((LOG_FNC_A ("su_wait_create() fails" ) ));
 		goto __exit_fail;
 	}
-	err = su_root_register (svd->root, wait, svd_if_handler, svd, 0);
+	err = su_root_register (svd->root, wait, svd_if_handler_timed, svd, 0);
 	if (err == -1){
 		SU_DEBUG_0 ((LOG_FNC_A ("su_root_register() fails" ) ));
 		goto __exit_fail;
@@ -176,6 +212,26 @@ __exit_fail:
 	return -1;
 }/*}}}*/
 
+/**
+ * Timed wrapper of \ref svd_if_handler.
+ *
+ * \param[in] 		root 		root object that contain wait object.
+ * \param[in] 		w			wait object that emits.
+ * \return 	handler return value.
+ */
+static int
+svd_if_handler_timed(su_root_magic_t * root, su_wait_t * w,
+		su_wakeup_arg_t * user_data)
+{/*{{{*/
+	unsigned long long loop_start;
+	int ret;
+
+	loop_start = svd_loop_enter (loop_cb_IF, 0);
+	ret = svd_if_handler (root, w, user_data);
+	svd_loop_leave (loop_cb_IF, loop_start);
+	return ret;
+}/*}}}*/
+
 /**
  * Do the all necessory job on given message.
  *
@@ -213,6 +269,26 @@ svd_exec_msg(svd_t * const svd, char const * const buf,
 		err = svd_exec_regs(svd, buff, buff_sz);
 	} else if(msg.type == msg_type_CHANNELS){
 		err = svd_exec_channels(svd, buff, buff_sz);
+	} else if(msg.type == msg_type_FLIGHT){
+		err = svd_exec_flight(svd, buff, buff_sz);
+	} else if(msg.type == msg_type_LATENCY){
+		err = svd_exec_lat(svd, buff, buff_sz);
+	} else if(msg.type == msg_type_LOOP){
+		err = svd_exec_loop(svd, buff, buff_sz);
+	} else if(msg.type == msg_type_IOCTL){
+		err = svd_exec_ioctl(svd, buff, buff_sz);
+	} else if(msg.type == msg_type_EVENTS){
+		err = svd_exec_events(svd, buff, buff_sz);
+	} else if(msg.type == msg_type_RELOAD){
+		err = svd_exec_reload(svd, buff, buff_sz);
+	} else if(msg.type == msg_type_HANDOFF){
+		err = svd_exec_handoff(svd, buff, buff_sz);
+	} else if(msg.type == msg_type_STARTUP){
+		err = svd_exec_startup(svd, buff, buff_sz);
+	} else if(msg.type == msg_type_CALL_MEM){
+		err = svd_exec_call_mem(svd, buff, buff_sz);
+	} else if(msg.type == msg_type_LOG){
+		err = svd_exec_log(svd, buff, buff_sz);
 	}
 	if(err){
 		goto __exit_fail;
@@ -259,7 +335,7 @@ svd_exec_jbt(svd_t * const svd, char ** const buff, int * const buff_sz)
 		err = ab_chan_media_jb_refresh(chan);
 		if(err){
 			if(svd_addtobuf(buff, buff_sz,
-					"{\"error\":\"jb_refresh error: %s\"}\n",ab_g_err_str)){
+					"{\"error\":\"jb_refresh error: %s\"}\n",ab_err_str())){
 				goto __exit_fail;
 			}
 			goto __exit_success;
@@ -323,7 +399,7 @@ svd_exec_2af(svd_t * const svd, struct svdif_msg_s * const msg,
 {/*{{{*/
 	if       (msg->ch_sel.ch_t == ch_t_ONE){/*{{{*/
 		int ch_n = msg->ch_sel.ch_if_one;
-		if((ch_n<0) || (ch_n>=CHANS_MAX)){
+		if((ch_n<0) || (ch_n>=svd->ab->chans_num)){
 			if(svd_addtobuf(buff, buff_sz,
 					"{\"error\":\"wrong chan num %d\"}\n",ch_n)){
 				goto __exit_fail;
@@ -468,15 +544,16 @@ svd_exec_channels(svd_t * svd, char ** const buff, int * const buff_sz)
 	for (i=0; i<g_conf.channels; i++) {
 		ab_chan_t * ab_chan = &svd->ab->chans[i];
 		svd_chan_t * chan_ctx = ab_chan->ctx;
+		svd_call_t * call = chan_ctx->call;
 		if(svd_addtobuf(buff, buff_sz, "{\"channel\":\"%i\",", i+1))
 			goto __exit_fail;
 			
 		if(svd_addtobuf(buff, buff_sz, "\"offhook\":\"%d\", \"outgoing\":\"%d\", \"incoming\":\"%d\",",
-		  chan_ctx->off_hook, chan_ctx->op_handle ? chan_ctx->outgoing_call : 0, chan_ctx->op_handle ? !chan_ctx->outgoing_call : 0))
+		  chan_ctx->off_hook, call ? call->outgoing : 0, call ? !call->outgoing : 0))
 			goto __exit_fail;
 			
 		if(svd_addtobuf(buff, buff_sz, "\"account\":\"%s\", \"address\":\"%s\",",
-		  chan_ctx->op_handle && chan_ctx->account ? chan_ctx->account->name : "", chan_ctx->op_handle ? (chan_ctx->remote_sip ? chan_ctx->remote_sip : "") : ""))
+		  call && call->account ? call->account->name : "", call && call->remote_sip ? call->remote_sip : ""))
 			goto __exit_fail;
 		if (chan_ctx->call_established) {
 			duration = now-chan_ctx->call_start;
@@ -503,6 +580,423 @@ __exit_fail:
 	return -1;
 }/*}}}*/
 
+/** Buffer for flight recorder records decoding.*/
+struct flight_buf_s {
+	char ** buff;
+	int * buff_sz;
+};
+
+/**
+ * Put one decoded flight record to the answer.
+ *
+ * \param[in]	r		record.
+ * \param[in]	arg		\ref flight_buf_s with the answer buffer.
+ * \retval -1	if somthing nasty happens.
+ * \retval 0 	if etherything is ok.
+ */
+static int
+svd_flight_rec_tobuf(struct flight_rec_s const * const r, void * arg)
+{/*{{{*/
+	struct flight_buf_s * fb = arg;
+	char line [FLIGHT_LINE_LEN];
+
+	svd_flight_decode (r, line, sizeof(line));
+	return svd_addtobuf(fb->buff, fb->buff_sz, "%s", line);
+}/*}}}*/
+
+static int
+svd_exec_flight(svd_t * svd, char ** const buff, int * const buff_sz)
+{/*{{{*/
+	struct flight_buf_s fb = {buff, buff_sz};
+
+	if(svd_addtobuf(buff, buff_sz, "%lu events recorded (UTC)\n",
+			g_flight.pos)){
+		goto __exit_fail;
+	}
+	if(svd_flight_foreach (svd_flight_rec_tobuf, &fb)){
+		goto __exit_fail;
+	}
+	return 0;
+__exit_fail:
+	return -1;
+}/*}}}*/
+
+static int
+svd_exec_lat(svd_t * svd, char ** const buff, int * const buff_sz)
+{/*{{{*/
+	int i;
+	sip_account_t * account;
+	int accounts;
+
+	if(svd_addtobuf(buff, buff_sz,"[\n")){
+		goto __exit_fail;
+	}
+	accounts=su_vector_len(g_conf.sip_account);
+	for (i=0; i<accounts; i++) {
+		account = su_vector_item(g_conf.sip_account, i);
+		if(svd_lat_tobuf(account->name, &account->lat, buff, buff_sz)){
+			goto __exit_fail;
+		}
+		if(svd_addtobuf(buff, buff_sz,",\n")){
+			goto __exit_fail;
+		}
+	}
+	/* calls without account (hangup before dialling, etc.) */
+	if(svd_lat_tobuf("", &svd->lat, buff, buff_sz)){
+		goto __exit_fail;
+	}
+	if(svd_addtobuf(buff, buff_sz,"\n]\n")){
+		goto __exit_fail;
+	}
+	return 0;
+__exit_fail:
+	return -1;
+}/*}}}*/
+
+static int
+svd_lat_tobuf(char const * const name, struct lat_stat_s const * const st,
+		char ** const buff, int * const buff_sz)
+{/*{{{*/
+	int i;
+	int j;
+
+	if(svd_addtobuf(buff, buff_sz, "{\"account\":\"%s\"", name)){
+		goto __exit_fail;
+	}
+	for (i=0; i<lat_iv_COUNT; i++){
+		struct lat_hist_s const * h = &st->iv[i];
+		if(svd_addtobuf(buff, buff_sz,
+				", \"%s\":{\"n\":\"%lu\", \"avg_ms\":\"%lu\", "
+				"\"max_ms\":\"%lu\", \"hist\":[",
+				lat_iv_name[i], h->n,
+				h->n ? (unsigned long)(h->sum_us / h->n / 1000) : 0,
+				h->max_us / 1000)){
+			goto __exit_fail;
+		}
+		for (j=0; j<LAT_BUCKETS; j++){
+			if(svd_addtobuf(buff, buff_sz, "%s%lu", j ? "," : "", h->cnt[j])){
+				goto __exit_fail;
+			}
+		}
+		if(svd_addtobuf(buff, buff_sz, "]}")){
+			goto __exit_fail;
+		}
+	}
+	if(svd_addtobuf(buff, buff_sz, "}")){
+		goto __exit_fail;
+	}
+	return 0;
+__exit_fail:
+	return -1;
+}/*}}}*/
+
+static int
+svd_exec_loop(svd_t * svd, char ** const buff, int * const buff_sz)
+{/*{{{*/
+	struct loop_cb_stat_s const * st;
+	int i;
+
+	if(svd_addtobuf(buff, buff_sz,"[\n")){
+		goto __exit_fail;
+	}
+	for (i=0; i<loop_cb_COUNT; i++){
+		st = svd_loop_stat (i);
+		if(svd_addtobuf(buff, buff_sz, "{\"cb\":\"%s\", \"slow\":\"%lu\"",
+				loop_cb_name[i], st->slow)){
+			goto __exit_fail;
+		}
+		if(svd_loop_hist_tobuf("dur", &st->dur, buff, buff_sz)){
+			goto __exit_fail;
+		}
+		if(svd_loop_hist_tobuf("lag", &st->lag, buff, buff_sz)){
+			goto __exit_fail;
+		}
+		if(i == loop_cb_MEDIA_URING && svd_uring_on ()){
+			struct uring_stat_s const * const u = svd_uring_stat ();
+			if(svd_addtobuf(buff, buff_sz,
+					", \"uring\":{\"enters\":\"%llu\", \"wakeups\":\"%llu\", "
+					"\"cqes\":\"%llu\", \"to_net\":\"%llu\", "
+					"\"to_board\":\"%llu\", \"dropped\":\"%llu\", "
+					"\"nobufs\":\"%llu\", \"errors\":\"%llu\", "
+					"\"bufs_min\":\"%lu\"}",
+					u->enters, u->wakeups, u->cqes, u->to_net, u->to_board,
+					u->dropped, u->nobufs, u->errors, u->bufs_min)){
+				goto __exit_fail;
+			}
+		}
+		if(svd_addtobuf(buff, buff_sz, "}%s\n", i<loop_cb_COUNT-1 ? "," : "")){
+			goto __exit_fail;
+		}
+	}
+	if(svd_addtobuf(buff, buff_sz,"]\n")){
+		goto __exit_fail;
+	}
+	return 0;
+__exit_fail:
+	return -1;
+}/*}}}*/
+
+static int
+svd_loop_hist_tobuf(char const * const name, struct loop_hist_s const * const h,
+		char ** const buff, int * const buff_sz)
+{/*{{{*/
+	int first = 1;
+	int j;
+
+	if(svd_addtobuf(buff, buff_sz,
+			", \"%s\":{\"n\":\"%lu\", \"avg_us\":\"%lu\", "
+			"\"max_us\":\"%lu\", \"hist\":[",
+			name, h->n,
+			h->n ? (unsigned long)(h->sum_us / h->n) : 0, h->max_us)){
+		goto __exit_fail;
+	}
+	/* only non-empty buckets as [lower bound us, count] */
+	for (j=0; j<LOOP_BUCKETS; j++){
+		if( !h->cnt[j]){
+			continue;
+		}
+		if(svd_addtobuf(buff, buff_sz, "%s[%lu,%lu]", first ? "" : ",",
+				svd_loop_bucket_low(j), h->cnt[j])){
+			goto __exit_fail;
+		}
+		first = 0;
+	}
+	if(svd_addtobuf(buff, buff_sz, "]}")){
+		goto __exit_fail;
+	}
+	return 0;
+__exit_fail:
+	return -1;
+}/*}}}*/
+
+/** Channel configurations names (see \ref ab_chan_cfg_e).*/
+static char const * const svd_cfg_name [ab_chan_cfg_COUNT] = {
+	"ring", "tone", "linefeed", "hook", "coder", "jb", "wlec",
+};
+
+static int
+svd_exec_ioctl(svd_t * svd, char ** const buff, int * const buff_sz)
+{/*{{{*/
+	unsigned long applied = 0;
+	unsigned long suppressed = 0;
+	int i;
+	int j;
+
+	if(svd_addtobuf(buff, buff_sz,"{\"chans\":[\n")){
+		goto __exit_fail;
+	}
+	for (i=0; i<svd->ab->chans_num; i++){
+		struct ab_chan_cfg_stat_s const * st = &svd->ab->chans[i].cfg_stat;
+		svd_chan_t const * ctx = svd->ab->chans[i].ctx;
+		if(svd_addtobuf(buff, buff_sz, "{\"channel\":\"%d\"", i+1)){
+			goto __exit_fail;
+		}
+		if(ctx && svd_addtobuf(buff, buff_sz,
+				", \"media\":{\"full\":\"%lu\", \"fast\":\"%lu\"}",
+				ctx->media_cache.full, ctx->media_cache.fast)){
+			goto __exit_fail;
+		}
+		for (j=0; j<ab_chan_cfg_COUNT; j++){
+			applied += st->applied[j];
+			suppressed += st->suppressed[j];
+			if(svd_addtobuf(buff, buff_sz,
+					", \"%s\":{\"applied\":\"%lu\", \"suppressed\":\"%lu\"}",
+					svd_cfg_name[j], st->applied[j], st->suppressed[j])){
+				goto __exit_fail;
+			}
+		}
+		if(svd_addtobuf(buff, buff_sz, "}%s\n",
+				i<svd->ab->chans_num-1 ? "," : "")){
+			goto __exit_fail;
+		}
+	}
+	if(svd_addtobuf(buff, buff_sz,
+			"], \"applied\":\"%lu\", \"suppressed\":\"%lu\"}\n",
+			applied, suppressed)){
+		goto __exit_fail;
+	}
+	return 0;
+__exit_fail:
+	return -1;
+}/*}}}*/
+
+static int
+svd_exec_events(svd_t * svd, char ** const buff, int * const buff_sz)
+{/*{{{*/
+	struct atab_evt_stats_s const * st = svd_atab_evt_stats ();
+	unsigned long gets = 0;
+	int first = 1;
+	int i;
+
+	/* backend calls, TAPI takes one ioctl per event */
+	for (i=0; i<svd->ab->devs_num; i++){
+		gets += svd->ab->devs[i].evt_gets;
+	}
+	if(svd_addtobuf(buff, buff_sz,
+			"{\"batches\":\"%lu\", \"batch_max\":\"%lu\", \"gets\":\"%lu\", "
+			"\"events\":[\n",
+			st->batches, st->batch_max, gets)){
+		goto __exit_fail;
+	}
+	/* only event types that have been got */
+	for (i=0; i<ab_dev_event_COUNT; i++){
+		struct atab_evt_stat_s const * e = &st->evt[i];
+		if( !e->n){
+			continue;
+		}
+		if(svd_addtobuf(buff, buff_sz,
+				"%s{\"event\":\"%s\", \"n\":\"%lu\", \"errors\":\"%lu\", "
+				"\"avg_us\":\"%lu\", \"max_us\":\"%lu\"}",
+				first ? "" : ",\n", atab_evt_name[i], e->n, e->errors,
+				(unsigned long)(e->sum_us / e->n), e->max_us)){
+			goto __exit_fail;
+		}
+		first = 0;
+	}
+	if(svd_addtobuf(buff, buff_sz,"]}\n")){
+		goto __exit_fail;
+	}
+	return 0;
+__exit_fail:
+	return -1;
+}/*}}}*/
+
+static int
+svd_exec_reload(svd_t * svd, char ** const buff, int * const buff_sz)
+{/*{{{*/
+	struct conf_reload_s r;
+
+	if(svd_conf_reload (svd, &r)){
+		if(svd_addtobuf(buff, buff_sz,
+				"{\"reload\":\"failed\"}\n")){
+			goto __exit_fail;
+		}
+		return 0;
+	}
+	if(svd_addtobuf(buff, buff_sz,
+			"{\"reload\":\"ok\", \"accounts_added\":\"%d\", "
+			"\"accounts_changed\":\"%d\", \"accounts_updated\":\"%d\", "
+			"\"accounts_removed\":\"%d\", \"dial_plan\":\"%d\", "
+			"\"codecs\":\"%d\", \"chans\":\"%d\", \"chans_pending\":\"%d\", "
+			"\"restart\":\"%d\"}\n",
+			r.accounts_added, r.accounts_changed, r.accounts_updated,
+			r.accounts_removed, r.dial_plan, r.codecs, r.chans,
+			r.chans_pending, r.restart)){
+		goto __exit_fail;
+	}
+	return 0;
+__exit_fail:
+	return -1;
+}/*}}}*/
+
+static int
+svd_exec_handoff(svd_t * svd, char ** const buff, int * const buff_sz)
+{/*{{{*/
+	if(svd_addtobuf(buff, buff_sz, "{\"handoff\":\"%s\"}\n",
+			svd_handoff_request (svd) ? "failed" : "started")){
+		goto __exit_fail;
+	}
+	return 0;
+__exit_fail:
+	return -1;
+}/*}}}*/
+
+static int
+svd_exec_startup(svd_t * svd, char ** const buff, int * const buff_sz)
+{/*{{{*/
+	struct boot_stat_s const * st = svd_boot_stat ();
+	struct ab_start_stat_s const * ab = &svd->ab->start;
+	int i;
+
+	if(svd_addtobuf(buff, buff_sz, "{\"ready_us\":\"%lu\", "
+			"\"first_reg_us\":\"%lu\", \"dns_hosts\":\"%d\", "
+			"\"dns_failed\":\"%d\",\n\"phases\":[\n",
+			st->ready_us, st->first_reg_us, st->dns_hosts, st->dns_failed)){
+		goto __exit_fail;
+	}
+	for (i=0; i<boot_phase_COUNT; i++){
+		if(svd_addtobuf(buff, buff_sz, "{\"phase\":\"%s\", \"done\":\"%d\", "
+				"\"begin_us\":\"%lu\", \"end_us\":\"%lu\"}%s\n",
+				boot_phase_name[i], st->ph[i].done, st->ph[i].begin_us,
+				st->ph[i].end_us, i<boot_phase_COUNT-1 ? "," : "")){
+			goto __exit_fail;
+		}
+	}
+	if(svd_addtobuf(buff, buff_sz, "],\n\"board\":{\"warm\":\"%d\", "
+			"\"total_us\":\"%lu\"", ab->warm, ab->total_us)){
+		goto __exit_fail;
+	}
+	for (i=0; i<ab_start_phase_COUNT; i++){
+		if(svd_addtobuf(buff, buff_sz, ", \"%s_us\":\"%lu\"",
+				ab_start_phase_name[i], ab->phase_us[i])){
+			goto __exit_fail;
+		}
+	}
+	if(svd_addtobuf(buff, buff_sz, "}}\n")){
+		goto __exit_fail;
+	}
+	return 0;
+__exit_fail:
+	return -1;
+}/*}}}*/
+
+static int
+svd_exec_call_mem(svd_t * svd, char ** const buff, int * const buff_sz)
+{/*{{{*/
+	struct call_mem_stat_s const * ms = &svd->call_mem;
+	svd_call_t * call;
+	unsigned long allocs;
+	unsigned long bytes;
+	int first = 1;
+	unsigned int i;
+
+	if(svd_addtobuf(buff, buff_sz, "{\"calls\":[\n")){
+		goto __exit_fail;
+	}
+	for (i=0; i<=svd->call_mask; i++){
+		for (call = svd->call_hash[i]; call; call = call->hash_next){
+			svd_call_mem (call, &allocs, &bytes);
+			if(svd_addtobuf(buff, buff_sz, "%s{\"chan\":\"%d\", "
+					"\"remote\":\"%s\", \"allocs\":\"%lu\", "
+					"\"bytes\":\"%lu\"}", first ? "" : ",\n",
+					call->chans ? call->chans->chan_idx + 1 : 0,
+					call->remote_sip ? call->remote_sip : "",
+					allocs, bytes)){
+				goto __exit_fail;
+			}
+			first = 0;
+		}
+	}
+	if(svd_addtobuf(buff, buff_sz, "%s],\n\"finished\":\"%lu\", "
+			"\"allocs\":\"%llu\", \"bytes\":\"%llu\", "
+			"\"max_allocs\":\"%lu\", \"max_bytes\":\"%lu\", "
+			"\"preload\":\"%d\"}\n", first ? "" : "\n",
+			ms->calls, ms->allocs, ms->bytes, ms->max_allocs,
+			ms->max_bytes, CALL_ARENA_PRELOAD)){
+		goto __exit_fail;
+	}
+	return 0;
+__exit_fail:
+	return -1;
+}/*}}}*/
+
+static int
+svd_exec_log(svd_t * svd, char ** const buff, int * const buff_sz)
+{/*{{{*/
+	struct logring_stat_s st;
+
+	svd_logring_stat (&st);
+	if(svd_addtobuf(buff, buff_sz, "{\"written\":\"%lu\", "
+			"\"dropped\":\"%lu\", \"truncated\":\"%lu\", "
+			"\"batches\":\"%lu\"}\n",
+			st.written, st.dropped, st.truncated, st.batches)){
+		goto __exit_fail;
+	}
+	return 0;
+__exit_fail:
+	return -1;
+}/*}}}*/
+
 static int
 svd_exec_shutdown(svd_t * svd, char ** const buff, int * const buff_sz)
 {/*{{{*/
@@ -578,7 +1072,7 @@ svd_rtcp_for_chan(ab_chan_t * const chan, char ** const buf, int * const palc,
 	err = ab_chan_media_rtcp_refresh(chan);
 	if(err){
 		if(svd_addtobuf(buf, palc,
-				"{\"error\":\"rtcp_refresh error: %s\"}\n",ab_g_err_str)){
+				"{\"error\":\"rtcp_refresh error: %s\"}\n",ab_err_str())){
 			goto __exit_fail;
 		}
 		goto __exit_success;
@@ -614,7 +1108,7 @@ svd_jb_for_chan(ab_chan_t * const chan, char ** const buf, int * const palc,
 	err = ab_chan_media_jb_refresh(chan);
 	if(err){
 		if(svd_addtobuf(buf, palc,
-				"{\"error\":\"jb_refresh error: %s\"}\n",ab_g_err_str)){
+				"{\"error\":\"jb_refresh error: %s\"}\n",ab_err_str())){
 			goto __exit_fail;
 		}
 		goto __exit_success;
@@ -9,10 +9,18 @@
 #include "svd_ua.h"
 #include "svd_atab.h"
 #include "svd_led.h"
+#include "svd_flight.h"
+#include "svd_loop.h"
+#include "svd_rec.h"
+#include "svd_handoff.h"
+#include "svd_boot.h"
+#include "svd_cdr.h"
+#include "svd_addr.h"
 #include <signal.h>
 #include <stdlib.h>
 #include <errno.h>
 #include <assert.h>
+#include <netinet/in.h>
 /*}}}*/
 
 /** @defgroup UAC_I User Agent Client internals.
@@ -53,6 +61,11 @@ svd_i_prack (svd_t * svd, nua_handle_t * nh, sip_account_t const * const account
 		sip_t const * const sip);
 /** Make REGISTER SIP action.*/
 static void svd_register (svd_t * const svd, sip_account_t * account);
+/** Update the voip led from the accounts registration state.*/
+static void svd_voip_led (void);
+/** Remember the dialog of the call (for the handoff).*/
+static void svd_call_track (svd_t * const svd, nua_handle_t const * const nh,
+		nua_event_t const event, sip_t const * const sip);
 
 
 /** Answer to outgoing INVITE.*/
@@ -96,7 +109,8 @@ static void
 svd_parse_sdp(svd_t * const svd, nua_handle_t * const nh, char const * str);
 /** Create SDP string depends on codec choice policy.*/
 static char *
-svd_new_sdp_string (ab_chan_t const * const chan, sip_account_t const * const account);
+svd_new_sdp_string (su_home_t * const home, ab_chan_t const * const chan,
+		sip_account_t const * const account, int const remote_af);
 /** @}*/
 
 /** Sets the telephone even payload */
@@ -127,7 +141,15 @@ svd_nua_callback (nua_event_t event, int status, char const * phrase,
 		nua_t * nua, svd_t * svd, nua_handle_t * nh, sip_account_t * account,
 		sip_t const * sip, tagi_t tags[] )
 {/*{{{*/
+	unsigned long long loop_start;
 DFS
+	loop_start = svd_loop_enter (loop_cb_NUA, 0);
+	svd_flight_put (flight_type_NUA, -1, event, status, nh);
+	if(svd_rec_on()){
+		svd_rec_sip (event, status, phrase, nh,
+				sip && sip->sip_cseq ? sip->sip_cseq->cs_method_name : NULL,
+				sip && sip->sip_call_id ? sip->sip_call_id->i_id : NULL);
+	}
 	SU_DEBUG_3(("Event : %s\n",nua_event_name(event)));
 	if(sip){
 		SU_DEBUG_3(("---[ SIP ]---\n" VA_NONE));
@@ -234,7 +256,11 @@ DFS
 		case nua_r_subscribe:	/*< 43 Answer to outgoing SUBSCRIBE */
 		case nua_r_unsubscribe:/*< 44 Answer to outgoing un-SUBSCRIBE */
 		case nua_r_notify:	/*< 45 Answer to outgoing NOTIFY */
+			break;
 		case nua_r_method:/*< 46 Answer to unknown outgoing method */
+			/* BYE of the adopted call */
+			svd_handoff_r_bye (svd, nh, status);
+			break;
 		case nua_r_authenticate:/*< 47 Answer to nua_authenticate() */
 			break;
 
@@ -246,6 +272,10 @@ DFS
 		 */
 			SU_DEBUG_2(("UNKNOWN EVENT : %d %s\n", status, phrase));
 	}
+	if(sip && nh){
+		svd_call_track (svd, nh, event, sip);
+	}
+	svd_loop_leave (loop_cb_NUA, loop_start);
 DFE
 }/*}}}*/
 
@@ -264,6 +294,7 @@ svd_invite_to (svd_t * const svd, int const chan_idx, char const * const to_str)
 {/*{{{*/
 	ab_chan_t * chan = &svd->ab->chans[chan_idx];
 	svd_chan_t * chan_ctx = chan->ctx;
+	svd_call_t * call = NULL;
 	nua_handle_t * nh = NULL;
 	sip_to_t *to = NULL;
 	sip_from_t *from = NULL;
@@ -310,16 +341,33 @@ DFS
 		goto __exit_fail;
 	
 	account = su_vector_item(g_conf.sip_account, account_index);
-	from = sip_from_make(svd->home, account->user_URI);
+
+	/* headers and strings of the call live in its arena */
+	call = svd_call_new (svd, account);
+	if( !call){
+		goto __exit_fail;
+	}
+	from = sip_from_make(call->home, account->user_URI);
+	if( !from){
+		SU_DEBUG_0 (("%s sip_from_make(): invalid address: %s\n",
+				__func__, account->user_URI));
+		goto __exit_fail;
+	}
 	from->a_display = account->display;
 	if (dplan_index<0) {
-		asprintf(&to_address, "sip:%s@%s", to_str, account->sip_domain);
+		to_address = su_sprintf(call->home, "sip:%s@%s",
+				to_str, account->sip_domain);
 	} else {
-		asprintf(&to_address, "sip:%s%s@%s", dplan->replace, to_str+dplan->prefixlen, account->sip_domain);
+		to_address = su_sprintf(call->home, "sip:%s%s@%s", dplan->replace,
+				to_str+dplan->prefixlen, account->sip_domain);
+	}
+	if( !to_address){
+		SU_DEBUG_0 ((LOG_FNC_A(LOG_NOMEM_A("to_address"))));
+		goto __exit_fail;
 	}
 	SU_DEBUG_9(("Going to call %s\n", to_address));
 
-	to = sip_to_make(svd->home, to_address);
+	to = sip_to_make(call->home, to_address);
 	if ( !to ) {
 		SU_DEBUG_0 (("%s sip_to_make(): invalid address: %s\n",
 				__func__, to_address));
@@ -337,34 +385,32 @@ DFS
 			SIPTAG_TO(to),
 			SIPTAG_FROM(from),
 			TAG_NULL());
-			
-	su_free(svd->home, to);
-	to = NULL;
 
-	/* reset rtp-socket parameters */
-	chan_ctx->account = account;
-	err = svd_media_tapi_rtp_sock_rebinddev(chan_ctx);
-	if (err){
-		SU_DEBUG_1 ((LOG_FNC_A("can`t SO_BINDTODEVICE on RTP-socket")));
+	if( !nh){
+		SU_DEBUG_1 ((LOG_FNC_A("can`t create handle")));
 		goto __exit_fail;
 	}
 
-	chan_ctx->op_handle = nh;
+	svd_call_handle (svd, call, nh);
+	if( !svd_call_bind (svd, chan_ctx, nh, account)){
+		goto __exit_fail;
+	}
+	call->remote_sip = to_address;
+	call->outgoing = 1;
 
-	if( !nh){
-		SU_DEBUG_1 ((LOG_FNC_A("can`t create handle")));
+	/* reset rtp-socket parameters */
+	err = svd_media_tapi_rtp_sock_rebinddev(chan_ctx);
+	if (err){
+		SU_DEBUG_1 ((LOG_FNC_A("can`t SO_BINDTODEVICE on RTP-socket")));
 		goto __exit_fail;
 	}
-	
-	chan_ctx->remote_sip = su_strdup(svd->home,to_address);
-	chan_ctx->outgoing_call = 1;
 
-	l_sdp_str = svd_new_sdp_string (chan, account);
+	l_sdp_str = svd_new_sdp_string (call->home, chan, account, AF_UNSPEC);
 	if ( !l_sdp_str){
 		goto __exit_fail;
 	}
 	
-	chan_ctx->account = account;
+	svd_lat_mark (&chan_ctx->lat, lat_mark_INVITE);
 	nua_invite( nh,
 			TAG_IF (account->outbound_proxy, NUTAG_PROXY(account->outbound_proxy)),		    
 			TAG_IF (account->user_agent, SIPTAG_USER_AGENT_STR(account->user_agent)),
@@ -375,23 +421,18 @@ DFS
 			SOATAG_RTP_SELECT (SOA_RTP_SELECT_SINGLE),
 			TAG_END() );
 DFE
-	free (l_sdp_str);
-	free (to_address);
+	su_free (call->home, l_sdp_str);
 	return 0;
 
 __exit_fail:
+	/* the call frees its headers and strings */
+	if (call && chan_ctx->call == call){
+		svd_call_unbind (svd, chan_ctx);
+	} else if (call){
+		svd_call_free (svd, call);
+	}
 	if (nh){
 		nua_handle_destroy(nh);
-		chan_ctx->op_handle = NULL;
-	}
-	if (to){
-		su_free(svd->home, to);
-	}
-	if (l_sdp_str){
-		free (l_sdp_str);
-	}
-	if (to_address){
-		free (to_address);
 	}
 DFE
 	return -1;
@@ -430,11 +471,15 @@ DFS
 		}
 
 		/* have remote sdp make local */
-		l_sdp_str = svd_new_sdp_string (chan, chan_ctx->account);
+		l_sdp_str = svd_new_sdp_string (chan_ctx->call->home, chan,
+				chan_ctx->call->account, chan_ctx->call->remote_af);
 		if ( !l_sdp_str){
 			goto __exit;
 		}
 
+		if (status == 200){
+			svd_lat_mark (&chan_ctx->lat, lat_mark_ANSWER);
+		}
 		nua_respond (chan_ctx->op_handle, status, phrase,
 				SOATAG_AUDIO_AUX("telephone-event"),
 				SOATAG_RTP_SORT (SOA_RTP_SORT_LOCAL),
@@ -448,7 +493,7 @@ DFS
 	}
 __exit:
 	if (l_sdp_str){
-		free (l_sdp_str);
+		su_free (chan_ctx->call->home, l_sdp_str);
 	}
 DFE
 	return call_answered;
@@ -477,7 +522,10 @@ DFS
 
 	svd_chan_t * chan_ctx = chan->ctx;
 
-	if (chan_ctx->op_handle){
+	if (chan_ctx->call && chan_ctx->call->adopted){
+		/* NUA has no dialog for the call of the previous svd */
+		svd_handoff_bye (svd, chan);
+	} else if (chan_ctx->op_handle){
 		nua_bye(chan_ctx->op_handle, TAG_END());
 	} else {
 		/* just clear call params */
@@ -504,38 +552,115 @@ svd_refresh_registration (svd_t * const svd)
 	int i;
 DFS
 	for (i=0; i<su_vector_len(g_conf.sip_account); i++) {
-		sip_account_t * account = su_vector_item(g_conf.sip_account, i);
-		account->registered = 0;
-		account->reg_tmr = su_timer_create(su_root_task(svd->root), 30000);
-		if (!account->enabled)
-			continue;
-		if ( nua_handle_has_registrations (account->op_reg)){
+		svd_account_register (svd, su_vector_item(g_conf.sip_account, i));
+	}
+DFE
+	return;
+}/*}}}*/
+
+/**
+ * Unregister the account from server and register it again.
+ *
+ * \param[in] svd 		context pointer
+ * \param[in] account 	account to register.
+ * \remark
+ *		The same as \ref svd_refresh_registration() for one account.
+ *		Disabled account is not registered. The existing handle sends the
+ *		un-REGISTER (to the registrar and user it was registered with), the
+ *		new REGISTER goes when it is answered or failed, see
+ *		\ref svd_r_register().
+ */
+void
+svd_account_register (svd_t * const svd, sip_account_t * const account)
+{/*{{{*/
+DFS
+	account->registered = 0;
+	if ( !account->reg_tmr)
+		account->reg_tmr = su_timer_create(su_root_task(svd->root), REG_RETRY_MS);
+	if (!account->enabled)
+		goto __exit;
+	su_timer_reset(account->reg_tmr);
+	if (account->op_reg){
+		/* the old binding (even a pending one) is removed first */
+		nua_unregister(account->op_reg,
+			SIPTAG_CONTACT_STR("*"),
+			TAG_IF (account->user_agent, SIPTAG_USER_AGENT_STR(account->user_agent)),		      
+			TAG_NULL());
+	} else {
+		/* unregister all previously registered on server */
+		sip_to_t * fr_to = NULL;
+		fr_to = sip_to_make(svd->home, account->user_URI);
+		if( !fr_to){
+		      SU_DEBUG_2((LOG_FNC_A(LOG_NOMEM)));
+		      goto __exit;
+		}
+		account->op_reg = nua_handle( svd->nua, NULL,
+			SIPTAG_TO(fr_to),
+			SIPTAG_FROM(fr_to),
+			TAG_NULL());
+		if (account->op_reg) {
+		        nua_handle_bind(account->op_reg, account);
 			nua_unregister(account->op_reg,
 				SIPTAG_CONTACT_STR("*"),
 				TAG_IF (account->user_agent, SIPTAG_USER_AGENT_STR(account->user_agent)),		      
 				TAG_NULL());
-		} else {
-			/* unregister all previously registered on server */
-			sip_to_t * fr_to = NULL;
-			fr_to = sip_to_make(svd->home, account->user_URI);
-			if( !fr_to){
-			      SU_DEBUG_2((LOG_FNC_A(LOG_NOMEM)));
-			      continue;
-			}
-			account->op_reg = nua_handle( svd->nua, NULL,
-				SIPTAG_TO(fr_to),
-				SIPTAG_FROM(fr_to),
-				TAG_NULL());
-			if (account->op_reg) {
-			        nua_handle_bind(account->op_reg, account);
-				nua_unregister(account->op_reg,
-					SIPTAG_CONTACT_STR("*"),
-					TAG_IF (account->user_agent, SIPTAG_USER_AGENT_STR(account->user_agent)),		      
-					TAG_NULL());
-			}
-			su_free (svd->home, fr_to);
 		}
+		su_free (svd->home, fr_to);
 	}
+__exit:
+DFE
+	return;
+}/*}}}*/
+
+/**
+ * Register the account without un-REGISTER of the previous bindings.
+ *
+ * \param[in] svd 		context pointer
+ * \param[in] account 	account registered by the previous svd.
+ * \remark
+ *		The handed off svd left its binding on the server, the new one
+ *		refreshes it with the same contact, so the incoming calls do not
+ *		miss the account meanwhile.
+ */
+void
+svd_account_continue (svd_t * const svd, sip_account_t * const account)
+{/*{{{*/
+DFS
+	account->registered = 0;
+	if ( !account->reg_tmr)
+		account->reg_tmr = su_timer_create(su_root_task(svd->root), REG_RETRY_MS);
+	if (!account->enabled)
+		goto __exit;
+	su_timer_reset(account->reg_tmr);
+	svd_register (svd, account);
+__exit:
+DFE
+	return;
+}/*}}}*/
+
+/**
+ * Unregister the account from server and do not register it again.
+ *
+ * \param[in] svd 		context pointer
+ * \param[in] account 	disabled account.
+ * \remark
+ *		The account should be disabled already, so the unregister answer
+ *		and the retry timer do not register it again.
+ */
+void
+svd_account_unregister (svd_t * const svd, sip_account_t * const account)
+{/*{{{*/
+DFS
+	if (account->reg_tmr)
+		su_timer_reset(account->reg_tmr);
+	account->registered = 0;
+	if ( nua_handle_has_registrations (account->op_reg)){
+		nua_unregister(account->op_reg,
+			SIPTAG_CONTACT_STR("*"),
+			TAG_IF (account->user_agent, SIPTAG_USER_AGENT_STR(account->user_agent)),		      
+			TAG_NULL());
+	}
+	svd_voip_led ();
 DFE
 	return;
 }/*}}}*/
@@ -656,9 +781,11 @@ svd_i_invite( svd_t * const svd, nua_handle_t * nh, sip_t const *sip)
 {/*{{{*/
 	ab_chan_t * chan;
 	svd_chan_t * chan_ctx;
+	svd_call_t * call = NULL;
 	sip_account_t * sip_account;
-	char *contact=NULL;
-	char *equal;
+	char const * contact;
+	char const * equal;
+	int contact_len;
 	sip_from_t const * from = sip->sip_from;
 	sip_p_asserted_identity_t const * pai = sip_p_asserted_identity( sip );
 	sip_remote_party_id_t * rpi = sip_remote_party_id( sip );
@@ -669,25 +796,47 @@ svd_i_invite( svd_t * const svd, nua_handle_t * nh, sip_t const *sip)
 	char *cname2=NULL;
 	int i;
 	unsigned char found = 0;
+	struct lat_call_s in_invite;
 DFS
+	memset(&in_invite, 0, sizeof(in_invite));
+	svd_lat_mark (&in_invite, lat_mark_IN_INVITE);
+
 	/* remote call */
 	sip_account = NULL;
-	/* sofia-sip could add a = plus some random string to the contact, remove it */
-	contact = strdup(sip->sip_request->rq_url->url_user);
-	if (equal = strrchr(contact, '='))
-		*equal=0;
+	/* sofia-sip could add a = plus some random string to the contact, skip it */
+	contact = sip->sip_request->rq_url->url_user;
+	if( !contact){
+		contact = "";
+	}
+	equal = strrchr(contact, '=');
+	contact_len = equal ? equal - contact : strlen(contact);
 	for (i=0; i<su_vector_len(g_conf.sip_account); i++) {
 		sip_account_t * temp_account = su_vector_item(g_conf.sip_account, i);
 		if( !temp_account->enabled)
 		  continue;
 
-		if ( !strcmp(temp_account->name, contact)){
+		if ( !strncmp(temp_account->name, contact, contact_len) &&
+				!temp_account->name[contact_len]){
 			/* found the account the call is coming from */
 			sip_account = temp_account;
 			break;
 		}
 	}
 
+	/* caller id strings live in the call arena */
+	call = svd_call_new (svd, sip_account);
+	if( !call){
+		nua_respond(nh, SIP_500_INTERNAL_SERVER_ERROR, TAG_END());
+		nua_handle_destroy(nh);
+		goto __exit;
+	}
+	svd_call_handle (svd, call, nh);
+	/* the rejected calls have the records too */
+	call->remote_sip = url_as_string(call->home, from->a_url);
+	if(sip->sip_call_id){
+		call->call_id = su_strdup (call->home, sip->sip_call_id->i_id);
+	}
+
 	if (pai) {
 	  SU_DEBUG_9(("Call with p-asserted-identity %s  %s:%s@%s\n",
 		      pai->paid_display, pai->paid_url->url_scheme, pai->paid_url->url_user,
@@ -708,8 +857,8 @@ DFS
 
 	/* use remote user as caller id, but check if it's numeric */
 	if (cid_from) {
-		cid = strdup(cid_from->url_user);
-		for (i=0; i<strlen(cid); i++) {
+		cid = su_strdup(call->home, cid_from->url_user);
+		for (i=0; cid && i<strlen(cid); i++) {
 			if ((cid[i] < '0' || cid[i] > '9') && (cid[i] != '+' || i>0)) {
 				cid[i] = 0;
 				break;
@@ -718,20 +867,19 @@ DFS
 	}
 	/* Try to use the Display name as caller name, removing " */
 	if (cid_display) {
-		cname = strdup(cid_display);
+		cname = su_strdup(call->home, cid_display);
 		cname2 = cname;
-		if (cname2[0] == 34)
+		if (cname2 && cname2[0] == 34)
 			cname2++;
-		int cl=strlen(cname2);
+		int cl = cname2 ? strlen(cname2) : 0;
 		if (cl>0 && cname2[cl-1] == 34)
 			cname2[cl-1] = 0;
 	}
 
 	if (!cname2 || cname2[0] == 0) {
-		if (cname)
-			free(cname);
 		/* no "Display name", use the remote user as caller name */
-		asprintf(&cname,"%s@%s", cid_from->url_user, cid_from->url_host);
+		cname = su_sprintf(call->home, "%s@%s",
+				cid_from->url_user, cid_from->url_host);
 		cname2 = cname;
 	}
 
@@ -741,21 +889,22 @@ DFS
 
 	/* without a number some phones won't ring, provide a dummy number */
 	if ((!cid || cid[0] == 0) && cname2 && cname2[0] != 0) {
-		if (cid) 
-		      free(cid);
-		cid = strdup("0");
+		cid = su_strdup(call->home, "0");
 	}
 	if (cid  && cid[0]=='+' && g_conf.cid_intnl_prefix) {
 		int prefixlen = strlen(g_conf.cid_intnl_prefix);
-		char * ccid = (char *) malloc(strlen(cid)+prefixlen); //no need to add one for the termination since we're removin the +
-		strcpy(ccid,g_conf.cid_intnl_prefix);
-		strcpy(ccid+prefixlen, cid+1);
-		free(cid);
-		cid=ccid;
+		char * ccid = su_alloc(call->home, strlen(cid)+prefixlen); //no need to add one for the termination since we're removin the +
+		if (ccid) {
+			strcpy(ccid,g_conf.cid_intnl_prefix);
+			strcpy(ccid+prefixlen, cid+1);
+			cid=ccid;
+		}
 	}
-	SU_DEBUG_0(("INCOMING CALL TO %s, caller id %s, caller name %s\n", contact, cid, cname2));
+	SU_DEBUG_0(("INCOMING CALL TO %.*s, caller id %s, caller name %s\n",
+			contact_len, contact, cid, cname2));
 
 	if (!sip_account) {
+		svd_call_reject (svd, call, 500);
 		nua_respond(nh, SIP_500_INTERNAL_SERVER_ERROR, TAG_END());
 		nua_handle_destroy(nh);
 		goto __exit;
@@ -764,20 +913,22 @@ DFS
 	for (i=0; i<g_conf.channels; i++) {
 		chan = &svd->ab->chans[i];
 		chan_ctx = chan->ctx;
-		if (sip_account->ring_incoming[i] && !(chan_ctx->op_handle) && !chan_ctx->off_hook) {
+		if (chset_has(sip_account->ring_incoming, i) && !(chan_ctx->op_handle) && !chan_ctx->off_hook) {
+		  if( !svd_call_bind (svd, chan_ctx, nh, sip_account)){
+			  continue;
+		  }
+		  chan_ctx->lat.t[lat_mark_IN_INVITE] = in_invite.t[lat_mark_IN_INVITE];
 		  ab_FXS_line_ring(chan, ab_chan_ring_RINGING, cid, cname2);
+		  svd_lat_mark (&chan_ctx->lat, lat_mark_RING);
 		  if (g_conf.chan_led[i])
 			  led_blink(g_conf.chan_led[i], LED_FAST_BLINK);
-		  chan_ctx->op_handle = nh;
-		  chan_ctx->account = sip_account;
-		  chan_ctx->outgoing_call = 0;
-		  chan_ctx->remote_sip = url_as_string(svd->home, from->a_url);
 		  found = 1;
 		}  
 	}
 
 	/* no channel available */
 	if( !found) {
+		svd_call_reject (svd, call, 486);
 		/* user is busy */
 		nua_respond(nh, SIP_486_BUSY_HERE, TAG_END());
 		nua_handle_destroy(nh);
@@ -787,44 +938,38 @@ DFS
 	nua_handle_bind (nh, sip_account);
 
 __exit:
-	if (cid)
-	  free(cid);
-	if (cname)
-	  free(cname);
-	if (contact)
-	  free(contact);
 DFE
+	return;
 }/*}}}*/
 
 static void
 svd_i_cancel (svd_t * const svd, nua_handle_t const * const nh)
 {/*{{{*/
-	int i;
 	ab_chan_t * chan;
 	svd_chan_t * chan_ctx;
+	svd_chan_t * next;
 	
 DFS
 	SU_DEBUG_3 (("CANCEL received\n" VA_NONE));
-	/* Stop ringing all channels tied to this account */
-	for (i=0; i<g_conf.channels; i++) {
+	/* Stop ringing all channels tied to this call */
+	for (chan_ctx = svd_nh_chan (svd, nh); chan_ctx; chan_ctx = next) {
+		int err;
+		int i = chan_ctx->chan_idx;
+		next = svd_nh_chan_next (chan_ctx);
 		chan = &svd->ab->chans[i];
-		chan_ctx = chan->ctx;
-		if (chan_ctx->op_handle == nh) {
-			int err;
-			err = ab_FXS_line_ring (chan, ab_chan_ring_MUTE, NULL, NULL);
-			if(err){
-			      SU_DEBUG_3 (("Can`t mutes ring on [%02d]: %s\n",
-					      chan->abs_idx , ab_g_err_str));
-			}
-			if (g_conf.chan_led[i]) {
-			      if (chan_ctx->off_hook)
-				led_on(g_conf.chan_led[i]);
-			      else
-				led_off(g_conf.chan_led[i]);
-			}
-			chan_ctx->op_handle = NULL;
-			svd_clear_call(svd, chan);
-		}  
+		err = ab_FXS_line_ring (chan, ab_chan_ring_MUTE, NULL, NULL);
+		if(err){
+		      SU_DEBUG_3 (("Can`t mutes ring on [%02d]: %s\n",
+				      chan->abs_idx , ab_err_str()));
+		}
+		if (g_conf.chan_led[i]) {
+		      if (chan_ctx->off_hook)
+			led_on(g_conf.chan_led[i]);
+		      else
+			led_off(g_conf.chan_led[i]);
+		}
+		svd_call_unbind (svd, chan_ctx);
+		svd_clear_call(svd, chan);
 	}
 DFE
 }/*}}}*/
@@ -850,7 +995,6 @@ svd_i_state(int status, char const *phrase, nua_t * nua, svd_t * svd,
 	char const * r_sdp = NULL;
 	int ss_state = nua_callstate_init;
 	int err;
-	int i;
 	ab_chan_t * chan;
 	svd_chan_t * chan_ctx;
 DFS
@@ -868,20 +1012,20 @@ DFS
 	}
 
 	/* find the channel associated to this event handle */		
-	for (i=0; i<g_conf.channels; i++) {
-		chan = &svd->ab->chans[i];
-		chan_ctx = chan->ctx;
-		if (chan_ctx->op_handle == nh) {
-			SU_DEBUG_4(("CALLSTATE bound to channel %d\n",i)); 
-			break;
-		}
-	}
+	chan_ctx = svd_nh_chan (svd, nh);
 	
 	/* channel not found, ignore */
-	if (chan_ctx->op_handle!=nh) {
+	if ( !chan_ctx) {
 		SU_DEBUG_4(("CALLSTATE: no channel bound to event handle, ignoring\n" VA_NONE));
 		goto __exit;
 	}
+	chan = &svd->ab->chans[chan_ctx->chan_idx];
+	SU_DEBUG_4(("CALLSTATE bound to channel %d\n",chan_ctx->chan_idx)); 
+
+	/* final status for the call record */
+	if (status >= 200 && chan_ctx->call) {
+		chan_ctx->call->status = status;
+	}
 	
 
 	if (r_sdp) {
@@ -909,6 +1053,7 @@ DFS
 
 	/* 18X received */
 		case nua_callstate_proceeding:
+			svd_lat_mark (&chan_ctx->lat, lat_mark_PROVISIONAL);
 			if( chan->parent->type == ab_dev_type_FXS){
 				/* play ringback */
 				err = ab_FXS_line_tone (chan, ab_chan_tone_RINGBACK);
@@ -923,6 +1068,7 @@ DFS
 
 	/* 2XX received */
 		case nua_callstate_completing:
+			svd_lat_mark (&chan_ctx->lat, lat_mark_OK);
 			nua_ack(nh, TAG_END());
 			break;
 /*}}}*/
@@ -953,11 +1099,16 @@ DFS
 			SU_DEBUG_3(("stop playing tone on [%02d]\n", chan->abs_idx));
 
 			if(ab_chan_media_activate (chan)){
-				SU_DEBUG_1(("media_activate error : %s\n", ab_g_err_str));
+				SU_DEBUG_1(("media_activate error : %s\n", ab_err_str()));
+			} else {
+				svd_lat_mark (&chan_ctx->lat, lat_mark_MEDIA);
+				chan_ctx->call->media = 1;
 			}
 			if (!chan_ctx->call_established)
 				chan_ctx->call_start = time(NULL);
 			chan_ctx->call_established = 1;
+			if (!chan_ctx->call->answer_us)
+				chan_ctx->call->answer_us = svd_cdr_now ();
 			break;
 		 }/*}}}*/
 
@@ -967,8 +1118,21 @@ DFS
 
 	/* BYE complete */
 		case nua_callstate_terminated:{/*{{{*/
+			svd_chan_t * ctx;
+			svd_chan_t * next;
 			SU_DEBUG_4 (("call on [%02d] terminated\n", chan->abs_idx));
 
+			/* other channels still ringing for this call */
+			for (ctx = chan_ctx->call_next; ctx; ctx = next) {
+				next = ctx->call_next;
+				ab_FXS_line_ring (&svd->ab->chans[ctx->chan_idx],
+						ab_chan_ring_MUTE, NULL, NULL);
+				if (g_conf.chan_led[ctx->chan_idx])
+					led_off(g_conf.chan_led[ctx->chan_idx]);
+				svd_call_unbind (svd, ctx);
+				svd_clear_call (svd, &svd->ab->chans[ctx->chan_idx]);
+			}
+
 			/* deactivate media */
 			ab_chan_media_deactivate (chan);
 
@@ -1025,18 +1189,10 @@ svd_i_prack (svd_t * svd, nua_handle_t * nh, sip_account_t const * const account
 		sip_t const * const sip)
 {/*{{{*/
 	sip_rack_t const * rack;
-	ab_chan_t * chan=NULL;
-	int i;
 DFS
 	rack = sip->sip_rack;
 	SU_DEBUG_3 (("received PRACK %u\n", rack ? rack->ra_response : 0));
-	for (i=0; i<g_conf.channels; i++) {
-	  if (((svd_chan_t *)(svd->ab->chans[i].ctx))->op_handle == nh) {
-	    chan = &svd->ab->chans[i];
-	    break;
-	    }
-	}    
-	if (chan == NULL){
+	if ( !svd_nh_chan (svd, nh)){
 		nua_handle_destroy(nh);
 	}
 DFE
@@ -1066,20 +1222,15 @@ svd_r_get_params(int status, char const *phrase, nua_t * nua, svd_t * svd,
 	char const * l_sdp_str = NULL;
 	ab_chan_t * chan;
 	svd_chan_t * chan_ctx;
-	int i;
 DFS
-	for (i=0; i<g_conf.channels; i++) {
-	  chan = &svd->ab->chans[i];
-	  chan_ctx = chan->ctx;
-	  if (chan_ctx->op_handle == nh)
-	    break;
-	}  
+	chan_ctx = svd_nh_chan (svd, nh);
 	
 	/* no channel for this handle, ignore */
-	if (chan_ctx->op_handle != nh) {
+	if ( !chan_ctx) {
 		SU_DEBUG_4(("svd_r_get_params: no channel with this handle, ignoring\n" VA_NONE));
 		goto __exit;
 	}
+	chan = &svd->ab->chans[chan_ctx->chan_idx];
 	
 	tl_gets( tags, SOATAG_LOCAL_SDP_STR_REF(l_sdp_str),
 			TAG_NULL() );
@@ -1188,9 +1339,14 @@ reg_timer_cb (su_root_magic_t *magic, su_timer_t *t, su_timer_arg_t *arg)
 {/*{{{*/
 	svd_t * svd = magic;
 	sip_account_t * account = arg;
-	
-	SU_DEBUG_3(("Retrying registration to %s, user_URI %s\n", account->registrar, account->user_URI));
-	svd_register(svd,account);
+	unsigned long long loop_start;
+
+	loop_start = svd_loop_enter (loop_cb_REG_TMR, account->reg_due);
+	if (account->enabled) {
+		SU_DEBUG_3(("Retrying registration to %s, user_URI %s\n", account->registrar, account->user_URI));
+		svd_register(svd,account);
+	}
+	svd_loop_leave (loop_cb_REG_TMR, loop_start);
 }/*}}}*/
 
 /**
@@ -1211,7 +1367,16 @@ svd_r_register(int status, char const *phrase, nua_t * nua, svd_t * svd,
 		nua_handle_t * nh, sip_account_t * account, sip_t const *sip,
 		tagi_t tags[], int const is_register)
 {/*{{{*/
+	unsigned char was_registered = account->registered;
+	int acc_idx;
 DFS
+	for (acc_idx=0; acc_idx<su_vector_len(g_conf.sip_account); acc_idx++){
+		if(su_vector_item(g_conf.sip_account, acc_idx) == account){
+			break;
+		}
+	}
+	svd_flight_put (flight_type_REG, -1, acc_idx, status, nh);
+
 	if(is_register){
 		SU_DEBUG_3(("REGISTER: %03d %s\n", status, phrase));
 	} else {
@@ -1239,7 +1404,16 @@ DFS
 					(sip_header_t*)m);
 		}
 		account->registered = is_register;
-		if( !is_register){
+		if(is_register){
+			svd_boot_registered ();
+		}
+		if( !is_register && account->enabled){
+			/* the new registration goes on the new handle (new user
+			 * and registrar after the reload) */
+			if (nh == account->op_reg){
+				nua_handle_destroy (nh);
+				account->op_reg = NULL;
+			}
 			sleep(1);
 			svd_register (svd, account);
 		}
@@ -1249,9 +1423,23 @@ DFS
 		//retry registration after 30 seconds
 		nua_handle_destroy (nh);
 		account->op_reg = NULL;
+		account->reg_due = svd_loop_now() + REG_RETRY_MS * 1000ULL;
 		su_timer_set(account->reg_tmr, reg_timer_cb, account);
 	}
-	/* update voip led */
+	if(was_registered != account->registered){
+		svd_flight_put (account->registered ? flight_type_REG_UP :
+				flight_type_REG_DOWN, -1, acc_idx, status, nh);
+	}
+	svd_voip_led ();
+DFE
+}/*}}}*/
+
+/**
+ * Turn the voip led on if some account is registered, off otherwise.
+ */
+static void
+svd_voip_led (void)
+{/*{{{*/
 	if (g_conf.voip_led) {
 		int registered = 0;
 		int i;
@@ -1267,7 +1455,46 @@ DFS
 		else
 			led_off(g_conf.voip_led);
 	}
-DFE
+}/*}}}*/
+
+/**
+ * Remember the Call-ID, the remote target and our last CSeq of the call.
+ *
+ * \param[in] svd 		context pointer.
+ * \param[in] nh 		event handle.
+ * \param[in] event 	occured event.
+ * \param[in] sip 		sip headers of the event.
+ * \remark
+ *		NUA keeps the dialog to itself, the handoff rebuilds it from these
+ *		(\ref svd_handoff_start()). The responses we get are to our own
+ *		requests, so their CSeq is ours.
+ */
+static void
+svd_call_track (svd_t * const svd, nua_handle_t const * const nh,
+		nua_event_t const event, sip_t const * const sip)
+{/*{{{*/
+	svd_call_t * call = svd_call_find (svd, nh);
+
+	if( !call || call->adopted){
+		return;
+	}
+	if( !call->call_id && sip->sip_call_id){
+		call->call_id = su_strdup (call->home, sip->sip_call_id->i_id);
+	}
+	if(sip->sip_contact &&
+			(event == nua_i_invite || event == nua_r_invite)){
+		char * contact = url_as_string (call->home, sip->sip_contact->m_url);
+		if(contact){
+			if(call->contact){
+				su_free (call->home, call->contact);
+			}
+			call->contact = contact;
+		}
+	}
+	if(sip->sip_status && sip->sip_cseq &&
+			sip->sip_cseq->cs_seq > call->cseq){
+		call->cseq = sip->sip_cseq->cs_seq;
+	}
 }/*}}}*/
 
 /**
@@ -1292,23 +1519,17 @@ svd_r_invite( int status, char const *phrase, nua_t * nua, svd_t * svd,
 	ab_chan_t * chan;
 	svd_chan_t * chan_ctx;
 	sip_account_t * account;
-	int i;
 DFS
 	SU_DEBUG_3(("got answer on INVITE: %03d %s\n", status, phrase));
 
-	for (i=0; i<g_conf.channels; i++) {
-		chan = &svd->ab->chans[i];
-		chan_ctx = chan->ctx;
-		if (chan_ctx->op_handle == nh) 
-		  break;
-	}
-	
-	if (chan_ctx->op_handle != nh) {
+	chan_ctx = svd_nh_chan (svd, nh);
+	if ( !chan_ctx) {
 		SU_DEBUG_0(("svd_r_invite, no channel with this handle, ignoring!\n" VA_NONE));
 		goto __exit;
 	}
+	chan = &svd->ab->chans[chan_ctx->chan_idx];
 	  
-	account = chan_ctx->account;
+	account = chan_ctx->call->account;
 	if (status >= 300) {
 		if (status == 401 || status == 407) {
 			svd_authenticate (svd, account, nh, sip, tags);
@@ -1403,36 +1624,42 @@ DFS
 
 	if (sdp_sess && sdp_sess->sdp_media->m_port &&
 			sdp_connection && sdp_connection->c_address) {
-		/* if this is an incoming call, potentially more than one channel
-		can answer, so we set sdp parameters for all channels involved in
-		this call (checking the nua handle) */
-		int i;
-		for (i=0; i<g_conf.channels; i++) {
-			ab_chan_t * chan = &svd->ab->chans[i];
-			svd_chan_t * chan_ctx = chan->ctx;
-			if (chan_ctx->op_handle == nh) {
-				chan_ctx->remote_port = sdp_sess->sdp_media->m_port;
-				chan_ctx->remote_host = su_strdup(svd->home,sdp_connection->c_address);
-				chan_ctx->sdp_payload = sdp_sess->sdp_media->m_rtpmaps->rm_pt;
-				memset(chan_ctx->sdp_cod_name, 0, sizeof(chan_ctx->sdp_cod_name));
-				if(strlen(sdp_sess->sdp_media->m_rtpmaps->rm_encoding) <
-						sizeof(chan_ctx->sdp_cod_name)){
-					strcpy(chan_ctx->sdp_cod_name,
-							sdp_sess->sdp_media->m_rtpmaps->rm_encoding);
-				} else {
-					SU_DEBUG_0(("ERROR: SDP CODNAME string size too small\n" VA_NONE));
-					goto __exit;
-				}
-				svd_set_te_codec(sdp_sess, chan_ctx->account, chan_ctx);
-				SU_DEBUG_5(("Set parameters for channel %d, remote %s:%d with coder/payload [%s/%d], fmtp: %s, telephone-event: %d\n",
-						i,
-						chan_ctx->remote_host,
-						chan_ctx->remote_port,
-						chan_ctx->sdp_cod_name,
-						chan_ctx->sdp_payload,
-						sdp_sess->sdp_media->m_rtpmaps->rm_fmtp,
-						chan_ctx->te_payload));
+		/* remote address is the call one, but if this is an incoming
+		call, potentially more than one channel can answer, so we set
+		codec parameters for all channels involved in this call */
+		svd_call_t * call = svd_call_find (svd, nh);
+		svd_chan_t * chan_ctx;
+		if ( !call) {
+			goto __exit;
+		}
+		call->remote_port = sdp_sess->sdp_media->m_port;
+		if (call->remote_host) {
+			su_free (call->home, call->remote_host);
+		}
+		call->remote_host = su_strdup(call->home, sdp_connection->c_address);
+		/* c=IN IP4 / IP6 both go to the same dual-stack socket */
+		svd_media_remote_set (call);
+		for (chan_ctx = call->chans; chan_ctx; chan_ctx = chan_ctx->call_next) {
+			int i = chan_ctx->chan_idx;
+			chan_ctx->sdp_payload = sdp_sess->sdp_media->m_rtpmaps->rm_pt;
+			memset(chan_ctx->sdp_cod_name, 0, sizeof(chan_ctx->sdp_cod_name));
+			if(strlen(sdp_sess->sdp_media->m_rtpmaps->rm_encoding) <
+					sizeof(chan_ctx->sdp_cod_name)){
+				strcpy(chan_ctx->sdp_cod_name,
+						sdp_sess->sdp_media->m_rtpmaps->rm_encoding);
+			} else {
+				SU_DEBUG_0(("ERROR: SDP CODNAME string size too small\n" VA_NONE));
+				goto __exit;
 			}
+			svd_set_te_codec(sdp_sess, call->account, chan_ctx);
+			SU_DEBUG_5(("Set parameters for channel %d, remote %s:%d with coder/payload [%s/%d], fmtp: %s, telephone-event: %d\n",
+					i,
+					call->remote_host,
+					call->remote_port,
+					chan_ctx->sdp_cod_name,
+					chan_ctx->sdp_payload,
+					sdp_sess->sdp_media->m_rtpmaps->rm_fmtp,
+					chan_ctx->te_payload));
 		}
 	}
 __exit:
@@ -1445,12 +1672,19 @@ DFE
 /**
  * Creates SDP string for given channel context.
  *
+ * \param[in] 	home	home to allocate the string (call arena).
  * \param[in] 	chan	channel with connection parameters.
+ * \param[in] 	account	account of the call.
+ * \param[in] 	remote_af	family of the offer (AF_UNSPEC for our offer).
  * \remark
- * 		Memory should be freed outside of the function.
+ * 		Memory should be freed outside of the function (or with the call).
+ * 		IPv6 media gets its "c=IN IP6" line here, IPv4 one is added by
+ * 		the SOA. The answer follows the offer family, our offer is IPv6
+ * 		only if the RTP interface has no IPv4 address.
  */
 static char *
-svd_new_sdp_string (ab_chan_t const * const chan, sip_account_t const * const account)
+svd_new_sdp_string (su_home_t * const home, ab_chan_t const * const chan,
+		sip_account_t const * const account, int const remote_af)
 {/*{{{*/
 	svd_chan_t * ctx = chan->ctx;
 	char * ret_str = NULL;
@@ -1458,6 +1692,8 @@ svd_new_sdp_string (ab_chan_t const * const chan, sip_account_t const * const ac
 	int ltmp;
 	int i;
 	long media_port = ctx->rtp_port;
+	char c_addr [INET6_ADDRSTRLEN] = {0,};
+	int af = remote_af;
 
 #if 0
 	FOR EXAMPLE
@@ -1468,16 +1704,30 @@ svd_new_sdp_string (ab_chan_t const * const chan, sip_account_t const * const ac
 "a=rtpmap:0 PCMU/8000\r\n"
 #endif
 
-	ret_str = malloc (SDP_STR_MAX_LEN);
+	ret_str = su_zalloc (home, SDP_STR_MAX_LEN);
 	if( !ret_str){
 		SU_DEBUG_1 ((LOG_FNC_A(LOG_NOMEM_A("sdp_str"))));
 		goto __exit_fail;
 	}
-	memset (ret_str, 0, SDP_STR_MAX_LEN);
+
+	if(af == AF_UNSPEC && svd_addr_local (account->rtp_interface,
+			AF_INET, NULL, 0)){
+		af = AF_INET6;
+	}
+	if(af == AF_INET6 && (svd_media_af () != AF_INET6 ||
+			svd_addr_local (account->rtp_interface, AF_INET6,
+			c_addr, sizeof(c_addr)))){
+		SU_DEBUG_2 (("No IPv6 media address on %s\n",
+				account->rtp_interface ? account->rtp_interface : "any"));
+		c_addr[0] = '\0';
+	}
 
 	ltmp = snprintf (ret_str, limit,
 			"v=0\r\n"
-			"m=audio %ld RTP/AVP",media_port);
+			"%s%s%s"
+			"m=audio %ld RTP/AVP",
+			c_addr[0] ? "c=IN IP6 " : "", c_addr, c_addr[0] ? "\r\n" : "",
+			media_port);
 	if(ltmp > -1 && ltmp < limit){
 		limit -= ltmp;
 	} else {
@@ -1556,7 +1806,7 @@ svd_new_sdp_string (ab_chan_t const * const chan, sip_account_t const * const ac
 
 	return ret_str;
 __exit_fail_allocated:
-	free(ret_str);
+	su_free(home, ret_str);
 __exit_fail:
 	return NULL;
 }/*}}}*/
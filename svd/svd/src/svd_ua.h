@@ -12,6 +12,8 @@
 
 /** Use first free fxo channel on self router - marker */
 #define FIRST_FREE_FXO "fxo"
+/** Registration retry timeout (ms).*/
+#define REG_RETRY_MS 30000
 
 /** @defgroup UAC_P User Agent Client interface.
  *  @ingroup UA_MAIN
@@ -27,6 +29,12 @@ int  svd_answer (svd_t * const svd, ab_chan_t * const chan,
 void svd_bye (svd_t * const svd, ab_chan_t * const chan);
 /** Make un-REGISTER and REGISTER again on SIP server.*/
 void svd_refresh_registration (svd_t * const svd);
+/** Make un-REGISTER and REGISTER again for one account.*/
+void svd_account_register (svd_t * const svd, sip_account_t * const account);
+/** Make REGISTER of the account registered by the previous svd.*/
+void svd_account_continue (svd_t * const svd, sip_account_t * const account);
+/** Make un-REGISTER for the disabled account.*/
+void svd_account_unregister (svd_t * const svd, sip_account_t * const account);
 /** Shutdown SIP stack.*/
 void svd_shutdown (svd_t * const svd);
 /** @}*/
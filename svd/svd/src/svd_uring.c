@@ -0,0 +1,948 @@
+/**
+ * @file svd_uring.c
+ * io_uring media engine implementation.
+ * It containes the ring setup on the raw system calls (the firmware
+ * 		toolchains have no liburing), the completions handler and the relay.
+ */
+
+/* Includes {{{ */
+#include "svd.h"
+#include "svd_loop.h"
+#include "svd_rec.h"
+#include "svd_uring.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#ifdef SVD_URING
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+/*}}}*/
+
+#ifdef SVD_URING
+
+/** Operations (user_data bits 0-7).*/
+enum uring_op_e {/*{{{*/
+	uring_op_LOCAL_RX, /**< Receive from the channel stream */
+	uring_op_REMOTE_RX, /**< Multishot recv from the RTP socket */
+	uring_op_SEND, /**< Send to the remote */
+	uring_op_WRITE, /**< Write to the channel stream */
+	uring_op_CANCEL, /**< Cancel of the channel receive */
+	uring_op_PROBE, /**< Multishot recv check on the setup */
+};/*}}}*/
+
+/** Make user_data of the operation, channel generation, channel and buffer.*/
+#define UR_UD(op,gen,ch,bid) ((__u64)(op) | ((__u64)(gen) << 8) | \
+		((__u64)(ch) << 16) | ((__u64)(bid) << 32))
+/** Operation of user_data.*/
+#define UR_UD_OP(ud) ((int)((ud) & 0xFF))
+/** Channel generation of user_data.*/
+#define UR_UD_GEN(ud) ((unsigned char)(((ud) >> 8) & 0xFF))
+/** Channel of user_data.*/
+#define UR_UD_CH(ud) ((int)(((ud) >> 16) & 0xFFFF))
+/** Buffer of user_data.*/
+#define UR_UD_BID(ud) ((unsigned)(((ud) >> 32) & 0xFFFF))
+/** Provided buffers group.*/
+#define UR_BGID 0
+/** Offset of the stream read and write (current position).*/
+#define UR_OFF_CUR ((__u64)-1)
+
+/** Send state of the buffer.*/
+struct ur_slot_s {/*{{{*/
+	struct msghdr msg; /**< sendmsg() header.*/
+	struct iovec iov; /**< Packet in the buffer.*/
+	struct sockaddr_storage addr; /**< Remote (the call can end before).*/
+};/*}}}*/
+
+/** Channel state.*/
+struct ur_chan_s {/*{{{*/
+	unsigned char on; /**< Receives are armed.*/
+	unsigned char gen; /**< Generation, completions of the older are skipped.*/
+	unsigned char local_sock; /**< Stream is a socket (multishot recv).*/
+	unsigned char local_wait; /**< Stream receive waits for the free entry.*/
+	unsigned char remote_wait; /**< Socket receive waits for the free entry.*/
+};/*}}}*/
+
+/** Engine context.*/
+static struct {/*{{{*/
+	int fd; /**< Ring or -1.*/
+	svd_t * svd; /**< svd with the board.*/
+	int wait_idx; /**< Root wait of the ring or -1.*/
+	void * sq_ptr; /**< Submission ring mapping.*/
+	size_t sq_len; /**< Submission ring mapping length.*/
+	void * cq_ptr; /**< Completion ring mapping (can be sq_ptr).*/
+	size_t cq_len; /**< Completion ring mapping length.*/
+	struct io_uring_sqe * sqes; /**< Submission entries.*/
+	size_t sqes_len; /**< Submission entries mapping length.*/
+	unsigned * sq_head; /**< Submission ring head (kernel).*/
+	unsigned * sq_tail; /**< Submission ring tail.*/
+	unsigned * sq_flags; /**< Submission ring flags (kernel).*/
+	unsigned sq_mask; /**< Submission ring mask.*/
+	unsigned sq_entries; /**< Submission ring size.*/
+	unsigned sq_local; /**< Tail of the filled entries.*/
+	unsigned to_submit; /**< Filled entries not taken by the kernel.*/
+	unsigned * cq_head; /**< Completion ring head.*/
+	unsigned * cq_tail; /**< Completion ring tail (kernel).*/
+	unsigned cq_mask; /**< Completion ring mask.*/
+	struct io_uring_cqe * cqes; /**< Completion entries.*/
+	struct io_uring_buf_ring * br; /**< Provided buffer ring.*/
+	unsigned short br_tail; /**< Provided buffer ring tail.*/
+	unsigned bufs_free; /**< Buffers in the provided ring.*/
+	unsigned char * bufs; /**< Buffers (one registered buffer).*/
+	struct ur_slot_s * slots; /**< Send state per buffer.*/
+	struct ur_chan_s * chans; /**< Channels state.*/
+	int chans_num; /**< Channels count.*/
+	unsigned char starved; /**< Some receive waits for the free entry.*/
+	int probe_res; /**< Result of the probe receive.*/
+	unsigned char probe_more; /**< Probe receive is still armed.*/
+	struct uring_stat_s st; /**< Statistics.*/
+} g_ur = { .fd = -1, .wait_idx = -1 };/*}}}*/
+
+/** Map the rings.*/
+static int ur_map (struct io_uring_params const * const p);
+/** Unmap the rings and free the buffers.*/
+static void ur_free (void);
+/** Get the free submission entry.*/
+static struct io_uring_sqe * ur_sqe (void);
+/** Submit the filled entries.*/
+static int ur_submit (unsigned const wait);
+/** Return the buffer to the provided ring.*/
+static void ur_buf_put (unsigned const bid);
+/** Arm the channel receive.*/
+static void ur_arm (int const idx, int const local);
+/** Send the channel packet to the remote.*/
+static void ur_to_net (int const idx, unsigned const bid, int const len);
+/** Write the remote packet to the channel.*/
+static void ur_to_board (int const idx, unsigned const bid, int const len);
+/** Handle one completion.*/
+static void ur_cqe (struct io_uring_cqe const * const cqe);
+/** Handle all completions.*/
+static void ur_reap (void);
+/** Rearm the receives that wait for the free entry.*/
+static void ur_rearm (void);
+/** Check that the kernel has multishot recv.*/
+static int ur_probe (void);
+/** Ring wait callback.*/
+static int ur_cb (su_root_magic_t * root, su_wait_t * w,
+		su_wakeup_arg_t * arg);
+
+/**
+ * Set up the ring and attach it to the root.
+ *
+ * \param[in] svd 	svd with the root and the board.
+ * \retval 0 	etherything is fine
+ * \retval -1 	the ring is not available, use the root handlers
+ */
+int
+svd_uring_init (svd_t * const svd)
+{/*{{{*/
+	struct io_uring_params p;
+	struct io_uring_buf_reg reg;
+	struct iovec iov;
+	su_wait_t wait[1];
+	unsigned i;
+	int ret;
+
+	g_ur.svd = svd;
+	g_ur.chans_num = svd->ab->chans_num;
+	g_ur.chans = calloc(g_ur.chans_num, sizeof(*g_ur.chans));
+	g_ur.slots = calloc(URING_BUFS, sizeof(*g_ur.slots));
+	if( !g_ur.chans || !g_ur.slots){
+		SU_DEBUG_1 ((LOG_FNC_A (LOG_NOMEM_A("uring") ) ));
+		goto __exit_fail;
+	}
+
+	memset(&p, 0, sizeof(p));
+	p.flags = IORING_SETUP_CQSIZE;
+	p.cq_entries = URING_ENTRIES * 4;
+	g_ur.fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+	if(g_ur.fd < 0){
+		SU_DEBUG_2 (("io_uring_setup() : %s\n", strerror(errno)));
+		g_ur.fd = -1;
+		goto __exit_fail;
+	}
+	if(ur_map (&p)){
+		goto __exit_fail;
+	}
+
+	/* buffers, the writes to the streams use them as registered */
+	g_ur.bufs = mmap(NULL, URING_BUFS * URING_BUF_SIZE,
+			PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(g_ur.bufs == MAP_FAILED){
+		g_ur.bufs = NULL;
+		SU_DEBUG_1 ((LOG_FNC_A (LOG_NOMEM_A("uring buffers") ) ));
+		goto __exit_fail;
+	}
+	iov.iov_base = g_ur.bufs;
+	iov.iov_len = URING_BUFS * URING_BUF_SIZE;
+	if(syscall(__NR_io_uring_register, g_ur.fd, IORING_REGISTER_BUFFERS,
+			&iov, 1)){
+		SU_DEBUG_2 (("io_uring register buffers : %s\n", strerror(errno)));
+		goto __exit_fail;
+	}
+
+	/* provided buffer ring (5.19+) */
+	g_ur.br = mmap(NULL, URING_BUFS * sizeof(struct io_uring_buf),
+			PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(g_ur.br == MAP_FAILED){
+		g_ur.br = NULL;
+		SU_DEBUG_1 ((LOG_FNC_A (LOG_NOMEM_A("uring buffer ring") ) ));
+		goto __exit_fail;
+	}
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (unsigned long)g_ur.br;
+	reg.ring_entries = URING_BUFS;
+	reg.bgid = UR_BGID;
+	if(syscall(__NR_io_uring_register, g_ur.fd, IORING_REGISTER_PBUF_RING,
+			&reg, 1)){
+		SU_DEBUG_2 (("io_uring buffer ring : %s\n", strerror(errno)));
+		goto __exit_fail;
+	}
+	for (i=0; i<URING_BUFS; i++){
+		ur_buf_put (i);
+	}
+	g_ur.st.bufs_min = g_ur.bufs_free;
+
+	/* multishot recv (6.0+) */
+	if(ur_probe ()){
+		goto __exit_fail;
+	}
+
+	ret = su_wait_create(wait, g_ur.fd, SU_WAIT_IN);
+	if (ret){
+		SU_DEBUG_0 ((LOG_FNC_A ("su_wait_create() fails" ) ));
+		goto __exit_fail;
+	}
+	ret = su_root_register (svd->root, wait, ur_cb, NULL, 0);
+	if (ret == -1){
+		SU_DEBUG_0 ((LOG_FNC_A ("su_root_register() fails" ) ));
+		goto __exit_fail;
+	}
+	g_ur.wait_idx = ret;
+	SU_DEBUG_3 (("Media engine: uring, %u entries, %d buffers\n",
+			g_ur.sq_entries, URING_BUFS));
+	return 0;
+__exit_fail:
+	ur_free ();
+	return -1;
+}/*}}}*/
+
+/**
+ * Detach the ring and free it.
+ *
+ * \remark
+ * 		The channels should be deleted before, the handoff calls it
+ * 		before the exec, so the sockets are not read by the old svd.
+ */
+void
+svd_uring_destroy (void)
+{/*{{{*/
+	if(g_ur.wait_idx != -1){
+		su_root_deregister (g_ur.svd->root, g_ur.wait_idx);
+		g_ur.wait_idx = -1;
+	}
+	ur_free ();
+}/*}}}*/
+
+/**
+ * Check if the engine is on.
+ *
+ * \return 	not 0 if the channels should use the ring.
+ */
+int
+svd_uring_on (void)
+{/*{{{*/
+	return g_ur.wait_idx != -1;
+}/*}}}*/
+
+/**
+ * Arm the receives of the channel.
+ *
+ * \param[in] chan 	channel with the stream and the RTP socket.
+ * \retval 0 	etherything is fine
+ * \retval -1 	error occures
+ */
+int
+svd_uring_chan_add (ab_chan_t * const chan)
+{/*{{{*/
+	svd_chan_t * const ctx = chan->ctx;
+	int const idx = ctx->chan_idx;
+	struct ur_chan_s * c;
+	struct stat st;
+
+	if( !svd_uring_on () || idx < 0 || idx >= g_ur.chans_num){
+		return -1;
+	}
+	c = &g_ur.chans[idx];
+	c->local_sock = !fstat(chan->rtp_fd, &st) && S_ISSOCK(st.st_mode);
+	c->on = 1;
+	ur_arm (idx, 1);
+	ur_arm (idx, 0);
+	return ur_submit (0);
+}/*}}}*/
+
+/**
+ * Cancel the receives of the channel.
+ *
+ * \param[in] chan 	channel.
+ * \remark
+ * 		The cancels are submitted at once, the descriptors can be closed
+ * 		after it. The late completions of the channel are skipped by the
+ * 		generation.
+ */
+void
+svd_uring_chan_del (ab_chan_t * const chan)
+{/*{{{*/
+	svd_chan_t * const ctx = chan->ctx;
+	int const idx = ctx->chan_idx;
+	struct ur_chan_s * c;
+	struct io_uring_sqe * sqe;
+	int local;
+
+	if( !svd_uring_on () || idx < 0 || idx >= g_ur.chans_num){
+		return;
+	}
+	c = &g_ur.chans[idx];
+	if( !c->on){
+		return;
+	}
+	for (local=0; local<2; local++){
+		sqe = ur_sqe ();
+		if( !sqe){
+			break;
+		}
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->fd = -1;
+		sqe->addr = UR_UD(local ? uring_op_LOCAL_RX : uring_op_REMOTE_RX,
+				c->gen, idx, 0);
+		sqe->user_data = UR_UD(uring_op_CANCEL, c->gen, idx, 0);
+	}
+	c->on = 0;
+	c->local_wait = 0;
+	c->remote_wait = 0;
+	c->gen++;
+	ur_submit (0);
+}/*}}}*/
+
+/**
+ * Get the engine statistics.
+ *
+ * \return 	statistics (zero if the engine is off).
+ */
+struct uring_stat_s const *
+svd_uring_stat (void)
+{/*{{{*/
+	return &g_ur.st;
+}/*}}}*/
+
+/**
+ * Map the rings.
+ *
+ * \param[in] p 	parameters from io_uring_setup().
+ * \retval 0 	etherything is fine
+ * \retval -1 	error occures
+ */
+static int
+ur_map (struct io_uring_params const * const p)
+{/*{{{*/
+	unsigned char * sq;
+	unsigned char * cq;
+	unsigned * array;
+	unsigned i;
+
+	g_ur.sq_len = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+	g_ur.cq_len = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+	if(p->features & IORING_FEAT_SINGLE_MMAP){
+		if(g_ur.cq_len > g_ur.sq_len){
+			g_ur.sq_len = g_ur.cq_len;
+		}
+		g_ur.cq_len = g_ur.sq_len;
+	}
+	g_ur.sq_ptr = mmap(NULL, g_ur.sq_len, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, g_ur.fd, IORING_OFF_SQ_RING);
+	if(g_ur.sq_ptr == MAP_FAILED){
+		g_ur.sq_ptr = NULL;
+		goto __exit_fail;
+	}
+	if(p->features & IORING_FEAT_SINGLE_MMAP){
+		g_ur.cq_ptr = g_ur.sq_ptr;
+	} else {
+		g_ur.cq_ptr = mmap(NULL, g_ur.cq_len, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, g_ur.fd, IORING_OFF_CQ_RING);
+		if(g_ur.cq_ptr == MAP_FAILED){
+			g_ur.cq_ptr = NULL;
+			goto __exit_fail;
+		}
+	}
+	g_ur.sqes_len = p->sq_entries * sizeof(struct io_uring_sqe);
+	g_ur.sqes = mmap(NULL, g_ur.sqes_len, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, g_ur.fd, IORING_OFF_SQES);
+	if(g_ur.sqes == MAP_FAILED){
+		g_ur.sqes = NULL;
+		goto __exit_fail;
+	}
+
+	sq = g_ur.sq_ptr;
+	g_ur.sq_head = (unsigned *)(sq + p->sq_off.head);
+	g_ur.sq_tail = (unsigned *)(sq + p->sq_off.tail);
+	g_ur.sq_flags = (unsigned *)(sq + p->sq_off.flags);
+	g_ur.sq_mask = *(unsigned *)(sq + p->sq_off.ring_mask);
+	g_ur.sq_entries = p->sq_entries;
+	g_ur.sq_local = *g_ur.sq_tail;
+	/* entries are used in the ring order */
+	array = (unsigned *)(sq + p->sq_off.array);
+	for (i=0; i<p->sq_entries; i++){
+		array[i] = i;
+	}
+
+	cq = g_ur.cq_ptr;
+	g_ur.cq_head = (unsigned *)(cq + p->cq_off.head);
+	g_ur.cq_tail = (unsigned *)(cq + p->cq_off.tail);
+	g_ur.cq_mask = *(unsigned *)(cq + p->cq_off.ring_mask);
+	g_ur.cqes = (struct io_uring_cqe *)(cq + p->cq_off.cqes);
+	return 0;
+__exit_fail:
+	SU_DEBUG_1 (("io_uring mmap() : %s\n", strerror(errno)));
+	return -1;
+}/*}}}*/
+
+/**
+ * Unmap the rings and free the buffers.
+ *
+ * \remark
+ * 		Closing the ring cancels all its operations.
+ */
+static void
+ur_free (void)
+{/*{{{*/
+	if(g_ur.fd != -1){
+		close(g_ur.fd);
+		g_ur.fd = -1;
+	}
+	if(g_ur.sqes){
+		munmap(g_ur.sqes, g_ur.sqes_len);
+		g_ur.sqes = NULL;
+	}
+	if(g_ur.cq_ptr && g_ur.cq_ptr != g_ur.sq_ptr){
+		munmap(g_ur.cq_ptr, g_ur.cq_len);
+	}
+	g_ur.cq_ptr = NULL;
+	if(g_ur.sq_ptr){
+		munmap(g_ur.sq_ptr, g_ur.sq_len);
+		g_ur.sq_ptr = NULL;
+	}
+	if(g_ur.br){
+		munmap(g_ur.br, URING_BUFS * sizeof(struct io_uring_buf));
+		g_ur.br = NULL;
+	}
+	if(g_ur.bufs){
+		munmap(g_ur.bufs, URING_BUFS * URING_BUF_SIZE);
+		g_ur.bufs = NULL;
+	}
+	if(g_ur.slots){
+		free(g_ur.slots);
+		g_ur.slots = NULL;
+	}
+	if(g_ur.chans){
+		free(g_ur.chans);
+		g_ur.chans = NULL;
+	}
+	g_ur.chans_num = 0;
+	g_ur.br_tail = 0;
+	g_ur.bufs_free = 0;
+	g_ur.to_submit = 0;
+	g_ur.starved = 0;
+}/*}}}*/
+
+/**
+ * Get the free submission entry.
+ *
+ * \return 	zeroed entry or NULL if the ring is full.
+ * \remark
+ * 		The full ring is submitted and checked again.
+ */
+static struct io_uring_sqe *
+ur_sqe (void)
+{/*{{{*/
+	struct io_uring_sqe * sqe;
+	unsigned head;
+
+	head = __atomic_load_n(g_ur.sq_head, __ATOMIC_ACQUIRE);
+	if(g_ur.sq_local - head >= g_ur.sq_entries){
+		ur_submit (0);
+		head = __atomic_load_n(g_ur.sq_head, __ATOMIC_ACQUIRE);
+		if(g_ur.sq_local - head >= g_ur.sq_entries){
+			g_ur.st.errors++;
+			return NULL;
+		}
+	}
+	sqe = &g_ur.sqes[g_ur.sq_local & g_ur.sq_mask];
+	memset(sqe, 0, sizeof(*sqe));
+	g_ur.sq_local++;
+	g_ur.to_submit++;
+	return sqe;
+}/*}}}*/
+
+/**
+ * Submit the filled entries.
+ *
+ * \param[in] wait 	completions to wait for (0 - do not wait).
+ * \retval 0 	etherything is fine
+ * \retval -1 	error occures
+ * \remark
+ * 		The kernel is not entered without the entries, completions to
+ * 		wait or the overflowed completions.
+ */
+static int
+ur_submit (unsigned const wait)
+{/*{{{*/
+	unsigned flags = 0;
+	int ret;
+
+	__atomic_store_n(g_ur.sq_tail, g_ur.sq_local, __ATOMIC_RELEASE);
+	if(wait || (__atomic_load_n(g_ur.sq_flags, __ATOMIC_RELAXED) &
+			IORING_SQ_CQ_OVERFLOW)){
+		flags |= IORING_ENTER_GETEVENTS;
+	}
+	if( !g_ur.to_submit && !flags){
+		return 0;
+	}
+	do {
+		ret = syscall(__NR_io_uring_enter, g_ur.fd, g_ur.to_submit, wait,
+				flags, NULL, 0);
+	} while (ret < 0 && errno == EINTR);
+	g_ur.st.enters++;
+	if(ret < 0){
+		if(errno == EAGAIN || errno == EBUSY){
+			/* the rest goes with the next enter */
+			return 0;
+		}
+		SU_DEBUG_2 (("io_uring_enter() : %s\n", strerror(errno)));
+		return -1;
+	}
+	g_ur.to_submit -= ret;
+	return 0;
+}/*}}}*/
+
+/**
+ * Return the buffer to the provided ring.
+ *
+ * \param[in] bid 	buffer.
+ */
+static void
+ur_buf_put (unsigned const bid)
+{/*{{{*/
+	struct io_uring_buf * b = &g_ur.br->bufs[g_ur.br_tail & (URING_BUFS - 1)];
+
+	b->addr = (unsigned long)(g_ur.bufs + bid * URING_BUF_SIZE);
+	b->len = URING_BUF_SIZE;
+	b->bid = bid;
+	g_ur.br_tail++;
+	__atomic_store_n(&g_ur.br->tail, g_ur.br_tail, __ATOMIC_RELEASE);
+	g_ur.bufs_free++;
+}/*}}}*/
+
+/**
+ * Arm the channel receive.
+ *
+ * \param[in] idx 	channel.
+ * \param[in] local 	stream (1) or RTP socket (0).
+ * \remark
+ * 		Without the free entry the receive waits for \ref ur_rearm().
+ */
+static void
+ur_arm (int const idx, int const local)
+{/*{{{*/
+	ab_chan_t * const chan = &g_ur.svd->ab->chans[idx];
+	svd_chan_t * const ctx = chan->ctx;
+	struct ur_chan_s * const c = &g_ur.chans[idx];
+	struct io_uring_sqe * sqe;
+
+	sqe = ur_sqe ();
+	if( !sqe){
+		if(local){
+			c->local_wait = 1;
+		} else {
+			c->remote_wait = 1;
+		}
+		g_ur.starved = 1;
+		return;
+	}
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = UR_BGID;
+	if(local){
+		c->local_wait = 0;
+		sqe->fd = chan->rtp_fd;
+		sqe->user_data = UR_UD(uring_op_LOCAL_RX, c->gen, idx, 0);
+		if(c->local_sock){
+			sqe->opcode = IORING_OP_RECV;
+			sqe->ioprio = IORING_RECV_MULTISHOT;
+		} else {
+			/* TAPI stream is a character device, one read at a time */
+			sqe->opcode = IORING_OP_READ;
+			sqe->len = URING_BUF_SIZE;
+			sqe->off = UR_OFF_CUR;
+		}
+	} else {
+		c->remote_wait = 0;
+		sqe->fd = ctx->rtp_sfd;
+		sqe->user_data = UR_UD(uring_op_REMOTE_RX, c->gen, idx, 0);
+		sqe->opcode = IORING_OP_RECV;
+		sqe->ioprio = IORING_RECV_MULTISHOT;
+	}
+}/*}}}*/
+
+/**
+ * Send the channel packet to the remote.
+ *
+ * \param[in] idx 	channel.
+ * \param[in] bid 	buffer with the packet (owned from now).
+ * \param[in] len 	packet length.
+ */
+static void
+ur_to_net (int const idx, unsigned const bid, int const len)
+{/*{{{*/
+	svd_chan_t * const ctx = g_ur.svd->ab->chans[idx].ctx;
+	svd_call_t * const call = ctx->call;
+	struct ur_slot_s * const s = &g_ur.slots[bid];
+	unsigned char * const buf = g_ur.bufs + bid * URING_BUF_SIZE;
+	struct io_uring_sqe * sqe;
+
+	if( !call || !call->remote_addr_len){
+		g_ur.st.dropped++;
+		ur_buf_put (bid);
+		return;
+	}
+	sqe = ur_sqe ();
+	if( !sqe){
+		ur_buf_put (bid);
+		return;
+	}
+	memcpy(&s->addr, &call->remote_addr, call->remote_addr_len);
+	s->iov.iov_base = buf;
+	s->iov.iov_len = len;
+	memset(&s->msg, 0, sizeof(s->msg));
+	s->msg.msg_name = &s->addr;
+	s->msg.msg_namelen = call->remote_addr_len;
+	s->msg.msg_iov = &s->iov;
+	s->msg.msg_iovlen = 1;
+	sqe->opcode = IORING_OP_SENDMSG;
+	sqe->fd = ctx->rtp_sfd;
+	sqe->addr = (unsigned long)&s->msg;
+	sqe->len = 1;
+	sqe->user_data = UR_UD(uring_op_SEND, 0, idx, bid);
+	g_ur.st.to_net++;
+
+	if( !ctx->lat.t[lat_mark_FIRST_RTP]){
+		svd_lat_mark (&ctx->lat, lat_mark_FIRST_RTP);
+	}
+	if(svd_rec_on()){
+		svd_rec_rtp (idx, rec_rtp_dir_TX, buf, len);
+	}
+}/*}}}*/
+
+/**
+ * Write the remote packet to the channel.
+ *
+ * \param[in] idx 	channel.
+ * \param[in] bid 	buffer with the packet (owned from now).
+ * \param[in] len 	packet length.
+ */
+static void
+ur_to_board (int const idx, unsigned const bid, int const len)
+{/*{{{*/
+	ab_chan_t * const chan = &g_ur.svd->ab->chans[idx];
+	svd_chan_t * const ctx = chan->ctx;
+	unsigned char * const buf = g_ur.bufs + bid * URING_BUF_SIZE;
+	struct io_uring_sqe * sqe;
+
+	sqe = ur_sqe ();
+	if( !sqe){
+		ur_buf_put (bid);
+		return;
+	}
+	sqe->opcode = IORING_OP_WRITE_FIXED;
+	sqe->fd = chan->rtp_fd;
+	sqe->addr = (unsigned long)buf;
+	sqe->len = len;
+	sqe->off = UR_OFF_CUR;
+	sqe->buf_index = 0;
+	sqe->user_data = UR_UD(uring_op_WRITE, 0, idx, bid);
+	g_ur.st.to_board++;
+	ctx->rtp_rx++;
+
+	if(svd_rec_on()){
+		svd_rec_rtp (idx, rec_rtp_dir_RX, buf, len);
+	}
+}/*}}}*/
+
+/**
+ * Handle one completion.
+ *
+ * \param[in] cqe 	completion.
+ */
+static void
+ur_cqe (struct io_uring_cqe const * const cqe)
+{/*{{{*/
+	__u64 const ud = cqe->user_data;
+	int const op = UR_UD_OP(ud);
+	int const idx = UR_UD_CH(ud);
+	int const res = cqe->res;
+	int const more = cqe->flags & IORING_CQE_F_MORE;
+	int bid = -1;
+	int local;
+	int live;
+
+	if(cqe->flags & IORING_CQE_F_BUFFER){
+		bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+		g_ur.bufs_free--;
+		if(g_ur.bufs_free < g_ur.st.bufs_min){
+			g_ur.st.bufs_min = g_ur.bufs_free;
+		}
+	}
+
+	switch(op){
+	case uring_op_LOCAL_RX:
+	case uring_op_REMOTE_RX:
+		local = (op == uring_op_LOCAL_RX);
+		live = idx < g_ur.chans_num && g_ur.chans[idx].on &&
+				g_ur.chans[idx].gen == UR_UD_GEN(ud);
+		if(live && res > 0 && bid >= 0){
+			if(local){
+				ur_to_net (idx, bid, res);
+			} else {
+				ur_to_board (idx, bid, res);
+			}
+			bid = -1;
+		}
+		if(bid >= 0){
+			ur_buf_put (bid);
+		}
+		if( !live || more){
+			break;
+		}
+		if       (res == -ENOBUFS){
+			/* all buffers are in flight, the data waits in the socket */
+			g_ur.st.nobufs++;
+			if(local){
+				g_ur.chans[idx].local_wait = 1;
+			} else {
+				g_ur.chans[idx].remote_wait = 1;
+			}
+			g_ur.starved = 1;
+		} else if(res > 0 || res == -EAGAIN || res == -EINTR){
+			ur_arm (idx, local);
+		} else {
+			g_ur.st.errors++;
+			SU_DEBUG_2 (("uring: [%02d] %s receive stopped : %s\n", idx,
+					local ? "stream" : "socket",
+					res ? strerror(-res) : "end of stream"));
+		}
+		break;
+	case uring_op_SEND:
+	case uring_op_WRITE:
+		if(res < 0){
+			g_ur.st.errors++;
+			SU_DEBUG_2 (("uring: [%02d] %s : %s\n", idx,
+					op == uring_op_SEND ? "sendmsg()" : "write()",
+					strerror(-res)));
+		}
+		ur_buf_put (UR_UD_BID(ud));
+		break;
+	case uring_op_PROBE:
+		g_ur.probe_res = res;
+		g_ur.probe_more = more ? 1 : 0;
+		if(bid >= 0){
+			ur_buf_put (bid);
+		}
+		break;
+	default:
+		if(bid >= 0){
+			ur_buf_put (bid);
+		}
+		break;
+	}
+}/*}}}*/
+
+/**
+ * Handle all completions.
+ */
+static void
+ur_reap (void)
+{/*{{{*/
+	unsigned head = *g_ur.cq_head;
+	unsigned tail;
+
+	while (head != (tail = __atomic_load_n(g_ur.cq_tail, __ATOMIC_ACQUIRE))){
+		while (head != tail){
+			ur_cqe (&g_ur.cqes[head & g_ur.cq_mask]);
+			head++;
+			g_ur.st.cqes++;
+		}
+		__atomic_store_n(g_ur.cq_head, head, __ATOMIC_RELEASE);
+	}
+}/*}}}*/
+
+/**
+ * Rearm the receives that wait for the free entry or buffers.
+ */
+static void
+ur_rearm (void)
+{/*{{{*/
+	int i;
+
+	if( !g_ur.starved || !g_ur.bufs_free){
+		return;
+	}
+	g_ur.starved = 0;
+	for (i=0; i<g_ur.chans_num; i++){
+		struct ur_chan_s * const c = &g_ur.chans[i];
+		if( !c->on){
+			continue;
+		}
+		if(c->local_wait){
+			ur_arm (i, 1);
+		}
+		if(c->remote_wait){
+			ur_arm (i, 0);
+		}
+	}
+}/*}}}*/
+
+/**
+ * Check that the kernel has multishot recv with the buffer ring.
+ *
+ * \retval 0 	etherything is fine
+ * \retval -1 	the kernel is too old
+ */
+static int
+ur_probe (void)
+{/*{{{*/
+	struct io_uring_sqe * sqe;
+	int sv[2];
+	int err = -1;
+	int i;
+
+	if(socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, sv)){
+		SU_DEBUG_2 (("uring probe socketpair() : %s\n", strerror(errno)));
+		return -1;
+	}
+	sqe = ur_sqe ();
+	if( !sqe){
+		SU_DEBUG_2 (("uring probe : no free sqe\n" VA_NONE));
+		goto __exit;
+	}
+	sqe->opcode = IORING_OP_RECV;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = UR_BGID;
+	sqe->fd = sv[0];
+	sqe->user_data = UR_UD(uring_op_PROBE, 0, 0, 0);
+	g_ur.probe_res = 0;
+	g_ur.probe_more = 0;
+	if(write(sv[1], "p", 1) != 1 || ur_submit (1)){
+		goto __exit;
+	}
+	ur_reap ();
+	if(g_ur.probe_res != 1 || !g_ur.probe_more){
+		SU_DEBUG_2 (("Kernel has no multishot recv (%d)\n", g_ur.probe_res));
+		goto __exit;
+	}
+	err = 0;
+__exit:
+	if(g_ur.probe_more){
+		sqe = ur_sqe ();
+		if( !sqe){
+			/* the probe recv stays armed, the ring is not usable */
+			SU_DEBUG_2 (("uring probe cancel : no free sqe\n" VA_NONE));
+			err = -1;
+			goto __close;
+		}
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->fd = -1;
+		sqe->addr = UR_UD(uring_op_PROBE, 0, 0, 0);
+		sqe->user_data = UR_UD(uring_op_CANCEL, 0, 0, 0);
+		for (i=0; i<4 && g_ur.probe_more; i++){
+			ur_submit (1);
+			ur_reap ();
+		}
+	}
+__close:
+	close(sv[0]);
+	close(sv[1]);
+	return err;
+}/*}}}*/
+
+/**
+ * Ring wait callback.
+ *
+ * \param[in] root 	root magic (svd).
+ * \param[in] w 		ring wait.
+ * \param[in] arg 	not used.
+ * \return 	0
+ * \remark
+ * 		One wakeup handles all completions and submits all the next
+ * 		operations with one io_uring_enter().
+ */
+static int
+ur_cb (su_root_magic_t * root, su_wait_t * w, su_wakeup_arg_t * arg)
+{/*{{{*/
+	unsigned long long start;
+
+	start = svd_loop_enter (loop_cb_MEDIA_URING, 0);
+	g_ur.st.wakeups++;
+	ur_reap ();
+	ur_rearm ();
+	ur_submit (0);
+	svd_loop_leave (loop_cb_MEDIA_URING, start);
+	return 0;
+}/*}}}*/
+
+#else /* SVD_URING */
+
+/** Statistics of the engine that is not compiled in.*/
+static struct uring_stat_s g_ur_st;
+
+int
+svd_uring_init (svd_t * const svd)
+{/*{{{*/
+	SU_DEBUG_2 (("io_uring media engine is not compiled in "
+			"(configure --enable-uring)\n" VA_NONE));
+	return -1;
+}/*}}}*/
+
+void
+svd_uring_destroy (void)
+{/*{{{*/
+}/*}}}*/
+
+int
+svd_uring_on (void)
+{/*{{{*/
+	return 0;
+}/*}}}*/
+
+int
+svd_uring_chan_add (ab_chan_t * const chan)
+{/*{{{*/
+	return -1;
+}/*}}}*/
+
+void
+svd_uring_chan_del (ab_chan_t * const chan)
+{/*{{{*/
+}/*}}}*/
+
+struct uring_stat_s const *
+svd_uring_stat (void)
+{/*{{{*/
+	return &g_ur_st;
+}/*}}}*/
+
+#endif /* SVD_URING */
@@ -0,0 +1,60 @@
+/**
+ * @file svd_uring.h
+ * io_uring media engine.
+ * It containes the RTP relay on the io_uring (instead of the
+ * 		su_root handlers of every channel) and its statistics.
+ */
+#ifndef __SVD_URING_H__
+#define __SVD_URING_H__
+
+#include "svd.h"
+
+/** @defgroup URING io_uring media engine.
+ *  @ingroup MEDIA
+ *  With "option media_engine 'uring'" (and svd configured with
+ *  --enable-uring) all channels share one ring. The RTP sockets have the
+ *  multishot recv armed, the TAPI streams have the read armed (multishot
+ *  recv too if the stream is a socket, as on the simulated board), both
+ *  take the buffers from one provided buffer ring. The packet goes out
+ *  from the same buffer: sendmsg to the remote or write from the
+ *  registered buffer to the stream, the buffer returns to the ring on the
+ *  completion. The ring descriptor is the only wait on the su_root, every
+ *  wakeup reaps all completions and submits the next operations with one
+ *  io_uring_enter(). If the ring can`t be set up (old kernel, seccomp),
+ *  svd uses the su_root handlers per channel.
+ *  @{*/
+/** Submission queue entries.*/
+#define URING_ENTRIES 256
+/** Provided buffers count (power of 2).*/
+#define URING_BUFS 256
+/** Provided buffer size (maximum RTP packet).*/
+#define URING_BUF_SIZE 512
+
+/** Engine statistics.*/
+struct uring_stat_s {/*{{{*/
+	unsigned long long enters; /**< io_uring_enter() calls.*/
+	unsigned long long wakeups; /**< Ring handler calls.*/
+	unsigned long long cqes; /**< Reaped completions.*/
+	unsigned long long to_net; /**< Packets from the channels.*/
+	unsigned long long to_board; /**< Packets from the sockets.*/
+	unsigned long long dropped; /**< Channel packets without the remote.*/
+	unsigned long long nobufs; /**< Receives stopped by the empty ring.*/
+	unsigned long long errors; /**< Failed operations.*/
+	unsigned long bufs_min; /**< Fewest free buffers seen.*/
+};/*}}}*/
+
+/** Set up the ring and attach it to the root.*/
+int  svd_uring_init (svd_t * const svd);
+/** Detach the ring and free it.*/
+void svd_uring_destroy (void);
+/** Check if the engine is on.*/
+int  svd_uring_on (void);
+/** Arm the receives of the channel.*/
+int  svd_uring_chan_add (ab_chan_t * const chan);
+/** Cancel the receives of the channel.*/
+void svd_uring_chan_del (ab_chan_t * const chan);
+/** Get the engine statistics.*/
+struct uring_stat_s const * svd_uring_stat (void);
+/** @}*/
+
+#endif /* __SVD_URING_H__ */